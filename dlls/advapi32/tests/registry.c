@@ -2716,6 +2716,105 @@ static void test_delete_value(void)
        "expect ERROR_FILE_NOT_FOUND, got %i\n", res);
 }
 
+static void test_large_key(void)
+{
+    static const int count = 2000;
+    char name[32], prev[32];
+    DWORD i, j, len, num_keys, num_values;
+    LARGE_INTEGER start, end, freq;
+    HKEY hkey, subkey;
+    LONG res;
+
+    res = RegCreateKeyA( hkey_main, "LargeKey", &hkey );
+    ok( !res, "RegCreateKeyA failed: %d\n", res );
+    if (res) return;
+
+    /* insert in an order that is neither sorted nor reverse sorted */
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < count; i++)
+    {
+        j = (i * 7919) % count;
+        sprintf( name, "key%05u", j );
+        res = RegCreateKeyA( hkey, name, &subkey );
+        ok( !res, "RegCreateKeyA %s failed: %d\n", name, res );
+        RegCloseKey( subkey );
+        sprintf( name, "value%05u", j );
+        res = RegSetValueExA( hkey, name, 0, REG_DWORD, (const BYTE *)&j, sizeof(j) );
+        ok( !res, "RegSetValueExA %s failed: %d\n", name, res );
+    }
+    QueryPerformanceCounter( &end );
+    trace( "created %u subkeys and values in %u ms\n", count,
+           (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart) );
+
+    res = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &num_keys, NULL, NULL, &num_values,
+                            NULL, NULL, NULL, NULL );
+    ok( !res, "RegQueryInfoKeyA failed: %d\n", res );
+    ok( num_keys == count, "got %u subkeys\n", num_keys );
+    ok( num_values == count, "got %u values\n", num_values );
+
+    /* lookups are case insensitive */
+    for (i = 0; i < count; i += 97)
+    {
+        sprintf( name, "KEY%05u", i );
+        res = RegOpenKeyA( hkey, name, &subkey );
+        ok( !res, "RegOpenKeyA %s failed: %d\n", name, res );
+        RegCloseKey( subkey );
+        sprintf( name, "Value%05u", i );
+        len = sizeof(j);
+        res = RegQueryValueExA( hkey, name, NULL, NULL, (BYTE *)&j, &len );
+        ok( !res, "RegQueryValueExA %s failed: %d\n", name, res );
+        ok( j == i, "got %u for %s\n", j, name );
+    }
+    res = RegOpenKeyA( hkey, "key99999", &subkey );
+    ok( res == ERROR_FILE_NOT_FOUND, "RegOpenKeyA returned %d\n", res );
+
+    /* deleting some entries must keep the others reachable */
+    for (i = 0; i < count; i += 3)
+    {
+        sprintf( name, "key%05u", i );
+        res = RegDeleteKeyA( hkey, name );
+        ok( !res, "RegDeleteKeyA %s failed: %d\n", name, res );
+        sprintf( name, "value%05u", i );
+        res = RegDeleteValueA( hkey, name );
+        ok( !res, "RegDeleteValueA %s failed: %d\n", name, res );
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "key%05u", i );
+        res = RegOpenKeyA( hkey, name, &subkey );
+        ok( res == (i % 3 ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND), "RegOpenKeyA %s returned %d\n", name, res );
+        if (!res) RegCloseKey( subkey );
+    }
+
+    /* enumeration is still in sorted order */
+    prev[0] = 0;
+    for (i = 0; ; i++)
+    {
+        res = RegEnumKeyA( hkey, i, name, sizeof(name) );
+        if (res) break;
+        ok( lstrcmpiA( prev, name ) < 0, "%s enumerated after %s\n", name, prev );
+        strcpy( prev, name );
+    }
+    ok( res == ERROR_NO_MORE_ITEMS, "RegEnumKeyA failed: %d\n", res );
+    ok( i == count - (count + 2) / 3, "enumerated %u subkeys\n", i );
+
+    prev[0] = 0;
+    for (i = 0; ; i++)
+    {
+        len = sizeof(name);
+        res = RegEnumValueA( hkey, i, name, &len, NULL, NULL, NULL, NULL );
+        if (res) break;
+        ok( lstrcmpiA( prev, name ) < 0, "%s enumerated after %s\n", name, prev );
+        strcpy( prev, name );
+    }
+    ok( res == ERROR_NO_MORE_ITEMS, "RegEnumValueA failed: %d\n", res );
+    ok( i == count - (count + 2) / 3, "enumerated %u values\n", i );
+
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -2755,6 +2854,7 @@ START_TEST(registry)
     test_rw_order();
     test_deleted_key();
     test_delete_value();
+    test_large_key();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -48,6 +48,39 @@ WINE_DEFAULT_DEBUG_CHANNEL(reg);
 
 #define SHARED_DATA     ((KSHARED_USER_DATA*)0x7ffe0000)
 
+/******************************************************************************
+ *           GetTickCount64       (KERNEL32.@)
+ */
+ULONGLONG WINAPI GetTickCount64(void)
+{
+    LARGE_INTEGER counter, frequency;
+
+    NtQueryPerformanceCounter( &counter, &frequency );
+    return counter.QuadPart * 1000 / frequency.QuadPart;
+}
+
+
+/***********************************************************************
+ *           GetTickCount       (KERNEL32.@)
+ *
+ * Get the number of milliseconds the system has been running.
+ *
+ * PARAMS
+ *  None.
+ *
+ * RETURNS
+ *  The current tick count.
+ *
+ * NOTES
+ *  The value returned will wrap around every 2^32 milliseconds.
+ */
+DWORD WINAPI GetTickCount(void)
+{
+    /* ntdll reads the shared data once it is kept up to date */
+    return NtGetTickCount();
+}
+
+
 /****************************************************************************
  *		QueryPerformanceCounter (KERNEL32.@)
  *
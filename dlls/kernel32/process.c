@@ -3814,9 +3814,49 @@ BOOL WINAPI GetLogicalProcessorInformation(PSYSTEM_LOGICAL_PROCESSOR_INFORMATION
  */
 BOOL WINAPI GetLogicalProcessorInformationEx(LOGICAL_PROCESSOR_RELATIONSHIP relationship, PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX buffer, PDWORD pBufLen)
 {
-    FIXME("(%u,%p,%p): stub\n", relationship, buffer, pBufLen);
-    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
-    return FALSE;
+    NTSTATUS status;
+
+    TRACE("(%u,%p,%p)\n", relationship, buffer, pBufLen);
+
+    if(!pBufLen)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    status = NtQuerySystemInformationEx( SystemLogicalProcessorInformationEx, &relationship, sizeof(relationship),
+                                         buffer, *pBufLen, pBufLen );
+
+    if (status == STATUS_INFO_LENGTH_MISMATCH)
+    {
+        SetLastError( ERROR_INSUFFICIENT_BUFFER );
+        return FALSE;
+    }
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( RtlNtStatusToDosError( status ) );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* retrieve the NUMA node records, the returned buffer must be freed by the caller */
+static SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *get_numa_nodes( DWORD *len )
+{
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = NULL;
+
+    *len = 0;
+    while (!GetLogicalProcessorInformationEx( RelationNumaNode, info, len ))
+    {
+        HeapFree( GetProcessHeap(), 0, info );
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) return NULL;
+        if (!(info = HeapAlloc( GetProcessHeap(), 0, *len )))
+        {
+            SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+            return NULL;
+        }
+    }
+    return info;
 }
 
 /***********************************************************************
@@ -3911,9 +3951,20 @@ HRESULT WINAPI RegisterApplicationRecoveryCallback(APPLICATION_RECOVERY_CALLBACK
  */
 BOOL WINAPI GetNumaHighestNodeNumber(PULONG highestnode)
 {
-    FIXME("(%p): stub\n", highestnode);
-    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
-    return FALSE;
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info, *node;
+    DWORD len;
+
+    TRACE("(%p)\n", highestnode);
+
+    if (!(info = get_numa_nodes( &len ))) return FALSE;
+
+    *highestnode = 0;
+    for (node = info; (char *)node < (char *)info + len;
+         node = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((char *)node + node->Size))
+        *highestnode = max( *highestnode, node->NumaNode.NodeNumber );
+
+    HeapFree( GetProcessHeap(), 0, info );
+    return TRUE;
 }
 
 /**********************************************************************
@@ -3921,9 +3972,25 @@ BOOL WINAPI GetNumaHighestNodeNumber(PULONG highestnode)
  */
 BOOL WINAPI GetNumaNodeProcessorMask(UCHAR node, PULONGLONG mask)
 {
-    FIXME("(%c %p): stub\n", node, mask);
-    SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
-    return FALSE;
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info, *ptr;
+    DWORD len;
+    BOOL ret = FALSE;
+
+    TRACE("(%u %p)\n", node, mask);
+
+    if (!(info = get_numa_nodes( &len ))) return FALSE;
+
+    for (ptr = info; (char *)ptr < (char *)info + len;
+         ptr = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((char *)ptr + ptr->Size))
+    {
+        if (ptr->NumaNode.NodeNumber != node) continue;
+        *mask = ptr->NumaNode.GroupMask.Mask;
+        ret = TRUE;
+        break;
+    }
+    HeapFree( GetProcessHeap(), 0, info );
+    if (!ret) SetLastError( ERROR_INVALID_PARAMETER );
+    return ret;
 }
 
 /**********************************************************************
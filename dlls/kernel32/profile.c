@@ -24,6 +24,7 @@
 
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
 
 #include "windef.h"
 #include "winbase.h"
@@ -50,6 +51,7 @@ typedef struct tagPROFILEKEY
 {
     WCHAR                 *value;
     struct tagPROFILEKEY  *next;
+    struct tagPROFILEKEY  *hash_next;    /* next key in the same hash bucket */
     WCHAR                  name[1];
 } PROFILEKEY;
 
@@ -57,6 +59,10 @@ typedef struct tagPROFILESECTION
 {
     struct tagPROFILEKEY       *key;
     struct tagPROFILESECTION   *next;
+    struct tagPROFILESECTION   *hash_next;     /* next section in the same hash bucket */
+    struct tagPROFILEKEY      **key_hash;      /* index of the keys by name, NULL if few keys */
+    unsigned int                key_hash_size;
+    unsigned int                key_count;
     WCHAR                       name[1];
 } PROFILESECTION;
 
@@ -65,16 +71,28 @@ typedef struct
 {
     BOOL             changed;
     PROFILESECTION  *section;
+    PROFILESECTION **section_hash;   /* index of the sections by name, NULL if few sections */
+    unsigned int     section_hash_size;
+    unsigned int     section_count;
     WCHAR           *filename;
     FILETIME LastWriteTime;
+    ULONGLONG FileSize;
+    SIZE_T mem_size;                 /* memory used by the parsed file */
     ENCODING encoding;
 } PROFILE;
 
 
-#define N_CACHED_PROFILES 10
+#define N_CACHED_PROFILES 256
 
-/* Cached profile files */
-static PROFILE *MRUProfile[N_CACHED_PROFILES]={NULL};
+/* default memory limit of the profile cache, override with WINEPROFILECACHE (in Kb) */
+#define PROFILE_CACHE_SIZE (16 * 1024 * 1024)
+
+/* lists with fewer entries than this are searched linearly */
+#define PROFILE_HASH_MIN 16
+
+/* Cached profile files, allocated on demand */
+static PROFILE *MRUProfile[N_CACHED_PROFILES];
+static unsigned int nb_cached_profiles;
 
 #define CurProfile (MRUProfile[0])
 
@@ -263,10 +281,184 @@ static void PROFILE_Free( PROFILESECTION *section )
             HeapFree( GetProcessHeap(), 0, key );
         }
         next_section = section->next;
+        HeapFree( GetProcessHeap(), 0, section->key_hash );
         HeapFree( GetProcessHeap(), 0, section );
     }
 }
 
+/* hash of the first len characters of a name, ignoring case */
+static unsigned int PROFILE_Hash( LPCWSTR name, int len )
+{
+    unsigned int hash = 0;
+
+    while (len-- > 0) hash = hash * 31 + tolowerW( *name++ );
+    return hash;
+}
+
+/* check whether name is equal to the first len characters of str, ignoring case */
+static inline BOOL PROFILE_NameMatches( LPCWSTR name, LPCWSTR str, int len )
+{
+    return !strncmpiW( name, str, len ) && !name[len];
+}
+
+/* size of a hash table for count entries */
+static unsigned int PROFILE_HashSize( unsigned int count )
+{
+    unsigned int size = PROFILE_HASH_MIN;
+
+    while (size < count * 2) size *= 2;
+    return size;
+}
+
+/* add a key to the index of its section; only the first of several keys
+ * with the same name can be found, as with a linear search */
+static void PROFILE_HashKey( PROFILESECTION *section, PROFILEKEY *key )
+{
+    PROFILEKEY **bucket, *other;
+
+    bucket = &section->key_hash[PROFILE_Hash( key->name, strlenW(key->name) ) & (section->key_hash_size - 1)];
+    for (other = *bucket; other; other = other->hash_next)
+        if (!strcmpiW( other->name, key->name )) return;
+    key->hash_next = *bucket;
+    *bucket = key;
+}
+
+/***********************************************************************
+ *           PROFILE_IndexKeys
+ *
+ * Rebuild the index of the keys of a section.
+ */
+static void PROFILE_IndexKeys( PROFILESECTION *section )
+{
+    PROFILEKEY *key;
+    unsigned int count = 0;
+
+    HeapFree( GetProcessHeap(), 0, section->key_hash );
+    section->key_hash = NULL;
+    section->key_hash_size = 0;
+    for (key = section->key; key; key = key->next) count++;
+    section->key_count = count;
+    if (count < PROFILE_HASH_MIN) return;
+
+    section->key_hash = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                   PROFILE_HashSize( count ) * sizeof(*section->key_hash) );
+    if (!section->key_hash) return;
+    section->key_hash_size = PROFILE_HashSize( count );
+    for (key = section->key; key; key = key->next) PROFILE_HashKey( section, key );
+}
+
+/* update the index after a key has been appended to a section */
+static void PROFILE_AddKey( PROFILESECTION *section, PROFILEKEY *key )
+{
+    key->hash_next = NULL;
+    if (++section->key_count >= PROFILE_HASH_MIN && section->key_count > section->key_hash_size / 2)
+        PROFILE_IndexKeys( section );
+    else if (section->key_hash)
+        PROFILE_HashKey( section, key );
+}
+
+static PROFILEKEY *PROFILE_FindKey( const PROFILESECTION *section, LPCWSTR name, int len )
+{
+    PROFILEKEY *key;
+
+    if (section->key_hash)
+    {
+        for (key = section->key_hash[PROFILE_Hash( name, len ) & (section->key_hash_size - 1)];
+             key; key = key->hash_next)
+            if (PROFILE_NameMatches( key->name, name, len )) return key;
+        return NULL;
+    }
+    for (key = section->key; key; key = key->next)
+        if (PROFILE_NameMatches( key->name, name, len )) return key;
+    return NULL;
+}
+
+/* add a section to the index of the profile, the unnamed first section is never found */
+static void PROFILE_HashSection( PROFILE *profile, PROFILESECTION *section )
+{
+    PROFILESECTION **bucket, *other;
+
+    if (!section->name[0]) return;
+    bucket = &profile->section_hash[PROFILE_Hash( section->name, strlenW(section->name) ) &
+                                    (profile->section_hash_size - 1)];
+    for (other = *bucket; other; other = other->hash_next)
+        if (!strcmpiW( other->name, section->name )) return;
+    section->hash_next = *bucket;
+    *bucket = section;
+}
+
+/***********************************************************************
+ *           PROFILE_IndexSections
+ *
+ * Rebuild the index of the sections of a profile.
+ */
+static void PROFILE_IndexSections( PROFILE *profile )
+{
+    PROFILESECTION *section;
+    unsigned int count = 0;
+
+    HeapFree( GetProcessHeap(), 0, profile->section_hash );
+    profile->section_hash = NULL;
+    profile->section_hash_size = 0;
+    for (section = profile->section; section; section = section->next) count++;
+    profile->section_count = count;
+    if (count < PROFILE_HASH_MIN) return;
+
+    profile->section_hash = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                       PROFILE_HashSize( count ) * sizeof(*profile->section_hash) );
+    if (!profile->section_hash) return;
+    profile->section_hash_size = PROFILE_HashSize( count );
+    for (section = profile->section; section; section = section->next)
+        PROFILE_HashSection( profile, section );
+}
+
+/* update the index after a section has been appended to a profile */
+static void PROFILE_AddSection( PROFILE *profile, PROFILESECTION *section )
+{
+    section->hash_next = NULL;
+    if (++profile->section_count >= PROFILE_HASH_MIN &&
+        profile->section_count > profile->section_hash_size / 2)
+        PROFILE_IndexSections( profile );
+    else if (profile->section_hash)
+        PROFILE_HashSection( profile, section );
+}
+
+static PROFILESECTION *PROFILE_FindSection( const PROFILE *profile, LPCWSTR name, int len )
+{
+    PROFILESECTION *section;
+
+    if (profile->section_hash)
+    {
+        for (section = profile->section_hash[PROFILE_Hash( name, len ) & (profile->section_hash_size - 1)];
+             section; section = section->hash_next)
+            if (PROFILE_NameMatches( section->name, name, len )) return section;
+        return NULL;
+    }
+    for (section = profile->section; section; section = section->next)
+        if (section->name[0] && PROFILE_NameMatches( section->name, name, len )) return section;
+    return NULL;
+}
+
+/* approximate amount of memory used by a profile tree */
+static SIZE_T PROFILE_MemSize( const PROFILE *profile )
+{
+    const PROFILESECTION *section;
+    const PROFILEKEY *key;
+    SIZE_T size = profile->section_hash_size * sizeof(*profile->section_hash);
+
+    for (section = profile->section; section; section = section->next)
+    {
+        size += sizeof(*section) + strlenW( section->name ) * sizeof(WCHAR);
+        size += section->key_hash_size * sizeof(*section->key_hash);
+        for (key = section->key; key; key = key->next)
+        {
+            size += sizeof(*key) + strlenW( key->name ) * sizeof(WCHAR);
+            if (key->value) size += (strlenW( key->value ) + 1) * sizeof(WCHAR);
+        }
+    }
+    return size;
+}
+
 /* returns TRUE if a whitespace character, else FALSE */
 static inline BOOL PROFILE_isspaceW(WCHAR c)
 {
@@ -394,6 +586,10 @@ static PROFILESECTION *PROFILE_Load(HANDLE hFile, ENCODING * pEncoding)
     first_section->name[0] = 0;
     first_section->key  = NULL;
     first_section->next = NULL;
+    first_section->hash_next = NULL;
+    first_section->key_hash  = NULL;
+    first_section->key_hash_size = 0;
+    first_section->key_count = 0;
     next_section = &first_section->next;
     next_key     = &first_section->key;
     prev_key     = NULL;
@@ -436,6 +632,10 @@ static PROFILESECTION *PROFILE_Load(HANDLE hFile, ENCODING * pEncoding)
                 section->name[len] = '\0';
                 section->key  = NULL;
                 section->next = NULL;
+                section->hash_next = NULL;
+                section->key_hash  = NULL;
+                section->key_hash_size = 0;
+                section->key_count = 0;
                 *next_section = section;
                 next_section  = &section->next;
                 next_key      = &section->key;
@@ -476,6 +676,7 @@ static PROFILESECTION *PROFILE_Load(HANDLE hFile, ENCODING * pEncoding)
             else key->value = NULL;
 
            key->next  = NULL;
+           key->hash_next = NULL;
            *next_key  = key;
            next_key   = &key->next;
            prev_key   = key;
@@ -487,6 +688,9 @@ static PROFILESECTION *PROFILE_Load(HANDLE hFile, ENCODING * pEncoding)
     if (szFile != pBuffer)
         HeapFree(GetProcessHeap(), 0, szFile);
     HeapFree(GetProcessHeap(), 0, buffer_base);
+
+    for (section = first_section; section; section = section->next)
+        PROFILE_IndexKeys( section );
     return first_section;
 }
 
@@ -496,8 +700,10 @@ static PROFILESECTION *PROFILE_Load(HANDLE hFile, ENCODING * pEncoding)
  *
  * Delete a section from a profile tree.
  */
-static BOOL PROFILE_DeleteSection( PROFILESECTION **section, LPCWSTR name )
+static BOOL PROFILE_DeleteSection( PROFILE *profile, LPCWSTR name )
 {
+    PROFILESECTION **section = &profile->section;
+
     while (*section)
     {
         if ((*section)->name[0] && !strcmpiW( (*section)->name, name ))
@@ -506,6 +712,7 @@ static BOOL PROFILE_DeleteSection( PROFILESECTION **section, LPCWSTR name )
             *section = to_del->next;
             to_del->next = NULL;
             PROFILE_Free( to_del );
+            PROFILE_IndexSections( profile );
             return TRUE;
         }
         section = &(*section)->next;
@@ -519,9 +726,11 @@ static BOOL PROFILE_DeleteSection( PROFILESECTION **section, LPCWSTR name )
  *
  * Delete a key from a profile tree.
  */
-static BOOL PROFILE_DeleteKey( PROFILESECTION **section,
+static BOOL PROFILE_DeleteKey( PROFILE *profile,
 			       LPCWSTR section_name, LPCWSTR key_name )
 {
+    PROFILESECTION **section = &profile->section;
+
     while (*section)
     {
         if ((*section)->name[0] && !strcmpiW( (*section)->name, section_name ))
@@ -535,6 +744,7 @@ static BOOL PROFILE_DeleteKey( PROFILESECTION **section,
                     *key = to_del->next;
                     HeapFree( GetProcessHeap(), 0, to_del->value);
                     HeapFree( GetProcessHeap(), 0, to_del );
+                    PROFILE_IndexKeys( *section );
                     return TRUE;
                 }
                 key = &(*key)->next;
@@ -567,6 +777,7 @@ static void PROFILE_DeleteAllKeys( LPCWSTR section_name)
 		HeapFree( GetProcessHeap(), 0, to_del );
 		CurProfile->changed =TRUE;
             }
+            PROFILE_IndexKeys( *section );
         }
         section = &(*section)->next;
     }
@@ -578,9 +789,11 @@ static void PROFILE_DeleteAllKeys( LPCWSTR section_name)
  *
  * Find a key in a profile tree, optionally creating it.
  */
-static PROFILEKEY *PROFILE_Find( PROFILESECTION **section, LPCWSTR section_name,
+static PROFILEKEY *PROFILE_Find( PROFILE *profile, LPCWSTR section_name,
                                  LPCWSTR key_name, BOOL create, BOOL create_always )
 {
+    PROFILESECTION *section, **next_section;
+    PROFILEKEY *key, **next_key;
     LPCWSTR p;
     int seclen, keylen;
 
@@ -602,54 +815,47 @@ static PROFILEKEY *PROFILE_Find( PROFILESECTION **section, LPCWSTR section_name,
     while ((p > key_name) && PROFILE_isspaceW(*p)) p--;
     keylen = p - key_name + 1;
 
-    while (*section)
+    if ((section = PROFILE_FindSection( profile, section_name, seclen )))
     {
-        if ( ((*section)->name[0])
-             && (!(strncmpiW( (*section)->name, section_name, seclen )))
-             && (((*section)->name)[seclen] == '\0') )
-        {
-            PROFILEKEY **key = &(*section)->key;
-
-            while (*key)
-            {
-                /* If create_always is FALSE then we check if the keyname
-                 * already exists. Otherwise we add it regardless of its
-                 * existence, to allow keys to be added more than once in
-                 * some cases.
-                 */
-                if(!create_always)
-                {
-                    if ( (!(strncmpiW( (*key)->name, key_name, keylen )))
-                         && (((*key)->name)[keylen] == '\0') )
-                        return *key;
-                }
-                key = &(*key)->next;
-            }
-            if (!create) return NULL;
-            if (!(*key = HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILEKEY) + strlenW(key_name) * sizeof(WCHAR) )))
-                return NULL;
-            strcpyW( (*key)->name, key_name );
-            (*key)->value = NULL;
-            (*key)->next  = NULL;
-            return *key;
-        }
-        section = &(*section)->next;
+        /* If create_always is FALSE then we check if the keyname
+         * already exists. Otherwise we add it regardless of its
+         * existence, to allow keys to be added more than once in
+         * some cases.
+         */
+        if (!create_always && (key = PROFILE_FindKey( section, key_name, keylen ))) return key;
+        if (!create) return NULL;
+        for (next_key = &section->key; *next_key; next_key = &(*next_key)->next) ;
+        if (!(key = HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILEKEY) + strlenW(key_name) * sizeof(WCHAR) )))
+            return NULL;
+        strcpyW( key->name, key_name );
+        key->value = NULL;
+        key->next  = NULL;
+        *next_key = key;
+        PROFILE_AddKey( section, key );
+        return key;
     }
     if (!create) return NULL;
-    *section = HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILESECTION) + strlenW(section_name) * sizeof(WCHAR) );
-    if(*section == NULL) return NULL;
-    strcpyW( (*section)->name, section_name );
-    (*section)->next = NULL;
-    if (!((*section)->key  = HeapAlloc( GetProcessHeap(), 0,
-                                        sizeof(PROFILEKEY) + strlenW(key_name) * sizeof(WCHAR) )))
+    for (next_section = &profile->section; *next_section; next_section = &(*next_section)->next) ;
+    section = HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILESECTION) + strlenW(section_name) * sizeof(WCHAR) );
+    if (section == NULL) return NULL;
+    strcpyW( section->name, section_name );
+    section->next = NULL;
+    section->key_hash = NULL;
+    section->key_hash_size = 0;
+    section->key_count = 0;
+    if (!(key = HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILEKEY) + strlenW(key_name) * sizeof(WCHAR) )))
     {
-        HeapFree(GetProcessHeap(), 0, *section);
+        HeapFree(GetProcessHeap(), 0, section);
         return NULL;
     }
-    strcpyW( (*section)->key->name, key_name );
-    (*section)->key->value = NULL;
-    (*section)->key->next  = NULL;
-    return (*section)->key;
+    strcpyW( key->name, key_name );
+    key->value = NULL;
+    key->next  = NULL;
+    section->key = key;
+    *next_section = section;
+    PROFILE_AddKey( section, key );
+    PROFILE_AddSection( profile, section );
+    return key;
 }
 
 
@@ -662,6 +868,7 @@ static BOOL PROFILE_FlushFile(void)
 {
     HANDLE hFile = NULL;
     FILETIME LastWriteTime;
+    LARGE_INTEGER size;
 
     if(!CurProfile)
     {
@@ -684,8 +891,11 @@ static BOOL PROFILE_FlushFile(void)
     PROFILE_Save( hFile, CurProfile->section, CurProfile->encoding );
     if(GetFileTime(hFile, NULL, NULL, &LastWriteTime))
        CurProfile->LastWriteTime=LastWriteTime;
+    if (GetFileSizeEx( hFile, &size ))
+        CurProfile->FileSize = size.QuadPart;
     CloseHandle( hFile );
     CurProfile->changed = FALSE;
+    CurProfile->mem_size = PROFILE_MemSize( CurProfile );
     return TRUE;
 }
 
@@ -702,9 +912,12 @@ static void PROFILE_ReleaseFile(void)
     HeapFree( GetProcessHeap(), 0, CurProfile->filename );
     CurProfile->changed = FALSE;
     CurProfile->section = NULL;
+    PROFILE_IndexSections( CurProfile );
     CurProfile->filename  = NULL;
     CurProfile->encoding = ENCODING_ANSI;
     ZeroMemory(&CurProfile->LastWriteTime, sizeof(CurProfile->LastWriteTime));
+    CurProfile->FileSize = 0;
+    CurProfile->mem_size = 0;
 }
 
 /***********************************************************************
@@ -727,6 +940,79 @@ static BOOL is_not_current(FILETIME * ft)
     return ftll + 21000000 < nowll;
 }
 
+/* check whether the cached contents of a profile can be trusted for a given file time */
+static BOOL is_time_reliable( FILETIME *ft )
+{
+    /* a file system that stores sub-second times will change them on modification */
+    if (((((ULONGLONG)ft->dwHighDateTime << 32) | ft->dwLowDateTime) % 10000000)) return TRUE;
+    return is_not_current( ft );
+}
+
+/***********************************************************************
+ *           PROFILE_IsUpToDate
+ *
+ * Check whether the file of a cached profile has been modified, without opening it.
+ */
+static BOOL PROFILE_IsUpToDate( PROFILE *profile )
+{
+    WIN32_FILE_ATTRIBUTE_DATA info;
+
+    if (!profile->section) return FALSE;
+    if (!GetFileAttributesExW( profile->filename, GetFileExInfoStandard, &info )) return FALSE;
+    return !memcmp( &info.ftLastWriteTime, &profile->LastWriteTime, sizeof(FILETIME) ) &&
+           (((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow) == profile->FileSize &&
+           is_time_reliable( &info.ftLastWriteTime );
+}
+
+/* read the contents of a profile file */
+static void PROFILE_LoadFile( PROFILE *profile, HANDLE hFile )
+{
+    LARGE_INTEGER size;
+
+    PROFILE_Free( profile->section );
+    profile->section = PROFILE_Load( hFile, &profile->encoding );
+    PROFILE_IndexSections( profile );
+    GetFileTime( hFile, NULL, NULL, &profile->LastWriteTime );
+    profile->FileSize = GetFileSizeEx( hFile, &size ) ? size.QuadPart : 0;
+    profile->mem_size = PROFILE_MemSize( profile );
+}
+
+/***********************************************************************
+ *           PROFILE_TrimCache
+ *
+ * Free the least recently used profiles until the cache fits in its memory limit.
+ */
+static void PROFILE_TrimCache(void)
+{
+    static SIZE_T limit;
+    PROFILE *profile;
+    SIZE_T total = 0;
+    unsigned int i;
+
+    if (!limit)
+    {
+        const char *env = getenv( "WINEPROFILECACHE" );
+        limit = env ? (SIZE_T)atoi( env ) * 1024 : PROFILE_CACHE_SIZE;
+        if (!limit) limit = 1;  /* only keep the current profile */
+    }
+
+    for (i = 0; i < nb_cached_profiles; i++) total += MRUProfile[i]->mem_size;
+
+    /* the current profile is always kept */
+    while (total > limit && nb_cached_profiles > 1)
+    {
+        profile = MRUProfile[nb_cached_profiles - 1];
+        if (profile->changed) break;  /* it couldn't be saved, keep it */
+        TRACE( "freeing %s (%lu bytes)\n", debugstr_w(profile->filename), profile->mem_size );
+        total -= profile->mem_size;
+        PROFILE_Free( profile->section );
+        HeapFree( GetProcessHeap(), 0, profile->section_hash );
+        HeapFree( GetProcessHeap(), 0, profile->filename );
+        HeapFree( GetProcessHeap(), 0, profile );
+        MRUProfile[--nb_cached_profiles] = NULL;
+    }
+}
+
 /***********************************************************************
  *           PROFILE_Open
  *
@@ -737,24 +1023,9 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
     WCHAR buffer[MAX_PATH];
     HANDLE hFile = INVALID_HANDLE_VALUE;
     FILETIME LastWriteTime;
-    int i,j;
+    LARGE_INTEGER size;
+    unsigned int i, j;
     PROFILE *tempProfile;
-    
-    ZeroMemory(&LastWriteTime, sizeof(LastWriteTime));
-
-    /* First time around */
-
-    if(!CurProfile)
-       for(i=0;i<N_CACHED_PROFILES;i++)
-       {
-          MRUProfile[i]=HeapAlloc( GetProcessHeap(), 0, sizeof(PROFILE) );
-          if(MRUProfile[i] == NULL) break;
-          MRUProfile[i]->changed=FALSE;
-          MRUProfile[i]->section=NULL;
-          MRUProfile[i]->filename=NULL;
-          MRUProfile[i]->encoding=ENCODING_ANSI;
-          ZeroMemory(&MRUProfile[i]->LastWriteTime, sizeof(FILETIME));
-       }
 
     if (!filename)
 	filename = wininiW;
@@ -774,9 +1045,32 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
         LPWSTR dummy;
         GetFullPathNameW(filename, sizeof(buffer)/sizeof(buffer[0]), buffer, &dummy);
     }
-        
+
     TRACE("path: %s\n", debugstr_w(buffer));
 
+    for (i = 0; i < nb_cached_profiles; i++)
+        if (!strcmpiW( buffer, MRUProfile[i]->filename )) break;
+
+    if (i < nb_cached_profiles)
+    {
+        TRACE("MRU Filename: %s, new filename: %s\n", debugstr_w(MRUProfile[i]->filename), debugstr_w(buffer));
+        if(i)
+        {
+            PROFILE_FlushFile();
+            tempProfile=MRUProfile[i];
+            for(j=i;j>0;j--)
+                MRUProfile[j]=MRUProfile[j-1];
+            CurProfile=tempProfile;
+        }
+
+        /* readers don't need to open the file if it didn't change */
+        if (!write_access && PROFILE_IsUpToDate( CurProfile ))
+        {
+            TRACE("(%s): already opened, unchanged (mru=%d)\n", debugstr_w(buffer), i);
+            return TRUE;
+        }
+    }
+
     hFile = CreateFileW(buffer, GENERIC_READ | (write_access ? GENERIC_WRITE : 0),
                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -787,54 +1081,53 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
         return FALSE;
     }
 
-    for(i=0;i<N_CACHED_PROFILES;i++)
+    if (i < nb_cached_profiles)
     {
-        if ((MRUProfile[i]->filename && !strcmpiW( buffer, MRUProfile[i]->filename )))
+        if (hFile != INVALID_HANDLE_VALUE)
         {
-            TRACE("MRU Filename: %s, new filename: %s\n", debugstr_w(MRUProfile[i]->filename), debugstr_w(buffer));
-            if(i)
+            GetFileTime(hFile, NULL, NULL, &LastWriteTime);
+            if (!memcmp( &CurProfile->LastWriteTime, &LastWriteTime, sizeof(FILETIME) ) &&
+                GetFileSizeEx( hFile, &size ) && size.QuadPart == CurProfile->FileSize &&
+                is_time_reliable(&LastWriteTime))
+                TRACE("(%s): already opened (mru=%d)\n",
+                      debugstr_w(buffer), i);
+            else
             {
-                PROFILE_FlushFile();
-                tempProfile=MRUProfile[i];
-                for(j=i;j>0;j--)
-                    MRUProfile[j]=MRUProfile[j-1];
-                CurProfile=tempProfile;
+                TRACE("(%s): already opened, needs refreshing (mru=%d)\n",
+                      debugstr_w(buffer), i);
+                PROFILE_LoadFile( CurProfile, hFile );
+                PROFILE_TrimCache();
             }
-
-            if (hFile != INVALID_HANDLE_VALUE)
-            {
-                GetFileTime(hFile, NULL, NULL, &LastWriteTime);
-                if (!memcmp( &CurProfile->LastWriteTime, &LastWriteTime, sizeof(FILETIME) ) &&
-                    is_not_current(&LastWriteTime))
-                    TRACE("(%s): already opened (mru=%d)\n",
-                          debugstr_w(buffer), i);
-                else
-                {
-                    TRACE("(%s): already opened, needs refreshing (mru=%d)\n",
-                          debugstr_w(buffer), i);
-                    PROFILE_Free(CurProfile->section);
-                    CurProfile->section = PROFILE_Load(hFile, &CurProfile->encoding);
-                    CurProfile->LastWriteTime = LastWriteTime;
-                }
-                CloseHandle(hFile);
-                return TRUE;
-            }
-            else TRACE("(%s): already opened, not yet created (mru=%d)\n",
-                       debugstr_w(buffer), i);
+            CloseHandle(hFile);
+            return TRUE;
         }
+        else TRACE("(%s): already opened, not yet created (mru=%d)\n",
+                   debugstr_w(buffer), i);
     }
 
     /* Flush the old current profile */
-    PROFILE_FlushFile();
+    if (CurProfile) PROFILE_FlushFile();
 
-    /* Make the oldest profile the current one only in order to get rid of it */
-    if(i==N_CACHED_PROFILES)
-      {
-       tempProfile=MRUProfile[N_CACHED_PROFILES-1];
-       for(i=N_CACHED_PROFILES-1;i>0;i--)
-          MRUProfile[i]=MRUProfile[i-1];
-       CurProfile=tempProfile;
-      }
+    if (i == nb_cached_profiles)
+    {
+        if (nb_cached_profiles < N_CACHED_PROFILES)
+        {
+            if (!(tempProfile = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(PROFILE) )))
+            {
+                if (hFile != INVALID_HANDLE_VALUE) CloseHandle( hFile );
+                return FALSE;
+            }
+            tempProfile->encoding = ENCODING_ANSI;
+            i = nb_cached_profiles++;
+        }
+        else
+        {
+            /* Make the oldest profile the current one only in order to get rid of it */
+            tempProfile = MRUProfile[--i];
+        }
+        for ( ; i > 0; i--) MRUProfile[i] = MRUProfile[i-1];
+        CurProfile = tempProfile;
+    }
     if(CurProfile->filename) PROFILE_ReleaseFile();
 
     /* OK, now that CurProfile is definitely free we assign it our new file */
@@ -843,8 +1136,7 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
 
     if (hFile != INVALID_HANDLE_VALUE)
     {
-        CurProfile->section = PROFILE_Load(hFile, &CurProfile->encoding);
-        GetFileTime(hFile, NULL, NULL, &CurProfile->LastWriteTime);
+        PROFILE_LoadFile( CurProfile, hFile );
         CloseHandle(hFile);
     }
     else
@@ -852,6 +1144,7 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
         /* Does not exist yet, we will create it in PROFILE_FlushFile */
         WARN("profile file %s not found\n", debugstr_w(buffer) );
     }
+    PROFILE_TrimCache();
     return TRUE;
 }
 
@@ -862,52 +1155,49 @@ static BOOL PROFILE_Open( LPCWSTR filename, BOOL write_access )
  * Returns all keys of a section.
  * If return_values is TRUE, also include the corresponding values.
  */
-static INT PROFILE_GetSection( PROFILESECTION *section, LPCWSTR section_name,
+static INT PROFILE_GetSection( const PROFILE *profile, LPCWSTR section_name,
 			       LPWSTR buffer, UINT len, BOOL return_values )
 {
+    PROFILESECTION *section;
     PROFILEKEY *key;
 
     if(!buffer) return 0;
 
     TRACE("%s,%p,%u\n", debugstr_w(section_name), buffer, len);
 
-    while (section)
+    if ((section = PROFILE_FindSection( profile, section_name, strlenW(section_name) )))
     {
-        if (section->name[0] && !strcmpiW( section->name, section_name ))
+        UINT oldlen = len;
+        for (key = section->key; key; key = key->next)
         {
-            UINT oldlen = len;
-            for (key = section->key; key; key = key->next)
-            {
-                if (len <= 2) break;
-                if (!*key->name) continue;  /* Skip empty lines */
-                if (IS_ENTRY_COMMENT(key->name)) continue;  /* Skip comments */
-                if (!return_values && !key->value) continue;  /* Skip lines w.o. '=' */
-                PROFILE_CopyEntry( buffer, key->name, len - 1, 0 );
+            if (len <= 2) break;
+            if (!*key->name) continue;  /* Skip empty lines */
+            if (IS_ENTRY_COMMENT(key->name)) continue;  /* Skip comments */
+            if (!return_values && !key->value) continue;  /* Skip lines w.o. '=' */
+            PROFILE_CopyEntry( buffer, key->name, len - 1, 0 );
+            len -= strlenW(buffer) + 1;
+            buffer += strlenW(buffer) + 1;
+            if (len < 2)
+                break;
+            if (return_values && key->value) {
+                buffer[-1] = '=';
+                PROFILE_CopyEntry ( buffer, key->value, len - 1, 0 );
                 len -= strlenW(buffer) + 1;
                 buffer += strlenW(buffer) + 1;
-		if (len < 2)
-		    break;
-		if (return_values && key->value) {
-			buffer[-1] = '=';
-			PROFILE_CopyEntry ( buffer, key->value, len - 1, 0 );
-			len -= strlenW(buffer) + 1;
-			buffer += strlenW(buffer) + 1;
-                }
             }
-            *buffer = '\0';
-            if (len <= 1)
-                /*If either lpszSection or lpszKey is NULL and the supplied
-                  destination buffer is too small to hold all the strings,
-                  the last string is truncated and followed by two null characters.
-                  In this case, the return value is equal to cchReturnBuffer
-                  minus two. */
-            {
-		buffer[-1] = '\0';
-                return oldlen - 2;
-            }
-            return oldlen - len;
         }
-        section = section->next;
+        *buffer = '\0';
+        if (len <= 1)
+            /*If either lpszSection or lpszKey is NULL and the supplied
+              destination buffer is too small to hold all the strings,
+              the last string is truncated and followed by two null characters.
+              In this case, the return value is equal to cchReturnBuffer
+              minus two. */
+        {
+            buffer[-1] = '\0';
+            return oldlen - 2;
+        }
+        return oldlen - len;
     }
     buffer[0] = buffer[1] = '\0';
     return 0;
@@ -993,7 +1283,7 @@ static INT PROFILE_GetString( LPCWSTR section, LPCWSTR key_name,
             PROFILE_CopyEntry(buffer, def_val, len, TRUE);
             return strlenW(buffer);
         }
-        key = PROFILE_Find( &CurProfile->section, section, key_name, FALSE, FALSE);
+        key = PROFILE_Find( CurProfile, section, key_name, FALSE, FALSE);
         PROFILE_CopyEntry( buffer, (key && key->value) ? key->value : def_val,
                            len, TRUE );
         TRACE("(%s,%s,%s): returning %s\n",
@@ -1004,7 +1294,7 @@ static INT PROFILE_GetString( LPCWSTR section, LPCWSTR key_name,
     /* no "else" here ! */
     if (section && section[0])
     {
-        INT ret = PROFILE_GetSection(CurProfile->section, section, buffer, len, FALSE);
+        INT ret = PROFILE_GetSection(CurProfile, section, buffer, len, FALSE);
         if (!buffer[0]) /* no luck -> def_val */
         {
             PROFILE_CopyEntry(buffer, def_val, len, TRUE);
@@ -1028,7 +1318,7 @@ static BOOL PROFILE_SetString( LPCWSTR section_name, LPCWSTR key_name,
     if (!key_name)  /* Delete a whole section */
     {
         TRACE("(%s)\n", debugstr_w(section_name));
-        CurProfile->changed |= PROFILE_DeleteSection( &CurProfile->section,
+        CurProfile->changed |= PROFILE_DeleteSection( CurProfile,
                                                       section_name );
         return TRUE;         /* Even if PROFILE_DeleteSection() has failed,
                                 this is not an error on application's level.*/
@@ -1036,13 +1326,13 @@ static BOOL PROFILE_SetString( LPCWSTR section_name, LPCWSTR key_name,
     else if (!value)  /* Delete a key */
     {
         TRACE("(%s,%s)\n", debugstr_w(section_name), debugstr_w(key_name) );
-        CurProfile->changed |= PROFILE_DeleteKey( &CurProfile->section,
+        CurProfile->changed |= PROFILE_DeleteKey( CurProfile,
                                                   section_name, key_name );
         return TRUE;          /* same error handling as above */
     }
     else  /* Set the key value */
     {
-        PROFILEKEY *key = PROFILE_Find(&CurProfile->section, section_name,
+        PROFILEKEY *key = PROFILE_Find(CurProfile, section_name,
                                         key_name, TRUE, create_always );
         TRACE("(%s,%s,%s):\n",
               debugstr_w(section_name), debugstr_w(key_name), debugstr_w(value) );
@@ -1298,7 +1588,7 @@ INT WINAPI GetPrivateProfileSectionW( LPCWSTR section, LPWSTR buffer,
     RtlEnterCriticalSection( &PROFILE_CritSect );
 
     if (PROFILE_Open( filename, FALSE ))
-        ret = PROFILE_GetSection(CurProfile->section, section, buffer, len, TRUE);
+        ret = PROFILE_GetSection(CurProfile, section, buffer, len, TRUE);
 
     RtlLeaveCriticalSection( &PROFILE_CritSect );
 
@@ -1623,7 +1913,7 @@ BOOL WINAPI GetPrivateProfileStructW (LPCWSTR section, LPCWSTR key,
     RtlEnterCriticalSection( &PROFILE_CritSect );
 
     if (PROFILE_Open( filename, FALSE )) {
-        PROFILEKEY *k = PROFILE_Find ( &CurProfile->section, section, key, FALSE, FALSE);
+        PROFILEKEY *k = PROFILE_Find ( CurProfile, section, key, FALSE, FALSE);
 	if (k) {
 	    TRACE("value (at %p): %s\n", k->value, debugstr_w(k->value));
 	    if (((strlenW(k->value) - 2) / 2) == len)
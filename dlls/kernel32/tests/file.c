@@ -4047,6 +4047,173 @@ todo_wine
     }
 }
 
+static void test_case_insensitive_lookup(void)
+{
+    static const int count = 1000;
+    char temp_path[MAX_PATH], dir[MAX_PATH + 16], path[MAX_PATH + 48];
+    LARGE_INTEGER start, end, freq;
+    DWORD attr, i, pass;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    sprintf( dir, "%sCaseLookupTest", temp_path );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectoryA error %d\n", GetLastError() );
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf( path, "%s\\Asset%05u.Dat", dir, i );
+        file = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+        ok( file != INVALID_HANDLE_VALUE, "CreateFileA %s error %d\n", path, GetLastError() );
+        CloseHandle( file );
+    }
+
+    /* look up every file with the wrong case; repeated passes should not rescan the directory */
+    QueryPerformanceFrequency( &freq );
+    for (pass = 0; pass < 3; pass++)
+    {
+        QueryPerformanceCounter( &start );
+        for (i = 0; i < count; i++)
+        {
+            sprintf( path, "%s\\ASSET%05u.DAT", dir, i );
+            attr = GetFileAttributesA( path );
+            ok( attr != INVALID_FILE_ATTRIBUTES, "%s not found\n", path );
+        }
+        QueryPerformanceCounter( &end );
+        trace( "pass %u: %u lookups in %u ms\n", pass, count,
+               (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart) );
+    }
+
+    sprintf( path, "%s\\ASSET%05u.DAT", dir, count );
+    attr = GetFileAttributesA( path );
+    ok( attr == INVALID_FILE_ATTRIBUTES, "%s found\n", path );
+
+    /* changes to the directory must be visible right away */
+    sprintf( path, "%s\\Asset%05u.Dat", dir, count );
+    file = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFileA %s error %d\n", path, GetLastError() );
+    CloseHandle( file );
+    sprintf( path, "%s\\ASSET%05u.DAT", dir, count );
+    attr = GetFileAttributesA( path );
+    ok( attr != INVALID_FILE_ATTRIBUTES, "%s not found\n", path );
+
+    sprintf( path, "%s\\Asset%05u.Dat", dir, 0 );
+    ret = DeleteFileA( path );
+    ok( ret, "DeleteFileA %s error %d\n", path, GetLastError() );
+    sprintf( path, "%s\\ASSET%05u.DAT", dir, 0 );
+    attr = GetFileAttributesA( path );
+    ok( attr == INVALID_FILE_ATTRIBUTES, "%s found\n", path );
+
+    for (i = 1; i <= count; i++)
+    {
+        sprintf( path, "%s\\asset%05u.dat", dir, i );
+        ret = DeleteFileA( path );
+        ok( ret, "DeleteFileA %s error %d\n", path, GetLastError() );
+    }
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectoryA error %d\n", GetLastError() );
+}
+
+/* overlapped writes to the end of the file must not overwrite each other */
+static void test_overlapped_append(void)
+{
+    char temp_path[MAX_PATH], filename[MAX_PATH], data[512];
+    OVERLAPPED ovl[16];
+    DWORD i, size;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ovl", 0, filename );
+    file = CreateFileA( filename, FILE_APPEND_DATA | SYNCHRONIZE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFileA error %d\n", GetLastError() );
+
+    memset( data, 'a', sizeof(data) );
+    for (i = 0; i < 16; i++)
+    {
+        memset( &ovl[i], 0, sizeof(ovl[i]) );
+        ovl[i].Offset = ovl[i].OffsetHigh = 0xffffffff;
+        ovl[i].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+        ret = WriteFile( file, data, sizeof(data), NULL, &ovl[i] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "%u: error %d\n", i, GetLastError() );
+    }
+    for (i = 0; i < 16; i++)
+    {
+        ret = GetOverlappedResult( file, &ovl[i], &size, TRUE );
+        ok( ret, "%u: GetOverlappedResult error %d\n", i, GetLastError() );
+        ok( size == sizeof(data), "%u: got size %u\n", i, size );
+        CloseHandle( ovl[i].hEvent );
+    }
+    size = GetFileSize( file, NULL );
+    ok( size == 16 * sizeof(data), "got file size %u\n", size );
+    CloseHandle( file );
+    DeleteFileA( filename );
+}
+
+static void test_overlapped_queue_depth(void)
+{
+    static const DWORD block_size = 65536, block_count = 128;
+    static const DWORD depths[] = { 1, 4, 16, 64 };
+    char temp_path[MAX_PATH], filename[MAX_PATH];
+    OVERLAPPED ovl[64];
+    LARGE_INTEGER start, end, freq;
+    DWORD i, d, block, size, time;
+    BYTE *data, *buffer;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ovl", 0, filename );
+    file = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFileA error %d\n", GetLastError() );
+
+    data = HeapAlloc( GetProcessHeap(), 0, block_size * block_count );
+    buffer = HeapAlloc( GetProcessHeap(), 0, block_size * block_count );
+    for (i = 0; i < block_size * block_count; i++) data[i] = i * 7 + i / block_size;
+    for (i = 0; i < 64; i++) ovl[i].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+
+    QueryPerformanceFrequency( &freq );
+    for (d = 0; d <= sizeof(depths) / sizeof(depths[0]); d++)
+    {
+        /* the first pass writes the file, the other ones read it back */
+        DWORD depth = d ? depths[d - 1] : 16;
+
+        memset( buffer, 0, block_size * block_count );
+        QueryPerformanceCounter( &start );
+        for (block = 0; block < block_count + depth; block++)
+        {
+            OVERLAPPED *ov = &ovl[block % depth];
+
+            if (block >= depth)  /* wait for the oldest request of the slot */
+            {
+                ret = GetOverlappedResult( file, ov, &size, TRUE );
+                ok( ret, "block %u: GetOverlappedResult error %d\n", block - depth, GetLastError() );
+                ok( size == block_size, "block %u: got size %u\n", block - depth, size );
+            }
+            if (block >= block_count) continue;
+
+            ov->Offset = block * block_size;
+            ov->OffsetHigh = 0;
+            if (d) ret = ReadFile( file, buffer + block * block_size, block_size, NULL, ov );
+            else ret = WriteFile( file, data + block * block_size, block_size, NULL, ov );
+            ok( ret || GetLastError() == ERROR_IO_PENDING, "block %u: error %d\n", block, GetLastError() );
+        }
+        QueryPerformanceCounter( &end );
+        time = (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart;
+        if (d) ok( !memcmp( buffer, data, block_size * block_count ), "depth %u: wrong data\n", depth );
+        trace( "%s %u KB at queue depth %u: %u us\n", d ? "read" : "wrote",
+               block_size * block_count / 1024, depth, time );
+    }
+
+    for (i = 0; i < 64; i++) CloseHandle( ovl[i].hEvent );
+    HeapFree( GetProcessHeap(), 0, data );
+    HeapFree( GetProcessHeap(), 0, buffer );
+    CloseHandle( file );
+}
+
 START_TEST(file)
 {
     InitFunctionPointers();
@@ -4092,4 +4259,7 @@ START_TEST(file)
     test_OpenFileById();
     test_SetFileValidData();
     test_file_access();
+    test_case_insensitive_lookup();
+    test_overlapped_queue_depth();
+    test_overlapped_append();
 }
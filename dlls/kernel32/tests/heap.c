@@ -38,6 +38,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
 struct heap_layout
@@ -872,6 +873,185 @@ static void test_child_heap( const char *arg )
     test_heap_checks( expect_heap );
 }
 
+#define LFH_THREADS  4
+#define LFH_BLOCKS   256
+
+struct lfh_thread_info
+{
+    HANDLE heap;
+    void  *blocks[LFH_BLOCKS];  /* blocks handed over by the previous thread */
+    LONG   errors;
+};
+
+static struct lfh_thread_info lfh_info[LFH_THREADS];
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    struct lfh_thread_info *info = arg;
+    struct lfh_thread_info *next = &lfh_info[(info - lfh_info + 1) % LFH_THREADS];
+    unsigned char *ptrs[LFH_BLOCKS];
+    SIZE_T size;
+    void *remote;
+    int i, j;
+
+    for (i = 0; i < 200; i++)
+    {
+        for (j = 0; j < LFH_BLOCKS; j++)
+        {
+            size = 1 + (i * 7 + j * 13) % 512;
+            if (!(ptrs[j] = HeapAlloc( info->heap, 0, size ))) { info->errors++; return 0; }
+            memset( ptrs[j], j, size );
+        }
+        for (j = 0; j < LFH_BLOCKS; j++)
+        {
+            size = 1 + (i * 7 + j * 13) % 512;
+            if (HeapSize( info->heap, 0, ptrs[j] ) != size ||
+                ptrs[j][0] != (unsigned char)j || ptrs[j][size - 1] != (unsigned char)j)
+                info->errors++;
+            if (j % 4)
+                HeapFree( info->heap, 0, ptrs[j] );
+            else  /* let the next thread free it, and free what the previous one handed over */
+            {
+                /* the next thread may not have picked up our last block yet */
+                remote = InterlockedExchangePointer( &next->blocks[j], ptrs[j] );
+                HeapFree( info->heap, 0, remote );
+                remote = InterlockedExchangePointer( &info->blocks[j], NULL );
+                if (remote && !HeapFree( info->heap, 0, remote )) info->errors++;
+            }
+        }
+    }
+    return 0;
+}
+
+static double run_lfh_threads( HANDLE heap )
+{
+    HANDLE threads[LFH_THREADS];
+    LARGE_INTEGER freq, start, end;
+    DWORD tid;
+    int i, j;
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < LFH_THREADS; i++)
+    {
+        memset( &lfh_info[i], 0, sizeof(lfh_info[i]) );
+        lfh_info[i].heap = heap;
+    }
+    for (i = 0; i < LFH_THREADS; i++)
+        threads[i] = CreateThread( NULL, 0, lfh_thread, &lfh_info[i], 0, &tid );
+    WaitForMultipleObjects( LFH_THREADS, threads, TRUE, INFINITE );
+    QueryPerformanceCounter( &end );
+
+    for (i = 0; i < LFH_THREADS; i++)
+    {
+        CloseHandle( threads[i] );
+        ok( !lfh_info[i].errors, "thread %u: %u errors\n", i, lfh_info[i].errors );
+        for (j = 0; j < LFH_BLOCKS; j++) HeapFree( heap, 0, lfh_info[i].blocks[j] );
+    }
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    return (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+}
+
+static HANDLE lfh_terminate_event;
+
+static DWORD WINAPI lfh_terminated_thread( void *arg )
+{
+    void *ptrs[64];
+    unsigned int i;
+
+    for (i = 0; i < 64; i++) ptrs[i] = HeapAlloc( arg, 0, 16 + (i % 8) * 16 );
+    for (i = 0; i < 64; i++) HeapFree( arg, 0, ptrs[i] );
+    SetEvent( lfh_terminate_event );
+    Sleep( INFINITE );
+    return 0;
+}
+
+static DWORD WINAPI lfh_alloc_thread( void *arg )
+{
+    void *ptr = HeapAlloc( arg, 0, 32 );
+    return HeapFree( arg, 0, ptr );
+}
+
+/* the blocks cached by a killed thread must not break the heap */
+static void test_lfh_terminated_thread( HANDLE heap )
+{
+    HANDLE thread;
+    DWORD ret;
+
+    lfh_terminate_event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    thread = CreateThread( NULL, 0, lfh_terminated_thread, heap, 0, NULL );
+    ret = WaitForSingleObject( lfh_terminate_event, 5000 );
+    ok( ret == WAIT_OBJECT_0, "wait failed %u\n", ret );
+    ok( TerminateThread( thread, 0 ), "TerminateThread failed %u\n", GetLastError() );
+    WaitForSingleObject( thread, 5000 );
+    CloseHandle( thread );
+
+    thread = CreateThread( NULL, 0, lfh_alloc_thread, heap, 0, NULL );
+    WaitForSingleObject( thread, 5000 );
+    GetExitCodeThread( thread, &ret );
+    ok( ret, "HeapFree failed in new thread\n" );
+    CloseHandle( thread );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    CloseHandle( lfh_terminate_event );
+}
+
+static void test_low_fragmentation_heap(void)
+{
+    double standard_time, lfh_time;
+    HANDLE heap, lfh_heap;
+    ULONG info;
+    void *ptr;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    info = 2;
+    SetLastError(0xdeadbeef);
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok(!ret, "HeapSetInformation succeeded on a HEAP_NO_SERIALIZE heap\n");
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    lfh_heap = HeapCreate( 0, 0, 0 );
+    info = 2;
+    ret = pHeapSetInformation( lfh_heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (!ret)  /* not available under a debugger */
+    {
+        skip("low-fragmentation heap not available\n");
+        HeapDestroy( heap );
+        HeapDestroy( lfh_heap );
+        return;
+    }
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( lfh_heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok(ret, "HeapQueryInformation error %u\n", GetLastError());
+    ok(info == 2, "expected 2, got %u\n", info);
+
+    ptr = HeapAlloc( lfh_heap, HEAP_ZERO_MEMORY, 24 );
+    ok(ptr != NULL, "HeapAlloc failed\n");
+    ok(HeapSize( lfh_heap, 0, ptr ) == 24, "wrong size %lu\n", HeapSize( lfh_heap, 0, ptr ));
+    ok(!((char *)ptr)[23], "memory not zeroed\n");
+    ptr = HeapReAlloc( lfh_heap, 0, ptr, 4000 );
+    ok(ptr != NULL, "HeapReAlloc failed\n");
+    ok(HeapFree( lfh_heap, 0, ptr ), "HeapFree failed\n");
+
+    standard_time = run_lfh_threads( heap );
+    lfh_time = run_lfh_threads( lfh_heap );
+    trace("%u threads, small blocks: standard heap %.3fs, low-fragmentation heap %.3fs\n",
+          LFH_THREADS, standard_time, lfh_time);
+
+    test_lfh_terminated_thread( lfh_heap );
+
+    HeapDestroy( heap );
+    HeapDestroy( lfh_heap );
+}
+
 START_TEST(heap)
 {
     int argc;
@@ -897,6 +1077,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), (2 << 20));
     test_sized_HeapReAlloc((1 << 20), 1);
     test_HeapQueryInformation();
+    test_low_fragmentation_heap();
 
     if (pRtlGetNtGlobalFlags)
     {
@@ -2749,6 +2749,165 @@ static void test_ResolveDelayLoadedAPI(void)
     DeleteFileA(dll_name);
 }
 
+static void test_export_lookup(void)
+{
+    static const char * const dlls[] =
+    {
+        "ntdll.dll", "kernel32.dll", "advapi32.dll", "user32.dll", "gdi32.dll", "msvcrt.dll",
+        "ole32.dll", "oleaut32.dll", "shell32.dll", "shlwapi.dll", "comctl32.dll", "ws2_32.dll",
+        "wininet.dll", "setupapi.dll", "crypt32.dll", "rpcrt4.dll"
+    };
+    HMODULE modules[sizeof(dlls) / sizeof(dlls[0])];
+    LARGE_INTEGER start, end, freq;
+    DWORD i, j, pass, count = 0, load_time;
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < sizeof(dlls) / sizeof(dlls[0]); i++) modules[i] = LoadLibraryA( dlls[i] );
+    QueryPerformanceCounter( &end );
+    load_time = (end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart;
+
+    QueryPerformanceCounter( &start );
+    for (pass = 0; pass < 10; pass++)
+    {
+        for (i = 0; i < sizeof(dlls) / sizeof(dlls[0]); i++)
+        {
+            HMODULE module = modules[i];
+            const IMAGE_EXPORT_DIRECTORY *exports;
+            const DWORD *names;
+            const WORD *ordinals;
+            ULONG size;
+
+            if (!module) continue;
+            exports = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+            if (!exports) continue;
+            names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+            ordinals = (const WORD *)((const char *)module + exports->AddressOfNameOrdinals);
+
+            for (j = 0; j < exports->NumberOfNames; j++)
+            {
+                const char *name = (const char *)module + names[j];
+                FARPROC proc = GetProcAddress( module, name );
+
+                count++;
+                if (pass) continue;
+                ok( proc == GetProcAddress( module, (LPCSTR)(ULONG_PTR)(ordinals[j] + exports->Base) ),
+                    "%s: %s doesn't match its ordinal %u\n", dlls[i], name, ordinals[j] + exports->Base );
+            }
+            if (!pass)
+                ok( !GetProcAddress( module, "__wine_nonexistent_export" ),
+                    "%s: found nonexistent export\n", dlls[i] );
+        }
+    }
+    QueryPerformanceCounter( &end );
+    trace( "loaded %u dlls in %u ms, %u name lookups in %u ms\n",
+           (DWORD)(sizeof(dlls) / sizeof(dlls[0])), load_time, count,
+           (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart) );
+
+    for (i = 0; i < sizeof(dlls) / sizeof(dlls[0]); i++)
+        if (modules[i]) FreeLibrary( modules[i] );
+}
+
+/* map a relocatable dll several times and check that its relocations are applied every time */
+static void test_relocated_image_mapping(void)
+{
+    struct
+    {
+        IMAGE_DOS_HEADER dos;
+        IMAGE_NT_HEADERS nt;
+        IMAGE_SECTION_HEADER sections[2];
+    } *headers;
+    IMAGE_BASE_RELOCATION *rel;
+    char temp_path[MAX_PATH], dll_name[MAX_PATH], *data;
+    DWORD_PTR image_base, value;
+    HANDLE file, map;
+    NTSTATUS status;
+    LARGE_INTEGER offset;
+    SIZE_T size;
+    void *addr[3];
+    DWORD i, written;
+    BOOL ret;
+
+    if (!pNtMapViewOfSection) return;
+
+    data = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, 0x600 );
+    headers = (void *)data;
+    headers->dos.e_magic = IMAGE_DOS_SIGNATURE;
+    headers->dos.e_lfanew = sizeof(headers->dos);
+    headers->nt = nt_header;
+    headers->nt.FileHeader.NumberOfSections = 2;
+    headers->nt.OptionalHeader.SectionAlignment = 0x1000;
+    headers->nt.OptionalHeader.FileAlignment = 0x200;
+    headers->nt.OptionalHeader.SizeOfImage = 0x3000;
+    headers->nt.OptionalHeader.SizeOfHeaders = 0x200;
+    headers->nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    headers->nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = 0x2000;
+    headers->nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = sizeof(*rel) + 2 * sizeof(WORD);
+    image_base = headers->nt.OptionalHeader.ImageBase;
+
+    memcpy( headers->sections[0].Name, ".data", 6 );
+    headers->sections[0].Misc.VirtualSize = 0x1000;
+    headers->sections[0].VirtualAddress = 0x1000;
+    headers->sections[0].SizeOfRawData = 0x200;
+    headers->sections[0].PointerToRawData = 0x200;
+    headers->sections[0].Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+    memcpy( headers->sections[1].Name, ".reloc", 7 );
+    headers->sections[1].Misc.VirtualSize = 0x1000;
+    headers->sections[1].VirtualAddress = 0x2000;
+    headers->sections[1].SizeOfRawData = 0x200;
+    headers->sections[1].PointerToRawData = 0x400;
+    headers->sections[1].Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_DISCARDABLE;
+
+    /* the data section holds a pointer to itself */
+    *(DWORD_PTR *)(data + 0x200) = image_base + 0x1000;
+    rel = (IMAGE_BASE_RELOCATION *)(data + 0x400);
+    rel->VirtualAddress = 0x1000;
+    rel->SizeOfBlock = sizeof(*rel) + 2 * sizeof(WORD);
+#ifdef _WIN64
+    ((WORD *)(rel + 1))[0] = IMAGE_REL_BASED_DIR64 << 12;
+#else
+    ((WORD *)(rel + 1))[0] = IMAGE_REL_BASED_HIGHLOW << 12;
+#endif
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ldr", 0, dll_name );
+    file = CreateFileA( dll_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile error %d\n", GetLastError() );
+    ret = WriteFile( file, data, 0x600, &written, NULL );
+    ok( ret && written == 0x600, "WriteFile error %d\n", GetLastError() );
+    CloseHandle( file );
+    HeapFree( GetProcessHeap(), 0, data );
+
+    file = CreateFileA( dll_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile error %d\n", GetLastError() );
+    map = CreateFileMappingW( file, NULL, PAGE_READONLY | SEC_IMAGE, 0, 0, 0 );
+    ok( map != 0, "CreateFileMapping error %d\n", GetLastError() );
+
+    offset.QuadPart = 0;
+    for (i = 0; i < 3; i++)
+    {
+        addr[i] = NULL;
+        size = 0;
+        status = pNtMapViewOfSection( map, GetCurrentProcess(), &addr[i], 0, 0, &offset,
+                                      &size, 1 /* ViewShare */, 0, PAGE_READONLY );
+        ok( status == STATUS_SUCCESS || status == STATUS_IMAGE_NOT_AT_BASE,
+            "%u: NtMapViewOfSection error %x\n", i, status );
+        if (!addr[i]) continue;
+        value = *(DWORD_PTR *)((char *)addr[i] + 0x1000);
+        ok( value == (DWORD_PTR)addr[i] + 0x1000 ||
+            broken( value == image_base + 0x1000 ),  /* relocated by the loader on Windows */
+            "%u: mapped at %p, got %lx\n", i, addr[i], value );
+        /* the next mapping is likely to end up at the same address */
+        if (i == 1) pNtUnmapViewOfSection( GetCurrentProcess(), addr[i] );
+    }
+    if (addr[0]) pNtUnmapViewOfSection( GetCurrentProcess(), addr[0] );
+    if (addr[2]) pNtUnmapViewOfSection( GetCurrentProcess(), addr[2] );
+
+    CloseHandle( map );
+    CloseHandle( file );
+    DeleteFileA( dll_name );
+}
+
 START_TEST(loader)
 {
     int argc;
@@ -2801,5 +2960,7 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_export_lookup();
+    test_relocated_image_mapping();
     test_ExitProcess();
 }
@@ -1123,6 +1123,73 @@ static void test_WritePrivateProfileString(void)
     DeleteFileA(path);
 }
 
+static void test_profile_large(void)
+{
+    static const int nb_sections = 100, nb_keys = 500;
+    char path[MAX_PATH], temp[MAX_PATH], section[32], key[32], value[64], expect[64];
+    LARGE_INTEGER freq, start, end;
+    char *data, *p;
+    int i, j, n, errors = 0;
+    DWORD ret;
+
+    GetTempPathA(MAX_PATH, temp);
+    GetTempFileNameA(temp, "wine", 0, path);
+
+    p = data = HeapAlloc(GetProcessHeap(), 0, nb_sections * (32 + nb_keys * 48));
+    for (i = 0; i < nb_sections; i++)
+    {
+        p += sprintf(p, "[section%d]\r\n", i);
+        for (j = 0; j < nb_keys; j++)
+            p += sprintf(p, "key%d_%d=value%d_%d\r\n", i, j, i, j);
+        /* a duplicate key, only the first one is visible */
+        p += sprintf(p, "key%d_0=duplicate\r\n", i);
+    }
+    create_test_file(path, data, p - data);
+    HeapFree(GetProcessHeap(), 0, data);
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (n = 0; n < 50000; n++)
+    {
+        i = (n * 7) % nb_sections;
+        j = (n * 13) % nb_keys;
+        sprintf(section, "SECTION%d", i);
+        sprintf(key, "Key%d_%d", i, j);
+        sprintf(expect, "value%d_%d", i, j);
+        ret = GetPrivateProfileStringA(section, key, "default", value, sizeof(value), path);
+        if (ret != strlen(expect) || strcmp(value, expect)) errors++;
+    }
+    QueryPerformanceCounter(&end);
+    ok(!errors, "%d lookups failed\n", errors);
+    trace("%d lookups in a file of %d keys: %.1f ms\n", n, nb_sections * nb_keys,
+          (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+    ret = GetPrivateProfileStringA("section42", "key42_499", "default", value, sizeof(value), path);
+    ok(ret == 11 && !strcmp(value, "value42_499"), "got %u %s\n", ret, value);
+    ret = GetPrivateProfileStringA("section42", "key42_500", "default", value, sizeof(value), path);
+    ok(ret == 7 && !strcmp(value, "default"), "got %u %s\n", ret, value);
+    ret = GetPrivateProfileStringA("section100", "key42_1", "default", value, sizeof(value), path);
+    ok(ret == 7 && !strcmp(value, "default"), "got %u %s\n", ret, value);
+
+    /* new and deleted entries must be found or not found */
+    ret = WritePrivateProfileStringA("section7", "newkey", "newvalue", path);
+    ok(ret, "WritePrivateProfileStringA failed %u\n", GetLastError());
+    ret = GetPrivateProfileStringA("section7", "NEWKEY", "default", value, sizeof(value), path);
+    ok(ret == 8 && !strcmp(value, "newvalue"), "got %u %s\n", ret, value);
+    ret = WritePrivateProfileStringA("section7", "key7_0", NULL, path);
+    ok(ret, "WritePrivateProfileStringA failed %u\n", GetLastError());
+    ret = GetPrivateProfileStringA("section7", "key7_0", "default", value, sizeof(value), path);
+    ok(ret == 9 && !strcmp(value, "duplicate"), "got %u %s\n", ret, value);
+    ret = WritePrivateProfileStringA("section8", NULL, NULL, path);
+    ok(ret, "WritePrivateProfileStringA failed %u\n", GetLastError());
+    ret = GetPrivateProfileStringA("section8", "key8_1", "default", value, sizeof(value), path);
+    ok(ret == 7 && !strcmp(value, "default"), "got %u %s\n", ret, value);
+    ret = GetPrivateProfileStringA("section9", "key9_1", "default", value, sizeof(value), path);
+    ok(ret == 8 && !strcmp(value, "value9_1"), "got %u %s\n", ret, value);
+
+    DeleteFileA(path);
+}
+
 START_TEST(profile)
 {
     test_profile_int();
@@ -1149,4 +1216,5 @@ START_TEST(profile)
         "[section2]\r",
         "CR only");
     test_WritePrivateProfileString();
+    test_profile_large();
 }
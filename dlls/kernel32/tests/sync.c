@@ -55,6 +55,9 @@ static VOID   (WINAPI *pReleaseSRWLockExclusive)(PSRWLOCK);
 static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE,OVERLAPPED_ENTRY*,ULONG,ULONG*,DWORD,BOOL);
+static BOOL   (WINAPI *pSetFileCompletionNotificationModes)(HANDLE,UCHAR);
+static BOOL   (WINAPI *pInitializeCriticalSectionEx)(CRITICAL_SECTION*,DWORD,DWORD);
 
 static void test_signalandwait(void)
 {
@@ -736,6 +739,89 @@ static void CALLBACK timer_queue_cb6(PVOID p, BOOLEAN timedOut)
     }
 }
 
+static void test_iocp_ex(void)
+{
+    char path[MAX_PATH], filename[MAX_PATH];
+    OVERLAPPED_ENTRY entries[8];
+    OVERLAPPED ovl, *povl;
+    HANDLE port, file;
+    DWORD size;
+    ULONG_PTR key;
+    ULONG count;
+    BOOL ret;
+    int i;
+
+    if (!pGetQueuedCompletionStatusEx || !pSetFileCompletionNotificationModes)
+    {
+        win_skip("GetQueuedCompletionStatusEx or SetFileCompletionNotificationModes not available\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed: %u\n", GetLastError());
+
+    for (i = 0; i < 5; i++)
+    {
+        ret = PostQueuedCompletionStatus(port, i + 100, i, (OVERLAPPED *)(ULONG_PTR)(i + 1));
+        ok(ret, "PostQueuedCompletionStatus failed: %u\n", GetLastError());
+    }
+
+    /* packets are dequeued in order, at most as many as requested */
+    memset(entries, 0xcc, sizeof(entries));
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 3, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed: %u\n", GetLastError());
+    ok(count == 3, "expected 3 entries, got %u\n", count);
+    for (i = 0; i < 3; i++)
+    {
+        ok(entries[i].lpCompletionKey == i, "%u: got key %lu\n", i, entries[i].lpCompletionKey);
+        ok(entries[i].lpOverlapped == (OVERLAPPED *)(ULONG_PTR)(i + 1), "%u: got overlapped %p\n", i, entries[i].lpOverlapped);
+        ok(entries[i].dwNumberOfBytesTransferred == i + 100, "%u: got %u bytes\n", i, entries[i].dwNumberOfBytesTransferred);
+    }
+
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 8, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed: %u\n", GetLastError());
+    ok(count == 2, "expected 2 entries, got %u\n", count);
+    ok(entries[0].lpCompletionKey == 3, "got key %lu\n", entries[0].lpCompletionKey);
+    ok(entries[1].lpCompletionKey == 4, "got key %lu\n", entries[1].lpCompletionKey);
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 8, &count, 50, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "expected WAIT_TIMEOUT, got %u\n", GetLastError());
+
+    /* synchronously completed I/O doesn't post a packet with FILE_SKIP_COMPLETION_PORT_ON_SUCCESS */
+    GetTempPathA(MAX_PATH, path);
+    GetTempFileNameA(path, "iocp", 0, filename);
+    file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed: %u\n", GetLastError());
+    ok(CreateIoCompletionPort(file, port, 0xdead, 0) == port, "CreateIoCompletionPort failed: %u\n", GetLastError());
+
+    ret = pSetFileCompletionNotificationModes(file, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE);
+    ok(ret, "SetFileCompletionNotificationModes failed: %u\n", GetLastError());
+
+    memset(&ovl, 0, sizeof(ovl));
+    ret = WriteFile(file, "test", 4, &size, &ovl);
+    if (ret)
+    {
+        ret = GetQueuedCompletionStatus(port, &size, &key, &povl, 50);
+        ok(!ret && !povl, "got unexpected completion packet\n");
+        ok(GetLastError() == WAIT_TIMEOUT, "expected WAIT_TIMEOUT, got %u\n", GetLastError());
+    }
+    else
+    {
+        ok(GetLastError() == ERROR_IO_PENDING, "WriteFile failed: %u\n", GetLastError());
+        ret = GetQueuedCompletionStatus(port, &size, &key, &povl, 1000);
+        ok(ret, "GetQueuedCompletionStatus failed: %u\n", GetLastError());
+        ok(key == 0xdead, "got key %lx\n", key);
+    }
+
+    CloseHandle(file);
+    CloseHandle(port);
+}
+
 static void test_timer_queue(void)
 {
     HANDLE q, t0, t1, t2, t3, t4, t5;
@@ -2284,6 +2370,341 @@ static void test_srwlock_example(void)
     trace("number of total exclusive accesses is %d\n", srwlock_protected_value);
 }
 
+static HANDLE pingpong_events[2], pingpong_semaphore;
+
+static DWORD WINAPI event_pingpong_thread(LPVOID arg)
+{
+    DWORD i, ret;
+
+    for (i = 0; i < 10000; i++)
+    {
+        ret = WaitForSingleObject(pingpong_events[0], 5000);
+        ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+        SetEvent(pingpong_events[1]);
+        ret = WaitForMultipleObjects(2, &pingpong_events[0], FALSE, 5000);
+        ok(ret == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", ret);
+        ReleaseSemaphore(pingpong_semaphore, 1, NULL);
+    }
+    return 0;
+}
+
+static void test_event_pingpong(void)
+{
+    LARGE_INTEGER start, end, freq;
+    HANDLE thread;
+    DWORD i, ret;
+    LONG prev;
+
+    pingpong_events[0] = CreateEventW(NULL, FALSE, FALSE, NULL);
+    pingpong_events[1] = CreateEventW(NULL, FALSE, FALSE, NULL);
+    pingpong_semaphore = CreateSemaphoreW(NULL, 0, 1, NULL);
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    thread = CreateThread(NULL, 0, event_pingpong_thread, NULL, 0, NULL);
+    for (i = 0; i < 10000; i++)
+    {
+        SetEvent(pingpong_events[0]);
+        ret = WaitForSingleObject(pingpong_events[1], 5000);
+        ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+        SetEvent(pingpong_events[0]);
+        ret = WaitForSingleObject(pingpong_semaphore, 5000);
+        ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+    }
+    ret = WaitForSingleObject(thread, 5000);
+    ok(ret == WAIT_OBJECT_0, "thread didn't exit, ret %u\n", ret);
+    QueryPerformanceCounter(&end);
+    CloseHandle(thread);
+
+    trace("event ping-pong, 10000 round trips: %u ms\n",
+          (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+
+    /* auto-reset events and semaphores must have been consumed by the waits */
+    ret = WaitForMultipleObjects(2, pingpong_events, FALSE, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    ok(ReleaseSemaphore(pingpong_semaphore, 1, &prev), "ReleaseSemaphore failed %u\n", GetLastError());
+    ok(prev == 0, "got previous count %d\n", prev);
+    SetLastError(0xdeadbeef);
+    ok(!ReleaseSemaphore(pingpong_semaphore, 1, &prev), "ReleaseSemaphore succeeded\n");
+    ok(GetLastError() == ERROR_TOO_MANY_POSTS, "got error %u\n", GetLastError());
+
+    CloseHandle(pingpong_events[0]);
+    CloseHandle(pingpong_events[1]);
+    CloseHandle(pingpong_semaphore);
+}
+
+static DWORD WINAPI event_wait_thread(LPVOID arg)
+{
+    return WaitForSingleObject(arg, 5000);
+}
+
+static void test_event_wait_interrupted(void)
+{
+    HANDLE event, dup, thread;
+    CONTEXT context;
+    DWORD ret;
+
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    DuplicateHandle(GetCurrentProcess(), event, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    thread = CreateThread(NULL, 0, event_wait_thread, dup, 0, NULL);
+    Sleep(100);
+
+    /* the waiting thread must still handle suspension and system APCs */
+    ret = SuspendThread(thread);
+    ok(ret == 0, "SuspendThread returned %u\n", ret);
+    context.ContextFlags = CONTEXT_CONTROL;
+    ok(GetThreadContext(thread, &context), "GetThreadContext failed %u\n", GetLastError());
+    ret = ResumeThread(thread);
+    ok(ret == 1, "ResumeThread returned %u\n", ret);
+
+    /* closing the handle doesn't end a wait in progress on the object */
+    CloseHandle(dup);
+    Sleep(50);
+    SetEvent(event);
+    ret = WaitForSingleObject(thread, 5000);
+    ok(ret == WAIT_OBJECT_0, "thread didn't exit, ret %u\n", ret);
+    GetExitCodeThread(thread, &ret);
+    ok(ret == WAIT_OBJECT_0, "wait returned %u\n", ret);
+
+    CloseHandle(thread);
+    CloseHandle(event);
+}
+
+static SRWLOCK srwlock_contention;
+static CONDITION_VARIABLE condvar_pingpong;
+static LONG srwlock_contention_inside, srwlock_contention_errors;
+static DWORD srwlock_contention_value, condvar_pingpong_turn;
+
+#define CONTENTION_LOOPS 100000
+
+static DWORD WINAPI srwlock_contention_thread(LPVOID arg)
+{
+    DWORD i, id = (DWORD)(DWORD_PTR)arg;
+
+    for (i = 0; i < CONTENTION_LOOPS; i++)
+    {
+        if ((i + id) % 4)
+        {
+            pAcquireSRWLockShared(&srwlock_contention);
+            InterlockedIncrement(&srwlock_contention_inside);
+            if (srwlock_contention_inside < 0) InterlockedIncrement(&srwlock_contention_errors);
+            InterlockedDecrement(&srwlock_contention_inside);
+            pReleaseSRWLockShared(&srwlock_contention);
+        }
+        else
+        {
+            pAcquireSRWLockExclusive(&srwlock_contention);
+            if (InterlockedExchangeAdd(&srwlock_contention_inside, -1000) != 0)
+                InterlockedIncrement(&srwlock_contention_errors);
+            srwlock_contention_value++;
+            InterlockedExchangeAdd(&srwlock_contention_inside, 1000);
+            pReleaseSRWLockExclusive(&srwlock_contention);
+        }
+    }
+    return 0;
+}
+
+static DWORD WINAPI condvar_pingpong_thread(LPVOID arg)
+{
+    DWORD i, id = (DWORD)(DWORD_PTR)arg;
+
+    pAcquireSRWLockExclusive(&srwlock_contention);
+    for (i = 0; i < CONTENTION_LOOPS / 10; i++)
+    {
+        while (condvar_pingpong_turn != id)
+            pSleepConditionVariableSRW(&condvar_pingpong, &srwlock_contention, INFINITE, 0);
+        condvar_pingpong_turn = !id;
+        pWakeConditionVariable(&condvar_pingpong);
+    }
+    pReleaseSRWLockExclusive(&srwlock_contention);
+    return 0;
+}
+
+static void test_srwlock_contention(void)
+{
+    LARGE_INTEGER start, end, freq;
+    HANDLE threads[4];
+    DWORD i;
+
+    if (!pInitializeSRWLock || !pSleepConditionVariableSRW)
+    {
+        /* function is not yet in XP, only in newer Windows */
+        win_skip("no srw lock support.\n");
+        return;
+    }
+
+    pInitializeSRWLock(&srwlock_contention);
+    pInitializeConditionVariable(&condvar_pingpong);
+    QueryPerformanceFrequency(&freq);
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 4; i++)
+        threads[i] = CreateThread(NULL, 0, srwlock_contention_thread, (void *)(DWORD_PTR)i, 0, NULL);
+    WaitForMultipleObjects(4, threads, TRUE, INFINITE);
+    QueryPerformanceCounter(&end);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+
+    ok(!srwlock_contention_errors, "got %d errors\n", srwlock_contention_errors);
+    ok(srwlock_contention_value == CONTENTION_LOOPS, "got %u exclusive accesses\n", srwlock_contention_value);
+    trace("4 threads, %u lock operations each: %u ms\n", CONTENTION_LOOPS,
+          (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+
+    ok(pTryAcquireSRWLockExclusive(&srwlock_contention), "lock should be free\n");
+    pReleaseSRWLockExclusive(&srwlock_contention);
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 2; i++)
+        threads[i] = CreateThread(NULL, 0, condvar_pingpong_thread, (void *)(DWORD_PTR)i, 0, NULL);
+    WaitForMultipleObjects(2, threads, TRUE, INFINITE);
+    QueryPerformanceCounter(&end);
+    for (i = 0; i < 2; i++) CloseHandle(threads[i]);
+
+    trace("condition variable ping-pong, %u round trips: %u ms\n", CONTENTION_LOOPS / 10,
+          (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+}
+
+static CRITICAL_SECTION critsect_contention;
+static DWORD critsect_contention_value;
+static LONG critsect_contention_errors;
+
+static DWORD WINAPI critsect_contention_thread(LPVOID arg)
+{
+    DWORD i, j;
+
+    for (i = 0; i < CONTENTION_LOOPS; i++)
+    {
+        EnterCriticalSection(&critsect_contention);
+        if (critsect_contention.OwningThread != ULongToHandle(GetCurrentThreadId()))
+            InterlockedIncrement(&critsect_contention_errors);
+        /* hold it for a short while, and sometimes recursively */
+        if (!(i % 16)) EnterCriticalSection(&critsect_contention);
+        for (j = 0; j < 10; j++) critsect_contention_value++;
+        if (!(i % 16)) LeaveCriticalSection(&critsect_contention);
+        LeaveCriticalSection(&critsect_contention);
+    }
+    return 0;
+}
+
+static DWORD run_critsect_contention(DWORD spincount)
+{
+    LARGE_INTEGER start, end, freq;
+    HANDLE threads[4];
+    SYSTEM_INFO si;
+    DWORD i, ret;
+
+    critsect_contention_value = 0;
+    critsect_contention_errors = 0;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 4; i++)
+        threads[i] = CreateThread(NULL, 0, critsect_contention_thread, NULL, 0, NULL);
+    WaitForMultipleObjects(4, threads, TRUE, INFINITE);
+    QueryPerformanceCounter(&end);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+
+    ok(!critsect_contention_errors, "got %d errors\n", critsect_contention_errors);
+    ok(critsect_contention_value == 4 * 10 * CONTENTION_LOOPS, "got %u\n", critsect_contention_value);
+    ok(TryEnterCriticalSection(&critsect_contention), "section should be free\n");
+    LeaveCriticalSection(&critsect_contention);
+    ok(critsect_contention.LockCount == -1, "got LockCount %d\n", critsect_contention.LockCount);
+
+    /* spinning must not change the spin count seen by the application */
+    GetSystemInfo(&si);
+    if (si.dwNumberOfProcessors <= 1) spincount = 0;
+    ret = SetCriticalSectionSpinCount(&critsect_contention, 1234);
+    ok((ret & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS) == spincount, "got previous spin count %x\n", ret);
+    if (si.dwNumberOfProcessors > 1)
+    {
+        ret = SetCriticalSectionSpinCount(&critsect_contention, 0);
+        ok(ret == 1234, "got previous spin count %x\n", ret);
+    }
+    DeleteCriticalSection(&critsect_contention);
+    return (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart);
+}
+
+static void test_critsect_contention(void)
+{
+    DWORD time;
+    BOOL ret;
+
+    InitializeCriticalSection(&critsect_contention);
+    time = run_critsect_contention(0);
+    trace("critical section without spinning: %u ms\n", time);
+
+    InitializeCriticalSectionAndSpinCount(&critsect_contention, 4000);
+    time = run_critsect_contention(4000);
+    trace("critical section with spin count 4000: %u ms\n", time);
+
+    if (!pInitializeCriticalSectionEx)
+    {
+        win_skip("InitializeCriticalSectionEx is not available\n");
+        return;
+    }
+    ret = pInitializeCriticalSectionEx(&critsect_contention, 1000, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    ok(ret, "InitializeCriticalSectionEx failed %u\n", GetLastError());
+    time = run_critsect_contention(1000);
+    trace("critical section with dynamic spinning: %u ms\n", time);
+}
+
+#define TIMER_COUNT 512
+
+static void test_waitable_timer_many(void)
+{
+    static HANDLE timers[TIMER_COUNT];
+    static DWORD due[TIMER_COUNT];
+    LARGE_INTEGER when, start, end, freq;
+    DWORD i, ret, elapsed, fired = 0;
+
+    if (!pCreateWaitableTimerA)
+    {
+        win_skip("CreateWaitableTimerA() is not available\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        timers[i] = pCreateWaitableTimerA(NULL, TRUE, NULL);
+        ok(timers[i] != NULL, "CreateWaitableTimer failed with error %u\n", GetLastError());
+        /* spread them over half a second, with a few far in the future */
+        due[i] = (i % 64) ? 10 + (i * 7919) % 500 : 24 * 60 * 60 * 1000;
+        when.QuadPart = -(LONGLONG)due[i] * 10000;
+        ret = SetWaitableTimer(timers[i], &when, 0, NULL, NULL, FALSE);
+        ok(ret, "SetWaitableTimer failed with error %u\n", GetLastError());
+    }
+    for (i = 1; i < TIMER_COUNT; i += 2)
+    {
+        ret = CancelWaitableTimer(timers[i]);
+        ok(ret, "CancelWaitableTimer failed with error %u\n", GetLastError());
+    }
+
+    for (i = 0; i < TIMER_COUNT; i += 2)
+    {
+        if (!(i % 64)) continue;
+        ret = WaitForSingleObject(timers[i], 5000);
+        ok(ret == WAIT_OBJECT_0, "timer %u: got %u\n", i, ret);
+        QueryPerformanceCounter(&end);
+        elapsed = (end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart;
+        /* allow for the granularity of the system timer */
+        ok(elapsed + 20 >= due[i], "timer %u fired after %u ms, expected %u\n", i, elapsed, due[i]);
+        fired++;
+    }
+    QueryPerformanceCounter(&end);
+    trace("%u timers fired in %u ms\n", fired,
+          (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        if (i % 2 || !(i % 64))
+        {
+            ret = WaitForSingleObject(timers[i], 0);
+            ok(ret == WAIT_TIMEOUT, "timer %u: got %u\n", i, ret);
+        }
+        CloseHandle(timers[i]);
+    }
+}
+
 START_TEST(sync)
 {
     HMODULE hdll = GetModuleHandleA("kernel32.dll");
@@ -2312,6 +2733,9 @@ START_TEST(sync)
     pReleaseSRWLockShared = (void *)GetProcAddress(hdll, "ReleaseSRWLockShared");
     pTryAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
     pTryAcquireSRWLockShared = (void *)GetProcAddress(hdll, "TryAcquireSRWLockShared");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
+    pSetFileCompletionNotificationModes = (void *)GetProcAddress(hdll, "SetFileCompletionNotificationModes");
+    pInitializeCriticalSectionEx = (void *)GetProcAddress(hdll, "InitializeCriticalSectionEx");
 
     test_signalandwait();
     test_mutex();
@@ -2320,6 +2744,7 @@ START_TEST(sync)
     test_semaphore();
     test_waitable_timer();
     test_iocp_callback();
+    test_iocp_ex();
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
@@ -2328,4 +2753,9 @@ START_TEST(sync)
     test_condvars_consumer_producer();
     test_srwlock_base();
     test_srwlock_example();
+    test_srwlock_contention();
+    test_event_pingpong();
+    test_event_wait_interrupted();
+    test_critsect_contention();
+    test_waitable_timer_many();
 }
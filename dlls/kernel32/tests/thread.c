@@ -90,6 +90,11 @@ static PTP_WORK (WINAPI *pCreateThreadpoolWork)(PTP_WORK_CALLBACK,PVOID,PTP_CALL
 static void (WINAPI *pSubmitThreadpoolWork)(PTP_WORK);
 static void (WINAPI *pWaitForThreadpoolWorkCallbacks)(PTP_WORK,BOOL);
 static void (WINAPI *pCloseThreadpoolWork)(PTP_WORK);
+static BOOL (WINAPI *pGetLogicalProcessorInformationEx)(LOGICAL_PROCESSOR_RELATIONSHIP,PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX,PDWORD);
+static BOOL (WINAPI *pGetThreadGroupAffinity)(HANDLE,GROUP_AFFINITY*);
+static BOOL (WINAPI *pSetThreadGroupAffinity)(HANDLE,const GROUP_AFFINITY*,GROUP_AFFINITY*);
+static BOOL (WINAPI *pGetNumaHighestNodeNumber)(PULONG);
+static BOOL (WINAPI *pGetNumaNodeProcessorMask)(UCHAR,PULONGLONG);
 
 static HANDLE create_target_process(const char *arg)
 {
@@ -1638,6 +1643,125 @@ static void test_threadpool(void)
     todo_wine ok (pool != NULL, "CreateThreadpool failed\n");
 }
 
+static void test_processor_topology(void)
+{
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info, *ptr;
+    GROUP_AFFINITY affinity, old_affinity;
+    DWORD_PTR processMask, systemMask;
+    ULONG_PTR cores = 0, packages = 0, group_mask = 0;
+    ULONGLONG node_mask;
+    ULONG highest;
+    DWORD len = 0, nb_cores = 0, nb_caches = 0, nb_groups = 0;
+    BOOL ret;
+
+    if (!pGetLogicalProcessorInformationEx)
+    {
+        win_skip("GetLogicalProcessorInformationEx is not available\n");
+        return;
+    }
+
+    SetLastError(0xdeadbeef);
+    ret = pGetLogicalProcessorInformationEx(RelationAll, NULL, &len);
+    ok(!ret && GetLastError() == ERROR_INSUFFICIENT_BUFFER, "got %d, error %u\n", ret, GetLastError());
+    ok(len > 0, "got len %u\n", len);
+
+    info = HeapAlloc(GetProcessHeap(), 0, len);
+    ret = pGetLogicalProcessorInformationEx(RelationAll, info, &len);
+    ok(ret, "GetLogicalProcessorInformationEx failed, error %u\n", GetLastError());
+
+    for (ptr = info; (char *)ptr < (char *)info + len;
+         ptr = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((char *)ptr + ptr->Size))
+    {
+        ok(ptr->Size > 0, "got empty record\n");
+        if (!ptr->Size) break;
+        switch (ptr->Relationship)
+        {
+        case RelationProcessorCore:
+            ok(ptr->Processor.GroupCount == 1, "got %u groups\n", ptr->Processor.GroupCount);
+            ok(!(cores & ptr->Processor.GroupMask[0].Mask), "overlapping cores %lx\n",
+               (ULONG_PTR)ptr->Processor.GroupMask[0].Mask);
+            cores |= ptr->Processor.GroupMask[0].Mask;
+            nb_cores++;
+            break;
+        case RelationProcessorPackage:
+            packages |= ptr->Processor.GroupMask[0].Mask;
+            break;
+        case RelationCache:
+            ok(ptr->Cache.Level >= 1 && ptr->Cache.Level <= 4, "got level %u\n", ptr->Cache.Level);
+            nb_caches++;
+            break;
+        case RelationGroup:
+            ok(ptr->Group.ActiveGroupCount >= 1, "got %u groups\n", ptr->Group.ActiveGroupCount);
+            group_mask = ptr->Group.GroupInfo[0].ActiveProcessorMask;
+            nb_groups++;
+            break;
+        default:
+            break;
+        }
+    }
+    ok(nb_cores > 0, "no processor cores\n");
+    ok(nb_groups == 1, "got %u group records\n", nb_groups);
+    ok(cores == packages, "cores %lx packages %lx\n", cores, packages);
+    ok(cores == group_mask, "cores %lx group %lx\n", cores, group_mask);
+    trace("%u cores, %u caches, processors %lx\n", nb_cores, nb_caches, cores);
+    HeapFree(GetProcessHeap(), 0, info);
+
+    /* filtered queries only return the requested records */
+    len = 0;
+    pGetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &len);
+    info = HeapAlloc(GetProcessHeap(), 0, len);
+    ret = pGetLogicalProcessorInformationEx(RelationProcessorCore, info, &len);
+    ok(ret, "GetLogicalProcessorInformationEx failed, error %u\n", GetLastError());
+    for (ptr = info; (char *)ptr < (char *)info + len;
+         ptr = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((char *)ptr + ptr->Size))
+    {
+        ok(ptr->Relationship == RelationProcessorCore, "got relationship %u\n", ptr->Relationship);
+        nb_cores--;
+    }
+    ok(!nb_cores, "core count mismatch\n");
+    HeapFree(GetProcessHeap(), 0, info);
+
+    if (pGetNumaHighestNodeNumber && pGetNumaNodeProcessorMask)
+    {
+        ret = pGetNumaHighestNodeNumber(&highest);
+        ok(ret, "GetNumaHighestNodeNumber failed, error %u\n", GetLastError());
+        ret = pGetNumaNodeProcessorMask(0, &node_mask);
+        ok(ret, "GetNumaNodeProcessorMask failed, error %u\n", GetLastError());
+        ok(node_mask && !(node_mask & ~(ULONGLONG)cores), "got node mask %x%08x\n",
+           (DWORD)(node_mask >> 32), (DWORD)node_mask);
+    }
+
+    if (!pGetThreadGroupAffinity || !pSetThreadGroupAffinity)
+    {
+        win_skip("thread group affinity functions are not available\n");
+        return;
+    }
+
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+    memset(&affinity, 0, sizeof(affinity));
+    ret = pGetThreadGroupAffinity(GetCurrentThread(), &affinity);
+    ok(ret, "GetThreadGroupAffinity failed, error %u\n", GetLastError());
+    ok(affinity.Group == 0, "got group %u\n", affinity.Group);
+    ok(affinity.Mask == processMask, "got mask %lx, expected %lx\n", affinity.Mask, processMask);
+
+    /* pin the thread to its lowest processor */
+    memset(&affinity, 0, sizeof(affinity));
+    affinity.Mask = processMask & ~(processMask - 1);
+    ret = pSetThreadGroupAffinity(GetCurrentThread(), &affinity, &old_affinity);
+    ok(ret, "SetThreadGroupAffinity failed, error %u\n", GetLastError());
+    ok(old_affinity.Mask == processMask, "got mask %lx\n", old_affinity.Mask);
+    ret = pGetThreadGroupAffinity(GetCurrentThread(), &affinity);
+    ok(ret && affinity.Mask == (processMask & ~(processMask - 1)), "got mask %lx\n", affinity.Mask);
+
+    affinity.Group = 1;
+    SetLastError(0xdeadbeef);
+    ret = pSetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+    ok(!ret && GetLastError() == ERROR_INVALID_PARAMETER, "got %d, error %u\n", ret, GetLastError());
+
+    ret = pSetThreadGroupAffinity(GetCurrentThread(), &old_affinity, NULL);
+    ok(ret, "SetThreadGroupAffinity failed, error %u\n", GetLastError());
+}
+
 static void init_funcs(void)
 {
     HMODULE hKernel32 = GetModuleHandleA("kernel32.dll");
@@ -1647,6 +1771,11 @@ static void init_funcs(void)
 
 #define X(f) p##f = (void*)GetProcAddress(hKernel32, #f)
     X(GetThreadPriorityBoost);
+    X(GetLogicalProcessorInformationEx);
+    X(GetThreadGroupAffinity);
+    X(SetThreadGroupAffinity);
+    X(GetNumaHighestNodeNumber);
+    X(GetNumaNodeProcessorMask);
     X(OpenThread);
     X(QueueUserWorkItem);
     X(SetThreadIdealProcessor);
@@ -1720,6 +1849,7 @@ START_TEST(thread)
    test_thread_priority();
    test_GetThreadTimes();
    test_thread_processor();
+   test_processor_topology();
    test_GetThreadExitCode();
 #ifdef __i386__
    test_SetThreadContext();
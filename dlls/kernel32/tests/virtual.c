@@ -2489,6 +2489,53 @@ static void test_shared_memory(int is_child)
     CloseHandle(mapping);
 }
 
+static void test_many_views(void)
+{
+    const unsigned int count = sizeof(void *) > sizeof(int) ? 100000 : 10000;
+    MEMORY_BASIC_INFORMATION info;
+    unsigned int i, failed = 0;
+    DWORD start;
+    void **ptrs;
+
+    ptrs = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*ptrs) );
+    start = GetTickCount();
+
+    for (i = 0; i < count; i++)
+    {
+        ptrs[i] = VirtualAlloc( NULL, 0x1000, MEM_RESERVE, PAGE_NOACCESS );
+        if (!ptrs[i]) break;
+    }
+    ok( i == count, "VirtualAlloc failed after %u views: %u\n", i, GetLastError() );
+    while (i < count) ptrs[i++] = NULL;
+
+    /* free every other view and query the resulting holes */
+    for (i = 0; i < count; i += 2)
+        if (ptrs[i] && !VirtualFree( ptrs[i], 0, MEM_RELEASE )) failed++;
+    ok( !failed, "VirtualFree failed %u times\n", failed );
+
+    for (i = 1; i < count; i += 2)
+    {
+        if (!ptrs[i]) continue;
+        if (VirtualQuery( ptrs[i], &info, sizeof(info) ) != sizeof(info) ||
+            info.AllocationBase != ptrs[i] || info.State != MEM_RESERVE) failed++;
+        if (VirtualQuery( (char *)ptrs[i] + 0x1000, &info, sizeof(info) ) != sizeof(info) ||
+            info.State != MEM_FREE) failed++;
+    }
+    ok( !failed, "VirtualQuery returned wrong information %u times\n", failed );
+
+    /* refill the holes, then release everything */
+    for (i = 0; i < count; i += 2)
+        if (!(ptrs[i] = VirtualAlloc( NULL, 0x1000, MEM_RESERVE, PAGE_NOACCESS ))) failed++;
+    ok( !failed, "VirtualAlloc failed %u times\n", failed );
+
+    for (i = 0; i < count; i++)
+        if (ptrs[i] && !VirtualFree( ptrs[i], 0, MEM_RELEASE )) failed++;
+    ok( !failed, "VirtualFree failed %u times\n", failed );
+
+    trace( "%u views churned in %u ms\n", count, GetTickCount() - start );
+    HeapFree( GetProcessHeap(), 0, ptrs );
+}
+
 START_TEST(virtual)
 {
     int argc;
@@ -2547,4 +2594,5 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_many_views();
 }
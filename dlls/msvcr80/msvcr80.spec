@@ -462,14 +462,14 @@
 @ cdecl _execvpe(str ptr ptr) msvcrt._execvpe
 @ cdecl _exit(long) msvcrt._exit
 @ cdecl _expand(ptr long) msvcrt._expand
-@ stub _fclose_nolock
+@ cdecl _fclose_nolock(ptr) msvcrt._fclose_nolock
 @ cdecl _fcloseall() msvcrt._fcloseall
 @ cdecl _fcvt(double long ptr ptr) msvcrt._fcvt
 @ cdecl _fcvt_s(ptr long double long ptr ptr) msvcrt._fcvt_s
 @ cdecl _fdopen(long str) msvcrt._fdopen
-@ stub _fflush_nolock
+@ cdecl _fflush_nolock(ptr) msvcrt._fflush_nolock
 @ cdecl _fgetchar() msvcrt._fgetchar
-@ stub _fgetwc_nolock
+@ cdecl _fgetwc_nolock(ptr) msvcrt._fgetwc_nolock
 @ cdecl _fgetwchar() msvcrt._fgetwchar
 @ cdecl _filbuf(ptr) msvcrt._filbuf
 @ cdecl _filelength(long) msvcrt._filelength
@@ -498,9 +498,9 @@
 @ stub _fprintf_p_l
 @ stub _fprintf_s_l
 @ cdecl _fputchar(long) msvcrt._fputchar
-@ stub _fputwc_nolock
+@ cdecl _fputwc_nolock(long ptr) msvcrt._fputwc_nolock
 @ cdecl _fputwchar(long) msvcrt._fputwchar
-@ stub _fread_nolock
+@ cdecl _fread_nolock(ptr long long ptr) msvcrt._fread_nolock
 @ stub _fread_nolock_s
 @ cdecl _free_locale(ptr) msvcrt._free_locale
 @ stub _freea
@@ -508,17 +508,17 @@
 @ stub _freefls
 @ varargs _fscanf_l(ptr str ptr) msvcrt._fscanf_l
 @ varargs _fscanf_s_l(ptr str ptr) msvcrt._fscanf_s_l
-@ stub _fseek_nolock
+@ cdecl _fseek_nolock(ptr long long) msvcrt._fseek_nolock
 @ cdecl _fseeki64(ptr int64 long) msvcrt._fseeki64
-@ stub _fseeki64_nolock
+@ cdecl _fseeki64_nolock(ptr int64 long) msvcrt._fseeki64_nolock
 @ cdecl _fsopen(str str long) msvcrt._fsopen
 @ cdecl _fstat32(long ptr) msvcrt._fstat32
 @ stub _fstat32i64
 @ cdecl _fstat64(long ptr) msvcrt._fstat64
 @ cdecl _fstat64i32(long ptr) msvcrt._fstat64i32
-@ stub _ftell_nolock
+@ cdecl _ftell_nolock(ptr) msvcrt._ftell_nolock
 @ cdecl -ret64 _ftelli64(ptr) msvcrt._ftelli64
-@ stub _ftelli64_nolock
+@ cdecl -ret64 _ftelli64_nolock(ptr) msvcrt._ftelli64_nolock
 @ cdecl _ftime32(ptr) msvcrt._ftime32
 @ cdecl _ftime32_s(ptr) msvcrt._ftime32_s
 @ cdecl _ftime64(ptr) msvcrt._ftime64
@@ -531,7 +531,7 @@
 @ stub _fwprintf_p
 @ stub _fwprintf_p_l
 @ stub _fwprintf_s_l
-@ stub _fwrite_nolock
+@ cdecl _fwrite_nolock(ptr long long ptr) msvcrt._fwrite_nolock
 @ varargs _fwscanf_l(ptr wstr ptr) msvcrt._fwscanf_l
 @ varargs _fwscanf_s_l(ptr wstr ptr) msvcrt._fwscanf_s_l
 @ cdecl _gcvt(double long str) msvcrt._gcvt
@@ -1083,10 +1083,10 @@
 @ cdecl _ultow_s(long ptr long long) msvcrt._ultow_s
 @ cdecl _umask(long) msvcrt._umask
 @ stub _umask_s
-@ stub _ungetc_nolock
+@ cdecl _ungetc_nolock(long ptr) msvcrt._ungetc_nolock
 @ cdecl _ungetch(long) msvcrt._ungetch
 @ stub _ungetch_nolock
-@ stub _ungetwc_nolock
+@ cdecl _ungetwc_nolock(long ptr) msvcrt._ungetwc_nolock
 @ stub _ungetwch
 @ stub _ungetwch_nolock
 @ cdecl _unlink(str) msvcrt._unlink
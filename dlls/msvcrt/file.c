@@ -889,26 +889,38 @@ int CDECL MSVCRT__flushall(void)
  *		fflush (MSVCRT.@)
  */
 int CDECL MSVCRT_fflush(MSVCRT_FILE* file)
+{
+    int ret;
+
+    if(!file) {
+        msvcrt_flush_all_buffers(MSVCRT__IOWRT);
+        return 0;
+    }
+
+    MSVCRT__lock_file(file);
+    ret = MSVCRT__fflush_nolock(file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_fflush_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fflush_nolock(MSVCRT_FILE* file)
 {
     if(!file) {
         msvcrt_flush_all_buffers(MSVCRT__IOWRT);
     } else if(file->_flag & MSVCRT__IOWRT) {
         int res;
 
-        MSVCRT__lock_file(file);
         res = msvcrt_flush_buffer(file);
 
         if(!res && (file->_flag & MSVCRT__IOCOMMIT))
             res = MSVCRT__commit(file->_file) ? MSVCRT_EOF : 0;
-        MSVCRT__unlock_file(file);
-
         return res;
     } else if(file->_flag & MSVCRT__IOREAD) {
-        MSVCRT__lock_file(file);
         file->_cnt = 0;
         file->_ptr = file->_base;
-        MSVCRT__unlock_file(file);
-
         return 0;
     }
     return 0;
@@ -1220,13 +1232,25 @@ int CDECL MSVCRT__fseeki64(MSVCRT_FILE* file, __int64 offset, int whence)
   int ret;
 
   MSVCRT__lock_file(file);
+  ret = MSVCRT__fseeki64_nolock(file, offset, whence);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
+/*********************************************************************
+ *		_fseeki64_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fseeki64_nolock(MSVCRT_FILE* file, __int64 offset, int whence)
+{
+  int ret;
+
   /* Flush output if needed */
   if(file->_flag & MSVCRT__IOWRT)
 	msvcrt_flush_buffer(file);
 
   if(whence == SEEK_CUR && file->_flag & MSVCRT__IOREAD ) {
       whence = SEEK_SET;
-      offset += MSVCRT__ftelli64(file);
+      offset += MSVCRT__ftelli64_nolock(file);
   }
 
   /* Discard buffered input */
@@ -1240,7 +1264,6 @@ int CDECL MSVCRT__fseeki64(MSVCRT_FILE* file, __int64 offset, int whence)
   file->_flag &= ~MSVCRT__IOEOF;
   ret = (MSVCRT__lseeki64(file->_file,offset,whence) == -1)?-1:0;
 
-  MSVCRT__unlock_file(file);
   return ret;
 }
 
@@ -1252,6 +1275,14 @@ int CDECL MSVCRT_fseek(MSVCRT_FILE* file, MSVCRT_long offset, int whence)
     return MSVCRT__fseeki64( file, offset, whence );
 }
 
+/*********************************************************************
+ *		_fseek_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fseek_nolock(MSVCRT_FILE* file, MSVCRT_long offset, int whence)
+{
+    return MSVCRT__fseeki64_nolock( file, offset, whence );
+}
+
 /*********************************************************************
  *		_chsize_s (MSVCRT.@)
  */
@@ -2481,6 +2512,40 @@ static int read_utf8(int fd, MSVCRT_wchar_t *buf, unsigned int count)
     return num_read*2;
 }
 
+/*********************************************************************
+ * (internal) text_find_cr_or_eof
+ *
+ * Returns the offset of the first \r or ^Z character in buf, or len.
+ * Scans a machine word at a time since text mode reads are dominated
+ * by runs of characters that need no translation.
+ */
+static unsigned int text_find_cr_or_eof(const char *buf, unsigned int len)
+{
+    const ULONG_PTR ones = ~(ULONG_PTR)0 / 0xff, highs = ones << 7;
+    const char *p = buf, *end = buf + len;
+
+    while (p < end && ((ULONG_PTR)p & (sizeof(ULONG_PTR) - 1)))
+    {
+        if (*p == '\r' || *p == 0x1a)
+            return p - buf;
+        p++;
+    }
+
+    for (; (ULONG_PTR)(end - p) >= sizeof(ULONG_PTR); p += sizeof(ULONG_PTR))
+    {
+        ULONG_PTR w = *(const ULONG_PTR *)p;
+        ULONG_PTR cr = w ^ (ones * '\r'), eof = w ^ (ones * 0x1a);
+
+        if (((cr - ones) & ~cr & highs) | ((eof - ones) & ~eof & highs))
+            break;
+    }
+
+    for (; p < end; p++)
+        if (*p == '\r' || *p == 0x1a)
+            return p - buf;
+    return len;
+}
+
 /*********************************************************************
  * (internal) read_i
  *
@@ -2564,6 +2629,22 @@ static int read_i(int fd, void *buf, unsigned int count)
 
             for (i=0, j=0; i<num_read; i+=1+utf16)
             {
+                /* move runs of untranslated characters in one go */
+                if (!utf16)
+                {
+                    DWORD run = text_find_cr_or_eof(bufstart+i, num_read-i);
+
+                    if (run)
+                    {
+                        if (j != i)
+                            memmove(bufstart+j, bufstart+i, run);
+                        i += run;
+                        j += run;
+                        if (i == num_read)
+                            break;
+                    }
+                }
+
                 /* in text mode, a ctrl-z signals EOF */
                 if (bufstart[i]==0x1a && (!utf16 || bufstart[i+1]==0))
                 {
@@ -3099,21 +3180,25 @@ int CDECL MSVCRT__write(int fd, const void* buf, unsigned int count)
 
         if (!(info->exflag & (EF_UTF8|EF_UTF16)))
         {
+            const char *src, *lf, *end = s + count;
+
             /* find number of \n */
-            for (nr_lf=0, i=0; i<count; i++)
-                if (s[i] == '\n')
-                    nr_lf++;
+            for (nr_lf=0, src=s; (lf = memchr(src, '\n', end-src)); src=lf+1)
+                nr_lf++;
             if (nr_lf)
             {
                 size = count+nr_lf;
                 if ((q = p = MSVCRT_malloc(size)))
                 {
-                    for (s = buf, i = 0, j = 0; i < count; i++)
+                    /* copy the runs between line feeds in bulk */
+                    for (src = s, j = 0; (lf = memchr(src, '\n', end-src)); src = lf+1)
                     {
-                        if (s[i] == '\n')
-                            p[j++] = '\r';
-                        p[j++] = s[i];
+                        memcpy(p+j, src, lf-src);
+                        j += lf-src;
+                        p[j++] = '\r';
+                        p[j++] = '\n';
                     }
+                    memcpy(p+j, src, end-src);
                 }
                 else
                 {
@@ -3246,22 +3331,33 @@ int CDECL MSVCRT__putw(int val, MSVCRT_FILE* file)
  */
 int CDECL MSVCRT_fclose(MSVCRT_FILE* file)
 {
-  int r, flag;
+  int ret;
 
   MSVCRT__lock_file(file);
+  ret = MSVCRT__fclose_nolock(file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
+/*********************************************************************
+ *		_fclose_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fclose_nolock(MSVCRT_FILE* file)
+{
+  int r, flag;
+
   flag = file->_flag;
   MSVCRT_free(file->_tmpfname);
   file->_tmpfname = NULL;
   /* flush stdio buffers */
   if(file->_flag & MSVCRT__IOWRT)
-      MSVCRT_fflush(file);
+      MSVCRT__fflush_nolock(file);
   if(file->_flag & MSVCRT__IOMYBUF)
       MSVCRT_free(file->_base);
 
   r=MSVCRT__close(file->_file);
 
   file->_flag = 0;
-  MSVCRT__unlock_file(file);
 
   return ((r == -1) || (flag & MSVCRT__IOERR) ? MSVCRT_EOF : 0);
 }
@@ -3340,19 +3436,24 @@ int CDECL MSVCRT__filbuf(MSVCRT_FILE* file)
  */
 int CDECL MSVCRT_fgetc(MSVCRT_FILE* file)
 {
-  unsigned char *i;
-  unsigned int j;
+  int ret;
 
   MSVCRT__lock_file(file);
+  ret = MSVCRT__fgetc_nolock(file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
+/*********************************************************************
+ *		_fgetc_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fgetc_nolock(MSVCRT_FILE* file)
+{
   if (file->_cnt>0) {
     file->_cnt--;
-    i = (unsigned char *)file->_ptr++;
-    j = *i;
-  } else
-    j = MSVCRT__filbuf(file);
-
-  MSVCRT__unlock_file(file);
-  return j;
+    return *(unsigned char *)file->_ptr++;
+  }
+  return MSVCRT__filbuf(file);
 }
 
 /*********************************************************************
@@ -3376,7 +3477,7 @@ char * CDECL MSVCRT_fgets(char *s, int size, MSVCRT_FILE* file)
 
   MSVCRT__lock_file(file);
 
-  while ((size >1) && (cc = MSVCRT_fgetc(file)) != MSVCRT_EOF && cc != '\n')
+  while ((size >1) && (cc = MSVCRT__fgetc_nolock(file)) != MSVCRT_EOF && cc != '\n')
     {
       *s++ = (char)cc;
       size --;
@@ -3401,16 +3502,27 @@ char * CDECL MSVCRT_fgets(char *s, int size, MSVCRT_FILE* file)
 MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
 {
     MSVCRT_wint_t ret;
-    int ch;
 
     MSVCRT__lock_file(file);
+    ret = MSVCRT__fgetwc_nolock(file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_fgetwc_nolock (MSVCRT.@)
+ */
+MSVCRT_wint_t CDECL MSVCRT__fgetwc_nolock(MSVCRT_FILE* file)
+{
+    MSVCRT_wint_t ret;
+    int ch;
 
     if((msvcrt_get_ioinfo(file->_file)->exflag & (EF_UTF8 | EF_UTF16))
             || !(msvcrt_get_ioinfo(file->_file)->wxflag & WX_TEXT)) {
         char *p;
 
         for(p=(char*)&ret; (MSVCRT_wint_t*)p<&ret+1; p++) {
-            ch = MSVCRT_fgetc(file);
+            ch = MSVCRT__fgetc_nolock(file);
             if(ch == MSVCRT_EOF) {
                 ret = MSVCRT_WEOF;
                 break;
@@ -3421,11 +3533,11 @@ MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
         char mbs[MSVCRT_MB_LEN_MAX];
         int len = 0;
 
-        ch = MSVCRT_fgetc(file);
+        ch = MSVCRT__fgetc_nolock(file);
         if(ch != MSVCRT_EOF) {
             mbs[0] = (char)ch;
             if(MSVCRT_isleadbyte((unsigned char)mbs[0])) {
-                ch = MSVCRT_fgetc(file);
+                ch = MSVCRT__fgetc_nolock(file);
                 if(ch != MSVCRT_EOF) {
                     mbs[1] = (char)ch;
                     len = 2;
@@ -3439,7 +3551,6 @@ MSVCRT_wint_t CDECL MSVCRT_fgetwc(MSVCRT_FILE* file)
             ret = MSVCRT_WEOF;
     }
 
-    MSVCRT__unlock_file(file);
     return ret;
 }
 
@@ -3455,7 +3566,7 @@ int CDECL MSVCRT__getw(MSVCRT_FILE* file)
 
   MSVCRT__lock_file(file);
   for (j=0; j<sizeof(int); j++) {
-    k = MSVCRT_fgetc(file);
+    k = MSVCRT__fgetc_nolock(file);
     if (k == MSVCRT_EOF) {
       file->_flag |= MSVCRT__IOEOF;
       MSVCRT__unlock_file(file);
@@ -3505,7 +3616,7 @@ MSVCRT_wchar_t * CDECL MSVCRT_fgetws(MSVCRT_wchar_t *s, int size, MSVCRT_FILE* f
 
   MSVCRT__lock_file(file);
 
-  while ((size >1) && (cc = MSVCRT_fgetwc(file)) != MSVCRT_WEOF && cc != '\n')
+  while ((size >1) && (cc = MSVCRT__fgetwc_nolock(file)) != MSVCRT_WEOF && cc != '\n')
     {
       *s++ = cc;
       size --;
@@ -3567,14 +3678,25 @@ int CDECL MSVCRT__flsbuf(int c, MSVCRT_FILE* file)
  *		fwrite (MSVCRT.@)
  */
 MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+{
+    MSVCRT_size_t ret;
+
+    MSVCRT__lock_file(file);
+    ret = MSVCRT__fwrite_nolock(ptr, size, nmemb, file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_fwrite_nolock (MSVCRT.@)
+ */
+MSVCRT_size_t CDECL MSVCRT__fwrite_nolock(const void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
 {
     MSVCRT_size_t wrcnt=size * nmemb;
     int written = 0;
     if (size == 0)
         return 0;
 
-    MSVCRT__lock_file(file);
-
     while(wrcnt) {
         if(file->_cnt) {
             int pcnt=(file->_cnt>wrcnt)? wrcnt: file->_cnt;
@@ -3607,7 +3729,6 @@ MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_si
         }
     }
 
-    MSVCRT__unlock_file(file);
     return written / size;
 }
 
@@ -3615,12 +3736,24 @@ MSVCRT_size_t CDECL MSVCRT_fwrite(const void *ptr, MSVCRT_size_t size, MSVCRT_si
  *		fputwc (MSVCRT.@)
  */
 MSVCRT_wint_t CDECL MSVCRT_fputwc(MSVCRT_wint_t wc, MSVCRT_FILE* file)
+{
+    MSVCRT_wint_t ret;
+
+    MSVCRT__lock_file(file);
+    ret = MSVCRT__fputwc_nolock(wc, file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_fputwc_nolock (MSVCRT.@)
+ */
+MSVCRT_wint_t CDECL MSVCRT__fputwc_nolock(MSVCRT_wint_t wc, MSVCRT_FILE* file)
 {
     MSVCRT_wchar_t mwc=wc;
     ioinfo *fdinfo;
     MSVCRT_wint_t ret;
 
-    MSVCRT__lock_file(file);
     fdinfo = msvcrt_get_ioinfo(file->_file);
 
     if((fdinfo->wxflag&WX_TEXT) && !(fdinfo->exflag&(EF_UTF8|EF_UTF16))) {
@@ -3628,17 +3761,16 @@ MSVCRT_wint_t CDECL MSVCRT_fputwc(MSVCRT_wint_t wc, MSVCRT_FILE* file)
         int char_len;
 
         char_len = MSVCRT_wctomb(buf, mwc);
-        if(char_len!=-1 && MSVCRT_fwrite(buf, char_len, 1, file)==1)
+        if(char_len!=-1 && MSVCRT__fwrite_nolock(buf, char_len, 1, file)==1)
             ret = wc;
         else
             ret = MSVCRT_WEOF;
-    }else if(MSVCRT_fwrite(&mwc, sizeof(mwc), 1, file) == 1) {
+    }else if(MSVCRT__fwrite_nolock(&mwc, sizeof(mwc), 1, file) == 1) {
         ret = wc;
     }else {
         ret = MSVCRT_WEOF;
     }
 
-    MSVCRT__unlock_file(file);
     return ret;
 }
 
@@ -3770,23 +3902,31 @@ int CDECL MSVCRT_fputc(int c, MSVCRT_FILE* file)
   int res;
 
   MSVCRT__lock_file(file);
+  res = MSVCRT__fputc_nolock(c, file);
+  MSVCRT__unlock_file(file);
+  return res;
+}
+
+/*********************************************************************
+ *		_fputc_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__fputc_nolock(int c, MSVCRT_FILE* file)
+{
+  int res;
+
   if(file->_cnt>0) {
     *file->_ptr++=c;
     file->_cnt--;
     if (c == '\n')
     {
       res = msvcrt_flush_buffer(file);
-      MSVCRT__unlock_file(file);
       return res ? res : c;
     }
     else {
-      MSVCRT__unlock_file(file);
       return c & 0xff;
     }
   } else {
-    res = MSVCRT__flsbuf(c, file);
-    MSVCRT__unlock_file(file);
-    return res;
+    return MSVCRT__flsbuf(c, file);
   }
 }
 
@@ -3802,6 +3942,19 @@ int CDECL MSVCRT__fputchar(int c)
  *		fread (MSVCRT.@)
  */
 MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
+{
+  MSVCRT_size_t ret;
+
+  MSVCRT__lock_file(file);
+  ret = MSVCRT__fread_nolock(ptr, size, nmemb, file);
+  MSVCRT__unlock_file(file);
+  return ret;
+}
+
+/*********************************************************************
+ *		_fread_nolock (MSVCRT.@)
+ */
+MSVCRT_size_t CDECL MSVCRT__fread_nolock(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nmemb, MSVCRT_FILE* file)
 {
   MSVCRT_size_t rcnt=size * nmemb;
   MSVCRT_size_t read=0;
@@ -3810,8 +3963,6 @@ MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nm
   if(!rcnt)
 	return 0;
 
-  MSVCRT__lock_file(file);
-
   /* first buffered data */
   if(file->_cnt>0) {
 	int pcnt= (rcnt>file->_cnt)? file->_cnt:rcnt;
@@ -3825,7 +3976,6 @@ MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nm
 	if(file->_flag & MSVCRT__IORW) {
 		file->_flag |= MSVCRT__IOREAD;
 	} else {
-        MSVCRT__unlock_file(file);
         return 0;
     }
   }
@@ -3871,7 +4021,6 @@ MSVCRT_size_t CDECL MSVCRT_fread(void *ptr, MSVCRT_size_t size, MSVCRT_size_t nm
     if (i < 1) break;
   }
   read+=pread;
-  MSVCRT__unlock_file(file);
   return read / size;
 }
 
@@ -3904,7 +4053,7 @@ MSVCRT_size_t CDECL fread_s(void *buf, MSVCRT_size_t buf_size, MSVCRT_size_t ele
                 return 0;
             }
 
-            MSVCRT_fread((char*)buf+buf_pos, 1, size, stream);
+            MSVCRT__fread_nolock((char*)buf+buf_pos, 1, size, stream);
             buf_pos += size;
             bytes_left -= size;
         }else {
@@ -4046,14 +4195,24 @@ int CDECL MSVCRT_fsetpos(MSVCRT_FILE* file, MSVCRT_fpos_t *pos)
  */
 __int64 CDECL MSVCRT__ftelli64(MSVCRT_FILE* file)
 {
-    __int64 pos;
+    __int64 ret;
 
     MSVCRT__lock_file(file);
+    ret = MSVCRT__ftelli64_nolock(file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_ftelli64_nolock (MSVCRT.@)
+ */
+__int64 CDECL MSVCRT__ftelli64_nolock(MSVCRT_FILE* file)
+{
+    __int64 pos;
+
     pos = _telli64(file->_file);
-    if(pos == -1) {
-        MSVCRT__unlock_file(file);
+    if(pos == -1)
         return -1;
-    }
     if(file->_bufsiz)  {
         if(file->_flag & MSVCRT__IOWRT) {
             pos += file->_ptr - file->_base;
@@ -4078,10 +4237,8 @@ __int64 CDECL MSVCRT__ftelli64(MSVCRT_FILE* file)
         } else {
             char *p;
 
-            if(MSVCRT__lseeki64(file->_file, pos, SEEK_SET) != pos) {
-                MSVCRT__unlock_file(file);
+            if(MSVCRT__lseeki64(file->_file, pos, SEEK_SET) != pos)
                 return -1;
-            }
 
             pos -= file->_bufsiz;
             pos += file->_ptr - file->_base;
@@ -4097,7 +4254,6 @@ __int64 CDECL MSVCRT__ftelli64(MSVCRT_FILE* file)
         }
     }
 
-    MSVCRT__unlock_file(file);
     return pos;
 }
 
@@ -4109,6 +4265,14 @@ LONG CDECL MSVCRT_ftell(MSVCRT_FILE* file)
   return MSVCRT__ftelli64(file);
 }
 
+/*********************************************************************
+ *		_ftell_nolock (MSVCRT.@)
+ */
+LONG CDECL MSVCRT__ftell_nolock(MSVCRT_FILE* file)
+{
+  return MSVCRT__ftelli64_nolock(file);
+}
+
 /*********************************************************************
  *		fgetpos (MSVCRT.@)
  */
@@ -4129,7 +4293,7 @@ int CDECL MSVCRT_fputs(const char *s, MSVCRT_FILE* file)
     int ret;
 
     MSVCRT__lock_file(file);
-    ret = MSVCRT_fwrite(s, sizeof(*s), len, file) == len ? 0 : MSVCRT_EOF;
+    ret = MSVCRT__fwrite_nolock(s, sizeof(*s), len, file) == len ? 0 : MSVCRT_EOF;
     MSVCRT__unlock_file(file);
     return ret;
 }
@@ -4145,14 +4309,14 @@ int CDECL MSVCRT_fputws(const MSVCRT_wchar_t *s, MSVCRT_FILE* file)
 
     MSVCRT__lock_file(file);
     if (!(msvcrt_get_ioinfo(file->_file)->wxflag & WX_TEXT)) {
-        ret = MSVCRT_fwrite(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
+        ret = MSVCRT__fwrite_nolock(s,sizeof(*s),len,file) == len ? 0 : MSVCRT_EOF;
         MSVCRT__unlock_file(file);
         return ret;
     }
 
     tmp_buf = add_std_buffer(file);
     for (i=0; i<len; i++) {
-        if(MSVCRT_fputwc(s[i], file) == MSVCRT_WEOF) {
+        if(MSVCRT__fputwc_nolock(s[i], file) == MSVCRT_WEOF) {
             if(tmp_buf) remove_std_buffer(file);
             MSVCRT__unlock_file(file);
             return MSVCRT_WEOF;
@@ -4180,6 +4344,14 @@ int CDECL MSVCRT_getc(MSVCRT_FILE* file)
   return MSVCRT_fgetc(file);
 }
 
+/*********************************************************************
+ *		_getc_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__getc_nolock(MSVCRT_FILE* file)
+{
+  return MSVCRT__fgetc_nolock(file);
+}
+
 /*********************************************************************
  *		gets (MSVCRT.@)
  */
@@ -4189,8 +4361,8 @@ char * CDECL MSVCRT_gets(char *buf)
   char * buf_start = buf;
 
   MSVCRT__lock_file(MSVCRT_stdin);
-  for(cc = MSVCRT_fgetc(MSVCRT_stdin); cc != MSVCRT_EOF && cc != '\n';
-      cc = MSVCRT_fgetc(MSVCRT_stdin))
+  for(cc = MSVCRT__fgetc_nolock(MSVCRT_stdin); cc != MSVCRT_EOF && cc != '\n';
+      cc = MSVCRT__fgetc_nolock(MSVCRT_stdin))
   if(cc != '\r') *buf++ = (char)cc;
 
   *buf = '\0';
@@ -4209,8 +4381,8 @@ MSVCRT_wchar_t* CDECL MSVCRT__getws(MSVCRT_wchar_t* buf)
     MSVCRT_wchar_t* ws = buf;
 
     MSVCRT__lock_file(MSVCRT_stdin);
-    for (cc = MSVCRT_fgetwc(MSVCRT_stdin); cc != MSVCRT_WEOF && cc != '\n';
-         cc = MSVCRT_fgetwc(MSVCRT_stdin))
+    for (cc = MSVCRT__fgetwc_nolock(MSVCRT_stdin); cc != MSVCRT_WEOF && cc != '\n';
+         cc = MSVCRT__fgetwc_nolock(MSVCRT_stdin))
     {
         if (cc != '\r')
             *buf++ = (MSVCRT_wchar_t)cc;
@@ -4255,12 +4427,12 @@ int CDECL MSVCRT_puts(const char *s)
     int ret;
 
     MSVCRT__lock_file(MSVCRT_stdout);
-    if(MSVCRT_fwrite(s, sizeof(*s), len, MSVCRT_stdout) != len) {
+    if(MSVCRT__fwrite_nolock(s, sizeof(*s), len, MSVCRT_stdout) != len) {
         MSVCRT__unlock_file(MSVCRT_stdout);
         return MSVCRT_EOF;
     }
 
-    ret = MSVCRT_fwrite("\n",1,1,MSVCRT_stdout) == 1 ? 0 : MSVCRT_EOF;
+    ret = MSVCRT__fwrite_nolock("\n",1,1,MSVCRT_stdout) == 1 ? 0 : MSVCRT_EOF;
     MSVCRT__unlock_file(MSVCRT_stdout);
     return ret;
 }
@@ -4275,12 +4447,12 @@ int CDECL MSVCRT__putws(const MSVCRT_wchar_t *s)
     int ret;
 
     MSVCRT__lock_file(MSVCRT_stdout);
-    if(MSVCRT_fwrite(s, sizeof(*s), len, MSVCRT_stdout) != len) {
+    if(MSVCRT__fwrite_nolock(s, sizeof(*s), len, MSVCRT_stdout) != len) {
         MSVCRT__unlock_file(MSVCRT_stdout);
         return MSVCRT_EOF;
     }
 
-    ret = MSVCRT_fwrite(&nl,sizeof(nl),1,MSVCRT_stdout) == 1 ? 0 : MSVCRT_EOF;
+    ret = MSVCRT__fwrite_nolock(&nl,sizeof(nl),1,MSVCRT_stdout) == 1 ? 0 : MSVCRT_EOF;
     MSVCRT__unlock_file(MSVCRT_stdout);
     return ret;
 }
@@ -4472,31 +4644,24 @@ int CDECL MSVCRT_tmpfile_s(MSVCRT_FILE** file)
     return 0;
 }
 
+/* the printf callbacks are called with the file locked */
 static int puts_clbk_file_a(void *file, int len, const char *str)
 {
-    return MSVCRT_fwrite(str, sizeof(char), len, file);
+    return MSVCRT__fwrite_nolock(str, sizeof(char), len, file);
 }
 
 static int puts_clbk_file_w(void *file, int len, const MSVCRT_wchar_t *str)
 {
-    int i, ret;
+    int i;
 
-    MSVCRT__lock_file(file);
-
-    if(!(msvcrt_get_ioinfo(((MSVCRT_FILE*)file)->_file)->wxflag & WX_TEXT)) {
-        ret = MSVCRT_fwrite(str, sizeof(MSVCRT_wchar_t), len, file);
-        MSVCRT__unlock_file(file);
-        return ret;
-    }
+    if(!(msvcrt_get_ioinfo(((MSVCRT_FILE*)file)->_file)->wxflag & WX_TEXT))
+        return MSVCRT__fwrite_nolock(str, sizeof(MSVCRT_wchar_t), len, file);
 
     for(i=0; i<len; i++) {
-        if(MSVCRT_fputwc(str[i], file) == MSVCRT_WEOF) {
-            MSVCRT__unlock_file(file);
+        if(MSVCRT__fputwc_nolock(str[i], file) == MSVCRT_WEOF)
             return -1;
-        }
     }
 
-    MSVCRT__unlock_file(file);
     return len;
 }
 
@@ -4719,11 +4884,23 @@ int CDECL MSVCRT_printf_s(const char *format, ...)
  *		ungetc (MSVCRT.@)
  */
 int CDECL MSVCRT_ungetc(int c, MSVCRT_FILE * file)
+{
+    int ret;
+
+    MSVCRT__lock_file(file);
+    ret = MSVCRT__ungetc_nolock(c, file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_ungetc_nolock (MSVCRT.@)
+ */
+int CDECL MSVCRT__ungetc_nolock(int c, MSVCRT_FILE * file)
 {
     if (c == MSVCRT_EOF)
         return MSVCRT_EOF;
 
-    MSVCRT__lock_file(file);
     if(file->_bufsiz == 0 && msvcrt_alloc_buffer(file))
         file->_ptr++;
     if(file->_ptr>file->_base) {
@@ -4731,19 +4908,16 @@ int CDECL MSVCRT_ungetc(int c, MSVCRT_FILE * file)
         if(file->_flag & MSVCRT__IOSTRG) {
             if(*file->_ptr != c) {
                 file->_ptr++;
-                MSVCRT__unlock_file(file);
                 return MSVCRT_EOF;
             }
         }else {
             *file->_ptr = c;
         }
         file->_cnt++;
-        MSVCRT_clearerr(file);
-        MSVCRT__unlock_file(file);
+        file->_flag &= ~(MSVCRT__IOERR | MSVCRT__IOEOF);
         return c;
     }
 
-    MSVCRT__unlock_file(file);
     return MSVCRT_EOF;
 }
 
@@ -4751,44 +4925,48 @@ int CDECL MSVCRT_ungetc(int c, MSVCRT_FILE * file)
  *              ungetwc (MSVCRT.@)
  */
 MSVCRT_wint_t CDECL MSVCRT_ungetwc(MSVCRT_wint_t wc, MSVCRT_FILE * file)
+{
+    MSVCRT_wint_t ret;
+
+    MSVCRT__lock_file(file);
+    ret = MSVCRT__ungetwc_nolock(wc, file);
+    MSVCRT__unlock_file(file);
+    return ret;
+}
+
+/*********************************************************************
+ *		_ungetwc_nolock (MSVCRT.@)
+ */
+MSVCRT_wint_t CDECL MSVCRT__ungetwc_nolock(MSVCRT_wint_t wc, MSVCRT_FILE * file)
 {
     MSVCRT_wchar_t mwc = wc;
 
     if (wc == MSVCRT_WEOF)
         return MSVCRT_WEOF;
 
-    MSVCRT__lock_file(file);
-
     if((msvcrt_get_ioinfo(file->_file)->exflag & (EF_UTF8 | EF_UTF16))
             || !(msvcrt_get_ioinfo(file->_file)->wxflag & WX_TEXT)) {
         unsigned char * pp = (unsigned char *)&mwc;
         int i;
 
         for(i=sizeof(MSVCRT_wchar_t)-1;i>=0;i--) {
-            if(pp[i] != MSVCRT_ungetc(pp[i],file)) {
-                MSVCRT__unlock_file(file);
+            if(pp[i] != MSVCRT__ungetc_nolock(pp[i],file))
                 return MSVCRT_WEOF;
-            }
         }
     }else {
         char mbs[MSVCRT_MB_LEN_MAX];
         int len;
 
         len = MSVCRT_wctomb(mbs, mwc);
-        if(len == -1) {
-            MSVCRT__unlock_file(file);
+        if(len == -1)
             return MSVCRT_WEOF;
-        }
 
         for(len--; len>=0; len--) {
-            if(mbs[len] != MSVCRT_ungetc(mbs[len], file)) {
-                MSVCRT__unlock_file(file);
+            if(mbs[len] != MSVCRT__ungetc_nolock(mbs[len], file))
                 return MSVCRT_WEOF;
-            }
         }
     }
 
-    MSVCRT__unlock_file(file);
     return mwc;
 }
 
@@ -911,7 +911,19 @@ int __cdecl      MSVCRT_fgetc(MSVCRT_FILE*);
 int __cdecl      MSVCRT_ungetc(int,MSVCRT_FILE*);
 MSVCRT_wint_t __cdecl MSVCRT_fgetwc(MSVCRT_FILE*);
 MSVCRT_wint_t __cdecl MSVCRT_ungetwc(MSVCRT_wint_t,MSVCRT_FILE*);
+int __cdecl      MSVCRT__fclose_nolock(MSVCRT_FILE*);
+int __cdecl      MSVCRT__fflush_nolock(MSVCRT_FILE*);
+int __cdecl      MSVCRT__fgetc_nolock(MSVCRT_FILE*);
+int __cdecl      MSVCRT__fputc_nolock(int,MSVCRT_FILE*);
+MSVCRT_wint_t __cdecl MSVCRT__fputwc_nolock(MSVCRT_wint_t,MSVCRT_FILE*);
+MSVCRT_size_t __cdecl MSVCRT__fread_nolock(void*,MSVCRT_size_t,MSVCRT_size_t,MSVCRT_FILE*);
+MSVCRT_size_t __cdecl MSVCRT__fwrite_nolock(const void*,MSVCRT_size_t,MSVCRT_size_t,MSVCRT_FILE*);
+int __cdecl      MSVCRT__fseeki64_nolock(MSVCRT_FILE*,__int64,int);
+int __cdecl      MSVCRT__ungetc_nolock(int,MSVCRT_FILE*);
+MSVCRT_wint_t __cdecl MSVCRT__fgetwc_nolock(MSVCRT_FILE*);
+MSVCRT_wint_t __cdecl MSVCRT__ungetwc_nolock(MSVCRT_wint_t,MSVCRT_FILE*);
 __int64 __cdecl  MSVCRT__ftelli64(MSVCRT_FILE* file);
+__int64 __cdecl  MSVCRT__ftelli64_nolock(MSVCRT_FILE*);
 void __cdecl     MSVCRT__exit(int);
 void __cdecl     MSVCRT_abort(void);
 MSVCRT_ulong* __cdecl MSVCRT___doserrno(void);
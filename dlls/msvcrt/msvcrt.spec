@@ -428,11 +428,15 @@
 @ cdecl _exit(long) MSVCRT__exit
 @ cdecl _expand(ptr long)
 # stub _expand_dbg(ptr long long str long)
+@ cdecl _fclose_nolock(ptr) MSVCRT__fclose_nolock
 @ cdecl _fcloseall() MSVCRT__fcloseall
 @ cdecl _fcvt(double long ptr ptr)
 @ cdecl _fcvt_s(ptr long double long ptr ptr)
 @ cdecl _fdopen(long str) MSVCRT__fdopen
+@ cdecl _fflush_nolock(ptr) MSVCRT__fflush_nolock
+@ cdecl _fgetc_nolock(ptr) MSVCRT__fgetc_nolock
 @ cdecl _fgetchar() MSVCRT__fgetchar
+@ cdecl _fgetwc_nolock(ptr) MSVCRT__fgetwc_nolock
 @ cdecl _fgetwchar() MSVCRT__fgetwchar
 @ cdecl _filbuf(ptr) MSVCRT__filbuf
 # extern _fileinfo
@@ -463,20 +467,27 @@
 # stub _fprintf_p(ptr str)
 # stub _fprintf_p_l(ptr str ptr)
 # stub _fprintf_s_l(ptr str ptr)
+@ cdecl _fputc_nolock(long ptr) MSVCRT__fputc_nolock
 @ cdecl _fputchar(long) MSVCRT__fputchar
+@ cdecl _fputwc_nolock(long ptr) MSVCRT__fputwc_nolock
 @ cdecl _fputwchar(long) MSVCRT__fputwchar
+@ cdecl _fread_nolock(ptr long long ptr) MSVCRT__fread_nolock
 # stub _free_dbg(ptr long)
 @ cdecl _free_locale(ptr) MSVCRT__free_locale
 # stub _freea(ptr)
 # stub _freea_s
 @ varargs _fscanf_l(ptr str ptr) MSVCRT__fscanf_l
 @ varargs _fscanf_s_l(ptr str ptr) MSVCRT__fscanf_s_l
+@ cdecl _fseek_nolock(ptr long long) MSVCRT__fseek_nolock
 @ cdecl _fseeki64(ptr int64 long) MSVCRT__fseeki64
+@ cdecl _fseeki64_nolock(ptr int64 long) MSVCRT__fseeki64_nolock
 @ cdecl _fsopen(str str long) MSVCRT__fsopen
 @ cdecl _fstat(long ptr) MSVCRT__fstat
 @ cdecl _fstat64(long ptr) MSVCRT__fstat64
 @ cdecl _fstati64(long ptr) MSVCRT__fstati64
+@ cdecl _ftell_nolock(ptr) MSVCRT__ftell_nolock
 @ cdecl -ret64 _ftelli64(ptr) MSVCRT__ftelli64
+@ cdecl -ret64 _ftelli64_nolock(ptr) MSVCRT__ftelli64_nolock
 @ cdecl _ftime(ptr) MSVCRT__ftime
 @ cdecl _ftime32(ptr) MSVCRT__ftime32
 @ cdecl _ftime32_s(ptr) MSVCRT__ftime32_s
@@ -491,6 +502,7 @@
 @ cdecl _futime(long ptr)
 @ cdecl _futime32(long ptr)
 @ cdecl _futime64(long ptr)
+@ cdecl _fwrite_nolock(ptr long long ptr) MSVCRT__fwrite_nolock
 @ varargs _fwprintf_l(ptr wstr ptr) MSVCRT__fwprintf_l
 # stub _fwprintf_p(ptr wstr)
 # stub _fwprintf_p_l(ptr wstr ptr)
@@ -520,6 +532,7 @@
 @ cdecl _get_terminate() MSVCRT__get_terminate
 @ cdecl _get_tzname(ptr str long long) MSVCRT__get_tzname
 @ cdecl _get_unexpected() MSVCRT__get_unexpected
+@ cdecl _getc_nolock(ptr) MSVCRT__getc_nolock
 @ cdecl _getch()
 @ cdecl _getche()
 @ cdecl _getcwd(str long) MSVCRT__getcwd
@@ -1024,7 +1037,9 @@
 @ cdecl _ultow_s(long ptr long long)
 @ cdecl _umask(long) MSVCRT__umask
 # stub _umask_s(long ptr)
+@ cdecl _ungetc_nolock(long ptr) MSVCRT__ungetc_nolock
 @ cdecl _ungetch(long)
+@ cdecl _ungetwc_nolock(long ptr) MSVCRT__ungetwc_nolock
 # stub _ungetwch(long)
 @ cdecl _unlink(str) MSVCRT__unlink
 @ cdecl _unloaddll(long)
@@ -49,6 +49,8 @@ static HANDLE proc_handles[2];
 
 static int (__cdecl *p_fopen_s)(FILE**, const char*, const char*);
 static int (__cdecl *p__wfopen_s)(FILE**, const wchar_t*, const wchar_t*);
+static size_t (__cdecl *p__fread_nolock)(void*, size_t, size_t, FILE*);
+static size_t (__cdecl *p__fwrite_nolock)(const void*, size_t, size_t, FILE*);
 
 static const char* get_base_name(const char *path)
 {
@@ -71,6 +73,8 @@ static void init(void)
     p_fopen_s = (void*)GetProcAddress(hmod, "fopen_s");
     p__wfopen_s = (void*)GetProcAddress(hmod, "_wfopen_s");
     __pioinfo = (void*)GetProcAddress(hmod, "__pioinfo");
+    p__fread_nolock = (void*)GetProcAddress(hmod, "_fread_nolock");
+    p__fwrite_nolock = (void*)GetProcAddress(hmod, "_fwrite_nolock");
 }
 
 static void test_filbuf( void )
@@ -1050,6 +1054,105 @@ static void test_ctrlz( void )
   free(tempf);
 }
 
+static void test_text_throughput( void )
+{
+  static const char line[] = "0123456789abcdefghijklmnopqrstuvwxyz\rABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  const int lines = 20000, len = sizeof(line) - 1;
+  const int size = lines * (len + 1);
+  LARGE_INTEGER freq, start, end;
+  char *tempf, *buffer;
+  FILE *tempfh;
+  int i, c, count, nl;
+  size_t ret;
+
+  QueryPerformanceFrequency(&freq);
+  buffer = malloc(size + 16);
+  tempf = _tempnam(".","wne");
+
+  QueryPerformanceCounter(&start);
+  tempfh = fopen(tempf, "wt");
+  for (i = 0; i < lines; i++)
+  {
+    fputs(line, tempfh);
+    fputc('\n', tempfh);
+  }
+  fclose(tempfh);
+  QueryPerformanceCounter(&end);
+  trace("fputs/fputc: %u bytes in %.3f ms\n", size,
+        (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+  /* every \n gains a \r in text mode */
+  tempfh = fopen(tempf, "rb");
+  ret = fread(buffer, 1, size + 16, tempfh);
+  ok(ret == size + lines, "got %u bytes, expected %u\n", (unsigned)ret, size + lines);
+  ok(!memcmp(buffer, line, len) && buffer[len] == '\r' && buffer[len + 1] == '\n',
+     "unexpected data %s\n", buffer);
+  fclose(tempfh);
+
+  QueryPerformanceCounter(&start);
+  tempfh = fopen(tempf, "rt");
+  for (count = nl = 0; (c = fgetc(tempfh)) != EOF; count++)
+    if (c == '\n') nl++;
+  fclose(tempfh);
+  QueryPerformanceCounter(&end);
+  ok(count == size, "read %d characters, expected %d\n", count, size);
+  ok(nl == lines, "read %d lines, expected %d\n", nl, lines);
+  trace("fgetc: %u bytes in %.3f ms\n", size,
+        (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+  QueryPerformanceCounter(&start);
+  tempfh = fopen(tempf, "rt");
+  ret = fread(buffer, 1, size + 16, tempfh);
+  fclose(tempfh);
+  QueryPerformanceCounter(&end);
+  ok(ret == size, "got %u bytes, expected %u\n", (unsigned)ret, size);
+  for (i = 0; i < lines; i++)
+    if (memcmp(buffer + i * (len + 1), line, len) || buffer[i * (len + 1) + len] != '\n') break;
+  ok(i == lines, "data mismatch at line %d\n", i);
+  trace("fread: %u bytes in %.3f ms\n", size,
+        (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+  /* a ctrl-z after the data still stops text mode reads */
+  tempfh = fopen(tempf, "ab");
+  fputs("\x1a" "trailer", tempfh);
+  fclose(tempfh);
+  tempfh = fopen(tempf, "rt");
+  ret = fread(buffer, 1, size + 16, tempfh);
+  ok(ret == size, "got %u bytes, expected %u\n", (unsigned)ret, size);
+  ok(feof(tempfh), "did not get EOF\n");
+  fclose(tempfh);
+
+  if (!p__fread_nolock || !p__fwrite_nolock)
+  {
+    win_skip("_fread_nolock or _fwrite_nolock not available\n");
+    unlink(tempf);
+    free(tempf);
+    free(buffer);
+    return;
+  }
+
+  QueryPerformanceCounter(&start);
+  tempfh = fopen(tempf, "wt");
+  for (i = 0; i < lines; i++)
+  {
+    p__fwrite_nolock(line, 1, len, tempfh);
+    p__fwrite_nolock("\n", 1, 1, tempfh);
+  }
+  fclose(tempfh);
+  tempfh = fopen(tempf, "rt");
+  ret = p__fread_nolock(buffer, 1, size + 16, tempfh);
+  fclose(tempfh);
+  QueryPerformanceCounter(&end);
+  ok(ret == size, "got %u bytes, expected %u\n", (unsigned)ret, size);
+  ok(!memcmp(buffer + size - len - 1, line, len), "unexpected data\n");
+  trace("_fwrite_nolock/_fread_nolock: %u bytes in %.3f ms\n", size,
+        (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+
+  unlink(tempf);
+  free(tempf);
+  free(buffer);
+}
+
 static void test_file_put_get( void )
 {
   char* tempf;
@@ -2276,6 +2379,7 @@ START_TEST(file)
     test_fgetwc_unicode();
     test_fputwc();
     test_ctrlz();
+    test_text_throughput();
     test_file_put_get();
     test_tmpnam();
     test_get_osfhandle();
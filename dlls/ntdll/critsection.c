@@ -38,8 +38,19 @@
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
+WINE_DECLARE_DEBUG_CHANNEL(lockstat);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
 
+/* Adaptive spinning: for sections flagged with RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN,
+ * and for Wine internal sections that don't have a spin count, we keep an estimate of
+ * how long we have to spin for the owner to release the section. It follows the spinning
+ * that was needed to get the section, and decays when spinning didn't help because the
+ * owner held it too long. The estimate is stored plus one in the CreatorBackTraceIndex
+ * field of the debug info, which is otherwise unused, so that the spin count seen by
+ * the application stays the one it has set; 0 means that the section isn't adaptive. */
+#define CRITSECT_MIN_SPIN        100    /* always spin at least that much */
+#define CRITSECT_MAX_SPIN        4000
+
 static inline LONG interlocked_inc( PLONG dest )
 {
     return interlocked_xchg_add( dest, 1 ) + 1;
@@ -52,7 +63,7 @@ static inline LONG interlocked_dec( PLONG dest )
 
 static inline void small_pause(void)
 {
-#ifdef __i386__
+#if defined(__i386__) || defined(__x86_64__)
     __asm__ __volatile__( "rep;nop" : : : "memory" );
 #else
     __asm__ __volatile__( "" : : : "memory" );
@@ -240,6 +251,78 @@ static inline NTSTATUS wait_semaphore( RTL_CRITICAL_SECTION *crit, int timeout )
     return ret;
 }
 
+/* Wine internal sections store their name in the debug info */
+static inline const char *crit_section_name( RTL_CRITICAL_SECTION *crit )
+{
+    if (!crit->DebugInfo) return NULL;
+    return (const char *)crit->DebugInfo->Spare[0];
+}
+
+/***********************************************************************
+ *           dump_lock_stats
+ *
+ * Report contention statistics on the lockstat debug channel. EntryCount
+ * counts the times the section was found busy, ContentionCount the times
+ * we had to go to sleep.
+ */
+static void dump_lock_stats( RTL_CRITICAL_SECTION *crit )
+{
+    const char *name = crit_section_name( crit );
+
+    if (!TRACE_ON(lockstat)) return;
+    TRACE_(lockstat)( "section %p %s: %u contended, %u waits, spin count %lx estimate %d\n",
+                      crit, debugstr_a(name ? name : "?"), crit->DebugInfo->EntryCount,
+                      crit->DebugInfo->ContentionCount, (ULONG_PTR)crit->SpinCount,
+                      crit->DebugInfo->CreatorBackTraceIndex - 1 );
+}
+
+/***********************************************************************
+ *           spin_critical_section
+ *
+ * Spin for a while before going to sleep on a busy section, in case the
+ * owner is about to release it. Returns TRUE if we got the section.
+ */
+static BOOL spin_critical_section( RTL_CRITICAL_SECTION *crit )
+{
+    RTL_CRITICAL_SECTION_DEBUG *debug = crit->DebugInfo;
+    ULONG count, limit, estimate = 0;
+    BOOL ret = FALSE;
+
+    if (debug && !debug->CreatorBackTraceIndex && !crit->SpinCount)
+    {
+        /* internal sections are often held very briefly, make them adaptive */
+        if (!crit_section_name( crit ) || NtCurrentTeb()->Peb->NumberOfProcessors <= 1) return FALSE;
+        debug->CreatorBackTraceIndex = 1;
+    }
+
+    if (debug && debug->CreatorBackTraceIndex)
+    {
+        estimate = debug->CreatorBackTraceIndex - 1;
+        limit = min( CRITSECT_MIN_SPIN + 2 * estimate, CRITSECT_MAX_SPIN );
+    }
+    else limit = crit->SpinCount;
+
+    for (count = 0; count < limit; count++)
+    {
+        if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
+        if (crit->LockCount == -1 && interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1)
+        {
+            ret = TRUE;
+            break;
+        }
+        small_pause();
+    }
+
+    if (debug && debug->CreatorBackTraceIndex)
+    {
+        /* the update is racy, but it's only an estimate anyway */
+        if (ret) estimate += ((LONG)count - (LONG)estimate) / 8;
+        else estimate -= estimate / 4;
+        debug->CreatorBackTraceIndex = estimate + 1;
+    }
+    return ret;
+}
+
 /***********************************************************************
  *           RtlInitializeCriticalSection   (NTDLL.@)
  *
@@ -311,7 +394,7 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionAndSpinCount( RTL_CRITICAL_SECTION *
  */
 NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULONG spincount, ULONG flags )
 {
-    if (flags & (RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN|RTL_CRITICAL_SECTION_FLAG_STATIC_INIT))
+    if (flags & RTL_CRITICAL_SECTION_FLAG_STATIC_INIT)
         FIXME("(%p,%u,0x%08x) semi-stub\n", crit, spincount, flags);
 
     /* FIXME: if RTL_CRITICAL_SECTION_FLAG_STATIC_INIT is given, we should use
@@ -340,8 +423,14 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
     crit->LockSemaphore  = 0;
-    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
-    crit->SpinCount = spincount & ~0x80000000;
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) crit->SpinCount = 0;
+    else
+    {
+        crit->SpinCount = spincount & ~0x80000000;
+        /* without debug info, dynamic spinning falls back to the given spin count */
+        if ((flags & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN) && crit->DebugInfo)
+            crit->DebugInfo->CreatorBackTraceIndex = 1;
+    }
     return STATUS_SUCCESS;
 }
 
@@ -393,6 +482,8 @@ ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG s
  */
 NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
+    if (crit->DebugInfo && crit->DebugInfo->EntryCount) dump_lock_stats( crit );
+
     crit->LockCount      = -1;
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
@@ -468,7 +559,11 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         rec.ExceptionInformation[0] = (ULONG_PTR)crit;
         RtlRaiseException( &rec );
     }
-    if (crit->DebugInfo) crit->DebugInfo->ContentionCount++;
+    if (crit->DebugInfo)
+    {
+        DWORD count = ++crit->DebugInfo->ContentionCount;
+        if (count >= 16 && !(count & (count - 1))) dump_lock_stats( crit );
+    }
     return STATUS_SUCCESS;
 }
 
@@ -530,20 +625,12 @@ NTSTATUS WINAPI RtlpUnWaitCriticalSection( RTL_CRITICAL_SECTION *crit )
  */
 NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
-    if (crit->SpinCount)
-    {
-        ULONG count;
+    if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) goto done;
 
-        if (RtlTryEnterCriticalSection( crit )) return STATUS_SUCCESS;
-        for (count = crit->SpinCount; count > 0; count--)
-        {
-            if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
-            if (crit->LockCount == -1)       /* try again */
-            {
-                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) goto done;
-            }
-            small_pause();
-        }
+    if (crit->OwningThread != ULongToHandle(GetCurrentThreadId()))
+    {
+        if (crit->DebugInfo) crit->DebugInfo->EntryCount++;
+        if (spin_critical_section( crit )) goto done;
     }
 
     if (interlocked_inc( &crit->LockCount ))
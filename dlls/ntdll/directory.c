@@ -65,6 +65,9 @@
 #ifdef HAVE_SYS_STATFS_H
 #include <sys/statfs.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include <time.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
@@ -2092,6 +2095,430 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* cache of the contents of directories for case-insensitive lookups */
+
+#define MAX_DIR_CACHE 64  /* max number of cached directories */
+
+struct dir_cache_name
+{
+    ULONG  unix_name;       /* offset of the Unix name in the data buffer */
+    ULONG  name;            /* offset of the case-folded name in the data buffer */
+    USHORT len;             /* length of the case-folded name in chars */
+    USHORT short_len;       /* length of the case-folded short name, 0 if none */
+    WCHAR  short_name[12];  /* case-folded short name */
+    int    next;            /* next name in the same hash bucket */
+    int    short_next;      /* next short name in the same hash bucket */
+};
+
+struct dir_cache
+{
+    struct list            entry;          /* entry in cache list, most recently used first */
+    dev_t                  dev;            /* device of the directory */
+    ino_t                  ino;            /* inode of the directory */
+    time_t                 mtime;          /* modification time when the directory was read */
+    unsigned long          mtime_nsec;
+    int                    wd;             /* inotify watch descriptor, -1 if none */
+    BOOL                   short_names;    /* short names have been filled */
+    unsigned int           count;          /* number of names */
+    unsigned int           hash_size;      /* number of hash buckets, a power of 2 */
+    int                   *buckets;        /* first name of each bucket */
+    int                   *short_buckets;  /* first short name of each bucket */
+    struct dir_cache_name *names;
+    char                  *data;           /* storage for the names */
+    ULONG                  data_size;
+};
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_count;
+#ifdef HAVE_SYS_INOTIFY_H
+static int dir_cache_inotify = -1;  /* -2 if inotify is not available */
+#endif
+
+static inline unsigned long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static inline unsigned int hash_dir_name( const WCHAR *name, int len )
+{
+    unsigned int hash = 0;
+    while (len--) hash = hash * 31 + *name++;
+    return hash ^ (hash >> 15);
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (cache->wd != -1) inotify_rm_watch( dir_cache_inotify, cache->wd );
+#endif
+    list_remove( &cache->entry );
+    dir_cache_count--;
+    RtlFreeHeap( GetProcessHeap(), 0, cache->buckets );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->data );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/***********************************************************************
+ *           process_dir_cache_events
+ *
+ * Drop the cached directories that have been modified according to inotify.
+ * dir_section must be held by caller.
+ */
+static void process_dir_cache_events(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    union
+    {
+        struct inotify_event event;
+        char data[4096];
+    } buffer;
+    struct inotify_event *event;
+    struct dir_cache *cache;
+    int len, offset;
+
+    if (dir_cache_inotify < 0) return;
+
+    while ((len = read( dir_cache_inotify, &buffer, sizeof(buffer) )) > 0)
+    {
+        for (offset = 0; offset < len; offset += sizeof(*event) + event->len)
+        {
+            event = (struct inotify_event *)(buffer.data + offset);
+            LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+            {
+                if (cache->wd != event->wd) continue;
+                if (event->mask & IN_IGNORED) cache->wd = -1;  /* watch is already gone */
+                free_dir_cache( cache );
+                break;
+            }
+        }
+    }
+#endif
+}
+
+/***********************************************************************
+ *           watch_dir_cache
+ *
+ * Add an inotify watch for a cached directory.
+ */
+static void watch_dir_cache( struct dir_cache *cache, const char *unix_name )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (dir_cache_inotify == -1)
+    {
+        if ((dir_cache_inotify = inotify_init()) != -1)
+        {
+            fcntl( dir_cache_inotify, F_SETFD, FD_CLOEXEC );
+            fcntl( dir_cache_inotify, F_SETFL, O_NONBLOCK );
+        }
+        else dir_cache_inotify = -2;
+    }
+    if (dir_cache_inotify < 0) return;
+    cache->wd = inotify_add_watch( dir_cache_inotify, unix_name,
+                                   IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR );
+#endif
+}
+
+/***********************************************************************
+ *           add_dir_cache_name
+ *
+ * Add a file name, and optionally its short name, to a directory cache being built.
+ */
+static BOOL add_dir_cache_name( struct dir_cache *cache, unsigned int *names_size,
+                                ULONG *data_pos, const char *name, const char *short_name )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache_name *entry;
+    int i, len, unix_len = strlen( name ) + 1;
+    ULONG needed;
+
+    len = ntdll_umbstowcs( 0, name, unix_len - 1, buffer, MAX_DIR_ENTRY_LEN );
+    if (len < 0) return TRUE;  /* ignore names that can't be converted */
+
+    if (cache->count == *names_size)
+    {
+        unsigned int size = max( 64, *names_size * 2 );
+        struct dir_cache_name *new_names;
+
+        if (cache->names)
+            new_names = RtlReAllocateHeap( GetProcessHeap(), 0, cache->names, size * sizeof(*new_names) );
+        else
+            new_names = RtlAllocateHeap( GetProcessHeap(), 0, size * sizeof(*new_names) );
+        if (!new_names) return FALSE;
+        cache->names = new_names;
+        *names_size = size;
+    }
+
+    needed = *data_pos + ((unix_len + 1) & ~1) + len * sizeof(WCHAR);
+    if (needed > cache->data_size)
+    {
+        ULONG size = max( needed, max( 4096, cache->data_size * 2 ));
+        char *new_data;
+
+        if (cache->data)
+            new_data = RtlReAllocateHeap( GetProcessHeap(), 0, cache->data, size );
+        else
+            new_data = RtlAllocateHeap( GetProcessHeap(), 0, size );
+        if (!new_data) return FALSE;
+        cache->data = new_data;
+        cache->data_size = size;
+    }
+
+    entry = &cache->names[cache->count++];
+    entry->unix_name = *data_pos;
+    memcpy( cache->data + *data_pos, name, unix_len );
+    *data_pos += (unix_len + 1) & ~1;
+    entry->name = *data_pos;
+    entry->len = len;
+    for (i = 0; i < len; i++) ((WCHAR *)(cache->data + *data_pos))[i] = tolowerW( buffer[i] );
+    *data_pos += len * sizeof(WCHAR);
+
+    entry->short_len = 0;
+    if (short_name)
+    {
+        len = ntdll_umbstowcs( 0, short_name, strlen(short_name), buffer,
+                               sizeof(entry->short_name) / sizeof(WCHAR) );
+        if (len > 0)
+        {
+            for (i = 0; i < len; i++) entry->short_name[i] = tolowerW( buffer[i] );
+            entry->short_len = len;
+        }
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *           hash_dir_cache_short_names
+ *
+ * Fill the short names of the cached names that aren't valid 8.3 names, and hash them.
+ */
+static void hash_dir_cache_short_names( struct dir_cache *cache )
+{
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    unsigned int i, j, bucket;
+
+    for (i = 0; i < cache->hash_size; i++) cache->short_buckets[i] = -1;
+    for (i = cache->count; i-- > 0; )
+    {
+        struct dir_cache_name *entry = &cache->names[i];
+
+        if (!cache->short_names)
+        {
+            str.Buffer = (WCHAR *)(cache->data + entry->name);
+            str.Length = str.MaximumLength = entry->len * sizeof(WCHAR);
+            if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+            {
+                entry->short_len = hash_short_file_name( &str, entry->short_name );
+                for (j = 0; j < entry->short_len; j++)
+                    entry->short_name[j] = tolowerW( entry->short_name[j] );
+            }
+        }
+        if (!entry->short_len) continue;
+        bucket = hash_dir_name( entry->short_name, entry->short_len ) & (cache->hash_size - 1);
+        entry->short_next = cache->short_buckets[bucket];
+        cache->short_buckets[bucket] = i;
+    }
+    cache->short_names = TRUE;
+}
+
+/***********************************************************************
+ *           read_dir_cache
+ *
+ * Read the contents of a directory into a new cache entry.
+ * dir_section must be held by caller.
+ */
+static struct dir_cache *read_dir_cache( const char *unix_name, const struct stat *st )
+{
+    /* without inotify, a directory modified in the last second may be modified
+     * again without its modification time changing */
+    BOOL recent = st->st_mtime >= time( NULL ) - 1;
+    struct dir_cache *cache;
+    unsigned int i, bucket, names_size = 0;
+    ULONG data_pos = 0;
+    BOOL ret = TRUE, done = FALSE;
+    struct dirent *de;
+    DIR *dir;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    cache->dev = st->st_dev;
+    cache->ino = st->st_ino;
+    cache->mtime = st->st_mtime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    cache->wd = -1;
+    list_add_head( &dir_cache_list, &cache->entry );
+    dir_cache_count++;
+
+    /* watch before reading so that we don't miss any change */
+    watch_dir_cache( cache, unix_name );
+    if (cache->wd == -1 && recent)
+    {
+        free_dir_cache( cache );
+        return NULL;
+    }
+
+#ifdef VFAT_IOCTL_READDIR_BOTH
+    {
+        int fd = open( unix_name, O_RDONLY | O_DIRECTORY );
+        if (fd != -1)
+        {
+            KERNEL_DIRENT *kde;
+
+            if ((kde = start_vfat_ioctl( fd )))
+            {
+                /* the file system provides the short names */
+                cache->short_names = TRUE;
+                while (ret && kde[0].d_reclen)
+                {
+                    /* make sure names are null-terminated to work around an x86-64 kernel bug */
+                    size_t len = min(kde[0].d_reclen, sizeof(kde[0].d_name) - 1 );
+                    kde[0].d_name[len] = 0;
+                    len = min(kde[1].d_reclen, sizeof(kde[1].d_name) - 1 );
+                    kde[1].d_name[len] = 0;
+
+                    if (kde[1].d_name[0])
+                        ret = add_dir_cache_name( cache, &names_size, &data_pos, kde[1].d_name, kde[0].d_name );
+                    else
+                        ret = add_dir_cache_name( cache, &names_size, &data_pos, kde[0].d_name, NULL );
+                    if (ioctl( fd, VFAT_IOCTL_READDIR_BOTH, (long)kde ) == -1) ret = FALSE;
+                }
+                done = TRUE;
+            }
+            close( fd );
+        }
+    }
+#endif /* VFAT_IOCTL_READDIR_BOTH */
+
+    if (!done)
+    {
+        if (!(dir = opendir( unix_name ))) ret = FALSE;
+        else
+        {
+            while (ret && (de = readdir( dir )))
+                ret = add_dir_cache_name( cache, &names_size, &data_pos, de->d_name, NULL );
+            closedir( dir );
+        }
+    }
+
+    if (ret)
+    {
+        cache->hash_size = 16;
+        while (cache->hash_size < cache->count) cache->hash_size *= 2;
+        if (!(cache->buckets = RtlAllocateHeap( GetProcessHeap(), 0,
+                                                2 * cache->hash_size * sizeof(*cache->buckets) )))
+            ret = FALSE;
+    }
+    if (!ret)
+    {
+        free_dir_cache( cache );
+        return NULL;
+    }
+
+    /* walk the names backwards so that the first one in directory order is found first */
+    for (i = 0; i < cache->hash_size; i++) cache->buckets[i] = -1;
+    for (i = cache->count; i-- > 0; )
+    {
+        struct dir_cache_name *entry = &cache->names[i];
+        bucket = hash_dir_name( (WCHAR *)(cache->data + entry->name), entry->len ) & (cache->hash_size - 1);
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = i;
+    }
+    cache->short_buckets = cache->buckets + cache->hash_size;
+    if (cache->short_names) hash_dir_cache_short_names( cache );
+
+    TRACE( "cached %u names for %s\n", cache->count, debugstr_a(unix_name) );
+    return cache;
+}
+
+/***********************************************************************
+ *           get_dir_cache
+ *
+ * Get the up to date cache of a directory, or NULL if it shouldn't be cached.
+ * dir_section must be held by caller.
+ */
+static struct dir_cache *get_dir_cache( const char *unix_name )
+{
+    struct dir_cache *cache;
+    struct stat st;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return NULL;
+
+    process_dir_cache_events();
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->dev != st.st_dev || cache->ino != st.st_ino) continue;
+        if (cache->mtime == st.st_mtime && cache->mtime_nsec == get_mtime_nsec( &st ))
+        {
+            list_remove( &cache->entry );
+            list_add_head( &dir_cache_list, &cache->entry );
+            return cache;
+        }
+        free_dir_cache( cache );
+        break;
+    }
+
+    if (dir_cache_count >= MAX_DIR_CACHE)
+        free_dir_cache( LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry ));
+
+    return read_dir_cache( unix_name, &st );
+}
+
+/***********************************************************************
+ *           find_file_in_dir_cache
+ *
+ * Find a file in the cached contents of a directory. unix_name contains the
+ * directory name, the file found is appended to it at pos.
+ * Returns 1 if found, 0 if not found, -1 if the cache can't tell.
+ * dir_section must be held by caller.
+ */
+static int find_file_in_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                                   BOOLEAN is_name_8_dot_3 )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache *cache;
+    struct dir_cache_name *entry;
+    unsigned int hash;
+    int i;
+
+    if (length > MAX_DIR_ENTRY_LEN) return -1;  /* not in the cache, let the scan decide */
+    if (!(cache = get_dir_cache( unix_name ))) return -1;
+
+    for (i = 0; i < length; i++) buffer[i] = tolowerW( name[i] );
+    hash = hash_dir_name( buffer, length ) & (cache->hash_size - 1);
+
+    for (i = cache->buckets[hash]; i != -1; i = entry->next)
+    {
+        entry = &cache->names[i];
+        if (entry->len == length && !memcmp( cache->data + entry->name, buffer, length * sizeof(WCHAR) ))
+            goto found;
+    }
+
+    if (!is_name_8_dot_3) return 0;
+
+    if (!cache->short_names) hash_dir_cache_short_names( cache );
+    for (i = cache->short_buckets[hash]; i != -1; i = entry->short_next)
+    {
+        entry = &cache->names[i];
+        if (entry->short_len == length && !memcmp( entry->short_name, buffer, length * sizeof(WCHAR) ))
+            goto found;
+    }
+    return 0;
+
+found:
+    unix_name[pos - 1] = '/';
+    strcpy( unix_name + pos, cache->data + entry->unix_name );
+    return 1;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2140,6 +2567,12 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    RtlEnterCriticalSection( &dir_section );
+    ret = find_file_in_dir_cache( unix_name, pos, name, length, is_name_8_dot_3 );
+    RtlLeaveCriticalSection( &dir_section );
+    if (ret > 0) goto success;
+    if (!ret) goto not_found;
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
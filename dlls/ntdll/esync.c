@@ -0,0 +1,240 @@
+/*
+ * eventfd-based synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* When WINEESYNC is set in the environment, the server keeps the state of
+ * events and semaphores in an eventfd (see server/esync.c). Once we have
+ * fetched the eventfd of a handle we can set, reset and wait on the object
+ * without any server round-trip. Waits that need the server (alertable
+ * waits, waiting for all of several objects, or objects without an
+ * eventfd) still go through server_select. Releasing a semaphore and
+ * pulsing an event go to the server too: the limit check needs a count
+ * that can't change under us, and a pulse can't be expressed as an
+ * eventfd counter. */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+# include <sys/poll.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(esync);
+
+/* check whether eventfd-based synchronization objects are enabled */
+int do_esync(void)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEESYNC" );
+        enabled = env && atoi( env );
+        if (enabled) TRACE( "using eventfd-based synchronization\n" );
+    }
+    return enabled;
+#else
+    return 0;
+#endif
+}
+
+/* retrieve and reset the eventfd counter, returns 0 if it wasn't signaled;
+ * semaphore eventfds only hand out a single unit per read */
+static ULONGLONG esync_read( int fd )
+{
+    ULONGLONG value;
+
+    if (read( fd, &value, sizeof(value) ) != sizeof(value)) return 0;
+    return value;
+}
+
+static void esync_write( int fd, ULONGLONG value )
+{
+    if (value && write( fd, &value, sizeof(value) ) != sizeof(value))
+        ERR( "failed to signal eventfd %d: %s\n", fd, strerror( errno ));
+}
+
+static NTSTATUS get_event_fd( HANDLE handle, int *fd )
+{
+    enum esync_type type;
+    unsigned int access, max;
+    NTSTATUS ret;
+
+    if ((ret = server_get_esync_fd( handle, fd, &type, &access, &max ))) return ret;
+    if (type != ESYNC_MANUAL_EVENT && type != ESYNC_AUTO_EVENT) ret = STATUS_OBJECT_TYPE_MISMATCH;
+    else if (!(access & EVENT_MODIFY_STATE)) ret = STATUS_ACCESS_DENIED;
+    if (ret) server_release_esync_fd( handle );
+    return ret;
+}
+
+/***********************************************************************
+ *           esync_set_event
+ *
+ * Returns STATUS_NOT_IMPLEMENTED if the server has to handle it.
+ */
+NTSTATUS esync_set_event( HANDLE handle )
+{
+    NTSTATUS ret;
+    int fd;
+
+    if ((ret = get_event_fd( handle, &fd ))) return ret;
+    /* any non-zero count means signaled, for both kinds of events */
+    esync_write( fd, 1 );
+    server_release_esync_fd( handle );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           esync_reset_event
+ */
+NTSTATUS esync_reset_event( HANDLE handle )
+{
+    NTSTATUS ret;
+    int fd;
+
+    if ((ret = get_event_fd( handle, &fd ))) return ret;
+    esync_read( fd );
+    server_release_esync_fd( handle );
+    return STATUS_SUCCESS;
+}
+
+/* try to acquire an object that poll reported as signaled */
+static BOOL esync_grab( int fd, enum esync_type type )
+{
+    switch (type)
+    {
+    case ESYNC_MANUAL_EVENT:
+        return TRUE;
+    case ESYNC_AUTO_EVENT:
+    case ESYNC_SEMAPHORE:
+        return esync_read( fd ) != 0;
+    default:
+        return FALSE;
+    }
+}
+
+/***********************************************************************
+ *           esync_wait_objects
+ *
+ * Returns STATUS_NOT_IMPLEMENTED if the server has to handle the wait.
+ */
+NTSTATUS esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_all,
+                             const LARGE_INTEGER *timeout )
+{
+    struct pollfd fds[MAXIMUM_WAIT_OBJECTS];
+    enum esync_type types[MAXIMUM_WAIT_OBJECTS];
+    unsigned int access, max;
+    LARGE_INTEGER now, zero;
+    LONGLONG end = 0;
+    NTSTATUS status;
+    DWORD i;
+    int ret;
+
+    /* waiting for all of several objects requires acquiring them atomically */
+    if (wait_all && count > 1) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        if (server_get_esync_fd( handles[i], &fds[i].fd, &types[i], &access, &max ))
+        {
+            while (i--) server_release_esync_fd( handles[i] );
+            return STATUS_NOT_IMPLEMENTED;
+        }
+        fds[i].events = POLLIN;
+    }
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        end = timeout->QuadPart;
+        if (end < 0)
+        {
+            NtQuerySystemTime( &now );
+            end = now.QuadPart - end;
+        }
+    }
+
+    for (;;)
+    {
+        int poll_timeout = -1;
+
+        if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+        {
+            NtQuerySystemTime( &now );
+            if (now.QuadPart >= end) poll_timeout = 0;
+            else poll_timeout = min( (end - now.QuadPart + 9999) / 10000, INT_MAX );
+        }
+
+        if ((ret = poll( fds, count, poll_timeout )) == -1)
+        {
+            if (errno != EINTR)
+            {
+                status = FILE_GetNtStatus();
+                break;
+            }
+            /* the server interrupts us with SIGUSR1 when it queues a system APC, since it
+             * doesn't know that we are waiting; run anything still queued before polling again */
+            zero.QuadPart = 0;
+            server_select( NULL, 0, SELECT_INTERRUPTIBLE, &zero );
+            continue;
+        }
+        if (!ret)
+        {
+            status = STATUS_TIMEOUT;
+            break;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i].revents & (POLLERR | POLLNVAL))
+            {
+                status = STATUS_INVALID_HANDLE;
+                goto done;
+            }
+            if ((fds[i].revents & POLLIN) && esync_grab( fds[i].fd, types[i] ))
+            {
+                TRACE( "acquired %p\n", handles[i] );
+                status = STATUS_WAIT_0 + i;
+                goto done;
+            }
+        }
+        /* somebody else got there first, wait again */
+    }
+
+done:
+    for (i = 0; i < count; i++) server_release_esync_fd( handles[i] );
+    return status;
+}
@@ -84,6 +84,7 @@ typedef struct
 /* Value for arena 'magic' field */
 #define ARENA_INUSE_MAGIC      0x455355
 #define ARENA_PENDING_MAGIC    0xbedead
+#define ARENA_LFH_MAGIC        0x48464c
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
 
@@ -159,6 +160,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct tagHEAP_LFH *lfh;        /* Low-fragmentation front-end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -290,7 +292,8 @@ static void subheap_notify_free_all(SUBHEAP const *subheap)
         {
             ARENA_INUSE const *pArena = (ARENA_INUSE const *)ptr;
             if (pArena->magic == ARENA_INUSE_MAGIC) notify_free(pArena + 1);
-            else if (pArena->magic != ARENA_PENDING_MAGIC) ERR("bad inuse_magic @%p\n", pArena);
+            else if (pArena->magic != ARENA_PENDING_MAGIC && pArena->magic != ARENA_LFH_MAGIC)
+                ERR("bad inuse_magic @%p\n", pArena);
             ptr += sizeof(*pArena) + (pArena->size & ARENA_SIZE_MASK);
         }
     }
@@ -377,7 +380,8 @@ static void HEAP_Dump( HEAP *heap )
             {
                 ARENA_INUSE *pArena = (ARENA_INUSE *)ptr;
                 DPRINTF( "%p %08x %s %08x\n",
-                         pArena, pArena->magic, pArena->magic == ARENA_INUSE_MAGIC ? "used" : "pend",
+                         pArena, pArena->magic, pArena->magic == ARENA_INUSE_MAGIC ? "used" :
+                         pArena->magic == ARENA_LFH_MAGIC ? "lfh " : "pend",
                          pArena->size & ARENA_SIZE_MASK );
                 ptr += sizeof(*pArena) + (pArena->size & ARENA_SIZE_MASK);
                 arenaSize += sizeof(ARENA_INUSE);
@@ -658,10 +662,11 @@ static void HEAP_MakeInUseBlockFree( SUBHEAP *subheap, ARENA_INUSE *pArena )
     if ((char *)pFree + size < (char *)subheap->base + subheap->size)
         return;  /* Not the last block, so nothing more to do */
 
-    /* Free the whole sub-heap if it's empty and not the original one */
+    /* Free the whole sub-heap if it's empty and not the original one; the low-fragmentation
+     * front-end looks up sub-heaps without the heap lock, so they are kept while it's enabled */
 
     if (((char *)pFree == (char *)subheap->base + subheap->headerSize) &&
-        (subheap != &subheap->heap->subheap))
+        (subheap != &subheap->heap->subheap) && !heap->lfh)
     {
         void *addr = subheap->base;
 
@@ -1204,7 +1209,8 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
     }
 
     /* Check magic number */
-    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC)
+    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC &&
+        pArena->magic != ARENA_LFH_MAGIC)
     {
         if (quiet == NOISY) {
             ERR("Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, pArena->magic, pArena );
@@ -1419,7 +1425,7 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
         ret = HEAP_ValidateInUseArena( subheap, arena, QUIET );
     else if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET)
         WARN( "Heap %p: unaligned arena pointer %p\n", subheap->heap, arena );
-    else if (arena->magic == ARENA_PENDING_MAGIC)
+    else if (arena->magic == ARENA_PENDING_MAGIC || arena->magic == ARENA_LFH_MAGIC)
         WARN( "Heap %p: block %p used after free\n", subheap->heap, arena + 1 );
     else if (arena->magic != ARENA_INUSE_MAGIC)
         WARN( "Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, arena->magic, arena );
@@ -1520,6 +1526,377 @@ void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/* Low-fragmentation heap front-end
+ *
+ * Small blocks are served from per-thread magazines of free blocks, one for
+ * each size class, without taking the heap lock. The blocks remain normal
+ * in-use arenas of the heap (marked with ARENA_LFH_MAGIC while cached), so
+ * HeapSize, HeapWalk and the validation code keep working on them. A thread
+ * freeing a block simply caches it, whichever thread allocated it; full
+ * magazines are emptied into a lock-free per-class depot shared by all
+ * threads, and new blocks are carved in batches from a single free block
+ * of the heap so that blocks of the same size end up next to each other.
+ */
+
+#define LFH_MAX_SIZE       ROUND_SIZE(512)  /* larger blocks go to the heap directly */
+#define LFH_NB_CLASSES     ((LFH_MAX_SIZE - HEAP_MIN_DATA_SIZE) / ALIGNMENT + 1)
+#define LFH_CLASS(size)    (((size) - HEAP_MIN_DATA_SIZE) / ALIGNMENT)
+#define LFH_MAGAZINE_SIZE  16    /* max blocks cached per thread and size class */
+#define LFH_BATCH_SIZE     8     /* number of blocks moved at once between a magazine and the heap */
+#define LFH_DEPOT_MAX      1024  /* max blocks kept per size class in the depot */
+
+struct lfh_magazine
+{
+    DWORD                    count;                       /* number of cached blocks */
+    ARENA_INUSE             *blocks[LFH_MAGAZINE_SIZE];   /* cached blocks, used in LIFO order */
+};
+
+struct lfh_thread_cache
+{
+    struct lfh_thread_cache *next;                        /* next cache of the same thread */
+    struct list              entry;                       /* entry in the heap list of caches */
+    HEAP                    *heap;                        /* heap the cache belongs to, NULL if unused */
+    LONG                     dead;                        /* the thread was killed without giving back the blocks */
+    struct lfh_magazine      magazines[LFH_NB_CLASSES];
+};
+
+/* thread_data->heap_cache value once the thread has given back its caches */
+#define LFH_DETACHED  ((struct lfh_thread_cache *)~(ULONG_PTR)0)
+
+typedef struct tagHEAP_LFH
+{
+    SLIST_HEADER             depot[LFH_NB_CLASSES];       /* free blocks shared between threads */
+    struct list              caches;                      /* thread caches holding blocks of the heap */
+} HEAP_LFH;
+
+/* protects the heap lists of caches and the heap field of the caches */
+static RTL_CRITICAL_SECTION lfh_section;
+static RTL_CRITICAL_SECTION_DEBUG lfh_section_debug =
+{
+    0, 0, &lfh_section,
+    { &lfh_section_debug.ProcessLocksList, &lfh_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": lfh_section") }
+};
+static RTL_CRITICAL_SECTION lfh_section = { &lfh_section_debug, -1, 0, 0, 0, 0 };
+
+static void lfh_flush_magazine( HEAP *heap, struct lfh_magazine *mag, unsigned int class, DWORD count );
+
+/* give back the blocks cached by threads that were killed, the caller has to free the returned
+ * caches once it no longer holds lfh_section; a thread killed in the middle of a heap call can
+ * leave its cache inconsistent, the same way it can leave the heap itself */
+static struct lfh_thread_cache *lfh_reclaim_dead_caches( HEAP *heap )
+{
+    struct lfh_thread_cache *cache, *next, *dead = NULL;
+    unsigned int i;
+
+    LIST_FOR_EACH_ENTRY_SAFE( cache, next, &heap->lfh->caches, struct lfh_thread_cache, entry )
+    {
+        if (!cache->dead) continue;
+        for (i = 0; i < LFH_NB_CLASSES; i++)
+            if (cache->magazines[i].count)
+                lfh_flush_magazine( heap, &cache->magazines[i], i, cache->magazines[i].count );
+        list_remove( &cache->entry );
+        /* nobody walks the list of caches of a dead thread anymore */
+        cache->next = dead;
+        dead = cache;
+    }
+    return dead;
+}
+
+/* get the cache of the current thread for a given heap, creating it if needed */
+static struct lfh_thread_cache *lfh_get_thread_cache( HEAP *heap )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_thread_cache *cache, **prev, *unused = NULL, *dead = NULL, *next;
+
+    if (thread_data->heap_cache == LFH_DETACHED) return NULL;  /* exiting, use the heap directly */
+
+    for (prev = &thread_data->heap_cache; (cache = *prev); prev = &cache->next)
+    {
+        if (cache->heap == heap)
+        {
+            if (prev != &thread_data->heap_cache)  /* move it to the front of the list */
+            {
+                *prev = cache->next;
+                cache->next = thread_data->heap_cache;
+                thread_data->heap_cache = cache;
+            }
+            return cache;
+        }
+        if (!cache->heap) unused = cache;
+    }
+
+    if (!(cache = unused))
+    {
+        if (!(cache = RtlAllocateHeap( processHeap, HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+        cache->next = thread_data->heap_cache;
+        thread_data->heap_cache = cache;
+    }
+
+    RtlEnterCriticalSection( &lfh_section );
+    cache->heap = heap;
+    list_add_head( &heap->lfh->caches, &cache->entry );
+    dead = lfh_reclaim_dead_caches( heap );
+    RtlLeaveCriticalSection( &lfh_section );
+
+    for ( ; dead; dead = next)
+    {
+        next = dead->next;
+        RtlFreeHeap( processHeap, 0, dead );
+    }
+    return cache;
+}
+
+/* move blocks from a magazine to the depot, or back to the heap if the depot is full */
+static void lfh_flush_magazine( HEAP *heap, struct lfh_magazine *mag, unsigned int class, DWORD count )
+{
+    SLIST_ENTRY *first, *last;
+    ARENA_INUSE *arena;
+    DWORD i;
+
+    if (RtlQueryDepthSList( &heap->lfh->depot[class] ) < LFH_DEPOT_MAX)
+    {
+        first = last = (SLIST_ENTRY *)(mag->blocks[mag->count - 1] + 1);
+        for (i = 1; i < count; i++)
+        {
+            last->Next = (SLIST_ENTRY *)(mag->blocks[mag->count - 1 - i] + 1);
+            last = last->Next;
+        }
+        mag->count -= count;
+        RtlInterlockedPushListSList( &heap->lfh->depot[class], first, last, count );
+        return;
+    }
+
+    RtlEnterCriticalSection( &heap->critSection );
+    while (count--)
+    {
+        arena = mag->blocks[--mag->count];
+        arena->magic = ARENA_INUSE_MAGIC;
+        HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+/* carve a batch of new blocks of the given size out of a single free block of the heap */
+static void lfh_carve_blocks( HEAP *heap, struct lfh_magazine *mag, SIZE_T block_size )
+{
+    SIZE_T step = block_size + sizeof(ARENA_INUSE);
+    SIZE_T total;
+    SUBHEAP *subheap;
+    ARENA_FREE *pFree;
+    ARENA_INUSE *pInUse;
+    DWORD i, count = LFH_BATCH_SIZE;
+
+    RtlEnterCriticalSection( &heap->critSection );
+
+    while (!(pFree = HEAP_FindFreeBlock( heap, count * step - sizeof(ARENA_INUSE), &subheap )))
+        if (!(count /= 2)) goto done;
+
+    list_remove( &pFree->entry );
+    pInUse = (ARENA_INUSE *)pFree;
+    pInUse->size = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
+    HEAP_ShrinkBlock( subheap, pInUse, count * step - sizeof(ARENA_INUSE) );
+    total = (pInUse->size & ARENA_SIZE_MASK) + sizeof(ARENA_INUSE);
+
+    /* split it; the first block keeps the flags and the last one gets what can't be shrunk */
+    for (i = 0; i < count; i++)
+    {
+        pInUse->size = block_size | (i ? 0 : pInUse->size & ARENA_FLAG_PREV_FREE);
+        if (i == count - 1) pInUse->size += total - count * step;
+        pInUse->magic = ARENA_LFH_MAGIC;
+        pInUse->unused_bytes = 0;
+        mag->blocks[mag->count + count - 1 - i] = pInUse;  /* hand out the lowest address first */
+        pInUse = (ARENA_INUSE *)((char *)pInUse + step);
+    }
+    mag->count += count;
+
+done:
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Allocate a small block from the current thread cache, refilling it if needed.
+ */
+static void *lfh_allocate( HEAP *heap, ULONG flags, SIZE_T size, SIZE_T rounded_size )
+{
+    unsigned int class = LFH_CLASS( rounded_size );
+    struct lfh_thread_cache *cache;
+    struct lfh_magazine *mag;
+    ARENA_INUSE *pInUse;
+    SLIST_ENTRY *entry;
+
+    if (!(cache = lfh_get_thread_cache( heap ))) return NULL;
+    mag = &cache->magazines[class];
+
+    if (!mag->count)
+    {
+        while (mag->count < LFH_BATCH_SIZE && (entry = RtlInterlockedPopEntrySList( &heap->lfh->depot[class] )))
+            mag->blocks[mag->count++] = (ARENA_INUSE *)entry - 1;
+        if (!mag->count) lfh_carve_blocks( heap, mag, rounded_size );
+        if (!mag->count) return NULL;
+    }
+
+    pInUse = mag->blocks[--mag->count];
+    pInUse->magic = ARENA_INUSE_MAGIC;
+    pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
+
+    notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
+    return pInUse + 1;
+}
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Put a small block into the current thread cache. Returns FALSE if the
+ * block has to be freed by the heap itself.
+ */
+static BOOL lfh_free( HEAP *heap, void *ptr )
+{
+    ARENA_INUSE *pInUse = (ARENA_INUSE *)ptr - 1;
+    struct lfh_thread_cache *cache;
+    struct lfh_magazine *mag;
+    SUBHEAP *subheap;
+    unsigned int class;
+    DWORD size;
+
+    if ((ULONG_PTR)pInUse % ALIGNMENT != ARENA_OFFSET) return FALSE;
+    /* make sure the block belongs to the heap before looking at it, anything else is
+     * left to the checks of the heap; sub-heaps are never freed while the front-end is enabled */
+    if (!(subheap = HEAP_FindSubHeap( heap, pInUse ))) return FALSE;
+    if ((char *)pInUse < (char *)subheap->base + subheap->headerSize) return FALSE;
+    if (pInUse->magic != ARENA_INUSE_MAGIC) return FALSE;
+    if (pInUse->size & ARENA_FLAG_FREE) return FALSE;
+    size = pInUse->size & ARENA_SIZE_MASK;
+    if (size < HEAP_MIN_DATA_SIZE || size > LFH_MAX_SIZE) return FALSE;
+    if ((char *)(pInUse + 1) + size > (char *)subheap->base + subheap->size) return FALSE;
+
+    if (!(cache = lfh_get_thread_cache( heap ))) return FALSE;
+    class = LFH_CLASS( size );
+    mag = &cache->magazines[class];
+    if (mag->count == LFH_MAGAZINE_SIZE) lfh_flush_magazine( heap, mag, class, LFH_BATCH_SIZE );
+
+    notify_free( ptr );
+    pInUse->magic = ARENA_LFH_MAGIC;
+    mag->blocks[mag->count++] = pInUse;
+    return TRUE;
+}
+
+/* enable the low-fragmentation front-end for a heap */
+static NTSTATUS lfh_enable( HEAP *heap )
+{
+    HEAP_LFH *lfh;
+    unsigned int i;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (RUNNING_ON_VALGRIND) return STATUS_UNSUCCESSFUL;
+    /* the front-end skips the serialization and all the debugging checks */
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_VALIDATE | HEAP_TAIL_CHECKING_ENABLED |
+                       HEAP_FREE_CHECKING_ENABLED | HEAP_PAGE_ALLOCS))
+        return STATUS_UNSUCCESSFUL;
+
+    if (!(lfh = RtlAllocateHeap( heap, 0, sizeof(*lfh) ))) return STATUS_NO_MEMORY;
+    for (i = 0; i < LFH_NB_CLASSES; i++) RtlInitializeSListHead( &lfh->depot[i] );
+    list_init( &lfh->caches );
+    /* set under the heap lock, so that nobody is freeing a sub-heap once it is visible */
+    RtlEnterCriticalSection( &heap->critSection );
+    if (heap->lfh)
+    {
+        RtlLeaveCriticalSection( &heap->critSection );
+        RtlFreeHeap( heap, 0, lfh );
+        return STATUS_SUCCESS;
+    }
+    heap->lfh = lfh;
+    RtlLeaveCriticalSection( &heap->critSection );
+    TRACE( "enabled for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+/* detach the thread caches from a heap that is being destroyed */
+static void lfh_destroy( HEAP *heap )
+{
+    struct lfh_thread_cache *cache, *next, *dead = NULL;
+    unsigned int i;
+
+    RtlEnterCriticalSection( &lfh_section );
+    LIST_FOR_EACH_ENTRY_SAFE( cache, next, &heap->lfh->caches, struct lfh_thread_cache, entry )
+    {
+        list_remove( &cache->entry );
+        for (i = 0; i < LFH_NB_CLASSES; i++) cache->magazines[i].count = 0;
+        cache->heap = NULL;
+        if (cache->dead)
+        {
+            cache->next = dead;
+            dead = cache;
+        }
+    }
+    RtlLeaveCriticalSection( &lfh_section );
+
+    for ( ; dead; dead = next)
+    {
+        next = dead->next;
+        RtlFreeHeap( processHeap, 0, dead );
+    }
+}
+
+/***********************************************************************
+ *           heap_thread_detach
+ *
+ * Give back the blocks cached by the current thread when it exits. Heap
+ * calls made after this go to the heap directly.
+ */
+void heap_thread_detach(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_thread_cache *cache, *next, *list = thread_data->heap_cache;
+    unsigned int i;
+
+    thread_data->heap_cache = LFH_DETACHED;
+    if (!list || list == LFH_DETACHED) return;
+
+    RtlEnterCriticalSection( &lfh_section );
+    for (cache = list; cache; cache = cache->next)
+    {
+        if (!cache->heap) continue;
+        for (i = 0; i < LFH_NB_CLASSES; i++)
+            if (cache->magazines[i].count)
+                lfh_flush_magazine( cache->heap, &cache->magazines[i], i, cache->magazines[i].count );
+        list_remove( &cache->entry );
+        cache->heap = NULL;
+    }
+    RtlLeaveCriticalSection( &lfh_section );
+
+    for (cache = list; cache; cache = next)
+    {
+        next = cache->next;
+        RtlFreeHeap( processHeap, 0, cache );
+    }
+}
+
+/***********************************************************************
+ *           heap_thread_abandon
+ *
+ * Called when the current thread is killed and can't take any lock anymore;
+ * the cached blocks are given back by the next thread that needs a cache
+ * for the same heap.
+ */
+void heap_thread_abandon(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct lfh_thread_cache *cache, *next, *list = interlocked_xchg_ptr( (void **)&thread_data->heap_cache, LFH_DETACHED );
+
+    if (list == LFH_DETACHED) return;
+    /* the next pointer belongs to the reclaiming thread once the cache is marked */
+    for (cache = list; cache; cache = next)
+    {
+        next = cache->next;
+        interlocked_xchg( &cache->dead, 1 );
+    }
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1564,8 +1941,11 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
     }
     else if (!addr)
     {
+        const char *env = getenv( "WINEHEAPLFH" );
+
         processHeap = subheap->heap;  /* assume the first heap we create is the process main heap */
         list_init( &processHeap->entry );
+        if (env && atoi( env )) lfh_enable( processHeap );
     }
 
     return subheap->heap;
@@ -1597,6 +1977,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
 
     if (heap == processHeap) return heap; /* cannot delete the main process heap */
 
+    if (heapPtr->lfh) lfh_destroy( heapPtr );
+
     /* remove it from the per-process list */
     RtlEnterCriticalSection( &processHeap->critSection );
     list_remove( &heapPtr->entry );
@@ -1673,6 +2055,16 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && rounded_size <= LFH_MAX_SIZE)
+    {
+        void *ret = lfh_allocate( heapPtr, flags, size, rounded_size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1754,6 +2146,12 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
         return FALSE;
     }
 
+    if (heapPtr->lfh && lfh_free( heapPtr, ptr ))
+    {
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
@@ -2123,7 +2521,8 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         }
 
         if (((ARENA_INUSE *)ptr - 1)->magic == ARENA_INUSE_MAGIC ||
-            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC)
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC ||
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_LFH_MAGIC)
         {
             ARENA_INUSE *pArena = (ARENA_INUSE *)ptr - 1;
             ptr += pArena->size & ARENA_SIZE_MASK;
@@ -2236,6 +2635,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2244,7 +2645,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0; /* low-fragmentation or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2252,3 +2654,36 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         return STATUS_INVALID_INFO_CLASS;
     }
 }
+
+
+/***********************************************************************
+ *           RtlSetHeapInformation    (NTDLL.@)
+ */
+NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
+                                       PVOID info, SIZE_T size )
+{
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG))
+            return STATUS_BUFFER_TOO_SMALL;
+
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* the front-end can't be disabled once enabled */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:
+            return lfh_enable( heapPtr );
+        default:
+            FIXME("unsupported heap compatibility mode %u\n", *(ULONG *)info);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld\n", heap, info_class, info, size );
+        return STATUS_SUCCESS;
+    }
+}
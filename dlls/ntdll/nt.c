@@ -1173,6 +1173,9 @@ static inline BOOL logical_proc_info_add_by_id(SYSTEM_LOGICAL_PROCESSOR_INFORMAT
             continue;
 
         data[i].ProcessorMask |= (ULONG_PTR)1<<proc;
+        /* several logical processors on the same core */
+        if(rel == RelationProcessorCore)
+            data[i].u.ProcessorCore.Flags = LTP_PC_SMT;
         return TRUE;
     }
 
@@ -1181,7 +1184,6 @@ static inline BOOL logical_proc_info_add_by_id(SYSTEM_LOGICAL_PROCESSOR_INFORMAT
 
     data[i].Relationship = rel;
     data[i].ProcessorMask = (ULONG_PTR)1<<proc;
-    /* TODO: set processor core flags */
     data[i].u.Reserved[0] = 0;
     data[i].u.Reserved[1] = id;
     *len = i+1;
@@ -1230,7 +1232,7 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
     static const char numa_info[] = "/sys/devices/system/node/node%d/cpumap";
 
     FILE *fcpu_list, *fnuma_list, *f;
-    DWORD len = 0, beg, end, i, j, r;
+    DWORD len = 0, beg, end, i, j, r, package;
     char op, name[MAX_PATH];
 
     fcpu_list = fopen("/sys/devices/system/cpu/online", "r");
@@ -1246,12 +1248,22 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
 
         for(i=beg; i<=end; i++)
         {
-            if(i > 8*sizeof(ULONG_PTR))
+            if(i >= 8*sizeof(ULONG_PTR))
             {
                 FIXME("skipping logical processor %d\n", i);
                 continue;
             }
 
+            sprintf(name, core_info, i, "physical_package_id");
+            f = fopen(name, "r");
+            if(f)
+            {
+                fscanf(f, "%u", &package);
+                fclose(f);
+            }
+            else package = 0;
+
+            /* core ids are only unique within a package */
             sprintf(name, core_info, i, "core_id");
             f = fopen(name, "r");
             if(f)
@@ -1260,6 +1272,7 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
                 fclose(f);
             }
             else r = i;
+            r |= package << 16;
             if(!logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorCore, r, i))
             {
                 SYSTEM_LOGICAL_PROCESSOR_INFORMATION *new_data;
@@ -1276,15 +1289,7 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
                 logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorCore, r, i);
             }
 
-            sprintf(name, core_info, i, "physical_package_id");
-            f = fopen(name, "r");
-            if(f)
-            {
-                fscanf(f, "%u", &r);
-                fclose(f);
-            }
-            else r = 0;
-            if(!logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorPackage, r, i))
+            if(!logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorPackage, package, i))
             {
                 SYSTEM_LOGICAL_PROCESSOR_INFORMATION *new_data;
 
@@ -1297,7 +1302,7 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
                 }
 
                 *data = new_data;
-                logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorPackage, r, i);
+                logical_proc_info_add_by_id(*data, &len, *max_len, RelationProcessorPackage, package, i);
             }
 
             for(j=0; j<4; j++)
@@ -1575,6 +1580,129 @@ static NTSTATUS create_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **
 }
 #endif
 
+/* retrieve the legacy processor information, the returned length is in bytes */
+static NTSTATUS get_logical_proc_info(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **data, DWORD *len)
+{
+    NTSTATUS ret;
+
+    /* Each logical processor may use up to 7 entries in returned table:
+     * core, numa node, package, L1i, L1d, L2, L3 */
+    *len = 7 * NtCurrentTeb()->Peb->NumberOfProcessors;
+    *data = RtlAllocateHeap(GetProcessHeap(), 0, *len * sizeof(**data));
+    if(!*data)
+        return STATUS_NO_MEMORY;
+
+    ret = create_logical_proc_info(data, len);
+    if(ret != STATUS_SUCCESS)
+        RtlFreeHeap(GetProcessHeap(), 0, *data);
+    return ret;
+}
+
+static DWORD count_bits(ULONG_PTR mask)
+{
+    DWORD count = 0;
+
+    for ( ; mask; mask &= mask - 1) count++;
+    return count;
+}
+
+/* size of an extended record, or 0 if it isn't returned for the given relationship */
+static DWORD logical_proc_info_ex_size(LOGICAL_PROCESSOR_RELATIONSHIP rel, LOGICAL_PROCESSOR_RELATIONSHIP filter)
+{
+    DWORD size = FIELD_OFFSET(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, u);
+
+    if(filter != RelationAll && filter != rel)
+        return 0;
+
+    switch(rel)
+    {
+    case RelationProcessorCore:
+    case RelationProcessorPackage:
+        return size + sizeof(PROCESSOR_RELATIONSHIP);
+    case RelationNumaNode:
+        return size + sizeof(NUMA_NODE_RELATIONSHIP);
+    case RelationCache:
+        return size + sizeof(CACHE_RELATIONSHIP);
+    case RelationGroup:
+        return size + sizeof(GROUP_RELATIONSHIP);
+    default:
+        return 0;
+    }
+}
+
+/***********************************************************************
+ *           create_logical_proc_info_ex
+ *
+ * Convert the legacy processor information to the extended records for the
+ * given relationship. All processors are in group 0, like the legacy masks.
+ * Returns the needed size; the records are only stored if they fit in max_len.
+ */
+static DWORD create_logical_proc_info_ex(const SYSTEM_LOGICAL_PROCESSOR_INFORMATION *data, DWORD count,
+        LOGICAL_PROCESSOR_RELATIONSHIP filter, SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *dataex, DWORD max_len)
+{
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *ex;
+    ULONG_PTR all_mask = 0;
+    DWORD i, size, len = 0;
+
+    for(i=0; i<count; i++)
+    {
+        if(data[i].Relationship == RelationProcessorCore)
+            all_mask |= data[i].ProcessorMask;
+        len += logical_proc_info_ex_size(data[i].Relationship, filter);
+    }
+    len += logical_proc_info_ex_size(RelationGroup, filter);
+    if(!dataex || len > max_len)
+        return len;
+
+    memset(dataex, 0, len);
+    ex = dataex;
+    for(i=0; i<count; i++)
+    {
+        if(!(size = logical_proc_info_ex_size(data[i].Relationship, filter)))
+            continue;
+
+        ex->Relationship = data[i].Relationship;
+        ex->Size = size;
+        switch(data[i].Relationship)
+        {
+        case RelationProcessorCore:
+        case RelationProcessorPackage:
+            if(data[i].Relationship == RelationProcessorCore)
+                ex->u.Processor.Flags = count_bits(data[i].ProcessorMask) > 1 ? LTP_PC_SMT : 0;
+            ex->u.Processor.GroupCount = 1;
+            ex->u.Processor.GroupMask[0].Mask = data[i].ProcessorMask;
+            break;
+        case RelationNumaNode:
+            ex->u.NumaNode.NodeNumber = data[i].u.NumaNode.NodeNumber;
+            ex->u.NumaNode.GroupMask.Mask = data[i].ProcessorMask;
+            break;
+        case RelationCache:
+            ex->u.Cache.Level = data[i].u.Cache.Level;
+            ex->u.Cache.Associativity = data[i].u.Cache.Associativity;
+            ex->u.Cache.LineSize = data[i].u.Cache.LineSize;
+            ex->u.Cache.CacheSize = data[i].u.Cache.Size;
+            ex->u.Cache.Type = data[i].u.Cache.Type;
+            ex->u.Cache.GroupMask.Mask = data[i].ProcessorMask;
+            break;
+        default:
+            break;
+        }
+        ex = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((char *)ex + size);
+    }
+
+    if((size = logical_proc_info_ex_size(RelationGroup, filter)))
+    {
+        ex->Relationship = RelationGroup;
+        ex->Size = size;
+        ex->u.Group.MaximumGroupCount = 1;
+        ex->u.Group.ActiveGroupCount = 1;
+        ex->u.Group.GroupInfo[0].MaximumProcessorCount = count_bits(all_mask);
+        ex->u.Group.GroupInfo[0].ActiveProcessorCount = count_bits(all_mask);
+        ex->u.Group.GroupInfo[0].ActiveProcessorMask = all_mask;
+    }
+    return len;
+}
+
 /******************************************************************************
  * NtQuerySystemInformation [NTDLL.@]
  * ZwQuerySystemInformation [NTDLL.@]
@@ -2014,22 +2142,8 @@ NTSTATUS WINAPI NtQuerySystemInformation(
         {
             SYSTEM_LOGICAL_PROCESSOR_INFORMATION *buf;
 
-            /* Each logical processor may use up to 7 entries in returned table:
-             * core, numa node, package, L1i, L1d, L2, L3 */
-            len = 7 * NtCurrentTeb()->Peb->NumberOfProcessors;
-            buf = RtlAllocateHeap(GetProcessHeap(), 0, len * sizeof(*buf));
-            if(!buf)
-            {
-                ret = STATUS_NO_MEMORY;
-                break;
-            }
-
-            ret = create_logical_proc_info(&buf, &len);
-            if( ret != STATUS_SUCCESS )
-            {
-                RtlFreeHeap(GetProcessHeap(), 0, buf);
-                break;
-            }
+            ret = get_logical_proc_info(&buf, &len);
+            if( ret != STATUS_SUCCESS ) break;
 
             if( Length >= len)
             {
@@ -2056,6 +2170,52 @@ NTSTATUS WINAPI NtQuerySystemInformation(
     return ret;
 }
 
+/******************************************************************************
+ * NtQuerySystemInformationEx [NTDLL.@]
+ * ZwQuerySystemInformationEx [NTDLL.@]
+ */
+NTSTATUS WINAPI NtQuerySystemInformationEx(SYSTEM_INFORMATION_CLASS SystemInformationClass,
+        PVOID Query, ULONG QueryLength, PVOID SystemInformation, ULONG Length, PULONG ResultLength)
+{
+    NTSTATUS ret = STATUS_SUCCESS;
+    ULONG len = 0;
+
+    TRACE("(0x%08x,%p,%u,%p,%u,%p)\n", SystemInformationClass, Query, QueryLength,
+          SystemInformation, Length, ResultLength);
+
+    switch (SystemInformationClass)
+    {
+    case SystemLogicalProcessorInformationEx:
+        {
+            SYSTEM_LOGICAL_PROCESSOR_INFORMATION *buf;
+            LOGICAL_PROCESSOR_RELATIONSHIP relation;
+
+            if (!Query || QueryLength < sizeof(DWORD))
+            {
+                ret = STATUS_INVALID_PARAMETER;
+                break;
+            }
+            relation = *(DWORD *)Query;
+
+            ret = get_logical_proc_info(&buf, &len);
+            if (ret != STATUS_SUCCESS) break;
+
+            len = create_logical_proc_info_ex(buf, len / sizeof(*buf), relation, SystemInformation, Length);
+            if (Length < len) ret = STATUS_INFO_LENGTH_MISMATCH;
+            else if (!SystemInformation) ret = STATUS_ACCESS_VIOLATION;
+            RtlFreeHeap(GetProcessHeap(), 0, buf);
+        }
+        break;
+    default:
+        FIXME("(0x%08x,%p,%u,%p,%u,%p) stub\n", SystemInformationClass, Query, QueryLength,
+              SystemInformation, Length, ResultLength);
+        ret = STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (ResultLength) *ResultLength = len;
+    return ret;
+}
+
 /******************************************************************************
  * NtSetSystemInformation [NTDLL.@]
  * ZwSetSystemInformation [NTDLL.@]
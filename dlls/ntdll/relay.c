@@ -23,9 +23,15 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -34,6 +40,7 @@
 #include "wine/exception.h"
 #include "ntdll_misc.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(relay);
@@ -297,6 +304,228 @@ static BOOL check_from_module( const WCHAR **includelist, const WCHAR **excludel
     return show;
 }
 
+/***********************************************************************
+ * Profiling
+ *
+ * When WINERELAYPROF is set to a file name, the relay thunks are set up
+ * without tracing and only count the calls and the time spent in every
+ * relayed function. The counters are kept per thread and per call path,
+ * and written to the file when the process exits, one line per path:
+ *
+ *   pid tid calls inclusive_time self_time dll.func;dll.func;...
+ *
+ * The time is in TSC cycles on x86 and in performance counter ticks
+ * elsewhere. Folding the self time by path gives flame graph input.
+ */
+
+#define PROFILE_HASH_SIZE 1024
+#define PROFILE_MAX_DEPTH 256
+
+struct relay_profile_node
+{
+    struct relay_profile_node *next;          /* next node in hash chain */
+    struct relay_profile_node *parent;        /* node of the caller, NULL for top-level calls */
+    struct relay_private_data *data;          /* dll of the called function */
+    unsigned int               ordinal;       /* ordinal of the function */
+    ULONGLONG                  calls;         /* number of calls */
+    ULONGLONG                  time;          /* inclusive time */
+    ULONGLONG                  child_time;    /* time spent in relayed callees */
+};
+
+struct relay_profile_frame
+{
+    struct relay_profile_node *node;          /* node of the call */
+    const INT_PTR             *stack;         /* stack pointer at the time of the call */
+    ULONGLONG                  start;         /* time of the call */
+};
+
+struct relay_profile
+{
+    struct list                entry;         /* entry in the list of thread profiles */
+    DWORD                      tid;           /* id of the thread */
+    unsigned int               depth;         /* current depth of the frame stack */
+    struct relay_profile_frame frames[PROFILE_MAX_DEPTH];
+    struct relay_profile_node *hash[PROFILE_HASH_SIZE];
+};
+
+static const char *profile_path;  /* file to write the profile to */
+static struct list profiles = LIST_INIT( profiles );
+
+static RTL_CRITICAL_SECTION profile_section;
+static RTL_CRITICAL_SECTION_DEBUG profile_section_debug =
+{
+    0, 0, &profile_section,
+    { &profile_section_debug.ProcessLocksList, &profile_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": profile_section") }
+};
+static RTL_CRITICAL_SECTION profile_section = { &profile_section_debug, -1, 0, 0, 0, 0 };
+
+/***********************************************************************
+ *           RELAY_ProfileEnabled
+ */
+BOOL RELAY_ProfileEnabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINERELAYPROF" );
+        if (env && *env) profile_path = env;
+        enabled = profile_path != NULL;
+    }
+    return enabled;
+}
+
+static inline ULONGLONG get_profile_time(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int low, high;
+
+    __asm__ __volatile__( "rdtsc" : "=a" (low), "=d" (high) );
+    return ((ULONGLONG)high << 32) | low;
+#else
+    LARGE_INTEGER counter;
+
+    NtQueryPerformanceCounter( &counter, NULL );
+    return counter.QuadPart;
+#endif
+}
+
+static struct relay_profile *get_thread_profile(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct relay_profile *profile = thread_data->relay_profile;
+
+    if (profile) return profile;
+    if (!(profile = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*profile) ))) return NULL;
+    profile->tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    RtlEnterCriticalSection( &profile_section );
+    list_add_tail( &profiles, &profile->entry );
+    RtlLeaveCriticalSection( &profile_section );
+    return thread_data->relay_profile = profile;
+}
+
+/* drop the frames of calls that have been unwound without returning */
+static inline void unwind_profile_frames( struct relay_profile *profile, const INT_PTR *stack )
+{
+    while (profile->depth && profile->frames[profile->depth - 1].stack < stack) profile->depth--;
+}
+
+static void profile_entry( struct relay_private_data *data, unsigned int ordinal, const INT_PTR *stack )
+{
+    struct relay_profile *profile;
+    struct relay_profile_node *node, *parent;
+    struct relay_profile_frame *frame;
+    unsigned int hash;
+
+    if (!(profile = get_thread_profile())) return;
+
+    /* a new call at the same stack address means the previous one is gone */
+    while (profile->depth && profile->frames[profile->depth - 1].stack <= stack) profile->depth--;
+    if (profile->depth == PROFILE_MAX_DEPTH) return;
+
+    parent = profile->depth ? profile->frames[profile->depth - 1].node : NULL;
+    hash = ((ULONG_PTR)parent / sizeof(*parent) + (ULONG_PTR)data / 64 + ordinal * 37) % PROFILE_HASH_SIZE;
+    for (node = profile->hash[hash]; node; node = node->next)
+        if (node->parent == parent && node->data == data && node->ordinal == ordinal) break;
+
+    if (!node)
+    {
+        if (!(node = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*node) ))) return;
+        node->parent  = parent;
+        node->data    = data;
+        node->ordinal = ordinal;
+        node->next    = profile->hash[hash];
+        profile->hash[hash] = node;
+    }
+
+    frame = &profile->frames[profile->depth++];
+    frame->node  = node;
+    frame->stack = stack;
+    frame->start = get_profile_time();
+}
+
+static void profile_exit( const INT_PTR *stack )
+{
+    ULONGLONG elapsed, now = get_profile_time();
+    struct relay_profile *profile = ntdll_get_thread_data()->relay_profile;
+    struct relay_profile_frame *frame;
+
+    if (!profile) return;
+    unwind_profile_frames( profile, stack );
+    if (!profile->depth || profile->frames[profile->depth - 1].stack != stack) return;
+
+    frame = &profile->frames[--profile->depth];
+    elapsed = now - frame->start;
+    frame->node->calls++;
+    frame->node->time += elapsed;
+    if (frame->node->parent) frame->node->parent->child_time += elapsed;
+}
+
+/* append the call path of a node to a buffer, outermost call first */
+static int format_profile_path( const struct relay_profile_node *node, char *buffer, int size )
+{
+    const struct relay_private_data *data = node->data;
+    const struct relay_entry_point *entry_point = data->entry_points + node->ordinal;
+    int len = 0;
+
+    if (node->parent) len = format_profile_path( node->parent, buffer, size );
+    if (len >= size) return len;
+    if (entry_point->name)
+        len += snprintf( buffer + len, size - len, "%s%s.%s", node->parent ? ";" : "",
+                         data->dllname, entry_point->name );
+    else
+        len += snprintf( buffer + len, size - len, "%s%s.%u", node->parent ? ";" : "",
+                         data->dllname, data->base + node->ordinal );
+    return len;
+}
+
+/***********************************************************************
+ *           RELAY_WriteProfile
+ *
+ * Write the profile of all threads to the profile file.
+ */
+void RELAY_WriteProfile(void)
+{
+    static const char header[] = "# pid tid calls inclusive_time self_time path\n";
+    const struct relay_profile_node *node;
+    struct relay_profile *profile;
+    char buffer[4096];
+    unsigned int i;
+    int fd, len;
+
+    if (!profile_path) return;
+    if ((fd = open( profile_path, O_WRONLY | O_CREAT | O_APPEND, 0666 )) == -1)
+    {
+        ERR( "failed to open %s: %s\n", debugstr_a(profile_path), strerror(errno) );
+        return;
+    }
+    write( fd, header, sizeof(header) - 1 );
+
+    RtlEnterCriticalSection( &profile_section );
+    LIST_FOR_EACH_ENTRY( profile, &profiles, struct relay_profile, entry )
+    {
+        for (i = 0; i < PROFILE_HASH_SIZE; i++)
+        {
+            for (node = profile->hash[i]; node; node = node->next)
+            {
+                if (!node->calls) continue;
+                len = snprintf( buffer, sizeof(buffer), "%04x %04x %s %s %s ",
+                                GetCurrentProcessId(), profile->tid,
+                                wine_dbgstr_longlong( node->calls ), wine_dbgstr_longlong( node->time ),
+                                wine_dbgstr_longlong( node->time - min( node->child_time, node->time )));
+                len += format_profile_path( node, buffer + len, sizeof(buffer) - len - 1 );
+                len = min( len, sizeof(buffer) - 1 );
+                buffer[len++] = '\n';
+                write( fd, buffer, len );
+            }
+        }
+    }
+    RtlLeaveCriticalSection( &profile_section );
+    close( fd );
+    profile_path = NULL;
+}
+
 /***********************************************************************
  *           RELAY_PrintArgs
  */
@@ -347,6 +576,7 @@ void * WINAPI relay_trace_entry( struct relay_descr *descr, unsigned int idx, co
         RELAY_PrintArgs( stack + 1, nb_args, descr->arg_types[ordinal] );
         DPRINTF( ") ret=%08lx\n", stack[0] );
     }
+    if (profile_path) profile_entry( data, ordinal, stack );
     return entry_point->orig_func;
 }
 
@@ -361,6 +591,7 @@ void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
 
+    if (profile_path) profile_exit( stack );
     if (!TRACE_ON(relay)) return;
 
     if (TRACE_ON(timestamp)) print_timestamp();
@@ -515,7 +746,9 @@ void WINAPI __regs_relay_call_regs( struct relay_descr *descr, unsigned int idx,
     memcpy( args_copy, args, nb_args * sizeof(args[0]) );
     args_copy[nb_args++] = (INT_PTR)context;  /* append context argument */
 
+    if (profile_path) profile_entry( data, ordinal, args );
     call_entry_point( orig_func + 12 + *(int *)(orig_func + 1), nb_args, args_copy, 0 );
+    if (profile_path) profile_exit( args );
 
     if (TRACE_ON(relay))
     {
@@ -756,6 +989,15 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+BOOL RELAY_ProfileEnabled(void)
+{
+    return FALSE;
+}
+
+void RELAY_WriteProfile(void)
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ */
 
 
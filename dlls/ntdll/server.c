@@ -51,6 +51,9 @@
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #ifdef HAVE_SYS_PRCTL_H
 # include <sys/prctl.h>
 #endif
@@ -76,6 +79,7 @@
 #include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/exception.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
@@ -89,6 +93,13 @@ WINE_DEFAULT_DEBUG_CHANNEL(server);
 #define MSG_CMSG_CLOEXEC 0
 #endif
 
+#if defined(__linux__) && !defined(F_ADD_SEALS)
+#define F_ADD_SEALS   1033
+#define F_SEAL_SEAL   0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW   0x0004
+#endif
+
 #define SOCKETNAME "socket"        /* name of the socket file */
 #define LOCKNAME   "lock"          /* name of the lock file */
 
@@ -183,6 +194,54 @@ static DECLSPEC_NORETURN void server_protocol_perror( const char *err )
 }
 
 
+#if defined(__linux__) && defined(__NR_futex)
+
+/* number of times to poll the request slot before sleeping on it */
+#define SLOT_SPIN_COUNT 1000
+
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+static inline unsigned int get_slot_reply_seq( const struct request_slot *slot )
+{
+    return *(volatile const unsigned int *)&slot->reply_seq;
+}
+
+/***********************************************************************
+ *           copy_slot_request_data
+ *
+ * Copy the request data to the request slot; helper for send_request.
+ */
+static unsigned int copy_slot_request_data( struct request_slot *slot,
+                                            const struct __server_request_info *req )
+{
+    unsigned int i, pos = 0;
+
+    __TRY
+    {
+        for (i = 0; i < req->data_count; i++)
+        {
+            memcpy( slot->data + pos, req->data[i].ptr, req->data[i].size );
+            pos += req->data[i].size;
+        }
+    }
+    __EXCEPT_PAGE_FAULT
+    {
+        return STATUS_ACCESS_VIOLATION;
+    }
+    __ENDTRY
+    return STATUS_SUCCESS;
+}
+
+#endif  /* __linux__ && __NR_futex */
+
+
 /***********************************************************************
  *           send_request
  *
@@ -199,6 +258,16 @@ static unsigned int send_request( const struct __server_request_info *req )
                           sizeof(req->u.req) )) == sizeof(req->u.req)) return STATUS_SUCCESS;
 
     }
+#if defined(__linux__) && defined(__NR_futex)
+    else if (ntdll_get_thread_data()->request_slot &&
+             req->u.req.request_header.request_size <= REQUEST_SLOT_DATA_SIZE)
+    {
+        /* the data goes to the slot, only the fixed part is written to the pipe */
+        if ((i = copy_slot_request_data( ntdll_get_thread_data()->request_slot, req ))) return i;
+        if ((ret = write( ntdll_get_thread_data()->request_fd, &req->u.req,
+                          sizeof(req->u.req) )) == sizeof(req->u.req)) return STATUS_SUCCESS;
+    }
+#endif
     else
     {
         struct iovec vec[__SERVER_MAX_DATA+1];
@@ -262,6 +331,49 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+#if defined(__linux__) && defined(__NR_futex)
+/***********************************************************************
+ *           wait_slot_reply
+ *
+ * Wait for a reply from the server in the request slot.
+ */
+static unsigned int wait_slot_reply( struct request_slot *slot, unsigned int seq,
+                                     struct __server_request_info *req )
+{
+    static const struct timespec timeout = { 1, 0 };
+    unsigned int i, spin = NtCurrentTeb()->Peb->NumberOfProcessors > 1 ? SLOT_SPIN_COUNT : 0;
+    data_size_t size;
+
+    /* the server usually replies within a few microseconds, avoid sleeping if possible */
+    for (i = 0; i < spin && get_slot_reply_seq( slot ) == seq; i++) small_pause();
+
+    while (get_slot_reply_seq( slot ) == seq)
+    {
+        struct pollfd pfd;
+
+        interlocked_xchg( (int *)&slot->waiting, 1 );
+        syscall( __NR_futex, &slot->reply_seq, 0 /* FUTEX_WAIT */, seq, &timeout, 0, 0 );
+        if (get_slot_reply_seq( slot ) != seq) break;
+
+        /* make sure the server is still there */
+        pfd.fd = ntdll_get_thread_data()->reply_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR))) abort_thread(0);
+    }
+    interlocked_xchg( (int *)&slot->waiting, 0 );
+
+    memcpy( &req->u.reply, &slot->reply, sizeof(req->u.reply) );
+    if ((size = req->u.reply.reply_header.reply_size))
+    {
+        if (size <= REQUEST_SLOT_DATA_SIZE) memcpy( req->reply_data, slot->data, size );
+        else read_reply_data( req->reply_data, size );
+    }
+    return req->u.reply.reply_header.error;
+}
+#endif
+
+
 /***********************************************************************
  *           wine_server_call (NTDLL.@)
  *
@@ -291,6 +403,18 @@ unsigned int wine_server_call( void *req_ptr )
     unsigned int ret;
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+#if defined(__linux__) && defined(__NR_futex)
+    if (ntdll_get_thread_data()->request_slot)
+    {
+        struct request_slot *slot = ntdll_get_thread_data()->request_slot;
+        unsigned int seq = get_slot_reply_seq( slot );
+
+        ret = send_request( req );
+        if (!ret) ret = wait_slot_reply( slot, seq, req );
+        pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+        return ret;
+    }
+#endif
     ret = send_request( req );
     if (!ret) ret = wait_reply( req );
     pthread_sigmask( SIG_SETMASK, &old_set, NULL );
@@ -397,7 +521,9 @@ static BOOL invoke_apc( const apc_call_t *call, apc_result_t *result )
                                         iosb, call->async_io.status, &apc );
         if (result->async_io.status != STATUS_PENDING)
         {
-            result->async_io.total = iosb->Information;
+            /* nothing gets reported in that case, and the iosb may be gone already */
+            if (result->async_io.status != STATUS_MORE_PROCESSING_REQUIRED)
+                result->async_io.total = iosb->Information;
             result->async_io.apc   = wine_server_client_ptr( apc );
         }
         break;
@@ -793,6 +919,7 @@ struct fd_cache_entry
     enum server_fd_type type : 5;
     unsigned int        access : 3;
     unsigned int        options : 24;
+    unsigned int        completion : 1;  /* known to be associated with a completion port */
 };
 
 #define FD_CACHE_BLOCK_SIZE  (65536 / sizeof(struct fd_cache_entry))
@@ -842,6 +969,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     fd_cache[entry][idx].type = type;
     fd_cache[entry][idx].access = access;
     fd_cache[entry][idx].options = options;
+    fd_cache[entry][idx].completion = 0;
     if (prev_fd != -1) close( prev_fd );
     return TRUE;
 }
@@ -869,6 +997,152 @@ static inline int get_cached_fd( HANDLE handle, enum server_fd_type *type,
 }
 
 
+/***********************************************************************/
+/* esync fd cache support */
+
+struct esync_cache_entry
+{
+    int             fd;      /* fd+2, 1 if the object has no eventfd, 0 if not looked up yet */
+    enum esync_type type;
+    unsigned int    access;
+    unsigned int    max;
+    int             users;   /* threads currently using an eventfd of this entry */
+    int             closed;  /* fd+1 of a closed handle still in use, closed by the last user */
+};
+
+#define ESYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(struct esync_cache_entry))
+#define ESYNC_CACHE_ENTRIES     256
+
+static struct esync_cache_entry *esync_cache[ESYNC_CACHE_ENTRIES];
+
+static inline unsigned int esync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / ESYNC_CACHE_BLOCK_SIZE;
+    return idx % ESYNC_CACHE_BLOCK_SIZE;
+}
+
+/* the caller owns a reference on the entry on success */
+static inline BOOL get_cached_esync_fd( HANDLE handle, int *fd, enum esync_type *type,
+                                        unsigned int *access, unsigned int *max )
+{
+    unsigned int entry, idx = esync_handle_to_index( handle, &entry );
+    struct esync_cache_entry *cache;
+
+    if (!(cache = esync_cache[entry])) return FALSE;
+    /* the reference has to be taken before looking at the fd, see server_remove_fd_from_cache */
+    interlocked_xchg_add( &cache[idx].users, 1 );
+    if (cache[idx].fd <= 1)
+    {
+        BOOL ret = (cache[idx].fd == 1);
+        server_release_esync_fd( handle );
+        if (ret) *fd = -1;
+        return ret;
+    }
+    *fd = cache[idx].fd - 2;
+    *type = cache[idx].type;
+    *access = cache[idx].access;
+    *max = cache[idx].max;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           server_release_esync_fd
+ *
+ * Release the eventfd returned by server_get_esync_fd.
+ */
+void server_release_esync_fd( HANDLE handle )
+{
+    unsigned int entry, idx = esync_handle_to_index( handle, &entry );
+    struct esync_cache_entry *cache = esync_cache[entry];
+
+    if (interlocked_xchg_add( &cache[idx].users, -1 ) == 1)
+    {
+        int fd = interlocked_xchg( &cache[idx].closed, 0 ) - 1;
+        if (fd >= 0) close( fd );
+    }
+}
+
+
+/***********************************************************************
+ *           server_get_esync_fd
+ *
+ * Retrieve the eventfd holding the state of an event or semaphore. The fd
+ * is cached and must be released with server_release_esync_fd once the
+ * caller is done with it, it may not be used after that.
+ */
+NTSTATUS server_get_esync_fd( HANDLE handle, int *fd, enum esync_type *type,
+                              unsigned int *access, unsigned int *max )
+{
+    unsigned int entry, idx = esync_handle_to_index( handle, &entry );
+    obj_handle_t fd_handle;
+    sigset_t sigset;
+    NTSTATUS ret;
+
+    if (entry >= ESYNC_CACHE_ENTRIES) return STATUS_NOT_IMPLEMENTED;  /* pseudo handle */
+
+    if (!get_cached_esync_fd( handle, fd, type, access, max ))
+    {
+        server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+        if (!get_cached_esync_fd( handle, fd, type, access, max ))
+        {
+            *fd = -1;
+            *type = ESYNC_NONE;
+            *access = *max = 0;
+
+            SERVER_START_REQ( get_esync_fd )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                if (!(ret = wine_server_call( req )))
+                {
+                    *type = reply->type;
+                    *access = reply->access;
+                    *max = reply->max;
+                    if ((*fd = receive_fd( &fd_handle )) != -1)
+                        assert( wine_server_ptr_handle(fd_handle) == handle );
+                }
+            }
+            SERVER_END_REQ;
+
+            /* an invalid handle may become valid later, don't remember it */
+            if (ret != STATUS_INVALID_HANDLE)
+            {
+                if (!esync_cache[entry])  /* do we need to allocate a new block of entries? */
+                {
+                    void *ptr = wine_anon_mmap( NULL, ESYNC_CACHE_BLOCK_SIZE * sizeof(struct esync_cache_entry),
+                                                PROT_READ | PROT_WRITE, 0 );
+                    if (ptr != MAP_FAILED) esync_cache[entry] = ptr;
+                }
+                /* the eventfd of a previous handle may still be in use, it has to be closed first */
+                if (esync_cache[entry] && !esync_cache[entry][idx].closed)
+                {
+                    esync_cache[entry][idx].type = *type;
+                    esync_cache[entry][idx].access = *access;
+                    esync_cache[entry][idx].max = *max;
+                    /* reference for the caller, taken before the fd can be seen */
+                    if (*fd != -1) interlocked_xchg_add( &esync_cache[entry][idx].users, 1 );
+                    interlocked_xchg( &esync_cache[entry][idx].fd, *fd + 2 );
+                }
+                else if (*fd != -1)
+                {
+                    close( *fd );
+                    *fd = -1;
+                }
+            }
+            else if (*fd != -1)
+            {
+                close( *fd );
+                *fd = -1;
+            }
+        }
+        server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    }
+    return *fd != -1 ? STATUS_SUCCESS : STATUS_NOT_IMPLEMENTED;
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -880,6 +1154,22 @@ int server_remove_fd_from_cache( HANDLE handle )
     if (entry < FD_CACHE_ENTRIES && fd_cache[entry])
         fd = interlocked_xchg( &fd_cache[entry][idx].fd, 0 ) - 1;
 
+    idx = esync_handle_to_index( handle, &entry );
+    if (entry < ESYNC_CACHE_ENTRIES && esync_cache[entry])
+    {
+        struct esync_cache_entry *cache = &esync_cache[entry][idx];
+        int esync_fd = interlocked_xchg( &cache->fd, 0 ) - 2;
+
+        /* other threads may still be polling or reading the eventfd, in that case
+         * the last one of them closes it; users are counted before they look at the fd */
+        if (esync_fd >= 0 && cache->users)
+        {
+            interlocked_xchg( &cache->closed, esync_fd + 1 );
+            if (cache->users || (esync_fd = interlocked_xchg( &cache->closed, 0 ) - 1) < 0)
+                esync_fd = -1;
+        }
+        if (esync_fd >= 0) close( esync_fd );
+    }
     return fd;
 }
 
@@ -938,6 +1228,37 @@ done:
 }
 
 
+/***********************************************************************
+ *           server_fd_has_completion
+ *
+ * Check whether the file of a handle is associated with a completion port.
+ */
+BOOL server_fd_has_completion( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    sigset_t sigset;
+    BOOL ret;
+
+    /* the association can't be removed, so only a positive answer is cached */
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if (entry < FD_CACHE_ENTRIES && fd_cache[entry] && fd_cache[entry][idx].completion)
+        ret = TRUE;
+    else
+    {
+        SERVER_START_REQ( get_fd_completion )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            ret = !wine_server_call( req ) && reply->bound;
+        }
+        SERVER_END_REQ;
+        if (ret && entry < FD_CACHE_ENTRIES && fd_cache[entry] && fd_cache[entry][idx].fd)
+            fd_cache[entry][idx].completion = 1;
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle   (NTDLL.@)
  *
@@ -1421,6 +1742,47 @@ NTSTATUS server_init_process_done(void)
 }
 
 
+/***********************************************************************
+ *           init_request_slot
+ *
+ * Create the shared memory used to pass requests and replies to the server
+ * without going through the pipes. Set WINESERVERSHM=0 to disable it.
+ */
+static void init_request_slot(void)
+{
+#if defined(__linux__) && defined(__NR_futex) && defined(__NR_memfd_create)
+    const char *env = getenv( "WINESERVERSHM" );
+    struct request_slot *slot;
+    unsigned int ret;
+    int fd;
+
+    if (env && !strcmp( env, "0" )) return;
+    if ((fd = syscall( __NR_memfd_create, "wine-request-slot", 3 /* MFD_CLOEXEC | MFD_ALLOW_SEALING */ )) == -1)
+        return;
+    /* the server only accepts a slot that can't be resized */
+    if (ftruncate( fd, sizeof(*slot) ) == -1 ||
+        fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL ) == -1 ||
+        (slot = mmap( NULL, sizeof(*slot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return;
+    }
+
+    wine_server_send_fd( fd );
+    SERVER_START_REQ( set_request_slot )
+    {
+        req->fd = fd;
+        ret = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    close( fd );
+
+    if (!ret) ntdll_get_thread_data()->request_slot = slot;
+    else munmap( slot, sizeof(*slot) );
+#endif
+}
+
+
 /***********************************************************************
  *           server_init_thread
  *
@@ -1485,6 +1847,7 @@ size_t server_init_thread( void *entry_point )
                 fatal_error( "WINEARCH set to win64 but '%s' is a 32-bit installation.\n",
                              wine_get_config_dir() );
         }
+        init_request_slot();
         return info_size;
     case STATUS_INVALID_IMAGE_WIN_64:
         fatal_error( "'%s' is a 32-bit installation, it cannot support 64-bit applications.\n",
@@ -1032,6 +1032,143 @@ static void test_keyed_events(void)
     NtClose( event );
 }
 
+static void test_server_latency(void)
+{
+    static const WCHAR name[] = {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s',
+                                 '\\','l','a','t','e','n','c','y','t','e','s','t',0};
+    static const WCHAR suffix[] = {'\\','l','a','t','e','n','c','y','t','e','s','t'};
+    char buffer[1024];
+    EVENT_BASIC_INFORMATION info;
+    OBJECT_NAME_INFORMATION *name_info = (OBJECT_NAME_INFORMATION *)buffer;
+    LARGE_INTEGER freq, start, end;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    HANDLE event, handle;
+    NTSTATUS status;
+    ULONG i, len;
+
+    pRtlInitUnicodeString(&str, name);
+    InitializeObjectAttributes(&attr, &str, 0, 0, NULL);
+    status = pNtCreateEvent(&event, EVENT_ALL_ACCESS, &attr, NotificationEvent, FALSE);
+    ok(status == STATUS_SUCCESS, "NtCreateEvent failed: %08x\n", status);
+    QueryPerformanceFrequency(&freq);
+
+    /* fixed size request and reply, each reply must match the preceding state change */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++)
+    {
+        if (i & 1) SetEvent(event);
+        else ResetEvent(event);
+        len = 0;
+        status = pNtQueryEvent(event, EventBasicInformation, &info, sizeof(info), &len);
+        if (status || len != sizeof(info) || info.EventState != (i & 1)) break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(i == 10000, "iteration %u: status %08x len %u state %d\n", i, status, len, info.EventState);
+    trace("SetEvent/ResetEvent + NtQueryEvent: %u ns per call\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 100000 / freq.QuadPart));
+
+    /* variable size request */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++)
+    {
+        handle = NULL;
+        status = pNtOpenEvent(&handle, EVENT_ALL_ACCESS, &attr);
+        if (status || !handle) break;
+        status = pNtClose(handle);
+        if (status) break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(i == 10000, "iteration %u: status %08x handle %p\n", i, status, handle);
+    trace("NtOpenEvent + NtClose: %u ns per call\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 100000 / freq.QuadPart));
+
+    /* variable size reply */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 10000; i++)
+    {
+        memset(buffer, 0, sizeof(buffer));
+        status = pNtQueryObject(event, ObjectNameInformation, buffer, sizeof(buffer), &len);
+        if (status || name_info->Name.Length < sizeof(suffix) ||
+            memcmp(name_info->Name.Buffer + (name_info->Name.Length - sizeof(suffix)) / sizeof(WCHAR),
+                   suffix, sizeof(suffix)))
+            break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(i == 10000, "iteration %u: status %08x name %s\n", i, status, wine_dbgstr_w(name_info->Name.Buffer));
+    trace("NtQueryObject: %u ns per call\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 100000 / freq.QuadPart));
+
+    pNtClose(event);
+}
+
+static void test_many_named_objects(void)
+{
+    const unsigned int count = 100000;
+    LARGE_INTEGER freq, start, end;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    char name[64];
+    HANDLE *events, handle;
+    NTSTATUS status;
+    unsigned int i;
+
+    events = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, count * sizeof(*events));
+    QueryPerformanceFrequency(&freq);
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < count; i++)
+    {
+        sprintf(name, "\\BaseNamedObjects\\stress_%u", i);
+        pRtlCreateUnicodeStringFromAsciiz(&str, name);
+        InitializeObjectAttributes(&attr, &str, 0, 0, NULL);
+        status = pNtCreateEvent(&events[i], EVENT_ALL_ACCESS, &attr, NotificationEvent, FALSE);
+        pRtlFreeUnicodeString(&str);
+        if (status) break;
+    }
+    QueryPerformanceCounter(&end);
+    ok(status == STATUS_SUCCESS, "%u: NtCreateEvent failed: %08x\n", i, status);
+    trace("created %u named events in %u ms\n", i,
+          (ULONG)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+
+    /* lookups must keep working while the namespace grows, in both case modes */
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < count; i += 7)
+    {
+        if (!events[i]) break;
+        sprintf(name, "\\BaseNamedObjects\\STRESS_%u", i);
+        pRtlCreateUnicodeStringFromAsciiz(&str, name);
+        InitializeObjectAttributes(&attr, &str, OBJ_CASE_INSENSITIVE, 0, NULL);
+        status = pNtOpenEvent(&handle, EVENT_ALL_ACCESS, &attr);
+        ok(status == STATUS_SUCCESS, "%u: NtOpenEvent failed: %08x\n", i, status);
+        if (status)
+        {
+            pRtlFreeUnicodeString(&str);
+            break;
+        }
+        pNtClose(handle);
+
+        InitializeObjectAttributes(&attr, &str, 0, 0, NULL);
+        status = pNtOpenEvent(&handle, EVENT_ALL_ACCESS, &attr);
+        ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "%u: NtOpenEvent returned %08x\n", i, status);
+        if (!status) pNtClose(handle);
+        pRtlFreeUnicodeString(&str);
+    }
+    QueryPerformanceCounter(&end);
+    trace("opened %u named events in %u ms\n", i / 7,
+          (ULONG)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+
+    for (i = 0; i < count; i++) if (events[i]) pNtClose(events[i]);
+
+    /* the names are gone once the objects are destroyed */
+    pRtlCreateUnicodeStringFromAsciiz(&str, "\\BaseNamedObjects\\stress_0");
+    InitializeObjectAttributes(&attr, &str, 0, 0, NULL);
+    status = pNtOpenEvent(&handle, EVENT_ALL_ACCESS, &attr);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "NtOpenEvent returned %08x\n", status);
+    pRtlFreeUnicodeString(&str);
+    HeapFree(GetProcessHeap(), 0, events);
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -1081,4 +1218,6 @@ START_TEST(om)
     test_type_mismatch();
     test_event();
     test_keyed_events();
+    test_server_latency();
+    test_many_named_objects();
 }
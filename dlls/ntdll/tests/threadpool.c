@@ -0,0 +1,608 @@
+/*
+ * Unit test suite for thread pool functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static HMODULE hntdll = 0;
+static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,PVOID);
+static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpCallbackMayRunLong)(TP_CALLBACK_INSTANCE *);
+static VOID     (WINAPI *pTpCallbackReleaseSemaphoreOnCompletion)(TP_CALLBACK_INSTANCE *,HANDLE,DWORD);
+static VOID     (WINAPI *pTpDisassociateCallback)(TP_CALLBACK_INSTANCE *);
+static BOOL     (WINAPI *pTpIsTimerSet)(TP_TIMER *);
+static VOID     (WINAPI *pTpPostWork)(TP_WORK *);
+static VOID     (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
+static VOID     (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,PVOID);
+static VOID     (WINAPI *pTpReleasePool)(TP_POOL *);
+static VOID     (WINAPI *pTpReleaseTimer)(TP_TIMER *);
+static VOID     (WINAPI *pTpReleaseWait)(TP_WAIT *);
+static VOID     (WINAPI *pTpReleaseWork)(TP_WORK *);
+static VOID     (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
+static BOOL     (WINAPI *pTpSetPoolMinThreads)(TP_POOL *,DWORD);
+static VOID     (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
+static VOID     (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
+static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static VOID     (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
+static VOID     (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
+static VOID     (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
+
+#define NTDLL_GET_PROC(func) \
+    do \
+    { \
+        p ## func = (void *)GetProcAddress(hntdll, #func); \
+        if (!p ## func) trace("Failed to get address for %s\n", #func); \
+    } \
+    while (0)
+
+static BOOL init_threadpool(void)
+{
+    hntdll = GetModuleHandleA("ntdll");
+    if (!hntdll)
+    {
+        win_skip("Could not load ntdll\n");
+        return FALSE;
+    }
+
+    NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocPool);
+    NTDLL_GET_PROC(TpAllocTimer);
+    NTDLL_GET_PROC(TpAllocWait);
+    NTDLL_GET_PROC(TpAllocWork);
+    NTDLL_GET_PROC(TpCallbackMayRunLong);
+    NTDLL_GET_PROC(TpCallbackReleaseSemaphoreOnCompletion);
+    NTDLL_GET_PROC(TpDisassociateCallback);
+    NTDLL_GET_PROC(TpIsTimerSet);
+    NTDLL_GET_PROC(TpPostWork);
+    NTDLL_GET_PROC(TpReleaseCleanupGroup);
+    NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleasePool);
+    NTDLL_GET_PROC(TpReleaseTimer);
+    NTDLL_GET_PROC(TpReleaseWait);
+    NTDLL_GET_PROC(TpReleaseWork);
+    NTDLL_GET_PROC(TpSetPoolMaxThreads);
+    NTDLL_GET_PROC(TpSetPoolMinThreads);
+    NTDLL_GET_PROC(TpSetTimer);
+    NTDLL_GET_PROC(TpSetWait);
+    NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpWaitForTimer);
+    NTDLL_GET_PROC(TpWaitForWait);
+    NTDLL_GET_PROC(TpWaitForWork);
+
+    if (!pTpAllocPool)
+    {
+        win_skip("Threadpool functions not supported, skipping tests\n");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#undef NTDLL_GET_PROC
+
+
+static void CALLBACK simple_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    HANDLE semaphore = userdata;
+    trace("Running simple callback\n");
+    Sleep(50);
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void test_tp_simple(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 1, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* post the callback using the default threadpool */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = NULL;
+    status = pTpSimpleTryPost(simple_cb, semaphore, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    /* post the callback using the new threadpool */
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpSimpleTryPost(simple_cb, semaphore, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* test with cleanup group */
+    group = NULL;
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+    ok(group != NULL, "expected group != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+    status = pTpSimpleTryPost(simple_cb, semaphore, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+
+    /* releasing the group members waits for the callback */
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+    result = WaitForSingleObject(semaphore, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
+static void CALLBACK work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    LONG *counter = userdata;
+    InterlockedIncrement(counter);
+}
+
+static void test_tp_work(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    LONG counter, done;
+    int i;
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    pTpSetPoolMaxThreads(pool, 2);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    work = NULL;
+    status = pTpAllocWork(&work, work_cb, &counter, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    /* post 10 identical work items at once */
+    counter = 0;
+    for (i = 0; i < 10; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    ok(counter == 10, "expected counter = 10, got %u\n", counter);
+
+    /* add more tasks and cancel them immediately, how many of them already
+     * ran depends on timing, but nothing may run once the wait returned */
+    counter = 0;
+    for (i = 0; i < 10; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, TRUE);
+    done = counter;
+    ok(done <= 10, "expected counter <= 10, got %u\n", done);
+    Sleep(50);
+    ok(counter == done, "expected counter = %u, got %u\n", done, counter);
+
+    pTpReleaseWork(work);
+    pTpReleasePool(pool);
+}
+
+struct nested_work
+{
+    TP_WORK *work;
+    LONG counter;
+    LONG remaining;
+};
+
+static void CALLBACK nested_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    struct nested_work *nested = userdata;
+
+    InterlockedIncrement(&nested->counter);
+    /* posting from a worker goes to its local queue, other workers steal from it */
+    if (InterlockedDecrement(&nested->remaining) > 0)
+    {
+        pTpPostWork(nested->work);
+        pTpPostWork(nested->work);
+    }
+}
+
+static void test_tp_work_nested(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct nested_work nested;
+    TP_POOL *pool;
+    NTSTATUS status;
+    DWORD start;
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    pTpSetPoolMaxThreads(pool, 4);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    nested.counter = 0;
+    nested.remaining = 50000;
+    status = pTpAllocWork(&nested.work, nested_work_cb, &nested, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+
+    start = GetTickCount();
+    pTpPostWork(nested.work);
+    while (nested.remaining > 0 && GetTickCount() - start < 10000) Sleep(10);
+    pTpWaitForWork(nested.work, FALSE);
+    trace("%u nested work callbacks in %u ms\n", nested.counter, GetTickCount() - start);
+    ok(nested.remaining <= 0, "not all callbacks were executed, %d remaining\n", nested.remaining);
+    ok(nested.counter >= 50000, "expected at least 50000 callbacks, got %u\n", nested.counter);
+
+    pTpReleaseWork(nested.work);
+    pTpReleasePool(pool);
+}
+
+static void CALLBACK group_cancel_cb(void *object, void *userdata)
+{
+    HANDLE semaphore = userdata;
+    trace("Running group cancel callback\n");
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void CALLBACK long_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    HANDLE semaphore = userdata;
+    NTSTATUS status;
+
+    status = pTpCallbackMayRunLong(instance);
+    ok(!status || status == STATUS_TOO_MANY_THREADS,
+       "TpCallbackMayRunLong failed with status %x\n", status);
+
+    Sleep(200);
+    pTpCallbackReleaseSemaphoreOnCompletion(instance, semaphore, 1);
+}
+
+static void CALLBACK unexpected_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    ok(0, "Unexpected callback\n");
+}
+
+static void test_tp_group_cancel(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    TP_WORK *work, *work2;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 2, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    pTpSetPoolMaxThreads(pool, 1);
+
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+    environment.CleanupGroupCancelCallback = group_cancel_cb;
+
+    /* the first callback blocks the only worker, the second one stays queued */
+    status = pTpAllocWork(&work, long_work_cb, semaphore, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    status = pTpAllocWork(&work2, unexpected_work_cb, semaphore, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+
+    pTpPostWork(work);
+    Sleep(50);
+    pTpPostWork(work2);
+
+    pTpReleaseCleanupGroupMembers(group, TRUE, semaphore);
+
+    /* the running callback completed, the pending one was cancelled */
+    result = WaitForSingleObject(semaphore, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(semaphore, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
+static void CALLBACK timer_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    HANDLE semaphore = userdata;
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void test_tp_timer(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    DWORD result, ticks;
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_TIMER *timer;
+    TP_POOL *pool;
+    int i;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 3, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    timer = NULL;
+    status = pTpAllocTimer(&timer, timer_cb, semaphore, &environment);
+    ok(!status, "TpAllocTimer failed with status %x\n", status);
+    ok(timer != NULL, "expected timer != NULL\n");
+    ok(!pTpIsTimerSet(timer), "TpIsTimerSet returned TRUE\n");
+
+    /* one-shot relative timer */
+    ticks = GetTickCount();
+    when.QuadPart = (ULONGLONG)200 * -10000;
+    pTpSetTimer(timer, &when, 0, 0);
+    ok(pTpIsTimerSet(timer), "TpIsTimerSet returned FALSE\n");
+    result = WaitForSingleObject(semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ticks = GetTickCount() - ticks;
+    ok(ticks >= 150, "expected approximately 200 ticks, got %u\n", ticks);
+
+    /* periodic timer */
+    when.QuadPart = (ULONGLONG)50 * -10000;
+    pTpSetTimer(timer, &when, 50, 0);
+    for (i = 0; i < 3; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+
+    /* disarm the timer */
+    pTpSetTimer(timer, NULL, 0, 0);
+    ok(!pTpIsTimerSet(timer), "TpIsTimerSet returned TRUE\n");
+    pTpWaitForTimer(timer, TRUE);
+    while (WaitForSingleObject(semaphore, 0) == WAIT_OBJECT_0);
+    result = WaitForSingleObject(semaphore, 200);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+
+    pTpReleaseTimer(timer);
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
+struct wait_info
+{
+    HANDLE semaphore;
+    LONG userdata;
+};
+
+static void CALLBACK wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+                             TP_WAIT *wait, TP_WAIT_RESULT result)
+{
+    struct wait_info *info = userdata;
+
+    if (result == WAIT_OBJECT_0)
+        InterlockedIncrement(&info->userdata);
+    else if (result == WAIT_TIMEOUT)
+        InterlockedExchangeAdd(&info->userdata, 0x10000);
+    else
+        ok(0, "unexpected result %u\n", result);
+    ReleaseSemaphore(info->semaphore, 1, NULL);
+}
+
+static void test_tp_wait(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct wait_info info;
+    LARGE_INTEGER when;
+    HANDLE event;
+    NTSTATUS status;
+    TP_WAIT *wait;
+    TP_POOL *pool;
+    DWORD result;
+
+    info.semaphore = CreateSemaphoreA(NULL, 0, 1, NULL);
+    ok(info.semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+    event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    ok(event != NULL, "CreateEventA failed %u\n", GetLastError());
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    wait = NULL;
+    status = pTpAllocWait(&wait, wait_cb, &info, &environment);
+    ok(!status, "TpAllocWait failed with status %x\n", status);
+    ok(wait != NULL, "expected wait != NULL\n");
+
+    /* infinite timeout, signal the event */
+    info.userdata = 0;
+    pTpSetWait(wait, event, NULL);
+    Sleep(50);
+    ok(info.userdata == 0, "expected info.userdata = 0, got %u\n", info.userdata);
+    SetEvent(event);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata);
+
+    /* waits are one-shot */
+    SetEvent(event);
+    result = WaitForSingleObject(info.semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata);
+    result = WaitForSingleObject(event, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* relative timeout */
+    info.userdata = 0;
+    when.QuadPart = (ULONGLONG)100 * -10000;
+    pTpSetWait(wait, event, &when);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 0x10000, "expected info.userdata = 0x10000, got %u\n", info.userdata);
+
+    /* zero timeout on a signaled object reports the signal */
+    info.userdata = 0;
+    SetEvent(event);
+    when.QuadPart = 0;
+    pTpSetWait(wait, event, &when);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata);
+
+    /* disarm the wait */
+    info.userdata = 0;
+    pTpSetWait(wait, event, NULL);
+    pTpSetWait(wait, NULL, NULL);
+    SetEvent(event);
+    result = WaitForSingleObject(info.semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 0, "expected info.userdata = 0, got %u\n", info.userdata);
+    result = WaitForSingleObject(event, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    pTpWaitForWait(wait, FALSE);
+    pTpReleaseWait(wait);
+    pTpReleasePool(pool);
+    CloseHandle(info.semaphore);
+    CloseHandle(event);
+}
+
+#define NUM_MULTI_WAITS 200
+
+static void CALLBACK multi_wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+                                   TP_WAIT *wait, TP_WAIT_RESULT result)
+{
+    LONG *counter = userdata;
+    ok(result == WAIT_OBJECT_0, "unexpected result %u\n", result);
+    InterlockedIncrement(counter);
+}
+
+static void test_tp_multi_wait(void)
+{
+    TP_WAIT *waits[NUM_MULTI_WAITS];
+    HANDLE events[NUM_MULTI_WAITS];
+    NTSTATUS status;
+    LONG counter;
+    DWORD start;
+    int i;
+
+    /* many more waits than a single thread can wait for at once */
+    for (i = 0; i < NUM_MULTI_WAITS; i++)
+    {
+        events[i] = CreateEventA(NULL, FALSE, FALSE, NULL);
+        ok(events[i] != NULL, "CreateEventA failed %u\n", GetLastError());
+        waits[i] = NULL;
+        status = pTpAllocWait(&waits[i], multi_wait_cb, &counter, NULL);
+        ok(!status, "TpAllocWait failed with status %x\n", status);
+        pTpSetWait(waits[i], events[i], NULL);
+    }
+
+    /* signal the events in reverse order */
+    counter = 0;
+    for (i = NUM_MULTI_WAITS - 1; i >= 0; i--)
+        SetEvent(events[i]);
+
+    start = GetTickCount();
+    while (counter < NUM_MULTI_WAITS && GetTickCount() - start < 5000) Sleep(10);
+    ok(counter == NUM_MULTI_WAITS, "expected %u callbacks, got %u\n", NUM_MULTI_WAITS, counter);
+
+    /* release half of the waits, then re-arm and signal the others */
+    for (i = 0; i < NUM_MULTI_WAITS; i += 2)
+    {
+        pTpWaitForWait(waits[i], FALSE);
+        pTpReleaseWait(waits[i]);
+        waits[i] = NULL;
+    }
+
+    counter = 0;
+    for (i = 1; i < NUM_MULTI_WAITS; i += 2)
+        pTpSetWait(waits[i], events[i], NULL);
+    for (i = 1; i < NUM_MULTI_WAITS; i += 2)
+        SetEvent(events[i]);
+
+    start = GetTickCount();
+    while (counter < NUM_MULTI_WAITS / 2 && GetTickCount() - start < 5000) Sleep(10);
+    ok(counter == NUM_MULTI_WAITS / 2, "expected %u callbacks, got %u\n", NUM_MULTI_WAITS / 2, counter);
+
+    for (i = 0; i < NUM_MULTI_WAITS; i++)
+    {
+        if (waits[i])
+        {
+            pTpWaitForWait(waits[i], FALSE);
+            pTpReleaseWait(waits[i]);
+        }
+        CloseHandle(events[i]);
+    }
+}
+
+static void test_tp_min_threads(void)
+{
+    TP_POOL *pool;
+    NTSTATUS status;
+    BOOL ret;
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+
+    ret = pTpSetPoolMinThreads(pool, 4);
+    ok(ret, "TpSetPoolMinThreads failed\n");
+    pTpSetPoolMaxThreads(pool, 2);
+
+    pTpReleasePool(pool);
+}
+
+START_TEST(threadpool)
+{
+    if (!init_threadpool())
+        return;
+
+    test_tp_simple();
+    test_tp_work();
+    test_tp_work_nested();
+    test_tp_group_cancel();
+    test_tp_timer();
+    test_tp_wait();
+    test_tp_multi_wait();
+    test_tp_min_threads();
+}
@@ -19,6 +19,7 @@
  */
 
 #include "ntdll_test.h"
+#include "ddk/wdm.h"
 
 #define TICKSPERSEC        10000000
 #define TICKSPERMSEC       10000
@@ -26,6 +27,7 @@
 
 static VOID (WINAPI *pRtlTimeToTimeFields)( const LARGE_INTEGER *liTime, PTIME_FIELDS TimeFields) ;
 static VOID (WINAPI *pRtlTimeFieldsToTime)(  PTIME_FIELDS TimeFields,  PLARGE_INTEGER Time) ;
+static NTSTATUS (WINAPI *pNtQuerySystemTime)( LARGE_INTEGER * );
 
 static const int MonthLengths[2][12] =
 {
@@ -94,13 +96,79 @@ static void test_pRtlTimeToTimeFields(void)
     }
 }
 
+static ULONGLONG read_ksystem_time(volatile KSYSTEM_TIME *time)
+{
+    ULONG high, low;
+
+    do
+    {
+        high = time->High1Time;
+        low = time->LowPart;
+    } while (high != time->High2Time);
+    return (ULONGLONG)high << 32 | low;
+}
+
+static void test_user_shared_data_time(void)
+{
+    KSHARED_USER_DATA *user_shared_data = (void *)0x7ffe0000;
+    ULONGLONG tick, interrupt, system, t1, t2;
+    LARGE_INTEGER now, freq, start, end;
+    volatile ULONG sum;
+    ULONG i;
+
+    ok(user_shared_data->TickCountMultiplier == 1 << 24, "got multiplier %x\n",
+       user_shared_data->TickCountMultiplier);
+
+    /* the fields are kept current once the tick count has been used */
+    GetTickCount();
+    Sleep(50);
+    tick = read_ksystem_time(&user_shared_data->TickCount);
+    t1 = GetTickCount64();
+    ok(t1 - tick < 100, "tick count %u, shared data %u\n", (ULONG)t1, (ULONG)tick);
+
+    pNtQuerySystemTime(&now);
+    system = read_ksystem_time(&user_shared_data->SystemTime);
+    ok(now.QuadPart - system < TICKSPERSEC, "system time %x%08x, shared data %x%08x\n",
+       now.u.HighPart, now.u.LowPart, (ULONG)(system >> 32), (ULONG)system);
+
+    /* the fields must keep moving without any call from this process */
+    interrupt = read_ksystem_time(&user_shared_data->InterruptTime);
+    Sleep(100);
+    t2 = read_ksystem_time(&user_shared_data->TickCount);
+    ok(t2 - tick >= 50 && t2 - tick < 1000, "shared tick count advanced by %u ms\n", (ULONG)(t2 - tick));
+    t2 = read_ksystem_time(&user_shared_data->InterruptTime);
+    ok(t2 - interrupt >= 50 * TICKSPERMSEC, "shared interrupt time advanced by %u\n",
+       (ULONG)(t2 - interrupt));
+
+    /* compare the cost of reading the page directly with the API paths */
+    QueryPerformanceFrequency(&freq);
+    sum = 0;
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 1000000; i++) sum += user_shared_data->TickCount.LowPart;
+    QueryPerformanceCounter(&end);
+    trace("shared data tick count: %u ms for 1000000 reads\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 1000000; i++) sum += GetTickCount();
+    QueryPerformanceCounter(&end);
+    trace("GetTickCount: %u ms for 1000000 calls\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < 1000000; i++) QueryPerformanceCounter(&now);
+    QueryPerformanceCounter(&end);
+    trace("QueryPerformanceCounter: %u ms for 1000000 calls\n",
+          (ULONG)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+}
+
 START_TEST(time)
 {
     HMODULE mod = GetModuleHandleA("ntdll.dll");
     pRtlTimeToTimeFields = (void *)GetProcAddress(mod,"RtlTimeToTimeFields");
     pRtlTimeFieldsToTime = (void *)GetProcAddress(mod,"RtlTimeFieldsToTime");
+    pNtQuerySystemTime = (void *)GetProcAddress(mod,"NtQuerySystemTime");
     if (pRtlTimeToTimeFields && pRtlTimeFieldsToTime)
         test_pRtlTimeToTimeFields();
     else
         win_skip("Required time conversion functions are not available\n");
+    test_user_shared_data_time();
 }
@@ -215,7 +215,6 @@ HANDLE thread_init(void)
     void *addr;
     SIZE_T size, info_size;
     HANDLE exe_file = 0;
-    LARGE_INTEGER now;
     NTSTATUS status;
     struct ntdll_thread_data *thread_data;
     static struct debug_info debug_info;  /* debug info for initial thread */
@@ -275,6 +274,8 @@ HANDLE thread_init(void)
     thread_data = (struct ntdll_thread_data *)teb->SpareBytes1;
     thread_data->request_fd = -1;
     thread_data->reply_fd   = -1;
+    thread_data->request_slot = NULL;
+    thread_data->heap_cache = NULL;
     thread_data->wait_fd[0] = -1;
     thread_data->wait_fd[1] = -1;
     thread_data->debug_info = &debug_info;
@@ -316,13 +317,7 @@ HANDLE thread_init(void)
     }
 
     /* initialize time values in user_shared_data */
-    NtQuerySystemTime( &now );
-    user_shared_data->SystemTime.LowPart = now.u.LowPart;
-    user_shared_data->SystemTime.High1Time = user_shared_data->SystemTime.High2Time = now.u.HighPart;
-    user_shared_data->u.TickCountQuad = (now.QuadPart - server_start_time) / 10000;
-    user_shared_data->u.TickCount.High2Time = user_shared_data->u.TickCount.High1Time;
-    user_shared_data->TickCountLowDeprecated = user_shared_data->u.TickCount.LowPart;
-    user_shared_data->TickCountMultiplier = 1 << 24;
+    init_shared_time();
 
     fill_cpu_info();
 
@@ -338,12 +333,15 @@ HANDLE thread_init(void)
 void terminate_thread( int status )
 {
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
+    heap_thread_abandon();
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    if (ntdll_get_thread_data()->request_slot)
+        munmap( ntdll_get_thread_data()->request_slot, sizeof(struct request_slot) );
     pthread_exit( UIntToPtr(status) );
 }
 
@@ -388,10 +386,15 @@ void exit_thread( int status )
         }
     }
 
+    /* no more heap calls can go through the thread caches after this */
+    heap_thread_detach();
+
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
     close( ntdll_get_thread_data()->request_fd );
+    if (ntdll_get_thread_data()->request_slot)
+        munmap( ntdll_get_thread_data()->request_slot, sizeof(struct request_slot) );
     pthread_exit( UIntToPtr(status) );
 }
 
@@ -529,6 +532,8 @@ NTSTATUS WINAPI RtlCreateUserThread( HANDLE process, const SECURITY_DESCRIPTOR *
     thread_data = (struct ntdll_thread_data *)teb->SpareBytes1;
     thread_data->request_fd  = request_pipe[1];
     thread_data->reply_fd    = -1;
+    thread_data->request_slot = NULL;
+    thread_data->heap_cache = NULL;
     thread_data->wait_fd[0]  = -1;
     thread_data->wait_fd[1]  = -1;
 
@@ -944,6 +949,31 @@ NTSTATUS WINAPI NtQueryInformationThread( HANDLE handle, THREADINFOCLASS class,
             }
         }
         return status;
+    case ThreadGroupInformation:
+        {
+            const ULONG_PTR affinity_mask = ((ULONG_PTR)1 << NtCurrentTeb()->Peb->NumberOfProcessors) - 1;
+            GROUP_AFFINITY affinity;
+
+            if (length != sizeof(affinity)) return STATUS_INFO_LENGTH_MISMATCH;
+            if (!data) return STATUS_ACCESS_VIOLATION;
+
+            /* all processors are in group 0 */
+            memset( &affinity, 0, sizeof(affinity) );
+            SERVER_START_REQ( get_thread_info )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                req->tid_in = 0;
+                if (!(status = wine_server_call( req )))
+                    affinity.Mask = reply->affinity & affinity_mask;
+            }
+            SERVER_END_REQ;
+            if (status == STATUS_SUCCESS)
+            {
+                memcpy( data, &affinity, sizeof(affinity) );
+                if (ret_len) *ret_len = sizeof(affinity);
+            }
+        }
+        return status;
     case ThreadTimes:
         {
             KERNEL_USER_TIMES   kusrt;
@@ -1187,6 +1217,24 @@ NTSTATUS WINAPI NtSetInformationThread( HANDLE handle, THREADINFOCLASS class,
             SERVER_END_REQ;
         }
         return status;
+    case ThreadGroupInformation:
+        {
+            const ULONG_PTR affinity_mask = ((ULONG_PTR)1 << NtCurrentTeb()->Peb->NumberOfProcessors) - 1;
+            const GROUP_AFFINITY *req_aff = data;
+
+            if (length != sizeof(*req_aff)) return STATUS_INVALID_PARAMETER;
+            if (req_aff->Group) return STATUS_INVALID_PARAMETER;  /* only one group is supported */
+            if (!req_aff->Mask || (req_aff->Mask & ~affinity_mask)) return STATUS_INVALID_PARAMETER;
+            SERVER_START_REQ( set_thread_info )
+            {
+                req->handle   = wine_server_obj_handle( handle );
+                req->affinity = req_aff->Mask;
+                req->mask     = SET_THREAD_INFO_AFFINITY;
+                status = wine_server_call( req );
+            }
+            SERVER_END_REQ;
+        }
+        return status;
     case ThreadHideFromDebugger:
         /* pretend the call succeeded to satisfy some code protectors */
         return STATUS_SUCCESS;
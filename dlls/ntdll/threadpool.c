@@ -39,22 +39,6 @@ WINE_DEFAULT_DEBUG_CHANNEL(threadpool);
 
 #define WORKER_TIMEOUT 30000 /* 30 seconds */
 
-static LONG num_workers;
-static LONG num_work_items;
-static LONG num_busy_workers;
-
-static struct list work_item_list = LIST_INIT(work_item_list);
-static HANDLE work_item_event;
-
-static RTL_CRITICAL_SECTION threadpool_cs;
-static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
-{
-    0, 0, &threadpool_cs,
-    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
-    0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_cs") }
-};
-static RTL_CRITICAL_SECTION threadpool_cs = { &critsect_debug, -1, 0, 0, 0, 0 };
-
 static HANDLE compl_port = NULL;
 static RTL_CRITICAL_SECTION threadpool_compl_cs;
 static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
@@ -65,13 +49,250 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
 };
 static RTL_CRITICAL_SECTION threadpool_compl_cs = { &critsect_compl_debug, -1, 0, 0, 0, 0 };
 
-struct work_item
+/* A work queue. Every worker owns one and pops its own tasks from the tail,
+ * other workers steal from the head. Tasks posted from threads outside the
+ * pool go to the pool-wide injection queue. */
+struct threadpool_queue
 {
-    struct list entry;
-    PRTL_WORK_ITEM_ROUTINE function;
-    PVOID context;
+    RTL_SRWLOCK             lock;
+    struct list             tasks;
+};
+
+struct threadpool
+{
+    LONG                    refcount;
+    LONG                    objcount;
+    BOOL                    shutdown;
+    RTL_CRITICAL_SECTION    cs;
+    /* tasks posted from outside the pool */
+    struct threadpool_queue queue;
+    /* number of tasks waiting in any queue of the pool */
+    LONG                    num_pending;
+    /* list of workers, protected by cs */
+    struct list             workers;
+    RTL_CONDITION_VARIABLE  update_event;
+    LONG                    num_idle_workers;
+    /* woken up when an object has no more outstanding callbacks */
+    RTL_CONDITION_VARIABLE  finished_event;
+    LONG                    num_object_waiters;
+    /* thread counts, protected by cs */
+    int                     max_workers;
+    int                     min_workers;
+    int                     num_workers;
+    int                     num_busy_workers;
+};
+
+struct threadpool_worker
+{
+    struct list             entry;
+    struct threadpool      *pool;
+    struct threadpool_queue queue;
+};
+
+enum threadpool_objtype
+{
+    TP_OBJECT_TYPE_SIMPLE,
+    TP_OBJECT_TYPE_WORK,
+    TP_OBJECT_TYPE_TIMER,
+    TP_OBJECT_TYPE_WAIT,
+    TP_OBJECT_TYPE_IO
+};
+
+struct threadpool_object
+{
+    void                   *win32_callback; /* leave space for kernel32 to store the Win32 callback */
+    LONG                    refcount;
+    BOOL                    shutdown;
+    /* read-only information */
+    enum threadpool_objtype type;
+    struct threadpool      *pool;
+    struct threadpool_group *group;
+    PVOID                   userdata;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK group_cancel_callback;
+    PTP_SIMPLE_CALLBACK     finalization_callback;
+    BOOL                    may_run_long;
+    HMODULE                 race_dll;
+    /* information about the group, locked via the group critical section */
+    struct list             group_entry;
+    BOOL                    is_group_member;
+    /* number of queued and running callbacks */
+    LONG                    num_outstanding;
+    /* arguments for callback */
+    union
+    {
+        struct
+        {
+            PTP_SIMPLE_CALLBACK callback;
+        } simple;
+        struct
+        {
+            PTP_WORK_CALLBACK callback;
+        } work;
+        struct
+        {
+            PTP_TIMER_CALLBACK callback;
+            /* information about the timer, locked via timerqueue.cs */
+            BOOL            timer_initialized;
+            BOOL            timer_pending;
+            struct list     timer_entry;
+            BOOL            timer_set;
+            ULONGLONG       timeout;
+            LONG            period;
+            LONG            window_length;
+        } timer;
+        struct
+        {
+            PTP_WAIT_CALLBACK callback;
+            /* WT_* flags, used by RtlRegisterWait */
+            ULONG           flags;
+            RTL_WAITORTIMERCALLBACKFUNC rtl_callback;
+            ULONG           rtl_timeout;
+            HANDLE          completion_event;
+            /* information about the wait object, locked via waitqueue.cs */
+            struct waitqueue_bucket *bucket;
+            BOOL            wait_pending;
+            struct list     wait_entry;
+            ULONGLONG       timeout;
+            HANDLE          handle;
+        } wait;
+        struct
+        {
+            PTP_IO_CALLBACK callback;
+            /* number of started and not yet completed operations */
+            LONG            pending_count;
+        } io;
+    } u;
+};
+
+/* a single posted callback */
+struct threadpool_task
+{
+    struct list             entry;
+    struct threadpool_object *object;
+    /* completion data for I/O objects */
+    ULONG_PTR               io_value;
+    IO_STATUS_BLOCK         io_iosb;
+    /* result for wait objects */
+    TP_WAIT_RESULT          wait_result;
+};
+
+struct threadpool_instance
+{
+    struct threadpool_object *object;
+    DWORD                   threadid;
+    BOOL                    associated;
+    BOOL                    may_run_long;
+    struct
+    {
+        CRITICAL_SECTION    *critical_section;
+        HANDLE              mutex;
+        HANDLE              semaphore;
+        LONG                semaphore_count;
+        HANDLE              event;
+        HMODULE             library;
+    } cleanup;
+};
+
+struct threadpool_group
+{
+    LONG                    refcount;
+    BOOL                    shutdown;
+    CRITICAL_SECTION        cs;
+    /* list of group members, locked via .cs */
+    struct list             members;
+};
+
+/* global timerqueue object */
+static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    struct list             pending_timers;
+    RTL_CONDITION_VARIABLE  update_event;
+}
+timerqueue =
+{
+    { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
+    0,                                          /* objcount */
+    FALSE,                                      /* thread_running */
+    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    RTL_CONDITION_VARIABLE_INIT                 /* update_event */
+};
+
+static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug =
+{
+    0, 0, &timerqueue.cs,
+    { &timerqueue_debug.ProcessLocksList, &timerqueue_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": timerqueue.cs") }
+};
+
+/* global I/O completion port shared by all I/O objects */
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    HANDLE                  port;
+}
+ioqueue =
+{
+    { &ioqueue_debug, -1, 0, 0, 0, 0 },         /* cs */
+    0,                                          /* objcount */
+    FALSE,                                      /* thread_running */
+    NULL                                        /* port */
+};
+
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug =
+{
+    0, 0, &ioqueue.cs,
+    { &ioqueue_debug.ProcessLocksList, &ioqueue_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": ioqueue.cs") }
+};
+
+/* global wait queue: each bucket is served by one thread waiting on up to
+ * MAXIMUM_WAITQUEUE_OBJECTS handles plus its update event */
+#define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
+
+struct waitqueue_bucket
+{
+    struct list             bucket_entry;
+    LONG                    objcount;
+    /* wait objects which are not armed */
+    struct list             reserved;
+    /* wait objects the thread is waiting for */
+    struct list             waiting;
+    HANDLE                  update_event;
+};
+
+static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    LONG                    num_buckets;
+    struct list             buckets;
+}
+waitqueue =
+{
+    { &waitqueue_debug, -1, 0, 0, 0, 0 },       /* cs */
+    0,                                          /* num_buckets */
+    LIST_INIT( waitqueue.buckets )              /* buckets */
 };
 
+static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
+{
+    0, 0, &waitqueue.cs,
+    { &waitqueue_debug.ProcessLocksList, &waitqueue_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
+};
+
+static struct threadpool *default_threadpool = NULL;
+
 static inline LONG interlocked_inc( PLONG dest )
 {
     return interlocked_xchg_add( dest, 1 ) + 1;
@@ -82,976 +303,3093 @@ static inline LONG interlocked_dec( PLONG dest )
     return interlocked_xchg_add( dest, -1 ) - 1;
 }
 
-static void WINAPI worker_thread_proc(void * param)
+static inline struct threadpool *impl_from_TP_POOL( TP_POOL *pool )
 {
-    interlocked_inc(&num_workers);
+    return (struct threadpool *)pool;
+}
 
-    /* free the work item memory sooner to reduce memory usage */
-    while (TRUE)
-    {
-        if (num_work_items > 0)
-        {
-            struct list *item;
-            RtlEnterCriticalSection(&threadpool_cs);
-            item = list_head(&work_item_list);
-            if (item)
-            {
-                struct work_item *work_item_ptr = LIST_ENTRY(item, struct work_item, entry);
-                struct work_item work_item;
-                list_remove(&work_item_ptr->entry);
-                interlocked_dec(&num_work_items);
+static inline struct threadpool_object *impl_from_TP_WORK( TP_WORK *work )
+{
+    struct threadpool_object *object = (struct threadpool_object *)work;
+    assert( object->type == TP_OBJECT_TYPE_WORK );
+    return object;
+}
+
+static inline struct threadpool_object *impl_from_TP_TIMER( TP_TIMER *timer )
+{
+    struct threadpool_object *object = (struct threadpool_object *)timer;
+    assert( object->type == TP_OBJECT_TYPE_TIMER );
+    return object;
+}
 
-                RtlLeaveCriticalSection(&threadpool_cs);
+static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
+{
+    struct threadpool_object *object = (struct threadpool_object *)wait;
+    assert( object->type == TP_OBJECT_TYPE_WAIT );
+    return object;
+}
 
-                work_item = *work_item_ptr;
-                RtlFreeHeap(GetProcessHeap(), 0, work_item_ptr);
+static inline struct threadpool_object *impl_from_TP_IO( TP_IO *io )
+{
+    struct threadpool_object *object = (struct threadpool_object *)io;
+    assert( object->type == TP_OBJECT_TYPE_IO );
+    return object;
+}
 
-                TRACE("executing %p(%p)\n", work_item.function, work_item.context);
+static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
+{
+    return (struct threadpool_group *)group;
+}
 
-                interlocked_inc(&num_busy_workers);
+static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CALLBACK_INSTANCE *instance )
+{
+    return (struct threadpool_instance *)instance;
+}
 
-                /* do the work */
-                work_item.function(work_item.context);
+/* the worker running on the current thread, if any */
+static inline struct threadpool_worker *get_current_worker(void)
+{
+    return NtCurrentTeb()->Reserved5[0];
+}
 
-                interlocked_dec(&num_busy_workers);
-            }
-            else
-                RtlLeaveCriticalSection(&threadpool_cs);
-        }
-        else
-        {
-            NTSTATUS status;
-            LARGE_INTEGER timeout;
-            timeout.QuadPart = -(WORKER_TIMEOUT * (ULONGLONG)10000);
-            status = NtWaitForSingleObject(work_item_event, FALSE, &timeout);
-            if (status != STATUS_WAIT_0)
-                break;
-        }
-    }
+static inline void set_current_worker( struct threadpool_worker *worker )
+{
+    NtCurrentTeb()->Reserved5[0] = worker;
+}
+
+static void CALLBACK threadpool_worker_proc( void *param );
+static void tp_object_submit( struct threadpool_object *object, const struct threadpool_task *data );
+static void tp_object_shutdown( struct threadpool_object *object );
+static BOOL tp_object_release( struct threadpool_object *object );
+static void tp_object_execute( struct threadpool_task *task );
 
-    interlocked_dec(&num_workers);
+/***********************************************************************
+ *           tp_queue_push / tp_queue_pop_head / tp_queue_pop_tail
+ */
+static void tp_queue_push( struct threadpool_queue *queue, struct threadpool_task *task )
+{
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    list_add_tail( &queue->tasks, &task->entry );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+}
 
-    RtlExitUserThread(0);
+static struct threadpool_task *tp_queue_pop_head( struct threadpool_queue *queue )
+{
+    struct list *ptr;
 
-    /* never reached */
+    if (list_empty( &queue->tasks )) return NULL;
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if ((ptr = list_head( &queue->tasks ))) list_remove( ptr );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return ptr ? LIST_ENTRY( ptr, struct threadpool_task, entry ) : NULL;
 }
 
-static NTSTATUS add_work_item_to_queue(struct work_item *work_item)
+static struct threadpool_task *tp_queue_pop_tail( struct threadpool_queue *queue )
 {
-    NTSTATUS status;
+    struct list *ptr;
 
-    RtlEnterCriticalSection(&threadpool_cs);
-    list_add_tail(&work_item_list, &work_item->entry);
-    num_work_items++;
-    RtlLeaveCriticalSection(&threadpool_cs);
+    if (list_empty( &queue->tasks )) return NULL;
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if ((ptr = list_tail( &queue->tasks ))) list_remove( ptr );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return ptr ? LIST_ENTRY( ptr, struct threadpool_task, entry ) : NULL;
+}
+
+/* remove all queued tasks of an object, returns the number of tasks removed */
+static LONG tp_queue_cancel( struct threadpool_queue *queue, struct threadpool_object *object,
+                             struct list *cancelled )
+{
+    struct threadpool_task *task, *next;
+    LONG count = 0;
 
-    if (!work_item_event)
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    LIST_FOR_EACH_ENTRY_SAFE( task, next, &queue->tasks, struct threadpool_task, entry )
     {
-        HANDLE sem;
-        status = NtCreateSemaphore(&sem, SEMAPHORE_ALL_ACCESS, NULL, 1, INT_MAX);
-        if (interlocked_cmpxchg_ptr( &work_item_event, sem, 0 ))
-            NtClose(sem);  /* somebody beat us to it */
+        if (task->object != object) continue;
+        list_remove( &task->entry );
+        list_add_tail( cancelled, &task->entry );
+        count++;
     }
-    else
-        status = NtReleaseSemaphore(work_item_event, 1, NULL);
-
-    return status;
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return count;
 }
 
 /***********************************************************************
- *              RtlQueueWorkItem   (NTDLL.@)
- *
- * Queues a work item into a thread in the thread pool.
- *
- * PARAMS
- *  Function [I] Work function to execute.
- *  Context  [I] Context to pass to the work function when it is executed.
- *  Flags    [I] Flags. See notes.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ *           tp_new_worker_thread    (internal)
  *
- * NOTES
- *  Flags can be one or more of the following:
- *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
- *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
- *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
- *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
- *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ * Create and account a new worker thread for the desired pool.
+ * The pool critical section must be held by the caller.
  */
-NTSTATUS WINAPI RtlQueueWorkItem(PRTL_WORK_ITEM_ROUTINE Function, PVOID Context, ULONG Flags)
+static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
 {
+    struct threadpool_worker *worker;
     HANDLE thread;
     NTSTATUS status;
-    struct work_item *work_item = RtlAllocateHeap(GetProcessHeap(), 0, sizeof(struct work_item));
 
-    if (!work_item)
+    if (!(worker = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*worker) )))
         return STATUS_NO_MEMORY;
 
-    work_item->function = Function;
-    work_item->context = Context;
-
-    if (Flags & ~WT_EXECUTELONGFUNCTION)
-        FIXME("Flags 0x%x not supported\n", Flags);
-
-    status = add_work_item_to_queue(work_item);
-
-    /* FIXME: tune this algorithm to not be as aggressive with creating threads
-     * if WT_EXECUTELONGFUNCTION isn't specified */
-    if ((status == STATUS_SUCCESS) &&
-        ((num_workers == 0) || (num_workers == num_busy_workers)))
-    {
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE,
-                                    NULL, 0, 0,
-                                    worker_thread_proc, NULL, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-            NtClose( thread );
-
-        /* NOTE: we don't care if we couldn't create the thread if there is at
-         * least one other available to process the request */
-        if ((num_workers > 0) && (status != STATUS_SUCCESS))
-            status = STATUS_SUCCESS;
-    }
+    worker->pool = pool;
+    RtlInitializeSRWLock( &worker->queue.lock );
+    list_init( &worker->queue.tasks );
 
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, worker, &thread, NULL );
     if (status != STATUS_SUCCESS)
     {
-        RtlEnterCriticalSection(&threadpool_cs);
-
-        interlocked_dec(&num_work_items);
-        list_remove(&work_item->entry);
-        RtlFreeHeap(GetProcessHeap(), 0, work_item);
-
-        RtlLeaveCriticalSection(&threadpool_cs);
-
+        RtlFreeHeap( GetProcessHeap(), 0, worker );
         return status;
     }
 
+    interlocked_inc( &pool->refcount );
+    list_add_tail( &pool->workers, &worker->entry );
+    pool->num_workers++;
+    pool->num_busy_workers++;
+    NtClose( thread );
     return STATUS_SUCCESS;
 }
 
 /***********************************************************************
- * iocp_poller - get completion events and run callbacks
+ *           tp_pool_kick    (internal)
+ *
+ * Make sure somebody picks up the newly queued tasks, either by waking up
+ * an idle worker or by starting a new one.
  */
-static DWORD CALLBACK iocp_poller(LPVOID Arg)
+static void tp_pool_kick( struct threadpool *pool )
 {
-    while( TRUE )
+    /* the num_pending increment done by the caller is a full barrier,
+     * pairing with the num_idle_workers increment in the worker */
+    if (pool->num_idle_workers)
     {
-        PRTL_OVERLAPPED_COMPLETION_ROUTINE callback;
-        LPVOID overlapped;
-        IO_STATUS_BLOCK iosb;
-        NTSTATUS res = NtRemoveIoCompletion( compl_port, (PULONG_PTR)&callback, (PULONG_PTR)&overlapped, &iosb, NULL );
-        if (res)
-        {
-            ERR("NtRemoveIoCompletion failed: 0x%x\n", res);
-        }
-        else
-        {
-            DWORD transferred = 0;
-            DWORD err = 0;
-
-            if (iosb.u.Status == STATUS_SUCCESS)
-                transferred = iosb.Information;
-            else
-                err = RtlNtStatusToDosError(iosb.u.Status);
-
-            callback( err, transferred, overlapped );
-        }
+        RtlEnterCriticalSection( &pool->cs );
+        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    else if (pool->num_workers < pool->max_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_idle_workers && pool->num_workers < pool->max_workers &&
+            pool->num_busy_workers >= pool->num_workers)
+            tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    return 0;
 }
 
 /***********************************************************************
- *              RtlSetIoCompletionCallback  (NTDLL.@)
- *
- * Binds a handle to a thread pool's completion port, and possibly
- * starts a non-I/O thread to monitor this port and call functions back.
- *
- * PARAMS
- *  FileHandle [I] Handle to bind to a completion port.
- *  Function   [I] Callback function to call on I/O completions.
- *  Flags      [I] Not used.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ *           tp_threadpool_alloc    (internal)
  *
+ * Allocates a new threadpool object.
  */
-NTSTATUS WINAPI RtlSetIoCompletionCallback(HANDLE FileHandle, PRTL_OVERLAPPED_COMPLETION_ROUTINE Function, ULONG Flags)
+static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
-    IO_STATUS_BLOCK iosb;
-    FILE_COMPLETION_INFORMATION info;
+    struct threadpool *pool;
 
-    if (Flags) FIXME("Unknown value Flags=0x%x\n", Flags);
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    if (!pool)
+        return STATUS_NO_MEMORY;
 
-    if (!compl_port)
-    {
-        NTSTATUS res = STATUS_SUCCESS;
+    pool->refcount              = 1;
+    pool->objcount              = 0;
+    pool->shutdown              = FALSE;
 
-        RtlEnterCriticalSection(&threadpool_compl_cs);
-        if (!compl_port)
-        {
-            HANDLE cport;
+    RtlInitializeCriticalSection( &pool->cs );
+    pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-            res = NtCreateIoCompletion( &cport, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
-            if (!res)
-            {
-                /* FIXME native can start additional threads in case of e.g. hung callback function. */
-                res = RtlQueueWorkItem( iocp_poller, NULL, WT_EXECUTEDEFAULT );
-                if (!res)
-                    compl_port = cport;
-                else
-                    NtClose( cport );
-            }
-        }
-        RtlLeaveCriticalSection(&threadpool_compl_cs);
-        if (res) return res;
-    }
+    RtlInitializeSRWLock( &pool->queue.lock );
+    list_init( &pool->queue.tasks );
+    pool->num_pending           = 0;
+    list_init( &pool->workers );
+    RtlInitializeConditionVariable( &pool->update_event );
+    pool->num_idle_workers      = 0;
+    RtlInitializeConditionVariable( &pool->finished_event );
+    pool->num_object_waiters    = 0;
 
-    info.CompletionPort = compl_port;
-    info.CompletionKey = (ULONG_PTR)Function;
+    pool->max_workers           = 500;
+    pool->min_workers           = 0;
+    pool->num_workers           = 0;
+    pool->num_busy_workers      = 0;
 
-    return NtSetInformationFile( FileHandle, &iosb, &info, sizeof(info), FileCompletionInformation );
+    TRACE( "allocated threadpool %p\n", pool );
+
+    *out = pool;
+    return STATUS_SUCCESS;
 }
 
-static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
+/***********************************************************************
+ *           tp_threadpool_shutdown    (internal)
+ *
+ * Prepares the shutdown of a threadpool object and notifies all worker
+ * threads to terminate (after all remaining work items have been
+ * processed).
+ */
+static void tp_threadpool_shutdown( struct threadpool *pool )
 {
-    if (timeout == INFINITE) return NULL;
-    pTime->QuadPart = (ULONGLONG)timeout * -10000;
-    return pTime;
+    assert( pool != default_threadpool );
+
+    RtlEnterCriticalSection( &pool->cs );
+    pool->shutdown = TRUE;
+    RtlWakeAllConditionVariable( &pool->update_event );
+    RtlLeaveCriticalSection( &pool->cs );
 }
 
-struct wait_work_item
+/***********************************************************************
+ *           tp_threadpool_release    (internal)
+ *
+ * Releases a reference to a threadpool object.
+ */
+static BOOL tp_threadpool_release( struct threadpool *pool )
 {
-    HANDLE Object;
-    HANDLE CancelEvent;
-    WAITORTIMERCALLBACK Callback;
-    PVOID Context;
-    ULONG Milliseconds;
-    ULONG Flags;
-    HANDLE CompletionEvent;
-    LONG DeleteCount;
-    BOOLEAN CallbackInProgress;
-};
+    if (interlocked_dec( &pool->refcount ))
+        return FALSE;
 
-static void delete_wait_work_item(struct wait_work_item *wait_work_item)
-{
-    NtClose( wait_work_item->CancelEvent );
-    RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
+    TRACE( "destroying threadpool %p\n", pool );
+
+    assert( pool->shutdown );
+    assert( !pool->objcount );
+    assert( list_empty( &pool->queue.tasks ) );
+
+    pool->cs.DebugInfo->Spare[0] = 0;
+    RtlDeleteCriticalSection( &pool->cs );
+
+    RtlFreeHeap( GetProcessHeap(), 0, pool );
+    return TRUE;
 }
 
-static DWORD CALLBACK wait_thread_proc(LPVOID Arg)
+/***********************************************************************
+ *           tp_threadpool_lock    (internal)
+ *
+ * Acquires a lock on a threadpool, specified with an TP_CALLBACK_ENVIRON
+ * block. When the lock is acquired successfully, it is guaranteed that
+ * there is at least one worker thread to process tasks.
+ */
+static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON *environment )
 {
-    struct wait_work_item *wait_work_item = Arg;
-    NTSTATUS status;
-    BOOLEAN alertable = (wait_work_item->Flags & WT_EXECUTEINIOTHREAD) != 0;
-    HANDLE handles[2] = { wait_work_item->Object, wait_work_item->CancelEvent };
-    LARGE_INTEGER timeout;
-    HANDLE completion_event;
+    struct threadpool *pool = NULL;
+    NTSTATUS status = STATUS_SUCCESS;
 
-    TRACE("\n");
+    if (environment)
+        pool = (struct threadpool *)environment->Pool;
 
-    while (TRUE)
+    if (!pool)
     {
-        status = NtWaitForMultipleObjects( 2, handles, FALSE, alertable,
-                                           get_nt_timeout( &timeout, wait_work_item->Milliseconds ) );
-        if (status == STATUS_WAIT_0 || status == STATUS_TIMEOUT)
+        if (!default_threadpool)
         {
-            BOOLEAN TimerOrWaitFired;
+            status = tp_threadpool_alloc( &pool );
+            if (status != STATUS_SUCCESS)
+                return status;
 
-            if (status == STATUS_WAIT_0)
+            if (interlocked_cmpxchg_ptr( (void *)&default_threadpool, pool, NULL ) != NULL)
             {
-                TRACE( "object %p signaled, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = FALSE;
+                pool->shutdown = TRUE;
+                tp_threadpool_release( pool );
             }
-            else
-            {
-                TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = TRUE;
-            }
-            wait_work_item->CallbackInProgress = TRUE;
-            wait_work_item->Callback( wait_work_item->Context, TimerOrWaitFired );
-            wait_work_item->CallbackInProgress = FALSE;
-
-            if (wait_work_item->Flags & WT_EXECUTEONLYONCE)
-                break;
         }
-        else
-            break;
+
+        pool = default_threadpool;
     }
 
-    completion_event = wait_work_item->CompletionEvent;
-    if (completion_event) NtSetEvent( completion_event, NULL );
+    RtlEnterCriticalSection( &pool->cs );
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-        delete_wait_work_item( wait_work_item );
+    /* Make sure that the threadpool has at least one thread. */
+    if (!pool->num_workers)
+        status = tp_new_worker_thread( pool );
 
-    return 0;
+    /* Keep a reference, and increment objcount to ensure that the
+     * last thread doesn't terminate. */
+    if (status == STATUS_SUCCESS)
+    {
+        interlocked_inc( &pool->refcount );
+        pool->objcount++;
+    }
+
+    RtlLeaveCriticalSection( &pool->cs );
+
+    if (status != STATUS_SUCCESS)
+        return status;
+
+    *out = pool;
+    return STATUS_SUCCESS;
 }
 
 /***********************************************************************
- *              RtlRegisterWait   (NTDLL.@)
+ *           tp_threadpool_unlock    (internal)
  *
- * Registers a wait for a handle to become signaled.
- *
- * PARAMS
- *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
- *  Object   [I] Object to wait to become signaled.
- *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
- *  Context  [I] Context to pass to the callback function when it is executed.
- *  Milliseconds [I] Number of milliseconds to wait before timing out.
- *  Flags    [I] Flags. See notes.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- *
- * NOTES
- *  Flags can be one or more of the following:
- *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
- *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
- *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
- *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
- *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ * Releases a lock on a threadpool.
  */
-NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
-                                RTL_WAITORTIMERCALLBACKFUNC Callback,
-                                PVOID Context, ULONG Milliseconds, ULONG Flags)
+static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    struct wait_work_item *wait_work_item;
-    NTSTATUS status;
+    RtlEnterCriticalSection( &pool->cs );
+    pool->objcount--;
+    if (pool->shutdown && !pool->objcount) RtlWakeAllConditionVariable( &pool->update_event );
+    RtlLeaveCriticalSection( &pool->cs );
+    tp_threadpool_release( pool );
+}
 
-    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
+/***********************************************************************
+ *           tp_group_alloc    (internal)
+ *
+ * Allocates a new threadpool group object.
+ */
+static NTSTATUS tp_group_alloc( struct threadpool_group **out )
+{
+    struct threadpool_group *group;
 
-    wait_work_item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*wait_work_item) );
-    if (!wait_work_item)
+    group = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*group) );
+    if (!group)
         return STATUS_NO_MEMORY;
 
-    wait_work_item->Object = Object;
-    wait_work_item->Callback = Callback;
-    wait_work_item->Context = Context;
-    wait_work_item->Milliseconds = Milliseconds;
-    wait_work_item->Flags = Flags;
-    wait_work_item->CallbackInProgress = FALSE;
-    wait_work_item->DeleteCount = 0;
-    wait_work_item->CompletionEvent = NULL;
+    group->refcount     = 1;
+    group->shutdown     = FALSE;
 
-    status = NtCreateEvent( &wait_work_item->CancelEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-    if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
-        return status;
-    }
+    RtlInitializeCriticalSection( &group->cs );
+    group->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool_group.cs");
 
-    Flags = Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD |
-                     WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION);
-    status = RtlQueueWorkItem( wait_thread_proc, wait_work_item, Flags );
-    if (status != STATUS_SUCCESS)
-    {
-        delete_wait_work_item( wait_work_item );
-        return status;
-    }
+    list_init( &group->members );
 
-    *NewWaitObject = wait_work_item;
-    return status;
+    TRACE( "allocated group %p\n", group );
+
+    *out = group;
+    return STATUS_SUCCESS;
 }
 
 /***********************************************************************
- *              RtlDeregisterWaitEx   (NTDLL.@)
+ *           tp_group_shutdown    (internal)
  *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
+ * Marks the group object for shutdown.
+ */
+static void tp_group_shutdown( struct threadpool_group *group )
+{
+    group->shutdown = TRUE;
+}
+
+/***********************************************************************
+ *           tp_group_release    (internal)
  *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
+ * Releases a reference to a group object.
+ */
+static BOOL tp_group_release( struct threadpool_group *group )
+{
+    if (interlocked_dec( &group->refcount ))
+        return FALSE;
+
+    TRACE( "destroying group %p\n", group );
+
+    assert( group->shutdown );
+    assert( list_empty( &group->members ) );
+
+    group->cs.DebugInfo->Spare[0] = 0;
+    RtlDeleteCriticalSection( &group->cs );
+
+    RtlFreeHeap( GetProcessHeap(), 0, group );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_timerqueue_thread_proc    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ * Fires the pending timers of all pools; exits once no timer objects
+ * are left.
  */
-NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
+static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    struct wait_work_item *wait_work_item = WaitHandle;
-    NTSTATUS status = STATUS_SUCCESS;
+    ULONGLONG timeout_lower, timeout_upper, new_timeout;
+    struct threadpool_object *other_timer;
+    LARGE_INTEGER now, timeout;
+    struct list *ptr;
 
-    TRACE( "(%p)\n", WaitHandle );
+    TRACE( "starting timer queue thread\n" );
 
-    NtSetEvent( wait_work_item->CancelEvent, NULL );
-    if (wait_work_item->CallbackInProgress)
+    RtlEnterCriticalSection( &timerqueue.cs );
+    for (;;)
     {
-        if (CompletionEvent != NULL)
+        NtQuerySystemTime( &now );
+
+        /* Check for expired timers. */
+        while ((ptr = list_head( &timerqueue.pending_timers )))
         {
-            if (CompletionEvent == INVALID_HANDLE_VALUE)
-            {
-                status = NtCreateEvent( &CompletionEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-                if (status != STATUS_SUCCESS)
-                    return status;
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    NtWaitForSingleObject( CompletionEvent, FALSE, NULL );
-                NtClose( CompletionEvent );
-            }
-            else
+            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            assert( timer->type == TP_OBJECT_TYPE_TIMER );
+            assert( timer->u.timer.timer_pending );
+            if (timer->u.timer.timeout > now.QuadPart)
+                break;
+
+            /* Queue a new callback in one of the worker threads. */
+            list_remove( &timer->u.timer.timer_entry );
+            timer->u.timer.timer_pending = FALSE;
+            tp_object_submit( timer, NULL );
+
+            /* Insert the timer back into the queue, except it's marked for shutdown. */
+            if (timer->u.timer.period && !timer->shutdown)
             {
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    status = STATUS_PENDING;
+                timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
+                if (timer->u.timer.timeout <= now.QuadPart)
+                    timer->u.timer.timeout = now.QuadPart + 1;
+
+                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
+                                     struct threadpool_object, u.timer.timer_entry )
+                {
+                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
+                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
+                        break;
+                }
+                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
+                timer->u.timer.timer_pending = TRUE;
             }
         }
-        else
-            status = STATUS_PENDING;
-    }
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-    {
-        status = STATUS_SUCCESS;
-        delete_wait_work_item( wait_work_item );
+        timeout_lower = timeout_upper = MAXLONGLONG;
+
+        /* Determine next timeout and use the window length to optimize wakeup times. */
+        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
+                             struct threadpool_object, u.timer.timer_entry )
+        {
+            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
+            if (other_timer->u.timer.timeout >= timeout_upper)
+                break;
+
+            timeout_lower = other_timer->u.timer.timeout;
+            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
+            if (new_timeout < timeout_upper)
+                timeout_upper = new_timeout;
+        }
+
+        /* Wait for timer update events or until the next timer expires. */
+        if (timerqueue.objcount)
+        {
+            timeout.QuadPart = timeout_lower;
+            RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
+            continue;
+        }
+
+        /* All timers have been destroyed, if no new timers are created
+         * within some amount of time, then we can shutdown this thread. */
+        timeout.QuadPart = (ULONGLONG)WORKER_TIMEOUT * -10000;
+        if (RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs,
+            &timeout ) == STATUS_TIMEOUT && !timerqueue.objcount)
+        {
+            break;
+        }
     }
 
-    return status;
+    timerqueue.thread_running = FALSE;
+    RtlLeaveCriticalSection( &timerqueue.cs );
+
+    TRACE( "terminating timer queue thread\n" );
+    RtlExitUserThread( 0 );
 }
 
 /***********************************************************************
- *              RtlDeregisterWait   (NTDLL.@)
- *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
- *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
+ *           tp_timerqueue_lock    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ * Acquires a lock on the global timerqueue. When the lock is acquired
+ * successfully, it is guaranteed that the timer thread is running.
  */
-NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
+static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
 {
-    return RtlDeregisterWaitEx(WaitHandle, NULL);
-}
+    NTSTATUS status = STATUS_SUCCESS;
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
 
+    timer->u.timer.timer_initialized    = FALSE;
+    timer->u.timer.timer_pending        = FALSE;
+    timer->u.timer.timer_set            = FALSE;
+    timer->u.timer.timeout              = 0;
+    timer->u.timer.period               = 0;
+    timer->u.timer.window_length        = 0;
 
-/************************** Timer Queue Impl **************************/
+    RtlEnterCriticalSection( &timerqueue.cs );
 
-struct timer_queue;
-struct queue_timer
-{
-    struct timer_queue *q;
-    struct list entry;
-    ULONG runcount;             /* number of callbacks pending execution */
-    RTL_WAITORTIMERCALLBACKFUNC callback;
-    PVOID param;
-    DWORD period;
-    ULONG flags;
-    ULONGLONG expire;
-    BOOL destroy;      /* timer should be deleted; once set, never unset */
-    HANDLE event;      /* removal event */
-};
+    /* Make sure that the timerqueue thread is running. */
+    if (!timerqueue.thread_running)
+    {
+        HANDLE thread;
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      timerqueue_thread_proc, NULL, &thread, NULL );
+        if (status == STATUS_SUCCESS)
+        {
+            timerqueue.thread_running = TRUE;
+            NtClose( thread );
+        }
+    }
 
-struct timer_queue
-{
-    DWORD magic;
-    RTL_CRITICAL_SECTION cs;
-    struct list timers;          /* sorted by expiration time */
-    BOOL quit;         /* queue should be deleted; once set, never unset */
-    HANDLE event;
-    HANDLE thread;
-};
+    if (status == STATUS_SUCCESS)
+    {
+        timer->u.timer.timer_initialized = TRUE;
+        timerqueue.objcount++;
+    }
 
-#define EXPIRE_NEVER (~(ULONGLONG) 0)
-#define TIMER_QUEUE_MAGIC 0x516d6954  /* TimQ */
+    RtlLeaveCriticalSection( &timerqueue.cs );
+    return status;
+}
 
-static void queue_remove_timer(struct queue_timer *t)
+/***********************************************************************
+ *           tp_timerqueue_unlock    (internal)
+ *
+ * Releases a lock on the global timerqueue.
+ */
+static void tp_timerqueue_unlock( struct threadpool_object *timer )
 {
-    /* We MUST hold the queue cs while calling this function.  This ensures
-       that we cannot queue another callback for this timer.  The runcount
-       being zero makes sure we don't have any already queued.  */
-    struct timer_queue *q = t->q;
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
 
-    assert(t->runcount == 0);
-    assert(t->destroy);
+    RtlEnterCriticalSection( &timerqueue.cs );
+    if (timer->u.timer.timer_initialized)
+    {
+        /* If timer was pending, remove it. */
+        if (timer->u.timer.timer_pending)
+        {
+            list_remove( &timer->u.timer.timer_entry );
+            timer->u.timer.timer_pending = FALSE;
+        }
 
-    list_remove(&t->entry);
-    if (t->event)
-        NtSetEvent(t->event, NULL);
-    RtlFreeHeap(GetProcessHeap(), 0, t);
+        /* If the last timer object was destroyed, then wake up the thread. */
+        if (!--timerqueue.objcount)
+        {
+            assert( list_empty( &timerqueue.pending_timers ) );
+            RtlWakeAllConditionVariable( &timerqueue.update_event );
+        }
 
-    if (q->quit && list_empty(&q->timers))
-        NtSetEvent(q->event, NULL);
+        timer->u.timer.timer_initialized = FALSE;
+    }
+    RtlLeaveCriticalSection( &timerqueue.cs );
 }
 
-static void timer_cleanup_callback(struct queue_timer *t)
+/***********************************************************************
+ *           ioqueue_thread_proc    (internal)
+ *
+ * Dispatches completion packets of the shared port to the pools of
+ * the I/O objects.
+ */
+static void CALLBACK ioqueue_thread_proc( void *param )
 {
-    struct timer_queue *q = t->q;
-    RtlEnterCriticalSection(&q->cs);
+    struct threadpool_object *io;
+    struct threadpool_task data;
+    LARGE_INTEGER timeout;
+    ULONG_PTR key;
+    NTSTATUS status;
 
-    assert(0 < t->runcount);
-    --t->runcount;
+    TRACE( "starting I/O completion thread\n" );
 
-    if (t->destroy && t->runcount == 0)
-        queue_remove_timer(t);
+    for (;;)
+    {
+        timeout.QuadPart = (ULONGLONG)WORKER_TIMEOUT * -10000;
+        status = NtRemoveIoCompletion( ioqueue.port, &key, &data.io_value, &data.io_iosb, &timeout );
+        if (status == STATUS_TIMEOUT)
+        {
+            RtlEnterCriticalSection( &ioqueue.cs );
+            if (!ioqueue.objcount)
+            {
+                ioqueue.thread_running = FALSE;
+                RtlLeaveCriticalSection( &ioqueue.cs );
+                break;
+            }
+            RtlLeaveCriticalSection( &ioqueue.cs );
+            continue;
+        }
+        if (status)
+        {
+            ERR( "NtRemoveIoCompletion failed: 0x%x\n", status );
+            continue;
+        }
 
-    RtlLeaveCriticalSection(&q->cs);
-}
+        io = (struct threadpool_object *)key;
+        assert( io->type == TP_OBJECT_TYPE_IO );
+        if (!io->shutdown) tp_object_submit( io, &data );
 
-static DWORD WINAPI timer_callback_wrapper(LPVOID p)
-{
-    struct queue_timer *t = p;
-    t->callback(t->param, TRUE);
-    timer_cleanup_callback(t);
-    return 0;
-}
+        /* release the reference taken by TpStartAsyncIoOperation */
+        interlocked_dec( &io->u.io.pending_count );
+        tp_object_release( io );
+    }
 
-static inline ULONGLONG queue_current_time(void)
-{
-    LARGE_INTEGER now, freq;
-    NtQueryPerformanceCounter(&now, &freq);
-    return now.QuadPart * 1000 / freq.QuadPart;
+    TRACE( "terminating I/O completion thread\n" );
+    RtlExitUserThread( 0 );
 }
 
-static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
-                            BOOL set_event)
+/***********************************************************************
+ *           tp_ioqueue_lock    (internal)
+ *
+ * Binds a file to the global completion port and makes sure that the
+ * I/O completion thread is running.
+ */
+static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status = STATUS_SUCCESS;
 
-    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
+    RtlEnterCriticalSection( &ioqueue.cs );
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
+    if (!ioqueue.port)
+        status = NtCreateIoCompletion( &ioqueue.port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+
+    if (status == STATUS_SUCCESS)
+    {
+        info.CompletionPort = ioqueue.port;
+        info.CompletionKey  = (ULONG_PTR)io;
+        status = NtSetInformationFile( file, &iosb, &info, sizeof(info), FileCompletionInformation );
+    }
+
+    if (status == STATUS_SUCCESS && !ioqueue.thread_running)
+    {
+        HANDLE thread;
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      ioqueue_thread_proc, NULL, &thread, NULL );
+        if (status == STATUS_SUCCESS)
         {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
+            ioqueue.thread_running = TRUE;
+            NtClose( thread );
         }
-    list_add_before(ptr, &t->entry);
+    }
 
-    t->expire = time;
+    if (status == STATUS_SUCCESS) ioqueue.objcount++;
 
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
-        NtSetEvent(q->event, NULL);
+    RtlLeaveCriticalSection( &ioqueue.cs );
+    return status;
 }
 
-static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
-                                    BOOL set_event)
+/***********************************************************************
+ *           tp_ioqueue_unlock    (internal)
+ */
+static void tp_ioqueue_unlock( struct threadpool_object *io )
 {
-    /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
-    queue_add_timer(t, time, set_event);
+    RtlEnterCriticalSection( &ioqueue.cs );
+    ioqueue.objcount--;
+    RtlLeaveCriticalSection( &ioqueue.cs );
 }
 
-static void queue_timer_expire(struct timer_queue *q)
+/***********************************************************************
+ *           tp_waitqueue_trigger    (internal)
+ *
+ * Disarms a wait object which was signaled or timed out and queues its
+ * callback. Returns TRUE if the callback has to be executed on the wait
+ * thread instead. Must be called with waitqueue.cs held.
+ */
+static BOOL tp_waitqueue_trigger( struct threadpool_object *wait, TP_WAIT_RESULT result )
 {
-    struct queue_timer *t = NULL;
+    struct threadpool_task data;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    list_remove( &wait->u.wait.wait_entry );
+    list_add_tail( &wait->u.wait.bucket->reserved, &wait->u.wait.wait_entry );
+    wait->u.wait.wait_pending = FALSE;
+
+    if (wait->u.wait.flags & WT_EXECUTEINWAITTHREAD)
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
-        {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
-        }
-        else
-            t = NULL;
+        interlocked_inc( &wait->refcount );
+        interlocked_inc( &wait->num_outstanding );
+        return TRUE;
     }
-    RtlLeaveCriticalSection(&q->cs);
 
-    if (t)
-    {
-        if (t->flags & WT_EXECUTEINTIMERTHREAD)
-            timer_callback_wrapper(t);
-        else
-        {
-            ULONG flags
-                = (t->flags
-                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
-                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
-            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
-            if (status != STATUS_SUCCESS)
-                timer_cleanup_callback(t);
-        }
-    }
+    memset( &data, 0, sizeof(data) );
+    data.wait_result = result;
+    tp_object_submit( wait, &data );
+    return FALSE;
 }
 
-static ULONG queue_get_timeout(struct timer_queue *q)
+/***********************************************************************
+ *           tp_waitqueue_execute    (internal)
+ *
+ * Runs the callback of a wait object directly on the wait thread.
+ */
+static void tp_waitqueue_execute( struct threadpool_object *wait, TP_WAIT_RESULT result )
 {
-    struct queue_timer *t;
-    ULONG timeout = INFINITE;
+    struct threadpool_task task;
 
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    task.object      = wait;
+    task.wait_result = result;
+    tp_object_execute( &task );
+    tp_object_release( wait );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_check_handles    (internal)
+ *
+ * Disarms wait objects with invalid handles, which would otherwise make
+ * every wait of the bucket fail. Must be called with waitqueue.cs held.
+ */
+static void tp_waitqueue_check_handles( struct waitqueue_bucket *bucket )
+{
+    struct threadpool_object *wait, *next;
+    OBJECT_BASIC_INFORMATION info;
+    NTSTATUS status;
+
+    LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+        status = NtQueryObject( wait->u.wait.handle, ObjectBasicInformation, &info, sizeof(info), NULL );
+        if (!status) continue;
 
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ERR( "cannot wait for handle %p of wait object %p, status %x\n", wait->u.wait.handle, wait, status );
+        list_remove( &wait->u.wait.wait_entry );
+        list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+        wait->u.wait.wait_pending = FALSE;
     }
-    RtlLeaveCriticalSection(&q->cs);
+}
 
-    return timeout;
+/***********************************************************************
+ *           tp_waitqueue_get_expired    (internal)
+ */
+static struct threadpool_object *tp_waitqueue_get_expired( struct waitqueue_bucket *bucket, ULONGLONG now )
+{
+    struct threadpool_object *wait;
+
+    LIST_FOR_EACH_ENTRY( wait, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
+    {
+        assert( wait->type == TP_OBJECT_TYPE_WAIT );
+        if (wait->u.wait.timeout <= now) return wait;
+    }
+    return NULL;
 }
 
-static void WINAPI timer_queue_thread_proc(LPVOID p)
+/***********************************************************************
+ *           waitqueue_thread_proc    (internal)
+ *
+ * Waits for all armed wait objects of a bucket with a single call to
+ * NtWaitForMultipleObjects; exits once the bucket stays empty.
+ */
+static void CALLBACK waitqueue_thread_proc( void *param )
 {
-    struct timer_queue *q = p;
-    ULONG timeout_ms;
+    struct threadpool_object *objects[MAXIMUM_WAITQUEUE_OBJECTS];
+    HANDLE handles[MAXIMUM_WAITQUEUE_OBJECTS + 1];
+    struct waitqueue_bucket *bucket = param;
+    struct threadpool_object *wait;
+    LARGE_INTEGER now, timeout, zero;
+    ULONGLONG next_timeout;
+    TP_WAIT_RESULT result;
+    DWORD num_handles, i;
+    NTSTATUS status;
 
-    timeout_ms = INFINITE;
+    TRACE( "starting wait queue thread\n" );
+
+    zero.QuadPart = 0;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
     for (;;)
     {
-        LARGE_INTEGER timeout;
-        NTSTATUS status;
-        BOOL done = FALSE;
+        /* Check for expired waits, the object might have been signaled in the meantime. */
+        NtQuerySystemTime( &now );
+        while ((wait = tp_waitqueue_get_expired( bucket, now.QuadPart )))
+        {
+            status = NtWaitForSingleObject( wait->u.wait.handle, FALSE, &zero );
+            if (status == STATUS_WAIT_0 || status == STATUS_ABANDONED_WAIT_0)
+                result = WAIT_OBJECT_0;
+            else
+                result = WAIT_TIMEOUT;
 
-        status = NtWaitForSingleObject(
-            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
+            if (tp_waitqueue_trigger( wait, result ))
+            {
+                RtlLeaveCriticalSection( &waitqueue.cs );
+                tp_waitqueue_execute( wait, result );
+                RtlEnterCriticalSection( &waitqueue.cs );
+                NtQuerySystemTime( &now );
+            }
+        }
 
-        if (status == STATUS_WAIT_0)
+        next_timeout = MAXLONGLONG;
+        num_handles  = 0;
+
+        LIST_FOR_EACH_ENTRY( wait, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
         {
-            /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
-               our timeout.  */
-            RtlEnterCriticalSection(&q->cs);
-            if (q->quit && list_empty(&q->timers))
-                done = TRUE;
-            RtlLeaveCriticalSection(&q->cs);
+            if (wait->u.wait.timeout < next_timeout)
+                next_timeout = wait->u.wait.timeout;
+
+            /* keep the object alive while the wait is in progress */
+            interlocked_inc( &wait->refcount );
+            objects[num_handles] = wait;
+            handles[num_handles++] = wait->u.wait.handle;
         }
-        else if (status == STATUS_TIMEOUT)
-            queue_timer_expire(q);
 
-        if (done)
-            break;
+        if (!bucket->objcount)
+        {
+            /* All wait objects have been destroyed or moved to other buckets, if no new
+             * objects are assigned within some amount of time, then we can shutdown this thread. */
+            assert( !num_handles );
+            RtlLeaveCriticalSection( &waitqueue.cs );
+            timeout.QuadPart = (ULONGLONG)WORKER_TIMEOUT * -10000;
+            status = NtWaitForSingleObject( bucket->update_event, FALSE, &timeout );
+            RtlEnterCriticalSection( &waitqueue.cs );
+
+            if (status == STATUS_TIMEOUT && !bucket->objcount)
+                break;
+            continue;
+        }
 
-        timeout_ms = queue_get_timeout(q);
+        handles[num_handles] = bucket->update_event;
+        timeout.QuadPart = next_timeout;
+
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        status = NtWaitForMultipleObjects( num_handles + 1, handles, FALSE, FALSE,
+                                           next_timeout == MAXLONGLONG ? NULL : &timeout );
+        RtlEnterCriticalSection( &waitqueue.cs );
+
+        if (status >= STATUS_WAIT_0 && status < STATUS_WAIT_0 + num_handles)
+            i = status - STATUS_WAIT_0;
+        else if (status >= STATUS_ABANDONED_WAIT_0 && status < STATUS_ABANDONED_WAIT_0 + num_handles)
+            i = status - STATUS_ABANDONED_WAIT_0;
+        else
+            i = num_handles;
+
+        if (i < num_handles)
+        {
+            /* The object may have been disarmed, re-armed or moved to another bucket in the
+             * meantime. As long as it is still armed the signal belongs to it, wherever it is. */
+            wait = objects[i];
+            if (wait->u.wait.bucket && wait->u.wait.wait_pending && wait->u.wait.handle == handles[i])
+            {
+                if (tp_waitqueue_trigger( wait, WAIT_OBJECT_0 ))
+                {
+                    RtlLeaveCriticalSection( &waitqueue.cs );
+                    tp_waitqueue_execute( wait, WAIT_OBJECT_0 );
+                    RtlEnterCriticalSection( &waitqueue.cs );
+                }
+            }
+            else
+                WARN( "wait object %p triggered while it was not armed\n", wait );
+        }
+        else if (status != STATUS_WAIT_0 + num_handles && status != STATUS_TIMEOUT)
+        {
+            tp_waitqueue_check_handles( bucket );
+        }
+
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        for (i = 0; i < num_handles; i++)
+            tp_object_release( objects[i] );
+        RtlEnterCriticalSection( &waitqueue.cs );
     }
 
-    NtClose(q->event);
-    RtlDeleteCriticalSection(&q->cs);
-    q->magic = 0;
-    RtlFreeHeap(GetProcessHeap(), 0, q);
-}
+    list_remove( &bucket->bucket_entry );
+    waitqueue.num_buckets--;
+    RtlLeaveCriticalSection( &waitqueue.cs );
 
-static void queue_destroy_timer(struct queue_timer *t)
-{
-    /* We MUST hold the queue cs while calling this function.  */
-    t->destroy = TRUE;
-    if (t->runcount == 0)
-        /* Ensure a timer is promptly removed.  If callbacks are pending,
-           it will be removed after the last one finishes by the callback
-           cleanup wrapper.  */
-        queue_remove_timer(t);
-    else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
-        queue_move_timer(t, EXPIRE_NEVER, FALSE);
+    NtClose( bucket->update_event );
+    RtlFreeHeap( GetProcessHeap(), 0, bucket );
+
+    TRACE( "terminating wait queue thread\n" );
+    RtlExitUserThread( 0 );
 }
 
 /***********************************************************************
- *              RtlCreateTimerQueue   (NTDLL.@)
- *
- * Creates a timer queue object and returns a handle to it.
- *
- * PARAMS
- *  NewTimerQueue [O] The newly created queue.
+ *           tp_waitqueue_lock    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ * Assigns a wait object to a bucket, starting a new wait thread when all
+ * buckets are full.
  */
-NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
+static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
 {
-    NTSTATUS status;
-    struct timer_queue *q = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *q);
-    if (!q)
-        return STATUS_NO_MEMORY;
+    struct waitqueue_bucket *bucket, *best = NULL;
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+    assert( wait->type == TP_OBJECT_TYPE_WAIT );
 
-    RtlInitializeCriticalSection(&q->cs);
-    list_init(&q->timers);
-    q->quit = FALSE;
-    q->magic = TIMER_QUEUE_MAGIC;
-    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-    if (status != STATUS_SUCCESS)
+    wait->u.wait.completion_event   = NULL;
+    wait->u.wait.bucket             = NULL;
+    wait->u.wait.wait_pending       = FALSE;
+    wait->u.wait.timeout            = 0;
+    wait->u.wait.handle             = NULL;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+
+    /* Fill up the fullest bucket first, so that the number of wait threads stays minimal. */
+    LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
     {
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
+        if (bucket->objcount >= MAXIMUM_WAITQUEUE_OBJECTS) continue;
+        if (!best || bucket->objcount > best->objcount) best = bucket;
     }
-    status = RtlCreateUserThread(GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                 timer_queue_thread_proc, q, &q->thread, NULL);
-    if (status != STATUS_SUCCESS)
+
+    if (!best)
     {
-        NtClose(q->event);
-        RtlFreeHeap(GetProcessHeap(), 0, q);
-        return status;
+        if (!(best = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*best) )))
+        {
+            status = STATUS_NO_MEMORY;
+            goto done;
+        }
+
+        best->objcount = 0;
+        list_init( &best->reserved );
+        list_init( &best->waiting );
+
+        status = NtCreateEvent( &best->update_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+        if (status)
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, best );
+            goto done;
+        }
+
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      waitqueue_thread_proc, best, &thread, NULL );
+        if (status)
+        {
+            NtClose( best->update_event );
+            RtlFreeHeap( GetProcessHeap(), 0, best );
+            goto done;
+        }
+        NtClose( thread );
+
+        list_add_tail( &waitqueue.buckets, &best->bucket_entry );
+        waitqueue.num_buckets++;
+        TRACE( "created wait queue bucket %p, %d buckets\n", best, waitqueue.num_buckets );
     }
 
-    *NewTimerQueue = q;
-    return STATUS_SUCCESS;
+    best->objcount++;
+    wait->u.wait.bucket = best;
+    list_add_tail( &best->reserved, &wait->u.wait.wait_entry );
+
+done:
+    RtlLeaveCriticalSection( &waitqueue.cs );
+    return status;
 }
 
 /***********************************************************************
- *              RtlDeleteTimerQueueEx   (NTDLL.@)
- *
- * Deletes a timer queue object.
- *
- * PARAMS
- *  TimerQueue      [I] The timer queue to destroy.
- *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
- *                      wait until all timers are finished firing before
- *                      returning.  Otherwise, return immediately and set the
- *                      event when all timers are done.
+ *           tp_waitqueue_rebalance    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS if synchronous, STATUS_PENDING if not.
- *  Failure: Any NTSTATUS code.
+ * Moves the wait objects of a sparsely used bucket into a fuller one with
+ * enough free slots, so that the thread of the emptied bucket can exit.
+ * Must be called with waitqueue.cs held.
  */
-NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
+static void tp_waitqueue_rebalance( struct waitqueue_bucket *bucket )
 {
-    struct timer_queue *q = TimerQueue;
-    struct queue_timer *t, *temp;
-    HANDLE thread;
-    NTSTATUS status;
+    struct threadpool_object *wait, *next;
+    struct waitqueue_bucket *other;
 
-    if (!q || q->magic != TIMER_QUEUE_MAGIC)
-        return STATUS_INVALID_HANDLE;
+    if (!bucket->objcount || bucket->objcount > MAXIMUM_WAITQUEUE_OBJECTS / 2)
+        return;
 
-    thread = q->thread;
+    LIST_FOR_EACH_ENTRY( other, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
+    {
+        if (other == bucket || other->objcount < bucket->objcount) continue;
+        if (other->objcount + bucket->objcount > MAXIMUM_WAITQUEUE_OBJECTS) continue;
 
-    RtlEnterCriticalSection(&q->cs);
-    q->quit = TRUE;
-    if (list_head(&q->timers))
-        /* When the last timer is removed, it will signal the timer thread to
-           exit...  */
-        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
-            queue_destroy_timer(t);
-    else
-        /* However if we have none, we must do it ourselves.  */
-        NtSetEvent(q->event, NULL);
-    RtlLeaveCriticalSection(&q->cs);
+        TRACE( "moving %d wait objects from bucket %p to %p\n", bucket->objcount, bucket, other );
 
-    if (CompletionEvent == INVALID_HANDLE_VALUE)
-    {
-        NtWaitForSingleObject(thread, FALSE, NULL);
-        status = STATUS_SUCCESS;
-    }
-    else
-    {
-        if (CompletionEvent)
+        LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->reserved, struct threadpool_object, u.wait.wait_entry )
         {
-            FIXME("asynchronous return on completion event unimplemented\n");
-            NtWaitForSingleObject(thread, FALSE, NULL);
-            NtSetEvent(CompletionEvent, NULL);
+            list_remove( &wait->u.wait.wait_entry );
+            list_add_tail( &other->reserved, &wait->u.wait.wait_entry );
+            wait->u.wait.bucket = other;
+        }
+        LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
+        {
+            list_remove( &wait->u.wait.wait_entry );
+            list_add_tail( &other->waiting, &wait->u.wait.wait_entry );
+            wait->u.wait.bucket = other;
         }
-        status = STATUS_PENDING;
-    }
 
-    NtClose(thread);
-    return status;
+        other->objcount += bucket->objcount;
+        bucket->objcount = 0;
+        NtSetEvent( other->update_event, NULL );
+        NtSetEvent( bucket->update_event, NULL );
+        return;
+    }
 }
 
-static struct timer_queue *default_timer_queue;
-
-static struct timer_queue *get_timer_queue(HANDLE TimerQueue)
+/***********************************************************************
+ *           tp_waitqueue_unlock    (internal)
+ *
+ * Removes a wait object from its bucket.
+ */
+static void tp_waitqueue_unlock( struct threadpool_object *wait )
 {
-    if (TimerQueue)
-        return TimerQueue;
-    else
+    struct waitqueue_bucket *bucket;
+    assert( wait->type == TP_OBJECT_TYPE_WAIT );
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    if ((bucket = wait->u.wait.bucket))
     {
-        if (!default_timer_queue)
-        {
-            HANDLE q;
-            NTSTATUS status = RtlCreateTimerQueue(&q);
-            if (status == STATUS_SUCCESS)
-            {
-                PVOID p = interlocked_cmpxchg_ptr(
-                    (void **) &default_timer_queue, q, NULL);
-                if (p)
-                    /* Got beat to the punch.  */
-                    RtlDeleteTimerQueueEx(q, NULL);
-            }
-        }
-        return default_timer_queue;
+        assert( bucket->objcount > 0 );
+
+        list_remove( &wait->u.wait.wait_entry );
+        wait->u.wait.bucket = NULL;
+        wait->u.wait.wait_pending = FALSE;
+        bucket->objcount--;
+
+        NtSetEvent( bucket->update_event, NULL );
+        tp_waitqueue_rebalance( bucket );
     }
+    RtlLeaveCriticalSection( &waitqueue.cs );
 }
 
 /***********************************************************************
- *              RtlCreateTimer   (NTDLL.@)
+ *           tp_waitqueue_arm    (internal)
  *
- * Creates a new timer associated with the given queue.
+ * Arms or disarms a wait object. Timeouts are absolute system times,
+ * MAXLONGLONG waits forever. Must be called with waitqueue.cs held.
+ */
+static void tp_waitqueue_arm( struct threadpool_object *wait, HANDLE handle, ULONGLONG timeout )
+{
+    struct waitqueue_bucket *bucket = wait->u.wait.bucket;
+
+    if (!handle && !wait->u.wait.wait_pending)
+        return;
+
+    list_remove( &wait->u.wait.wait_entry );
+    wait->u.wait.handle = handle;
+
+    if (handle)
+    {
+        wait->u.wait.timeout = timeout;
+        list_add_tail( &bucket->waiting, &wait->u.wait.wait_entry );
+        wait->u.wait.wait_pending = TRUE;
+    }
+    else
+    {
+        list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+        wait->u.wait.wait_pending = FALSE;
+    }
+
+    /* Wake up the wait thread, so that it picks up the new handle list. */
+    NtSetEvent( bucket->update_event, NULL );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_rearm    (internal)
  *
- * PARAMS
- *  NewTimer   [O] The newly created timer.
- *  TimerQueue [I] The queue to hold the timer.
- *  Callback   [I] The callback to fire.
- *  Parameter  [I] The argument for the callback.
- *  DueTime    [I] The delay, in milliseconds, before first firing the
- *                 timer.
- *  Period     [I] The period, in milliseconds, at which to fire the timer
- *                 after the first callback.  If zero, the timer will only
- *                 fire once.  It still needs to be deleted with
- *                 RtlDeleteTimer.
- * Flags       [I] Flags controlling the execution of the callback.  In
- *                 addition to the WT_* thread pool flags (see
- *                 RtlQueueWorkItem), WT_EXECUTEINTIMERTHREAD and
- *                 WT_EXECUTEONLYONCE are supported.
+ * Re-arms a repeating wait registered with RtlRegisterWait once its
+ * callback has returned.
+ */
+static void tp_waitqueue_rearm( struct threadpool_object *wait )
+{
+    LARGE_INTEGER now;
+    ULONGLONG timeout = MAXLONGLONG;
+
+    if (wait->u.wait.flags & WT_EXECUTEONLYONCE)
+        return;
+
+    if (wait->u.wait.rtl_timeout != INFINITE)
+    {
+        NtQuerySystemTime( &now );
+        timeout = now.QuadPart + (ULONGLONG)wait->u.wait.rtl_timeout * 10000;
+    }
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    if (wait->u.wait.bucket && !wait->u.wait.wait_pending && wait->u.wait.handle)
+        tp_waitqueue_arm( wait, wait->u.wait.handle, timeout );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
+
+/***********************************************************************
+ *           tp_object_initialize    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ * Initializes members of a threadpool object.
  */
-NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
-                               RTL_WAITORTIMERCALLBACKFUNC Callback,
-                               PVOID Parameter, DWORD DueTime, DWORD Period,
-                               ULONG Flags)
+static void tp_object_initialize( struct threadpool_object *object, struct threadpool *pool,
+                                  PVOID userdata, TP_CALLBACK_ENVIRON *environment )
 {
-    NTSTATUS status;
-    struct queue_timer *t;
-    struct timer_queue *q = get_timer_queue(TimerQueue);
+    BOOL is_simple_callback = (object->type == TP_OBJECT_TYPE_SIMPLE);
 
-    if (!q) return STATUS_NO_MEMORY;
-    if (q->magic != TIMER_QUEUE_MAGIC) return STATUS_INVALID_HANDLE;
+    object->win32_callback          = NULL;
+    object->refcount                = 1;
+    object->shutdown                = FALSE;
 
-    t = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *t);
-    if (!t)
-        return STATUS_NO_MEMORY;
+    object->pool                    = pool;
+    object->group                   = NULL;
+    object->userdata                = userdata;
+    object->group_cancel_callback   = NULL;
+    object->finalization_callback   = NULL;
+    object->may_run_long            = 0;
+    object->race_dll                = NULL;
 
-    t->q = q;
-    t->runcount = 0;
-    t->callback = Callback;
-    t->param = Parameter;
-    t->period = Period;
-    t->flags = Flags;
-    t->destroy = FALSE;
-    t->event = NULL;
+    memset( &object->group_entry, 0, sizeof(object->group_entry) );
+    object->is_group_member         = FALSE;
 
-    status = STATUS_SUCCESS;
-    RtlEnterCriticalSection(&q->cs);
-    if (q->quit)
-        status = STATUS_INVALID_HANDLE;
-    else
-        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
-    RtlLeaveCriticalSection(&q->cs);
+    object->num_outstanding         = 0;
 
-    if (status == STATUS_SUCCESS)
-        *NewTimer = t;
-    else
-        RtlFreeHeap(GetProcessHeap(), 0, t);
+    if (environment)
+    {
+        if (environment->Version != 1)
+            FIXME( "unsupported environment version %u\n", environment->Version );
 
-    return status;
+        object->group = impl_from_TP_CLEANUP_GROUP( environment->CleanupGroup );
+        object->group_cancel_callback   = environment->CleanupGroupCancelCallback;
+        object->finalization_callback   = environment->FinalizationCallback;
+        object->may_run_long            = environment->u.s.LongFunction != 0;
+        object->race_dll                = environment->RaceDll;
+
+        if (environment->ActivationContext)
+            FIXME( "activation context not supported yet\n" );
+
+        if (environment->u.s.Persistent)
+            FIXME( "persistent threads not supported yet\n" );
+    }
+
+    if (object->race_dll)
+        LdrAddRefDll( 0, object->race_dll );
+
+    TRACE( "allocated object %p of type %u\n", object, object->type );
+
+    /* For simple callbacks we have to run tp_object_submit before adding this object
+     * to the cleanup group. As soon as the cleanup group members are released ->shutdown
+     * will be set, and tp_object_submit would fail with an assertion. */
+
+    if (is_simple_callback)
+        tp_object_submit( object, NULL );
+
+    if (object->group)
+    {
+        struct threadpool_group *group = object->group;
+        interlocked_inc( &group->refcount );
+
+        RtlEnterCriticalSection( &group->cs );
+        list_add_tail( &group->members, &object->group_entry );
+        object->is_group_member = TRUE;
+        RtlLeaveCriticalSection( &group->cs );
+    }
+
+    if (is_simple_callback)
+    {
+        tp_object_shutdown( object );
+        tp_object_release( object );
+    }
 }
 
 /***********************************************************************
- *              RtlUpdateTimer   (NTDLL.@)
+ *           tp_object_submit    (internal)
  *
- * Changes the time at which a timer expires.
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, const struct threadpool_task *data )
+{
+    struct threadpool *pool = object->pool;
+    struct threadpool_worker *worker = get_current_worker();
+    struct threadpool_task *task;
+
+    assert( !object->shutdown );
+
+    if (!(task = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*task) )))
+    {
+        ERR( "out of memory, dropping callback for object %p\n", object );
+        return;
+    }
+    if (data) *task = *data;
+    task->object = object;
+
+    interlocked_inc( &object->refcount );
+    interlocked_inc( &object->num_outstanding );
+
+    /* tasks posted from a worker of the same pool stay local to that worker */
+    if (worker && worker->pool == pool)
+        tp_queue_push( &worker->queue, task );
+    else
+        tp_queue_push( &pool->queue, task );
+
+    interlocked_inc( &pool->num_pending );
+    tp_pool_kick( pool );
+}
+
+/***********************************************************************
+ *           tp_object_finished    (internal)
  *
- * PARAMS
- *  TimerQueue [I] The queue that holds the timer.
- *  Timer      [I] The timer to update.
- *  DueTime    [I] The delay, in milliseconds, before next firing the timer.
- *  Period     [I] The period, in milliseconds, at which to fire the timer
- *                 after the first callback.  If zero, the timer will not
- *                 refire once.  It still needs to be deleted with
- *                 RtlDeleteTimer.
+ * Accounts for a callback that completed, was cancelled, or was
+ * disassociated from its object.
+ */
+static void tp_object_finished( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+
+    /* the decrement is a full barrier, pairing with the waiter increment */
+    if (!interlocked_dec( &object->num_outstanding ) && pool->num_object_waiters)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        RtlWakeAllConditionVariable( &pool->finished_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+}
+
+/***********************************************************************
+ *           tp_object_cancel    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
+ * Cancels all currently pending callbacks for a specific object.
  */
-NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
-                               DWORD DueTime, DWORD Period)
+static void tp_object_cancel( struct threadpool_object *object, BOOL group_cancel, PVOID userdata )
 {
-    struct queue_timer *t = Timer;
-    struct timer_queue *q = t->q;
+    struct threadpool *pool = object->pool;
+    struct threadpool_worker *worker;
+    struct threadpool_task *task, *next;
+    struct list cancelled = LIST_INIT( cancelled );
+    LONG count;
+
+    RtlEnterCriticalSection( &pool->cs );
+    count = tp_queue_cancel( &pool->queue, object, &cancelled );
+    LIST_FOR_EACH_ENTRY( worker, &pool->workers, struct threadpool_worker, entry )
+        count += tp_queue_cancel( &worker->queue, object, &cancelled );
+    interlocked_xchg_add( &pool->num_pending, -count );
+    RtlLeaveCriticalSection( &pool->cs );
+
+    /* Execute group cancellation callback if defined, and if this was actually a group cancel. */
+    if (count && group_cancel && object->group_cancel_callback)
+    {
+        TRACE( "executing group cancel callback %p(%p, %p)\n", object->group_cancel_callback, object, userdata );
+        object->group_cancel_callback( object->userdata, userdata );
+        TRACE( "callback %p returned\n", object->group_cancel_callback );
+    }
 
-    RtlEnterCriticalSection(&q->cs);
-    /* Can't change a timer if it was once-only or destroyed.  */
-    if (t->expire != EXPIRE_NEVER)
+    LIST_FOR_EACH_ENTRY_SAFE( task, next, &cancelled, struct threadpool_task, entry )
     {
-        t->period = Period;
-        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
+        RtlFreeHeap( GetProcessHeap(), 0, task );
+        tp_object_finished( object );
+        tp_object_release( object );
     }
-    RtlLeaveCriticalSection(&q->cs);
+}
 
-    return STATUS_SUCCESS;
+/***********************************************************************
+ *           tp_object_wait    (internal)
+ *
+ * Waits until all pending and running callbacks of a specific object
+ * have been processed.
+ */
+static void tp_object_wait( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+
+    RtlEnterCriticalSection( &pool->cs );
+    interlocked_inc( &pool->num_object_waiters );
+    while (object->num_outstanding)
+        RtlSleepConditionVariableCS( &pool->finished_event, &pool->cs, NULL );
+    interlocked_dec( &pool->num_object_waiters );
+    RtlLeaveCriticalSection( &pool->cs );
 }
 
 /***********************************************************************
- *              RtlDeleteTimer   (NTDLL.@)
+ *           tp_object_shutdown    (internal)
  *
- * Cancels a timer-queue timer.
+ * Marks a threadpool object for shutdown (which means that no further
+ * tasks can be submitted).
+ */
+static void tp_object_shutdown( struct threadpool_object *object )
+{
+    if (object->type == TP_OBJECT_TYPE_TIMER)
+        tp_timerqueue_unlock( object );
+    else if (object->type == TP_OBJECT_TYPE_WAIT)
+        tp_waitqueue_unlock( object );
+    else if (object->type == TP_OBJECT_TYPE_IO)
+        tp_ioqueue_unlock( object );
+
+    object->shutdown = TRUE;
+}
+
+/***********************************************************************
+ *           tp_object_release    (internal)
  *
- * PARAMS
- *  TimerQueue      [I] The queue that holds the timer.
- *  Timer           [I] The timer to update.
- *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
- *                      wait until the timer is finished firing all pending
- *                      callbacks before returning.  Otherwise, return
- *                      immediately and set the timer is done.
+ * Releases a reference to a threadpool object.
+ */
+static BOOL tp_object_release( struct threadpool_object *object )
+{
+    if (interlocked_dec( &object->refcount ))
+        return FALSE;
+
+    TRACE( "destroying object %p of type %u\n", object, object->type );
+
+    assert( object->shutdown );
+    assert( !object->num_outstanding );
+
+    /* release reference to the group */
+    if (object->group)
+    {
+        struct threadpool_group *group = object->group;
+
+        RtlEnterCriticalSection( &group->cs );
+        if (object->is_group_member)
+        {
+            list_remove( &object->group_entry );
+            object->is_group_member = FALSE;
+        }
+        RtlLeaveCriticalSection( &group->cs );
+
+        tp_group_release( group );
+    }
+
+    tp_threadpool_unlock( object->pool );
+
+    if (object->race_dll)
+        LdrUnloadDll( object->race_dll );
+
+    /* signal the event passed to RtlDeregisterWaitEx */
+    if (object->type == TP_OBJECT_TYPE_WAIT && object->u.wait.completion_event)
+        NtSetEvent( object->u.wait.completion_event, NULL );
+
+    RtlFreeHeap( GetProcessHeap(), 0, object );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_object_execute    (internal)
  *
- * RETURNS
- *  Success: STATUS_SUCCESS if the timer is done, STATUS_PENDING if not,
-             or if the completion event is NULL.
- *  Failure: Any NTSTATUS code.
+ * Runs a single callback on the current worker thread.
  */
-NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
-                               HANDLE CompletionEvent)
+static void tp_object_execute( struct threadpool_task *task )
 {
-    struct queue_timer *t = Timer;
-    struct timer_queue *q;
-    NTSTATUS status = STATUS_PENDING;
-    HANDLE event = NULL;
+    struct threadpool_object *object = task->object;
+    struct threadpool_instance instance;
+    TP_CALLBACK_INSTANCE *callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
+    NTSTATUS status;
 
-    if (!Timer)
-        return STATUS_INVALID_PARAMETER_1;
-    q = t->q;
-    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    instance.object                     = object;
+    instance.threadid                   = GetCurrentThreadId();
+    instance.associated                 = TRUE;
+    instance.may_run_long               = object->may_run_long;
+    instance.cleanup.critical_section   = NULL;
+    instance.cleanup.mutex              = NULL;
+    instance.cleanup.semaphore          = NULL;
+    instance.cleanup.semaphore_count    = 0;
+    instance.cleanup.event              = NULL;
+    instance.cleanup.library            = NULL;
+
+    switch (object->type)
     {
-        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-        if (status == STATUS_SUCCESS)
-            status = STATUS_PENDING;
+        case TP_OBJECT_TYPE_SIMPLE:
+        {
+            TRACE( "executing simple callback %p(%p, %p)\n",
+                   object->u.simple.callback, callback_instance, object->userdata );
+            object->u.simple.callback( callback_instance, object->userdata );
+            TRACE( "callback %p returned\n", object->u.simple.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WORK:
+        {
+            TRACE( "executing work callback %p(%p, %p, %p)\n",
+                   object->u.work.callback, callback_instance, object->userdata, object );
+            object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
+            TRACE( "callback %p returned\n", object->u.work.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_TIMER:
+        {
+            TRACE( "executing timer callback %p(%p, %p, %p)\n",
+                   object->u.timer.callback, callback_instance, object->userdata, object );
+            object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
+            TRACE( "callback %p returned\n", object->u.timer.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WAIT:
+        {
+            TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
+                   object->u.wait.callback, callback_instance, object->userdata, object, task->wait_result );
+            object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, task->wait_result );
+            TRACE( "callback %p returned\n", object->u.wait.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_IO:
+        {
+            TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
+                   object->u.io.callback, callback_instance, object->userdata,
+                   task->io_value, &task->io_iosb, object );
+            object->u.io.callback( callback_instance, object->userdata,
+                                   (void *)task->io_value, &task->io_iosb, (TP_IO *)object );
+            TRACE( "callback %p returned\n", object->u.io.callback );
+            break;
+        }
+
+        default:
+            assert(0);
+            break;
     }
-    else if (CompletionEvent)
-        event = CompletionEvent;
 
-    RtlEnterCriticalSection(&q->cs);
-    t->event = event;
-    if (t->runcount == 0 && event)
-        status = STATUS_SUCCESS;
-    queue_destroy_timer(t);
-    RtlLeaveCriticalSection(&q->cs);
+    /* Execute finalization callback. */
+    if (object->finalization_callback)
+    {
+        TRACE( "executing finalization callback %p(%p, %p)\n",
+               object->finalization_callback, callback_instance, object->userdata );
+        object->finalization_callback( callback_instance, object->userdata );
+        TRACE( "callback %p returned\n", object->finalization_callback );
+    }
 
-    if (CompletionEvent == INVALID_HANDLE_VALUE && event)
+    /* Execute cleanup tasks. */
+    if (instance.cleanup.critical_section)
     {
-        if (status == STATUS_PENDING)
+        RtlLeaveCriticalSection( instance.cleanup.critical_section );
+    }
+    if (instance.cleanup.mutex)
+    {
+        status = NtReleaseMutant( instance.cleanup.mutex, NULL );
+        if (status != STATUS_SUCCESS) goto skip_cleanup;
+    }
+    if (instance.cleanup.semaphore)
+    {
+        status = NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
+        if (status != STATUS_SUCCESS) goto skip_cleanup;
+    }
+    if (instance.cleanup.event)
+    {
+        status = NtSetEvent( instance.cleanup.event, NULL );
+        if (status != STATUS_SUCCESS) goto skip_cleanup;
+    }
+    if (instance.cleanup.library)
+    {
+        LdrUnloadDll( instance.cleanup.library );
+    }
+
+skip_cleanup:
+    if (object->type == TP_OBJECT_TYPE_WAIT)
+        tp_waitqueue_rearm( object );
+
+    if (instance.associated) tp_object_finished( object );
+}
+
+/***********************************************************************
+ *           tp_worker_get_task    (internal)
+ *
+ * Picks the next task for a worker: its own queue first (most recently
+ * posted), then the injection queue, then the oldest task of another
+ * worker.
+ */
+static struct threadpool_task *tp_worker_get_task( struct threadpool_worker *worker )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_worker *other;
+    struct threadpool_task *task;
+
+    if (!pool->num_pending) return NULL;
+
+    if (!(task = tp_queue_pop_tail( &worker->queue )) &&
+        !(task = tp_queue_pop_head( &pool->queue )))
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        LIST_FOR_EACH_ENTRY( other, &pool->workers, struct threadpool_worker, entry )
         {
-            NtWaitForSingleObject(event, FALSE, NULL);
-            status = STATUS_SUCCESS;
+            if (other == worker) continue;
+            if ((task = tp_queue_pop_head( &other->queue ))) break;
         }
-        NtClose(event);
+        RtlLeaveCriticalSection( &pool->cs );
     }
 
-    return status;
+    if (task) interlocked_dec( &pool->num_pending );
+    return task;
+}
+
+/***********************************************************************
+ *           threadpool_worker_proc    (internal)
+ */
+static void CALLBACK threadpool_worker_proc( void *param )
+{
+    struct threadpool_worker *worker = param;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_task *task;
+    LARGE_INTEGER timeout;
+    NTSTATUS status;
+
+    TRACE( "starting worker thread for pool %p\n", pool );
+    set_current_worker( worker );
+
+    for (;;)
+    {
+        if ((task = tp_worker_get_task( worker )))
+        {
+            struct threadpool_object *object = task->object;
+
+            tp_object_execute( task );
+            RtlFreeHeap( GetProcessHeap(), 0, task );
+            tp_object_release( object );
+            continue;
+        }
+
+        RtlEnterCriticalSection( &pool->cs );
+        pool->num_busy_workers--;
+
+        /* the increment is a full barrier, pairing with the num_pending increment in tp_object_submit */
+        interlocked_inc( &pool->num_idle_workers );
+        if (pool->num_pending)
+        {
+            interlocked_dec( &pool->num_idle_workers );
+            pool->num_busy_workers++;
+            RtlLeaveCriticalSection( &pool->cs );
+            continue;
+        }
+
+        /* Terminate the thread when the pool is shut down and no objects are left. */
+        if (pool->shutdown && !pool->objcount)
+        {
+            interlocked_dec( &pool->num_idle_workers );
+            break;
+        }
+
+        timeout.QuadPart = (ULONGLONG)WORKER_TIMEOUT * -10000;
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs,
+                                              pool->shutdown ? NULL : &timeout );
+        interlocked_dec( &pool->num_idle_workers );
+
+        /* Terminate idle threads above the minimum, but keep one thread
+         * as long as objects are still referencing the pool. */
+        if (status == STATUS_TIMEOUT && !pool->num_pending &&
+            pool->num_workers > max( pool->min_workers, pool->objcount ? 1 : 0 ))
+            break;
+
+        pool->num_busy_workers++;
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+
+    /* Unregister the worker, the pool critical section is still held. */
+    assert( list_empty( &worker->queue.tasks ) );
+    list_remove( &worker->entry );
+    pool->num_workers--;
+    RtlLeaveCriticalSection( &pool->cs );
+
+    set_current_worker( NULL );
+    RtlFreeHeap( GetProcessHeap(), 0, worker );
+
+    TRACE( "terminating worker thread for pool %p\n", pool );
+    tp_threadpool_release( pool );
+    RtlExitUserThread( 0 );
+}
+
+struct rtl_work_item
+{
+    PRTL_WORK_ITEM_ROUTINE function;
+    PVOID context;
+};
+
+/***********************************************************************
+ *           process_rtl_work_item   (internal)
+ */
+static void CALLBACK process_rtl_work_item( TP_CALLBACK_INSTANCE *instance, void *userdata )
+{
+    struct rtl_work_item *item = userdata;
+
+    TRACE( "executing %p(%p)\n", item->function, item->context );
+    item->function( item->context );
+
+    RtlFreeHeap( GetProcessHeap(), 0, item );
+}
+
+/***********************************************************************
+ *              RtlQueueWorkItem   (NTDLL.@)
+ *
+ * Queues a work item into a thread in the thread pool.
+ *
+ * PARAMS
+ *  Function [I] Work function to execute.
+ *  Context  [I] Context to pass to the work function when it is executed.
+ *  Flags    [I] Flags. See notes.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ * NOTES
+ *  Flags can be one or more of the following:
+ *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
+ *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
+ *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
+ *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
+ *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ */
+NTSTATUS WINAPI RtlQueueWorkItem(PRTL_WORK_ITEM_ROUTINE Function, PVOID Context, ULONG Flags)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct rtl_work_item *item;
+    NTSTATUS status;
+
+    TRACE( "%p %p %u\n", Function, Context, Flags );
+
+    item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*item) );
+    if (!item)
+        return STATUS_NO_MEMORY;
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.u.s.LongFunction = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+    environment.u.s.Persistent   = (Flags & WT_EXECUTEINPERSISTENTTHREAD) != 0;
+
+    item->function = Function;
+    item->context  = Context;
+
+    status = TpSimpleTryPost( process_rtl_work_item, item, &environment );
+    if (status)
+        RtlFreeHeap( GetProcessHeap(), 0, item );
+
+    return status;
+}
+
+/***********************************************************************
+ * iocp_poller - get completion events and run callbacks
+ */
+static DWORD CALLBACK iocp_poller(LPVOID Arg)
+{
+    while( TRUE )
+    {
+        PRTL_OVERLAPPED_COMPLETION_ROUTINE callback;
+        LPVOID overlapped;
+        IO_STATUS_BLOCK iosb;
+        NTSTATUS res = NtRemoveIoCompletion( compl_port, (PULONG_PTR)&callback, (PULONG_PTR)&overlapped, &iosb, NULL );
+        if (res)
+        {
+            ERR("NtRemoveIoCompletion failed: 0x%x\n", res);
+        }
+        else
+        {
+            DWORD transferred = 0;
+            DWORD err = 0;
+
+            if (iosb.u.Status == STATUS_SUCCESS)
+                transferred = iosb.Information;
+            else
+                err = RtlNtStatusToDosError(iosb.u.Status);
+
+            callback( err, transferred, overlapped );
+        }
+    }
+    return 0;
+}
+
+/***********************************************************************
+ *              RtlSetIoCompletionCallback  (NTDLL.@)
+ *
+ * Binds a handle to a thread pool's completion port, and possibly
+ * starts a non-I/O thread to monitor this port and call functions back.
+ *
+ * PARAMS
+ *  FileHandle [I] Handle to bind to a completion port.
+ *  Function   [I] Callback function to call on I/O completions.
+ *  Flags      [I] Not used.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ */
+NTSTATUS WINAPI RtlSetIoCompletionCallback(HANDLE FileHandle, PRTL_OVERLAPPED_COMPLETION_ROUTINE Function, ULONG Flags)
+{
+    IO_STATUS_BLOCK iosb;
+    FILE_COMPLETION_INFORMATION info;
+
+    if (Flags) FIXME("Unknown value Flags=0x%x\n", Flags);
+
+    if (!compl_port)
+    {
+        NTSTATUS res = STATUS_SUCCESS;
+
+        RtlEnterCriticalSection(&threadpool_compl_cs);
+        if (!compl_port)
+        {
+            HANDLE cport;
+
+            res = NtCreateIoCompletion( &cport, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+            if (!res)
+            {
+                /* FIXME native can start additional threads in case of e.g. hung callback function. */
+                res = RtlQueueWorkItem( iocp_poller, NULL, WT_EXECUTEDEFAULT );
+                if (!res)
+                    compl_port = cport;
+                else
+                    NtClose( cport );
+            }
+        }
+        RtlLeaveCriticalSection(&threadpool_compl_cs);
+        if (res) return res;
+    }
+
+    info.CompletionPort = compl_port;
+    info.CompletionKey = (ULONG_PTR)Function;
+
+    return NtSetInformationFile( FileHandle, &iosb, &info, sizeof(info), FileCompletionInformation );
+}
+
+static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
+{
+    if (timeout == INFINITE) return NULL;
+    pTime->QuadPart = (ULONGLONG)timeout * -10000;
+    return pTime;
+}
+
+/***********************************************************************
+ *           tp_alloc_wait    (internal)
+ */
+static NTSTATUS tp_alloc_wait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                               TP_CALLBACK_ENVIRON *environment, ULONG flags )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_WAIT;
+    object->u.wait.callback     = callback;
+    object->u.wait.flags        = flags;
+    object->u.wait.rtl_callback = NULL;
+    object->u.wait.rtl_timeout  = INFINITE;
+
+    status = tp_waitqueue_lock( object );
+    if (status)
+    {
+        tp_threadpool_unlock( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_WAIT *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           rtl_wait_callback    (internal)
+ */
+static void CALLBACK rtl_wait_callback( TP_CALLBACK_INSTANCE *instance, void *userdata,
+                                        TP_WAIT *wait, TP_WAIT_RESULT result )
+{
+    struct threadpool_object *object = impl_from_TP_WAIT( wait );
+
+    if (result == WAIT_OBJECT_0)
+        TRACE( "object %p signaled, calling callback %p with context %p\n",
+               object->u.wait.handle, object->u.wait.rtl_callback, userdata );
+    else
+        TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
+               object->u.wait.handle, object->u.wait.rtl_callback, userdata );
+
+    object->u.wait.rtl_callback( userdata, result == WAIT_TIMEOUT );
+}
+
+/***********************************************************************
+ *              RtlRegisterWait   (NTDLL.@)
+ *
+ * Registers a wait for a handle to become signaled.
+ *
+ * PARAMS
+ *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
+ *  Object   [I] Object to wait to become signaled.
+ *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
+ *  Context  [I] Context to pass to the callback function when it is executed.
+ *  Milliseconds [I] Number of milliseconds to wait before timing out.
+ *  Flags    [I] Flags. See notes.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ * NOTES
+ *  Flags can be one or more of the following:
+ *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
+ *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
+ *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
+ *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
+ *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ *|WT_EXECUTEINWAITTHREAD - Executes the work item in the thread waiting for the object.
+ *|WT_EXECUTEONLYONCE - Stops waiting after the callback has been called once.
+ *
+ *  Waits are not serviced by a thread of their own; each wait thread
+ *  watches up to MAXIMUM_WAIT_OBJECTS - 1 registrations at once.
+ */
+NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
+                                RTL_WAITORTIMERCALLBACKFUNC Callback,
+                                PVOID Context, ULONG Milliseconds, ULONG Flags)
+{
+    struct threadpool_object *object;
+    TP_CALLBACK_ENVIRON environment;
+    LARGE_INTEGER now;
+    NTSTATUS status;
+    TP_WAIT *wait;
+
+    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.u.s.LongFunction = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+    environment.u.s.Persistent   = (Flags & WT_EXECUTEINPERSISTENTTHREAD) != 0;
+
+    status = tp_alloc_wait( &wait, rtl_wait_callback, Context, &environment,
+                            Flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE) );
+    if (status != STATUS_SUCCESS)
+        return status;
+
+    object = impl_from_TP_WAIT( wait );
+    object->u.wait.rtl_callback = Callback;
+    object->u.wait.rtl_timeout  = Milliseconds;
+
+    NtQuerySystemTime( &now );
+    RtlEnterCriticalSection( &waitqueue.cs );
+    tp_waitqueue_arm( object, Object, Milliseconds == INFINITE ? MAXLONGLONG :
+                      now.QuadPart + (ULONGLONG)Milliseconds * 10000 );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+
+    *NewWaitObject = object;
+    return status;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWaitEx   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
+{
+    struct threadpool_object *object = impl_from_TP_WAIT( WaitHandle );
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "(%p)\n", WaitHandle );
+
+    tp_object_shutdown( object );
+    tp_object_cancel( object, FALSE, NULL );
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+        tp_object_wait( object );
+    else
+    {
+        /* the event is signaled once the last callback has returned */
+        if (CompletionEvent)
+            object->u.wait.completion_event = CompletionEvent;
+        if (object->num_outstanding)
+            status = STATUS_PENDING;
+    }
+
+    tp_object_release( object );
+    return status;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWait   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
+{
+    return RtlDeregisterWaitEx(WaitHandle, NULL);
+}
+
+
+/************************** Timer Queue Impl **************************/
+
+struct timer_queue;
+struct queue_timer
+{
+    struct timer_queue *q;
+    struct list entry;
+    ULONG runcount;             /* number of callbacks pending execution */
+    RTL_WAITORTIMERCALLBACKFUNC callback;
+    PVOID param;
+    DWORD period;
+    ULONG flags;
+    ULONGLONG expire;
+    BOOL destroy;      /* timer should be deleted; once set, never unset */
+    HANDLE event;      /* removal event */
+};
+
+struct timer_queue
+{
+    DWORD magic;
+    RTL_CRITICAL_SECTION cs;
+    struct list timers;          /* sorted by expiration time */
+    BOOL quit;         /* queue should be deleted; once set, never unset */
+    HANDLE event;
+    HANDLE thread;
+};
+
+#define EXPIRE_NEVER (~(ULONGLONG) 0)
+#define TIMER_QUEUE_MAGIC 0x516d6954  /* TimQ */
+
+static void queue_remove_timer(struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  This ensures
+       that we cannot queue another callback for this timer.  The runcount
+       being zero makes sure we don't have any already queued.  */
+    struct timer_queue *q = t->q;
+
+    assert(t->runcount == 0);
+    assert(t->destroy);
+
+    list_remove(&t->entry);
+    if (t->event)
+        NtSetEvent(t->event, NULL);
+    RtlFreeHeap(GetProcessHeap(), 0, t);
+
+    if (q->quit && list_empty(&q->timers))
+        NtSetEvent(q->event, NULL);
+}
+
+static void timer_cleanup_callback(struct queue_timer *t)
+{
+    struct timer_queue *q = t->q;
+    RtlEnterCriticalSection(&q->cs);
+
+    assert(0 < t->runcount);
+    --t->runcount;
+
+    if (t->destroy && t->runcount == 0)
+        queue_remove_timer(t);
+
+    RtlLeaveCriticalSection(&q->cs);
+}
+
+static DWORD WINAPI timer_callback_wrapper(LPVOID p)
+{
+    struct queue_timer *t = p;
+    t->callback(t->param, TRUE);
+    timer_cleanup_callback(t);
+    return 0;
+}
+
+static inline ULONGLONG queue_current_time(void)
+{
+    LARGE_INTEGER now, freq;
+    NtQueryPerformanceCounter(&now, &freq);
+    return now.QuadPart * 1000 / freq.QuadPart;
+}
+
+static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
+                            BOOL set_event)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    struct timer_queue *q = t->q;
+    struct list *ptr = &q->timers;
+
+    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
+
+    if (time != EXPIRE_NEVER)
+        LIST_FOR_EACH(ptr, &q->timers)
+        {
+            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
+            if (time < cur->expire)
+                break;
+        }
+    list_add_before(ptr, &t->entry);
+
+    t->expire = time;
+
+    /* If we insert at the head of the list, we need to expire sooner
+       than expected.  */
+    if (set_event && &t->entry == list_head(&q->timers))
+        NtSetEvent(q->event, NULL);
+}
+
+static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
+                                    BOOL set_event)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    list_remove(&t->entry);
+    queue_add_timer(t, time, set_event);
+}
+
+static void queue_timer_expire(struct timer_queue *q)
+{
+    struct queue_timer *t = NULL;
+
+    RtlEnterCriticalSection(&q->cs);
+    if (list_head(&q->timers))
+    {
+        ULONGLONG now, next;
+        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        {
+            ++t->runcount;
+            if (t->period)
+            {
+                next = t->expire + t->period;
+                /* avoid trigger cascade if overloaded / hibernated */
+                if (next < now)
+                    next = now + t->period;
+            }
+            else
+                next = EXPIRE_NEVER;
+            queue_move_timer(t, next, FALSE);
+        }
+        else
+            t = NULL;
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (t)
+    {
+        if (t->flags & WT_EXECUTEINTIMERTHREAD)
+            timer_callback_wrapper(t);
+        else
+        {
+            ULONG flags
+                = (t->flags
+                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
+                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
+            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
+            if (status != STATUS_SUCCESS)
+                timer_cleanup_callback(t);
+        }
+    }
+}
+
+static ULONG queue_get_timeout(struct timer_queue *q)
+{
+    struct queue_timer *t;
+    ULONG timeout = INFINITE;
+
+    RtlEnterCriticalSection(&q->cs);
+    if (list_head(&q->timers))
+    {
+        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        assert(!t->destroy || t->expire == EXPIRE_NEVER);
+
+        if (t->expire != EXPIRE_NEVER)
+        {
+            ULONGLONG time = queue_current_time();
+            timeout = t->expire < time ? 0 : t->expire - time;
+        }
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    return timeout;
+}
+
+static void WINAPI timer_queue_thread_proc(LPVOID p)
+{
+    struct timer_queue *q = p;
+    ULONG timeout_ms;
+
+    timeout_ms = INFINITE;
+    for (;;)
+    {
+        LARGE_INTEGER timeout;
+        NTSTATUS status;
+        BOOL done = FALSE;
+
+        status = NtWaitForSingleObject(
+            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
+
+        if (status == STATUS_WAIT_0)
+        {
+            /* There are two possible ways to trigger the event.  Either
+               we are quitting and the last timer got removed, or a new
+               timer got put at the head of the list so we need to adjust
+               our timeout.  */
+            RtlEnterCriticalSection(&q->cs);
+            if (q->quit && list_empty(&q->timers))
+                done = TRUE;
+            RtlLeaveCriticalSection(&q->cs);
+        }
+        else if (status == STATUS_TIMEOUT)
+            queue_timer_expire(q);
+
+        if (done)
+            break;
+
+        timeout_ms = queue_get_timeout(q);
+    }
+
+    NtClose(q->event);
+    RtlDeleteCriticalSection(&q->cs);
+    q->magic = 0;
+    RtlFreeHeap(GetProcessHeap(), 0, q);
+}
+
+static void queue_destroy_timer(struct queue_timer *t)
+{
+    /* We MUST hold the queue cs while calling this function.  */
+    t->destroy = TRUE;
+    if (t->runcount == 0)
+        /* Ensure a timer is promptly removed.  If callbacks are pending,
+           it will be removed after the last one finishes by the callback
+           cleanup wrapper.  */
+        queue_remove_timer(t);
+    else
+        /* Make sure no destroyed timer masks an active timer at the head
+           of the sorted list.  */
+        queue_move_timer(t, EXPIRE_NEVER, FALSE);
+}
+
+/***********************************************************************
+ *              RtlCreateTimerQueue   (NTDLL.@)
+ *
+ * Creates a timer queue object and returns a handle to it.
+ *
+ * PARAMS
+ *  NewTimerQueue [O] The newly created queue.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
+{
+    NTSTATUS status;
+    struct timer_queue *q = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *q);
+    if (!q)
+        return STATUS_NO_MEMORY;
+
+    RtlInitializeCriticalSection(&q->cs);
+    list_init(&q->timers);
+    q->quit = FALSE;
+    q->magic = TIMER_QUEUE_MAGIC;
+    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (status != STATUS_SUCCESS)
+    {
+        RtlFreeHeap(GetProcessHeap(), 0, q);
+        return status;
+    }
+    status = RtlCreateUserThread(GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 timer_queue_thread_proc, q, &q->thread, NULL);
+    if (status != STATUS_SUCCESS)
+    {
+        NtClose(q->event);
+        RtlFreeHeap(GetProcessHeap(), 0, q);
+        return status;
+    }
+
+    *NewTimerQueue = q;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeleteTimerQueueEx   (NTDLL.@)
+ *
+ * Deletes a timer queue object.
+ *
+ * PARAMS
+ *  TimerQueue      [I] The timer queue to destroy.
+ *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
+ *                      wait until all timers are finished firing before
+ *                      returning.  Otherwise, return immediately and set the
+ *                      event when all timers are done.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS if synchronous, STATUS_PENDING if not.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
+{
+    struct timer_queue *q = TimerQueue;
+    struct queue_timer *t, *temp;
+    HANDLE thread;
+    NTSTATUS status;
+
+    if (!q || q->magic != TIMER_QUEUE_MAGIC)
+        return STATUS_INVALID_HANDLE;
+
+    thread = q->thread;
+
+    RtlEnterCriticalSection(&q->cs);
+    q->quit = TRUE;
+    if (list_head(&q->timers))
+        /* When the last timer is removed, it will signal the timer thread to
+           exit...  */
+        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
+            queue_destroy_timer(t);
+    else
+        /* However if we have none, we must do it ourselves.  */
+        NtSetEvent(q->event, NULL);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        NtWaitForSingleObject(thread, FALSE, NULL);
+        status = STATUS_SUCCESS;
+    }
+    else
+    {
+        if (CompletionEvent)
+        {
+            FIXME("asynchronous return on completion event unimplemented\n");
+            NtWaitForSingleObject(thread, FALSE, NULL);
+            NtSetEvent(CompletionEvent, NULL);
+        }
+        status = STATUS_PENDING;
+    }
+
+    NtClose(thread);
+    return status;
+}
+
+static struct timer_queue *default_timer_queue;
+
+static struct timer_queue *get_timer_queue(HANDLE TimerQueue)
+{
+    if (TimerQueue)
+        return TimerQueue;
+    else
+    {
+        if (!default_timer_queue)
+        {
+            HANDLE q;
+            NTSTATUS status = RtlCreateTimerQueue(&q);
+            if (status == STATUS_SUCCESS)
+            {
+                PVOID p = interlocked_cmpxchg_ptr(
+                    (void **) &default_timer_queue, q, NULL);
+                if (p)
+                    /* Got beat to the punch.  */
+                    RtlDeleteTimerQueueEx(q, NULL);
+            }
+        }
+        return default_timer_queue;
+    }
+}
+
+/***********************************************************************
+ *              RtlCreateTimer   (NTDLL.@)
+ *
+ * Creates a new timer associated with the given queue.
+ *
+ * PARAMS
+ *  NewTimer   [O] The newly created timer.
+ *  TimerQueue [I] The queue to hold the timer.
+ *  Callback   [I] The callback to fire.
+ *  Parameter  [I] The argument for the callback.
+ *  DueTime    [I] The delay, in milliseconds, before first firing the
+ *                 timer.
+ *  Period     [I] The period, in milliseconds, at which to fire the timer
+ *                 after the first callback.  If zero, the timer will only
+ *                 fire once.  It still needs to be deleted with
+ *                 RtlDeleteTimer.
+ * Flags       [I] Flags controlling the execution of the callback.  In
+ *                 addition to the WT_* thread pool flags (see
+ *                 RtlQueueWorkItem), WT_EXECUTEINTIMERTHREAD and
+ *                 WT_EXECUTEONLYONCE are supported.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
+                               RTL_WAITORTIMERCALLBACKFUNC Callback,
+                               PVOID Parameter, DWORD DueTime, DWORD Period,
+                               ULONG Flags)
+{
+    NTSTATUS status;
+    struct queue_timer *t;
+    struct timer_queue *q = get_timer_queue(TimerQueue);
+
+    if (!q) return STATUS_NO_MEMORY;
+    if (q->magic != TIMER_QUEUE_MAGIC) return STATUS_INVALID_HANDLE;
+
+    t = RtlAllocateHeap(GetProcessHeap(), 0, sizeof *t);
+    if (!t)
+        return STATUS_NO_MEMORY;
+
+    t->q = q;
+    t->runcount = 0;
+    t->callback = Callback;
+    t->param = Parameter;
+    t->period = Period;
+    t->flags = Flags;
+    t->destroy = FALSE;
+    t->event = NULL;
+
+    status = STATUS_SUCCESS;
+    RtlEnterCriticalSection(&q->cs);
+    if (q->quit)
+        status = STATUS_INVALID_HANDLE;
+    else
+        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (status == STATUS_SUCCESS)
+        *NewTimer = t;
+    else
+        RtlFreeHeap(GetProcessHeap(), 0, t);
+
+    return status;
+}
+
+/***********************************************************************
+ *              RtlUpdateTimer   (NTDLL.@)
+ *
+ * Changes the time at which a timer expires.
+ *
+ * PARAMS
+ *  TimerQueue [I] The queue that holds the timer.
+ *  Timer      [I] The timer to update.
+ *  DueTime    [I] The delay, in milliseconds, before next firing the timer.
+ *  Period     [I] The period, in milliseconds, at which to fire the timer
+ *                 after the first callback.  If zero, the timer will not
+ *                 refire once.  It still needs to be deleted with
+ *                 RtlDeleteTimer.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
+                               DWORD DueTime, DWORD Period)
+{
+    struct queue_timer *t = Timer;
+    struct timer_queue *q = t->q;
+
+    RtlEnterCriticalSection(&q->cs);
+    /* Can't change a timer if it was once-only or destroyed.  */
+    if (t->expire != EXPIRE_NEVER)
+    {
+        t->period = Period;
+        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
+    }
+    RtlLeaveCriticalSection(&q->cs);
+
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeleteTimer   (NTDLL.@)
+ *
+ * Cancels a timer-queue timer.
+ *
+ * PARAMS
+ *  TimerQueue      [I] The queue that holds the timer.
+ *  Timer           [I] The timer to update.
+ *  CompletionEvent [I] If NULL, return immediately.  If INVALID_HANDLE_VALUE,
+ *                      wait until the timer is finished firing all pending
+ *                      callbacks before returning.  Otherwise, return
+ *                      immediately and set the timer is done.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS if the timer is done, STATUS_PENDING if not,
+             or if the completion event is NULL.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
+                               HANDLE CompletionEvent)
+{
+    struct queue_timer *t = Timer;
+    struct timer_queue *q;
+    NTSTATUS status = STATUS_PENDING;
+    HANDLE event = NULL;
+
+    if (!Timer)
+        return STATUS_INVALID_PARAMETER_1;
+    q = t->q;
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+        if (status == STATUS_SUCCESS)
+            status = STATUS_PENDING;
+    }
+    else if (CompletionEvent)
+        event = CompletionEvent;
+
+    RtlEnterCriticalSection(&q->cs);
+    t->event = event;
+    if (t->runcount == 0 && event)
+        status = STATUS_SUCCESS;
+    queue_destroy_timer(t);
+    RtlLeaveCriticalSection(&q->cs);
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE && event)
+    {
+        if (status == STATUS_PENDING)
+        {
+            NtWaitForSingleObject(event, FALSE, NULL);
+            status = STATUS_SUCCESS;
+        }
+        NtClose(event);
+    }
+
+    return status;
+}
+
+
+/***********************************************************************
+ *           TpAllocCleanupGroup    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
+{
+    TRACE( "%p\n", out );
+
+    return tp_group_alloc( (struct threadpool_group **)out );
+}
+
+/***********************************************************************
+ *           TpAllocIoCompletion    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocIoCompletion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                     PVOID userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p %p\n", out, file, callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_IO;
+    object->u.io.callback = callback;
+    object->u.io.pending_count = 0;
+
+    status = tp_ioqueue_lock( object, file );
+    if (status)
+    {
+        tp_threadpool_unlock( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_IO *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocPool    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocPool( TP_POOL **out, PVOID reserved )
+{
+    TRACE( "%p %p\n", out, reserved );
+
+    if (reserved)
+        FIXME( "reserved argument is nonzero (%p)\n", reserved );
+
+    return tp_threadpool_alloc( (struct threadpool **)out );
+}
+
+/***********************************************************************
+ *           TpAllocTimer    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocTimer( TP_TIMER **out, PTP_TIMER_CALLBACK callback, PVOID userdata,
+                              TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_TIMER;
+    object->u.timer.callback = callback;
+
+    status = tp_timerqueue_lock( object );
+    if (status)
+    {
+        tp_threadpool_unlock( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_TIMER *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocWait    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    return tp_alloc_wait( out, callback, userdata, environment, WT_EXECUTEONLYONCE );
+}
+
+/***********************************************************************
+ *           TpAllocWork    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWork( TP_WORK **out, PTP_WORK_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_WORK;
+    object->u.work.callback = callback;
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_WORK *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpCallbackLeaveCriticalSectionOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackLeaveCriticalSectionOnCompletion( TP_CALLBACK_INSTANCE *instance, CRITICAL_SECTION *crit )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, crit );
+
+    if (!this->cleanup.critical_section)
+        this->cleanup.critical_section = crit;
+}
+
+/***********************************************************************
+ *           TpCallbackMayRunLong    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+    struct threadpool_object *object = this->object;
+    struct threadpool *pool;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return STATUS_UNSUCCESSFUL; /* FIXME */
+    }
+
+    if (this->may_run_long)
+        return STATUS_SUCCESS;
+
+    /* Make sure another worker can pick up the remaining tasks. */
+    pool = object->pool;
+    RtlEnterCriticalSection( &pool->cs );
+
+    if (pool->num_pending && !pool->num_idle_workers)
+    {
+        if (pool->num_workers < pool->max_workers)
+            status = tp_new_worker_thread( pool );
+        else
+            status = STATUS_TOO_MANY_THREADS;
+    }
+
+    RtlLeaveCriticalSection( &pool->cs );
+    this->may_run_long = TRUE;
+    return status;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseMutexOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseMutexOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE mutex )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, mutex );
+
+    if (!this->cleanup.mutex)
+        this->cleanup.mutex = mutex;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseSemaphoreOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseSemaphoreOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE semaphore, DWORD count )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p %u\n", instance, semaphore, count );
+
+    if (!this->cleanup.semaphore)
+    {
+        this->cleanup.semaphore = semaphore;
+        this->cleanup.semaphore_count = count;
+    }
+}
+
+/***********************************************************************
+ *           TpCallbackSetEventOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackSetEventOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE event )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, event );
+
+    if (!this->cleanup.event)
+        this->cleanup.event = event;
+}
+
+/***********************************************************************
+ *           TpCallbackUnloadDllOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackUnloadDllOnCompletion( TP_CALLBACK_INSTANCE *instance, HMODULE module )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, module );
+
+    if (!this->cleanup.library)
+        this->cleanup.library = module;
+}
+
+/***********************************************************************
+ *           TpCancelAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpCancelAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    interlocked_dec( &this->u.io.pending_count );
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpDisassociateCallback    (NTDLL.@)
+ */
+VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return;
+    }
+
+    if (!this->associated)
+        return;
+
+    tp_object_finished( this->object );
+    this->associated = FALSE;
+}
+
+/***********************************************************************
+ *           TpIsTimerSet    (NTDLL.@)
+ */
+BOOL WINAPI TpIsTimerSet( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    return this->u.timer.timer_set;
+}
+
+/***********************************************************************
+ *           TpPostWork    (NTDLL.@)
+ */
+VOID WINAPI TpPostWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p\n", work );
+
+    tp_object_submit( this, NULL );
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroup    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroup( TP_CLEANUP_GROUP *group )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+
+    TRACE( "%p\n", group );
+
+    tp_group_shutdown( this );
+    tp_group_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroupMembers    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_pending, PVOID userdata )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+    struct threadpool_object *object, *next;
+    struct list members;
+
+    TRACE( "%p %u %p\n", group, cancel_pending, userdata );
+
+    RtlEnterCriticalSection( &this->cs );
+
+    /* Unset group, increase references, and mark objects for shutdown */
+    LIST_FOR_EACH_ENTRY_SAFE( object, next, &this->members, struct threadpool_object, group_entry )
+    {
+        assert( object->group == this );
+        assert( object->is_group_member );
+
+        /* Simple callbacks are very special. The user doesn't hold any reference, so
+         * they would be released too early. Add one additional temporary reference. */
+        if (object->type == TP_OBJECT_TYPE_SIMPLE)
+        {
+            if (interlocked_inc( &object->refcount ) == 1)
+            {
+                /* Object is basically already destroyed, but group reference
+                 * was not deleted yet. We can safely ignore this object. */
+                interlocked_dec( &object->refcount );
+                list_remove( &object->group_entry );
+                object->is_group_member = FALSE;
+                continue;
+            }
+        }
+
+        object->is_group_member = FALSE;
+        tp_object_shutdown( object );
+    }
+
+    /* Move members to a new temporary list */
+    list_init( &members );
+    list_move_tail( &members, &this->members );
+
+    RtlLeaveCriticalSection( &this->cs );
+
+    /* Cancel pending callbacks if requested */
+    if (cancel_pending)
+    {
+        LIST_FOR_EACH_ENTRY( object, &members, struct threadpool_object, group_entry )
+        {
+            tp_object_cancel( object, TRUE, userdata );
+        }
+    }
+
+    /* Wait for remaining callbacks to finish */
+    LIST_FOR_EACH_ENTRY_SAFE( object, next, &members, struct threadpool_object, group_entry )
+    {
+        tp_object_wait( object );
+        tp_object_release( object );
+    }
+}
+
+/***********************************************************************
+ *           TpReleaseIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseIoCompletion( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    tp_object_shutdown( this );
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpReleasePool    (NTDLL.@)
+ */
+VOID WINAPI TpReleasePool( TP_POOL *pool )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+
+    TRACE( "%p\n", pool );
+
+    tp_threadpool_shutdown( this );
+    tp_threadpool_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseTimer     (NTDLL.@)
+ */
+VOID WINAPI TpReleaseTimer( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    tp_object_shutdown( this );
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseWait    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWait( TP_WAIT *wait )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+
+    TRACE( "%p\n", wait );
+
+    tp_object_shutdown( this );
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseWork    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p\n", work );
+
+    tp_object_shutdown( this );
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpSetPoolMaxThreads    (NTDLL.@)
+ */
+VOID WINAPI TpSetPoolMaxThreads( TP_POOL *pool, DWORD maximum )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+
+    TRACE( "%p %u\n", pool, maximum );
+
+    RtlEnterCriticalSection( &this->cs );
+    this->max_workers = max( maximum, 1 );
+    this->min_workers = min( this->min_workers, this->max_workers );
+    RtlLeaveCriticalSection( &this->cs );
+}
+
+/***********************************************************************
+ *           TpSetPoolMinThreads    (NTDLL.@)
+ */
+BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "%p %u\n", pool, minimum );
+
+    RtlEnterCriticalSection( &this->cs );
+
+    while (this->num_workers < minimum)
+    {
+        status = tp_new_worker_thread( this );
+        if (status != STATUS_SUCCESS)
+            break;
+    }
+
+    if (status == STATUS_SUCCESS)
+    {
+        this->min_workers = minimum;
+        this->max_workers = max( this->min_workers, this->max_workers );
+    }
+
+    RtlLeaveCriticalSection( &this->cs );
+    return !status;
+}
+
+/***********************************************************************
+ *           TpSetTimer    (NTDLL.@)
+ */
+VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+    struct threadpool_object *other_timer;
+    BOOL submit_timer = FALSE;
+    ULONGLONG timestamp = 0;
+
+    TRACE( "%p %p %u %u\n", timer, timeout, period, window_length );
+
+    RtlEnterCriticalSection( &timerqueue.cs );
+
+    assert( this->u.timer.timer_initialized );
+    this->u.timer.timer_set = timeout != NULL;
+
+    /* Convert relative timeout to absolute timestamp and handle a timeout
+     * of zero, which means that the timer is submitted immediately. */
+    if (timeout)
+    {
+        timestamp = timeout->QuadPart;
+        if ((LONGLONG)timestamp < 0)
+        {
+            LARGE_INTEGER now;
+            NtQuerySystemTime( &now );
+            timestamp = now.QuadPart - timestamp;
+        }
+        else if (!timestamp)
+        {
+            if (!period)
+                timeout = NULL;
+            else
+            {
+                LARGE_INTEGER now;
+                NtQuerySystemTime( &now );
+                timestamp = now.QuadPart + (ULONGLONG)period * 10000;
+            }
+            submit_timer = TRUE;
+        }
+    }
+
+    /* First remove existing timeout. */
+    if (this->u.timer.timer_pending)
+    {
+        list_remove( &this->u.timer.timer_entry );
+        this->u.timer.timer_pending = FALSE;
+    }
+
+    /* If the timer was enabled, then add it back to the queue. */
+    if (timeout)
+    {
+        this->u.timer.timeout       = timestamp;
+        this->u.timer.period        = period;
+        this->u.timer.window_length = window_length;
+
+        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
+                             struct threadpool_object, u.timer.timer_entry )
+        {
+            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
+            if (this->u.timer.timeout < other_timer->u.timer.timeout)
+                break;
+        }
+        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+
+        /* Wake up the timer thread when the timeout has to be updated. */
+        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+            RtlWakeAllConditionVariable( &timerqueue.update_event );
+
+        this->u.timer.timer_pending = TRUE;
+    }
+
+    RtlLeaveCriticalSection( &timerqueue.cs );
+
+    if (submit_timer)
+       tp_object_submit( this, NULL );
+}
+
+/***********************************************************************
+ *           TpSetWait    (NTDLL.@)
+ */
+VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+    ULONGLONG timestamp = MAXLONGLONG;
+    LARGE_INTEGER now;
+
+    TRACE( "%p %p %p\n", wait, handle, timeout );
+
+    if (timeout)
+    {
+        timestamp = timeout->QuadPart;
+        if ((LONGLONG)timestamp < 0)
+        {
+            NtQuerySystemTime( &now );
+            timestamp = now.QuadPart - timestamp;
+        }
+    }
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    assert( this->u.wait.bucket );
+    tp_waitqueue_arm( this, handle, timestamp );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
+
+/***********************************************************************
+ *           TpSimpleTryPost    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
+                                 TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p\n", callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_SIMPLE;
+    object->u.simple.callback = callback;
+    tp_object_initialize( object, pool, userdata, environment );
+
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpStartAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpStartAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* keep the object alive until the completion packet is dispatched */
+    interlocked_inc( &this->refcount );
+    interlocked_inc( &this->u.io.pending_count );
+}
+
+/***********************************************************************
+ *           TpWaitForIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForIoCompletion( TP_IO *io, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p %d\n", io, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this, FALSE, NULL );
+    tp_object_wait( this );
+}
+
+/***********************************************************************
+ *           TpWaitForTimer    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForTimer( TP_TIMER *timer, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p %d\n", timer, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this, FALSE, NULL );
+    tp_object_wait( this );
+}
+
+/***********************************************************************
+ *           TpWaitForWait    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForWait( TP_WAIT *wait, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+
+    TRACE( "%p %d\n", wait, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this, FALSE, NULL );
+    tp_object_wait( this );
+}
+
+/***********************************************************************
+ *           TpWaitForWork    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForWork( TP_WORK *work, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p %u\n", work, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this, FALSE, NULL );
+    tp_object_wait( this );
 }
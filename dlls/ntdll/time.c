@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <string.h>
 #include <limits.h>
+#include <signal.h>
 #include <time.h>
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
@@ -51,6 +52,7 @@
 #include "wine/unicode.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
+#include "ddk/wdm.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
@@ -89,6 +91,9 @@ static RTL_CRITICAL_SECTION TIME_tz_section = { &critsect_debug, -1, 0, 0, 0, 0
 #define SECS_1601_TO_1980  ((379 * 365 + 91) * (ULONGLONG)SECSPERDAY)
 #define TICKS_1601_TO_1980 (SECS_1601_TO_1980 * TICKSPERSEC)
 
+/* interval between updates of the user_shared_data time fields, in ns (default Windows clock rate) */
+#define SHARED_TIME_INTERVAL 15625000
+
 
 static const int MonthLengths[2][MONSPERYEAR] =
 {
@@ -125,6 +130,83 @@ static ULONGLONG monotonic_counter(void)
     return now.tv_sec * (ULONGLONG)TICKSPERSEC + now.tv_usec * 10 + TICKS_1601_TO_1970 - server_start_time;
 }
 
+/* update a KSYSTEM_TIME so that readers checking High1Time against High2Time never see a torn value */
+static inline void set_ksystem_time( volatile KSYSTEM_TIME *time, ULONGLONG value )
+{
+    interlocked_xchg( (int *)&time->High2Time, value >> 32 );
+    interlocked_xchg( (int *)&time->LowPart, (ULONG)value );
+    interlocked_xchg( (int *)&time->High1Time, value >> 32 );
+}
+
+/* store the current time values in user_shared_data */
+static void update_shared_time(void)
+{
+    struct timeval now;
+    ULONGLONG counter = monotonic_counter();
+
+    gettimeofday( &now, 0 );
+    set_ksystem_time( &user_shared_data->SystemTime,
+                      now.tv_sec * (ULONGLONG)TICKSPERSEC + now.tv_usec * 10 + TICKS_1601_TO_1970 );
+    set_ksystem_time( &user_shared_data->InterruptTime, counter );
+    set_ksystem_time( &user_shared_data->u.TickCount, counter / TICKSPERMSEC );
+    user_shared_data->TickCountLowDeprecated = user_shared_data->u.TickCount.LowPart;
+}
+
+static int shared_time_started;
+static int shared_time_live;  /* set once the thread keeps the time fields current */
+
+/* thread keeping the user_shared_data time fields current; it never runs any Win32 code */
+static void *shared_time_thread( void *arg )
+{
+    struct timespec interval;
+
+    interval.tv_sec  = 0;
+    interval.tv_nsec = SHARED_TIME_INTERVAL;
+
+    update_shared_time();
+    shared_time_live = 1;
+    for (;;)
+    {
+        nanosleep( &interval, NULL );
+        update_shared_time();
+    }
+    return NULL;
+}
+
+/* start the thread updating the time fields the first time the tick count is needed,
+ * so that processes that never ask for it don't keep waking up */
+static void start_shared_time_thread(void)
+{
+    sigset_t sigset, old_sigset;
+    pthread_attr_t attr;
+    pthread_t id;
+
+    if (interlocked_cmpxchg( &shared_time_started, 1, 0 )) return;
+
+    /* the thread is unknown to the server, it must never handle any signal */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setstacksize( &attr, max( PTHREAD_STACK_MIN, 64 * 1024 ) );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    if (pthread_create( &id, &attr, shared_time_thread, NULL ))
+        ERR( "failed to start the shared time thread, tick count will be computed on demand\n" );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+}
+
+/***********************************************************************
+ *           init_shared_time
+ *
+ * Initialize the time fields of user_shared_data. They are kept updated
+ * by a thread started on the first NtGetTickCount call.
+ */
+void init_shared_time(void)
+{
+    user_shared_data->TickCountMultiplier = 1 << 24;
+    update_shared_time();
+}
+
 /******************************************************************************
  *       RtlTimeToTimeFields [NTDLL.@]
  *
@@ -492,6 +574,8 @@ NTSTATUS WINAPI NtQueryPerformanceCounter( LARGE_INTEGER *counter, LARGE_INTEGER
  */
 ULONG WINAPI NtGetTickCount(void)
 {
+    if (shared_time_live) return user_shared_data->u.TickCount.LowPart;
+    start_shared_time_thread();
     return monotonic_counter() / TICKSPERMSEC;
 }
 
@@ -0,0 +1,351 @@
+/*
+ * io_uring-based asynchronous file I/O
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* When WINEURING is set in the environment, overlapped reads and writes at
+ * an explicit offset on regular files are submitted to an io_uring instead
+ * of being done synchronously. A reaper thread waits for the completions,
+ * fills the IO_STATUS_BLOCK and signals the event or the completion port.
+ * The server is only involved for these two.
+ *
+ * The server doesn't know about these requests, so they can't be cancelled
+ * and the file stays open until they complete. That is only acceptable for
+ * disk files, where every request completes in bounded time; pipes and
+ * sockets, which may wait forever, always go through the server. Appending
+ * writes have to find the end of file when they are done, they are left
+ * to the synchronous path too.
+ *
+ * Requests with an APC routine, or without any event or completion port,
+ * still go through the server, since only the server can queue the APC to
+ * the calling thread or signal the file object. The completion value is
+ * always set for overlapped I/O, so whether a port is associated with the
+ * file has to be checked with the server. */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+
+#define NONAMELESSUNION
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(uring);
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+
+#define URING_ENTRIES 256
+
+struct uring_request
+{
+    HANDLE              handle;   /* file handle, for the completion port */
+    HANDLE              event;    /* event to signal on completion */
+    ULONG_PTR           cvalue;   /* completion port value */
+    IO_STATUS_BLOCK    *iosb;
+    int                 fd;       /* our own copy of the unix fd */
+    BOOL                is_read;
+    struct iovec        iov;      /* the part of the buffer that remains to be done */
+    ULONG               count;
+    ULONG               done;
+    ULONGLONG           offset;
+};
+
+static int ring_fd = -1;
+static unsigned int sq_entries;
+static unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+static unsigned int *cq_head, *cq_tail, *cq_mask;
+static struct io_uring_sqe *sqes;
+static struct io_uring_cqe *cqes;
+static int in_flight;  /* number of submission entries not completed yet */
+
+static RTL_CRITICAL_SECTION uring_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &uring_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_section") }
+};
+static RTL_CRITICAL_SECTION uring_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static void complete_request( struct uring_request *req, int res );
+
+/* check whether io_uring-based file I/O is enabled */
+static int do_uring(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEURING" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+/* thread waiting for the completions */
+static void CALLBACK uring_reaper( void *arg )
+{
+    for (;;)
+    {
+        unsigned int head, tail;
+
+        if (syscall( __NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) == -1 &&
+            errno != EINTR)
+        {
+            ERR( "failed to wait for completions: %s\n", strerror( errno ));
+            return;
+        }
+
+        head = *cq_head;
+        tail = interlocked_cmpxchg( (int *)cq_tail, 0, 0 );
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            struct uring_request *req = (struct uring_request *)(ULONG_PTR)cqe->user_data;
+            int res = cqe->res;
+
+            interlocked_xchg( (int *)cq_head, ++head );
+            interlocked_xchg_add( &in_flight, -1 );
+            if (req) complete_request( req, res );
+        }
+    }
+}
+
+/* create the ring and its reaper thread, the uring_section must be held */
+static BOOL init_ring(void)
+{
+    static BOOL failed;
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq_ptr, *cq_ptr;
+    HANDLE thread;
+    int fd;
+
+    if (ring_fd != -1) return TRUE;
+    if (failed) return FALSE;
+    failed = TRUE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring not available: %s\n", strerror( errno ));
+        return FALSE;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = max( sq_size, cq_size );
+
+    sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING );
+    if (sq_ptr == MAP_FAILED) goto error;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) cq_ptr = sq_ptr;
+    else if ((cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                             fd, IORING_OFF_CQ_RING )) == MAP_FAILED)
+        goto error;
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED) goto error;
+
+    sq_entries = params.sq_entries;
+    sq_head  = (unsigned int *)(sq_ptr + params.sq_off.head);
+    sq_tail  = (unsigned int *)(sq_ptr + params.sq_off.tail);
+    sq_mask  = (unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+    sq_array = (unsigned int *)(sq_ptr + params.sq_off.array);
+    cq_head  = (unsigned int *)(cq_ptr + params.cq_off.head);
+    cq_tail  = (unsigned int *)(cq_ptr + params.cq_off.tail);
+    cq_mask  = (unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+    cqes     = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    ring_fd  = fd;
+
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                             uring_reaper, NULL, &thread, NULL ))
+    {
+        ERR( "failed to create the reaper thread\n" );
+        ring_fd = -1;
+        return FALSE;
+    }
+    NtClose( thread );
+    TRACE( "created ring with %u entries\n", sq_entries );
+    failed = FALSE;
+    return TRUE;
+
+error:
+    WARN( "failed to map the ring: %s\n", strerror( errno ));
+    close( fd );
+    return FALSE;
+}
+
+/* queue a request to the ring, the uring_section must be held */
+static NTSTATUS queue_request( struct uring_request *req )
+{
+    unsigned int tail = *sq_tail;
+    struct io_uring_sqe *sqe;
+    int ret;
+
+    if (in_flight + 1 > sq_entries || tail - *sq_head + 1 > sq_entries)
+        return STATUS_DEVICE_BUSY;
+
+    sqe = &sqes[tail & *sq_mask];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode = req->is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = req->fd;
+    sqe->off = req->offset + req->done;
+    sqe->addr = (ULONG_PTR)&req->iov;
+    sqe->len = 1;
+    sqe->user_data = (ULONG_PTR)req;
+    sq_array[tail & *sq_mask] = tail & *sq_mask;
+    tail++;
+
+    interlocked_xchg_add( &in_flight, 1 );
+    interlocked_xchg( (int *)sq_tail, tail );
+
+    while ((ret = syscall( __NR_io_uring_enter, ring_fd, 1, 0, 0, NULL, 0 )) == -1 && errno == EINTR);
+    if (ret == -1) ERR( "failed to submit request: %s\n", strerror( errno ));
+    return STATUS_SUCCESS;
+}
+
+/* process the completion of a transfer, called from the reaper thread */
+static void complete_request( struct uring_request *req, int res )
+{
+    NTSTATUS status;
+
+    if (res >= 0)
+    {
+        req->done += res;
+        req->iov.iov_base = (char *)req->iov.iov_base + res;
+        req->iov.iov_len -= res;
+    }
+
+    /* writes must be complete */
+    if (!req->is_read && res > 0 && req->iov.iov_len)
+    {
+        RtlEnterCriticalSection( &uring_section );
+        status = queue_request( req );
+        RtlLeaveCriticalSection( &uring_section );
+        if (!status) return;
+        res = req->done;  /* return what we have so far */
+    }
+
+    if (res < 0)
+    {
+        errno = -res;
+        status = FILE_GetNtStatus();
+    }
+    else if (req->is_read && !res && req->count)
+        status = STATUS_END_OF_FILE;
+    else
+        status = STATUS_SUCCESS;
+
+    TRACE( "%p %s %u/%u bytes status %x\n", req->handle, req->is_read ? "read" : "wrote",
+           req->done, req->count, status );
+
+    close( req->fd );
+    req->iosb->Information = req->done;
+    interlocked_xchg( (int *)&req->iosb->u.Status, status );
+    if (req->event) NtSetEvent( req->event, NULL );
+    if (req->cvalue) NTDLL_AddCompletion( req->handle, req->cvalue, status, req->done, FALSE );
+    RtlFreeHeap( GetProcessHeap(), 0, req );
+}
+
+/***********************************************************************
+ *           uring_submit_io
+ *
+ * Submit an overlapped read or write to the ring.
+ * Returns STATUS_NOT_IMPLEMENTED if the caller has to handle it.
+ */
+NTSTATUS uring_submit_io( HANDLE handle, int unix_fd, enum server_fd_type type, BOOL is_read,
+                          HANDLE event, ULONG_PTR cvalue, IO_STATUS_BLOCK *iosb,
+                          void *buffer, ULONG length, ULONGLONG offset )
+{
+    struct uring_request *req;
+    NTSTATUS status;
+
+    if (!do_uring()) return STATUS_NOT_IMPLEMENTED;
+    if (type != FD_TYPE_FILE) return STATUS_NOT_IMPLEMENTED;
+    /* without any of them, completion has to be reported through the file object */
+    if (!event && (!cvalue || !server_fd_has_completion( handle ))) return STATUS_NOT_IMPLEMENTED;
+
+    if (!(req = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*req) ))) return STATUS_NOT_IMPLEMENTED;
+    if ((req->fd = dup( unix_fd )) == -1)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    req->handle       = handle;
+    req->event        = event;
+    req->cvalue       = cvalue;
+    req->iosb         = iosb;
+    req->is_read      = is_read;
+    req->iov.iov_base = buffer;
+    req->iov.iov_len  = length;
+    req->count        = length;
+    req->done         = 0;
+    req->offset       = offset;
+
+    /* the request may complete before we return */
+    iosb->u.Status = STATUS_PENDING;
+    iosb->Information = 0;
+    if (event) NtResetEvent( event, NULL );
+
+    RtlEnterCriticalSection( &uring_section );
+    status = init_ring() ? queue_request( req ) : STATUS_NOT_IMPLEMENTED;
+    RtlLeaveCriticalSection( &uring_section );
+
+    if (status)
+    {
+        close( req->fd );
+        RtlFreeHeap( GetProcessHeap(), 0, req );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    TRACE( "%p %s %u bytes at %s\n", handle, is_read ? "reading" : "writing", length,
+           wine_dbgstr_longlong( offset ));
+    return STATUS_PENDING;
+}
+
+#else  /* HAVE_LINUX_IO_URING_H */
+
+NTSTATUS uring_submit_io( HANDLE handle, int unix_fd, enum server_fd_type type, BOOL is_read,
+                          HANDLE event, ULONG_PTR cvalue, IO_STATUS_BLOCK *iosb,
+                          void *buffer, ULONG length, ULONGLONG offset )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
@@ -52,6 +52,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -70,6 +71,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -101,6 +103,7 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -246,6 +249,111 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/***********************************************************************
+ *           views_tree functions
+ *
+ * The views are kept both in an address-ordered list, for walking
+ * neighbours, and in a red-black tree keyed by the address range, for
+ * lookups. Views never overlap, so an address compares equal to the
+ * view containing it.
+ */
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static int views_tree_compare( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if ((const char *)addr < (const char *)view->base) return -1;
+    if ((const char *)addr >= (const char *)view->base + view->size) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    views_tree_compare,
+};
+
+
+/***********************************************************************
+ *           find_view_after
+ *
+ * Find the first view ending after the specified address, i.e. either the
+ * view containing it or the next view above it.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_after( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *result = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else
+        {
+            result = view;
+            if (view->base <= addr) break;
+            ptr = ptr->left;
+        }
+    }
+    return result;
+}
+
+
+/***********************************************************************
+ *           find_view_before
+ *
+ * Find the last view starting before the specified address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_before( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *result = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if (view->base >= addr) ptr = ptr->left;
+        else
+        {
+            result = view;
+            ptr = ptr->right;
+        }
+    }
+    return result;
+}
+
+
+/***********************************************************************
+ *           next_view
+ */
+static inline struct file_view *next_view( struct file_view *view )
+{
+    struct list *ptr = list_next( &views_list, &view->entry );
+    return ptr ? LIST_ENTRY( ptr, struct file_view, entry ) : NULL;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -260,17 +368,14 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
+    struct wine_rb_entry *ptr;
     struct file_view *view;
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    if (!(ptr = wine_rb_get( &views_tree, addr ))) return NULL;
+    view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    return view;
 }
 
 
@@ -293,13 +398,9 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_after( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -312,6 +413,7 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
+    struct file_view *view;
     struct list *ptr;
     void *start;
 
@@ -320,9 +422,12 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* start from the last view that can overlap the candidate area */
+        if (!(view = find_view_before( (char *)start + size ))) return start;
+
+        for (ptr = &view->entry; ptr; ptr = list_prev( &views_list, ptr ))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base + view->size <= (char *)start) break;
             if ((char *)view->base >= (char *)start + size) continue;
@@ -336,9 +441,12 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        /* start from the first view that can overlap the candidate area */
+        if (!(view = find_view_after( start ))) return start;
+
+        for (ptr = &view->entry; ptr; ptr = list_next( &views_list, ptr ))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base >= (char *)start + size) break;
             if ((char *)view->base + view->size <= (char *)start) continue;
@@ -389,14 +497,13 @@ static void remove_reserved_area( void *addr, size_t size )
     wine_mmap_remove_reserved_area( addr, size, 0 );
 
     /* unmap areas not covered by an existing view */
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    for (view = find_view_after( addr ); view; view = next_view( view ))
     {
         if ((char *)view->base >= (char *)addr + size)
         {
             munmap( addr, size );
             break;
         }
-        if ((char *)view->base + view->size <= (char *)addr) continue;
         if (view->base > addr) munmap( addr, (char *)view->base - (char *)addr );
         if ((char *)view->base + view->size > (char *)addr + size) break;
         size = (char *)addr + size - ((char *)view->base + view->size);
@@ -442,6 +549,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
     list_remove( &view->entry );
+    wine_rb_remove( &views_tree, view->base );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
 }
@@ -454,8 +562,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
-    struct list *ptr;
+    struct file_view *view, *prev;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
     assert( !((UINT_PTR)base & page_mask) );
@@ -476,43 +583,28 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
-
     /* Check for overlapping views. This can happen if the previous view
      * was a system view that got unmapped behind our back. In that case
      * we recover by simply deleting it. */
 
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
+    while ((prev = find_view_range( base, size )))
     {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)prev->base + prev->size > (char *)base)
-        {
-            TRACE( "overlapping prev view %p-%p for %p-%p\n",
-                   prev->base, (char *)prev->base + prev->size,
-                   base, (char *)base + view->size );
-            assert( prev->protect & VPROT_SYSTEM );
-            delete_view( prev );
-        }
+        TRACE( "overlapping view %p-%p for %p-%p\n",
+               prev->base, (char *)prev->base + prev->size, base, (char *)base + size );
+        assert( prev->protect & VPROT_SYSTEM );
+        delete_view( prev );
     }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
+
+    /* Insert it in the tree and in the linked list */
+
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ) == -1)
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)base + view->size > (char *)next->base)
-        {
-            TRACE( "overlapping next view %p-%p for %p-%p\n",
-                   next->base, (char *)next->base + next->size,
-                   base, (char *)base + view->size );
-            assert( next->protect & VPROT_SYSTEM );
-            delete_view( next );
-        }
+        FIXME( "out of memory in virtual heap for %p-%p\n", base, (char *)base + size );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
     }
+    if ((prev = find_view_before( base ))) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
 
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
@@ -1051,6 +1143,180 @@ static NTSTATUS stat_mapping_file( struct file_view *view, struct stat *st )
 }
 
 
+/***********************************************************************
+ *           use_reloc_cache
+ *
+ * When WINERELOCCACHE is set, images that can't be mapped at their preferred
+ * base are moved to an address derived from the file identity, so that the
+ * processes of a prefix usually agree on it. The relocated image is saved
+ * in the prefix the first time, and mapped directly from there by later
+ * loads, so that its pages are shared until they are written to.
+ */
+static BOOL use_reloc_cache(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINERELOCCACHE" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+/* the range where relocated images are placed; for 32-bit processes it has to be below 2Gb,
+ * for 64-bit ones it's kept away from the default image bases */
+#ifdef _WIN64
+#define RELOC_CACHE_START 0x6000000000
+#define RELOC_CACHE_END   0x7000000000
+#else
+#define RELOC_CACHE_START 0x10000000
+#define RELOC_CACHE_END   0x60000000
+#endif
+
+/* first page of a cached image file, the image follows on the next page */
+struct reloc_cache_header
+{
+    char      magic[8];      /* RELOC_CACHE_MAGIC */
+    ULONG64   base;          /* address the image is relocated to */
+    ULONG64   total_size;    /* size of the image */
+    ULONG     header_size;   /* size of the PE headers of the original file */
+    ULONG     header_crc;    /* CRC of the PE headers of the original file */
+};
+
+#define RELOC_CACHE_MAGIC "WINERELC"
+
+static inline unsigned long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/***********************************************************************
+ *           get_reloc_cache_base
+ *
+ * Return the base address used for a relocated image.
+ */
+static void *get_reloc_cache_base( const struct stat *st, SIZE_T total_size, SIZE_T mask )
+{
+    UINT_PTR slots, hash;
+
+    if (total_size >= RELOC_CACHE_END - RELOC_CACHE_START) return NULL;
+    slots = (RELOC_CACHE_END - RELOC_CACHE_START - total_size) / (mask + 1);
+    hash = (UINT_PTR)st->st_ino * 0x9e3779b1 + (UINT_PTR)st->st_dev * 0x85ebca6b + (UINT_PTR)st->st_size;
+    return (char *)RELOC_CACHE_START + (hash % slots) * (mask + 1);
+}
+
+/***********************************************************************
+ *           get_reloc_cache_name
+ *
+ * Build the name of the cached image of a file relocated at a given base.
+ */
+static BOOL get_reloc_cache_name( char *name, size_t size, const struct stat *st, const void *base )
+{
+    int len = snprintf( name, size, "%s/relocs/%llx-%llx-%llx-%llx.%lx-%lx", wine_get_config_dir(),
+                        (unsigned long long)st->st_dev, (unsigned long long)st->st_ino,
+                        (unsigned long long)st->st_size, (unsigned long long)st->st_mtime,
+                        get_mtime_nsec( st ), (unsigned long)base );
+    return len > 0 && len < size;
+}
+
+/***********************************************************************
+ *           open_reloc_cache
+ *
+ * Open the cached image of a file relocated at a given base, if any. The
+ * cache file has to match the PE headers of the file, which are already
+ * mapped at base.
+ */
+static int open_reloc_cache( const struct stat *st, const void *base, SIZE_T total_size, SIZE_T header_size )
+{
+    char name[1024];
+    struct reloc_cache_header header;
+    struct stat cache_st;
+    int fd;
+
+    if (!get_reloc_cache_name( name, sizeof(name), st, base )) return -1;
+    if ((fd = open( name, O_RDONLY )) == -1) return -1;
+    if (fstat( fd, &cache_st ) == -1 || cache_st.st_size != page_size + total_size ||
+        pread( fd, &header, sizeof(header), 0 ) != sizeof(header) ||
+        memcmp( header.magic, RELOC_CACHE_MAGIC, sizeof(header.magic) ) ||
+        header.base != (UINT_PTR)base || header.total_size != total_size ||
+        header.header_size != header_size ||
+        header.header_crc != RtlComputeCrc32( 0, base, header_size ))
+    {
+        WARN_(module)( "ignoring invalid cache file %s\n", debugstr_a(name) );
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+/* write a whole buffer at a given file offset */
+static BOOL write_reloc_cache_data( int fd, const void *data, SIZE_T size, off_t offset )
+{
+    SIZE_T pos = 0;
+    ssize_t ret;
+
+    while (pos < size)
+    {
+        if ((ret = pwrite( fd, (const char *)data + pos, size - pos, offset + pos )) <= 0)
+        {
+            if (ret == -1 && errno == EINTR) continue;
+            return FALSE;
+        }
+        pos += ret;
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *           save_reloc_cache
+ *
+ * Save a copy of an image relocated at base to the cache. The file is
+ * written under a temporary name first so that other processes never see
+ * it partially.
+ */
+static void save_reloc_cache( const struct stat *st, const void *base, const char *ptr,
+                              SIZE_T total_size, SIZE_T header_size )
+{
+    char name[1024], tmp[1040], *p;
+    struct reloc_cache_header header;
+    BOOL ret;
+    int fd;
+
+    if (!get_reloc_cache_name( name, sizeof(name), st, base )) return;
+    p = strrchr( name, '/' );
+    *p = 0;
+    mkdir( name, 0777 );
+    *p = '/';
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, RELOC_CACHE_MAGIC, sizeof(header.magic) );
+    header.base = (UINT_PTR)base;
+    header.total_size = total_size;
+    header.header_size = header_size;
+    header.header_crc = RtlComputeCrc32( 0, (const BYTE *)ptr, header_size );
+
+    snprintf( tmp, sizeof(tmp), "%s.%u", name, getpid() );
+    if ((fd = open( tmp, O_WRONLY | O_CREAT | O_EXCL, 0666 )) == -1) return;
+    ret = write_reloc_cache_data( fd, &header, sizeof(header), 0 ) &&
+          write_reloc_cache_data( fd, ptr, total_size, page_size );
+    close( fd );
+    if (!ret || rename( tmp, name ) == -1)
+    {
+        WARN_(module)( "failed to save relocated image to %s\n", debugstr_a(name) );
+        unlink( tmp );
+        return;
+    }
+    TRACE_(module)( "saved relocated image to %s\n", debugstr_a(name) );
+}
+
+
 /***********************************************************************
  *           map_image
  *
@@ -1072,15 +1338,31 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
     struct file_view *view = NULL;
     char *ptr, *header_end, *header_start;
     INT_PTR delta = 0;
-
-    /* zero-map the whole range */
+    BOOL save_cache = FALSE;
+    struct file_view *cache_copy = NULL;
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
 
+    if (fstat( fd, &st ) == -1)
+    {
+        status = FILE_GetNtStatus();
+        goto error;
+    }
+
+    /* zero-map the whole range */
+
     if (base >= (char *)address_space_start)  /* make sure the DOS area remains free */
         status = map_view( &view, base, total_size, mask, FALSE,
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
 
+    if (status != STATUS_SUCCESS && use_reloc_cache())
+    {
+        char *cache_base = get_reloc_cache_base( &st, total_size, mask );
+        if (cache_base && cache_base != base)
+            status = map_view( &view, cache_base, total_size, mask, FALSE,
+                               VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
+    }
+
     if (status != STATUS_SUCCESS)
         status = map_view( &view, NULL, total_size, mask, FALSE,
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
@@ -1092,11 +1374,6 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
 
     /* map the header */
 
-    if (fstat( fd, &st ) == -1)
-    {
-        status = FILE_GetNtStatus();
-        goto error;
-    }
     status = STATUS_INVALID_IMAGE_FORMAT;  /* generic error */
     if (!st.st_size) goto error;
     header_size = min( header_size, st.st_size );
@@ -1144,6 +1421,35 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
         goto done;
     }
 
+    /* use the cached relocated image if there is one */
+
+    if (ptr != base && use_reloc_cache() &&
+        ((nt->FileHeader.Characteristics & IMAGE_FILE_DLL) || !NtCurrentTeb()->Peb->ImageBaseAddress) &&
+        !(nt->FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED))
+    {
+        int cache_fd;
+
+        for (i = 0; i < nt->FileHeader.NumberOfSections; i++)
+            if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+                (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) break;
+
+        /* shared sections have to be mapped from the server */
+        if (i == nt->FileHeader.NumberOfSections)
+        {
+            if ((cache_fd = open_reloc_cache( &st, ptr, total_size, header_size )) != -1)
+            {
+                status = map_file_into_view( view, cache_fd, 0, total_size, page_size,
+                                             VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE );
+                close( cache_fd );
+                if (status != STATUS_SUCCESS) goto error;
+                TRACE_(module)( "mapped relocated image from cache at %p\n", ptr );
+                delta = ptr - base;
+                goto set_protections;
+            }
+            save_cache = TRUE;
+        }
+    }
+
 
     /* map all the sections */
 
@@ -1275,8 +1581,15 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
                                              (USHORT *)(rel + 1), delta );
             if (!rel) goto error;
         }
+
+        /* the file is written once we are out of the critical section, from a private copy
+         * since the image protections may not allow reading all of it */
+        if (save_cache && map_view( &cache_copy, NULL, total_size, 0, FALSE,
+                                    VPROT_COMMITTED | VPROT_READ | VPROT_WRITE ) == STATUS_SUCCESS)
+            memcpy( cache_copy->base, ptr, total_size );
     }
 
+ set_protections:
     /* set the image protections */
 
     VIRTUAL_SetProt( view, ptr, ROUND_SIZE( 0, header_size ), VPROT_COMMITTED | VPROT_READ );
@@ -1311,6 +1624,17 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
     view->map_protect = map_vprot;
     server_leave_uninterrupted_section( &csVirtual, &sigset );
 
+    if (cache_copy)
+    {
+        void *copy_base = cache_copy->base;
+
+        save_reloc_cache( &st, ptr, copy_base, total_size, header_size );
+        server_enter_uninterrupted_section( &csVirtual, &sigset );
+        if ((cache_copy = VIRTUAL_FindView( copy_base, 0 )) && cache_copy->base == copy_base)
+            delete_view( cache_copy );
+        server_leave_uninterrupted_section( &csVirtual, &sigset );
+    }
+
     *addr_ptr = ptr;
 #ifdef VALGRIND_LOAD_PDB_DEBUGINFO
     VALGRIND_LOAD_PDB_DEBUGINFO(fd, ptr, total_size, delta);
@@ -1375,6 +1699,7 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    if (wine_rb_init( &views_tree, &views_tree_functions ) == -1) abort();
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2183,7 +2508,6 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
 {
     struct file_view *view;
     char *base, *alloc_base = 0;
-    struct list *ptr;
     SIZE_T size = 0;
     MEMORY_BASIC_INFORMATION *info = buffer;
     sigset_t sigset;
@@ -2239,30 +2563,18 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    if ((view = find_view_after( base )) && (char *)view->base <= base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
-        {
-            alloc_base = view->base;
-            size = view->size;
-            break;
-        }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        struct file_view *prev = find_view_before( base );
+
+        if (prev) alloc_base = (char *)prev->base + prev->size;
+        size = (view ? (char *)view->base : (char *)working_set_limit) - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
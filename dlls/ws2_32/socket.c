@@ -129,6 +129,12 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -155,6 +161,7 @@
 #include "wine/debug.h"
 #include "wine/exception.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 
 #ifdef HAS_IPX
 # include "wsnwlink.h"
@@ -333,6 +340,9 @@ typedef struct ws2_async
 {
     HANDLE                              hSocket;
     int                                 type;
+    struct list                         entry;      /* entry in the reactor queues */
+    struct reactor_socket              *reactor;    /* socket whose reactor queue holds it */
+    LONG                                refs;       /* held by the reactor queue and the server async */
     LPWSAOVERLAPPED                     user_overlapped;
     LPWSAOVERLAPPED_COMPLETION_ROUTINE  completion_func;
     IO_STATUS_BLOCK                     local_iosb;
@@ -363,6 +373,17 @@ typedef struct ws2_accept_async
     struct ws2_async    *read;
 } ws2_accept_async;
 
+typedef struct ws2_transmit_async
+{
+    SOCKET                      socket;
+    LPOVERLAPPED                user_overlapped;
+    ULONG_PTR                   cvalue;
+    DWORD                       flags;
+    DWORD                       send_size;  /* maximum size of a single send, 0 for default */
+    DWORD                       count;
+    TRANSMIT_PACKETS_ELEMENT    elements[1];
+} ws2_transmit_async;
+
 /****************************************************************/
 
 /* ----------------------------------- internal data */
@@ -415,7 +436,7 @@ static int ws_protocol_info(SOCKET s, int unicode, WSAPROTOCOL_INFOW *buffer, in
 int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
 
-static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information );
+static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information, BOOL sync );
 
 #define MAP_OPTION(opt) { WS_##opt, opt }
 
@@ -2030,7 +2051,7 @@ static NTSTATUS WS2_async_accept_recv( void *arg, IO_STATUS_BLOCK *iosb, NTSTATU
     if (wsa->user_overlapped->hEvent)
         SetEvent(wsa->user_overlapped->hEvent);
     if (wsa->cvalue)
-        WS_AddCompletion( HANDLE2SOCKET(wsa->listen_socket), wsa->cvalue, iosb->u.Status, iosb->Information );
+        WS_AddCompletion( HANDLE2SOCKET(wsa->listen_socket), wsa->cvalue, iosb->u.Status, iosb->Information, FALSE );
 
     *apc = ws2_async_accept_apc;
     return status;
@@ -2090,6 +2111,17 @@ static NTSTATUS WS2_async_accept( void *arg, IO_STATUS_BLOCK *iosb, NTSTATUS sta
     if (!wsa->read)
         goto finish;
 
+    /* clients usually send their request right after connecting, so try to
+     * read it now instead of queuing another async on the accepting socket */
+    status = WS2_async_recv( wsa->read, iosb, STATUS_ALERTED, apc );
+    if (status != STATUS_PENDING)
+    {
+        if (wsa->user_overlapped->hEvent)
+            SetEvent(wsa->user_overlapped->hEvent);
+        *apc = ws2_async_accept_apc;
+        return status;
+    }
+
     SERVER_START_REQ( register_async )
     {
         req->type           = ASYNC_TYPE_READ;
@@ -2240,6 +2272,399 @@ static NTSTATUS WS2_async_send(void* user, IO_STATUS_BLOCK* iosb, NTSTATUS statu
     return status;
 }
 
+/***********************************************************************
+ *              Socket reactor
+ *
+ * When WINESOCKREACTOR is set, overlapped recv and send operations that
+ * can't complete right away are handed to a reactor thread instead of
+ * being polled by the server. The reactor waits for readiness with epoll
+ * and completes them itself, setting the event or posting to the
+ * completion port. Operations with a completion routine still go through
+ * the server, which queues the APC to the right thread.
+ *
+ * Each queued operation is still registered with the server as a wait
+ * async on the socket, so that CancelIo, CancelIoEx and closing the last
+ * handle reach it; the reactor terminates that async itself before
+ * reporting a completion.
+ */
+#ifdef HAVE_SYS_EPOLL_H
+
+struct reactor_socket
+{
+    struct list entry;
+    SOCKET      s;
+    dev_t       dev;     /* identity of the unix socket, since handle values get reused */
+    ino_t       ino;
+    int         fd;      /* our own copy of the unix fd */
+    struct list reads;   /* pending recv operations, in submission order */
+    struct list writes;  /* pending send operations, in submission order */
+};
+
+static int reactor_epoll = -1;
+static struct list reactor_sockets = LIST_INIT( reactor_sockets );
+
+static CRITICAL_SECTION reactor_cs;
+static CRITICAL_SECTION_DEBUG reactor_cs_debug =
+{
+    0, 0, &reactor_cs,
+    { &reactor_cs_debug.ProcessLocksList, &reactor_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": reactor_cs") }
+};
+static CRITICAL_SECTION reactor_cs = { &reactor_cs_debug, -1, 0, 0, 0, 0 };
+
+static BOOL use_reactor(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINESOCKREACTOR" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+/* find the entry of a socket, provided it still refers to the same unix socket;
+ * the reactor_cs must be held */
+static struct reactor_socket *find_reactor_socket( SOCKET s, int fd )
+{
+    struct reactor_socket *rs;
+    struct stat st;
+    BOOL checked = FALSE;
+
+    LIST_FOR_EACH_ENTRY( rs, &reactor_sockets, struct reactor_socket, entry )
+    {
+        if (rs->s != s) continue;
+        if (!checked && fstat( fd, &st ) == -1) return NULL;
+        checked = TRUE;
+        if (rs->dev == st.st_dev && rs->ino == st.st_ino) return rs;
+    }
+    return NULL;
+}
+
+/* check that an entry returned by epoll hasn't been freed since, the reactor_cs must be held */
+static BOOL is_reactor_socket( const struct reactor_socket *ptr )
+{
+    struct reactor_socket *rs;
+
+    LIST_FOR_EACH_ENTRY( rs, &reactor_sockets, struct reactor_socket, entry )
+        if (rs == ptr) return TRUE;
+    return FALSE;
+}
+
+/* update the epoll events of a socket, and forget it once it has nothing pending */
+static void update_reactor_socket( struct reactor_socket *rs )
+{
+    struct epoll_event ev;
+
+    ev.events = (list_empty( &rs->reads ) ? 0 : EPOLLIN) | (list_empty( &rs->writes ) ? 0 : EPOLLOUT);
+    ev.data.ptr = rs;
+    if (ev.events)
+    {
+        epoll_ctl( reactor_epoll, EPOLL_CTL_MOD, rs->fd, &ev );
+        return;
+    }
+    epoll_ctl( reactor_epoll, EPOLL_CTL_DEL, rs->fd, &ev );
+    close( rs->fd );
+    list_remove( &rs->entry );
+    HeapFree( GetProcessHeap(), 0, rs );
+}
+
+static void release_reactor_async( ws2_async *wsa )
+{
+    if (!InterlockedDecrement( &wsa->refs )) HeapFree( GetProcessHeap(), 0, wsa );
+}
+
+/* report the completion of an operation taken off its queue, the reactor_cs must not be held */
+static void reactor_complete( ws2_async *wsa )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->user_overlapped;
+    HANDLE event = (HANDLE)((ULONG_PTR)wsa->user_overlapped->hEvent & ~1);
+    BOOL post = !((ULONG_PTR)wsa->user_overlapped->hEvent & 1);
+    BOOL is_read = (wsa->type == ASYNC_TYPE_READ);
+
+    TRACE( "socket %p %s status %x %lu bytes\n", wsa->hSocket, is_read ? "recv" : "send",
+           wsa->local_iosb.u.Status, wsa->local_iosb.Information );
+
+    iosb->Information = wsa->local_iosb.Information;
+    iosb->u.Status = wsa->local_iosb.u.Status;
+    _enable_event( wsa->hSocket, is_read ? FD_READ : FD_WRITE, 0, 0 );
+    if (post) WS_AddCompletion( HANDLE2SOCKET(wsa->hSocket), (ULONG_PTR)wsa->user_overlapped,
+                                iosb->u.Status, iosb->Information, FALSE );
+    if (event) SetEvent( event );
+    release_reactor_async( wsa );
+}
+
+/***********************************************************************
+ *              WS2_async_reactor
+ *
+ * Called when the server terminates the async of a queued operation:
+ * because the reactor completed it, because of CancelIo or CancelIoEx,
+ * or because the socket is gone.
+ */
+static NTSTATUS WS2_async_reactor( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status, void **apc )
+{
+    ws2_async *wsa = user;
+    struct reactor_socket *rs;
+
+    EnterCriticalSection( &reactor_cs );
+    if ((rs = wsa->reactor))
+    {
+        list_remove( &wsa->entry );
+        wsa->reactor = NULL;
+        update_reactor_socket( rs );
+    }
+    LeaveCriticalSection( &reactor_cs );
+
+    if (rs)
+    {
+        wsa->local_iosb.u.Status = status;
+        reactor_complete( wsa );
+    }
+    release_reactor_async( wsa );
+    /* the result has been reported already, and the iosb may have been reused */
+    return STATUS_MORE_PROCESSING_REQUIRED;
+}
+
+/* terminate the server async of an operation before reporting its completion */
+static void reactor_retire( ws2_async *wsa )
+{
+    NTSTATUS status;
+
+    SERVER_START_REQ( cancel_async )
+    {
+        req->handle      = wine_server_obj_handle( wsa->hSocket );
+        req->iosb        = wine_server_client_ptr( wsa->user_overlapped );
+        req->only_thread = FALSE;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    /* the handle was closed while the operation was running */
+    if (status == STATUS_INVALID_HANDLE) wsa->local_iosb.u.Status = STATUS_CANCELLED;
+}
+
+/* try to complete the pending operations of a socket, the reactor_cs must be held */
+static void reactor_process( struct reactor_socket *rs, BOOL is_read, struct list *done )
+{
+    struct list *queue = is_read ? &rs->reads : &rs->writes;
+    struct list *ptr;
+    int n;
+
+    while ((ptr = list_head( queue )))
+    {
+        ws2_async *wsa = LIST_ENTRY( ptr, ws2_async, entry );
+
+        n = is_read ? WS2_recv( rs->fd, wsa ) : WS2_send( rs->fd, wsa );
+        if (n == -1)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            wsa->local_iosb.u.Status = wsaErrStatus();
+        }
+        else
+        {
+            wsa->local_iosb.Information += n;
+            /* sends are only complete once the whole buffer is sent */
+            if (!is_read && wsa->first_iovec < wsa->n_iovecs) continue;
+            wsa->local_iosb.u.Status = STATUS_SUCCESS;
+        }
+        list_remove( &wsa->entry );
+        list_add_tail( done, &wsa->entry );
+        wsa->reactor = NULL;
+    }
+}
+
+static DWORD WINAPI reactor_thread( void *arg )
+{
+    struct epoll_event events[64];
+    int i, count;
+
+    for (;;)
+    {
+        struct list done;
+        struct list *ptr;
+
+        if ((count = epoll_wait( reactor_epoll, events, sizeof(events)/sizeof(events[0]), -1 )) == -1)
+        {
+            if (errno == EINTR) continue;
+            ERR( "epoll_wait failed: %s\n", strerror( errno ));
+            return 1;
+        }
+
+        list_init( &done );
+        EnterCriticalSection( &reactor_cs );
+        for (i = 0; i < count; i++)
+        {
+            struct reactor_socket *rs = events[i].data.ptr;
+
+            if (!is_reactor_socket( rs )) continue;  /* forgotten in the meantime */
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) reactor_process( rs, TRUE, &done );
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) reactor_process( rs, FALSE, &done );
+            update_reactor_socket( rs );
+        }
+        LeaveCriticalSection( &reactor_cs );
+
+        while ((ptr = list_head( &done )))
+        {
+            ws2_async *wsa = LIST_ENTRY( ptr, ws2_async, entry );
+
+            list_remove( ptr );
+            reactor_retire( wsa );
+            reactor_complete( wsa );
+        }
+    }
+}
+
+/* check whether a socket has pending operations, new ones have to be queued after them */
+static BOOL reactor_pending( SOCKET s, int fd, BOOL is_read )
+{
+    struct reactor_socket *rs;
+    BOOL ret;
+
+    if (reactor_epoll == -1) return FALSE;
+    EnterCriticalSection( &reactor_cs );
+    rs = find_reactor_socket( s, fd );
+    ret = rs && !list_empty( is_read ? &rs->reads : &rs->writes );
+    LeaveCriticalSection( &reactor_cs );
+    return ret;
+}
+
+/***********************************************************************
+ *              reactor_queue
+ *
+ * Queue an overlapped operation to the reactor. The iosb must be set to
+ * pending already, since the operation can complete before we return.
+ */
+static BOOL reactor_queue( SOCKET s, int fd, ws2_async *wsa, BOOL is_read, ULONG done )
+{
+    struct reactor_socket *rs;
+    struct epoll_event ev;
+    struct stat st;
+    HANDLE thread;
+    NTSTATUS status;
+
+    if (!use_reactor() || wsa->completion_func || !wsa->user_overlapped) return FALSE;
+
+    EnterCriticalSection( &reactor_cs );
+    if (reactor_epoll == -1)
+    {
+        if ((reactor_epoll = epoll_create( 64 )) == -1) goto failed;
+        if (!(thread = CreateThread( NULL, 0, reactor_thread, NULL, 0, NULL )))
+        {
+            close( reactor_epoll );
+            reactor_epoll = -1;
+            goto failed;
+        }
+        CloseHandle( thread );
+    }
+
+    if (!(rs = find_reactor_socket( s, fd )))
+    {
+        if (fstat( fd, &st ) == -1) goto failed;
+        if (!(rs = HeapAlloc( GetProcessHeap(), 0, sizeof(*rs) ))) goto failed;
+        rs->s   = s;
+        rs->dev = st.st_dev;
+        rs->ino = st.st_ino;
+        list_init( &rs->reads );
+        list_init( &rs->writes );
+        ev.events = 0;
+        ev.data.ptr = rs;
+        if ((rs->fd = dup( fd )) == -1 || epoll_ctl( reactor_epoll, EPOLL_CTL_ADD, rs->fd, &ev ) == -1)
+        {
+            if (rs->fd != -1) close( rs->fd );
+            HeapFree( GetProcessHeap(), 0, rs );
+            goto failed;
+        }
+        list_add_tail( &reactor_sockets, &rs->entry );
+    }
+
+    wsa->type = is_read ? ASYNC_TYPE_READ : ASYNC_TYPE_WRITE;
+    wsa->refs = 2;  /* one for the queue, one for the server async */
+    wsa->local_iosb.u.Status = STATUS_PENDING;
+    wsa->local_iosb.Information = done;
+
+    SERVER_START_REQ( register_async )
+    {
+        req->type           = ASYNC_TYPE_WAIT;
+        req->async.handle   = wine_server_obj_handle( wsa->hSocket );
+        req->async.callback = wine_server_client_ptr( WS2_async_reactor );
+        req->async.iosb     = wine_server_client_ptr( wsa->user_overlapped );
+        req->async.arg      = wine_server_client_ptr( wsa );
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    if (status != STATUS_PENDING)
+    {
+        update_reactor_socket( rs );  /* forget it again if it was just added */
+        goto failed;
+    }
+
+    wsa->reactor = rs;
+    list_add_tail( is_read ? &rs->reads : &rs->writes, &wsa->entry );
+    update_reactor_socket( rs );
+    LeaveCriticalSection( &reactor_cs );
+    TRACE( "queued %s on socket %04lx\n", is_read ? "recv" : "send", s );
+    return TRUE;
+
+failed:
+    LeaveCriticalSection( &reactor_cs );
+    return FALSE;
+}
+
+/* abort the pending operations of a socket that is being closed */
+static void reactor_close( SOCKET s )
+{
+    struct reactor_socket *rs;
+    struct list done;
+    struct list *ptr;
+    int fd;
+
+    if (reactor_epoll == -1) return;
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1) return;
+
+    list_init( &done );
+    EnterCriticalSection( &reactor_cs );
+    if ((rs = find_reactor_socket( s, fd )))
+    {
+        list_move_tail( &done, &rs->reads );
+        list_move_tail( &done, &rs->writes );
+        LIST_FOR_EACH( ptr, &done ) LIST_ENTRY( ptr, ws2_async, entry )->reactor = NULL;
+        update_reactor_socket( rs );
+    }
+    LeaveCriticalSection( &reactor_cs );
+    release_sock_fd( s, fd );
+
+    /* their server asyncs go away with the handle */
+    while ((ptr = list_head( &done )))
+    {
+        ws2_async *wsa = LIST_ENTRY( ptr, ws2_async, entry );
+
+        list_remove( ptr );
+        wsa->local_iosb.u.Status = STATUS_CANCELLED;
+        reactor_complete( wsa );
+    }
+}
+
+#else  /* HAVE_SYS_EPOLL_H */
+
+static inline BOOL reactor_pending( SOCKET s, int fd, BOOL is_read )
+{
+    return FALSE;
+}
+
+static inline BOOL reactor_queue( SOCKET s, int fd, ws2_async *wsa, BOOL is_read, ULONG done )
+{
+    return FALSE;
+}
+
+static inline void reactor_close( SOCKET s )
+{
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
+
 /***********************************************************************
  *              WS2_async_shutdown      (INTERNAL)
  *
@@ -2495,6 +2920,302 @@ static void WINAPI WS2_GetAcceptExSockaddrs(PVOID buffer, DWORD data_size, DWORD
     *remote_addr = (struct WS_sockaddr *)(cbuf + sizeof(int));
 }
 
+#define TRANSMIT_BUFFER_SIZE 0x10000
+
+/***********************************************************************
+ *              WS2_transmit_buffer                (INTERNAL)
+ *
+ * Send a memory buffer, blocking until the socket has accepted all of it.
+ */
+static NTSTATUS WS2_transmit_buffer( int fd, const char *buf, ULONG len, ULONG_PTR *total )
+{
+    int n;
+
+    while (len)
+    {
+        if ((n = send( fd, buf, len, 0 )) < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return wsaErrStatus();
+            do_block( fd, POLLOUT, -1 );
+            continue;
+        }
+        buf += n;
+        len -= n;
+        *total += n;
+    }
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              WS2_transmit_file                  (INTERNAL)
+ *
+ * Send part of a file. The data is handed from the file to the socket with
+ * sendfile() when possible so that it never has to be copied to user space.
+ */
+static NTSTATUS WS2_transmit_file( int fd, HANDLE file, LONGLONG offset, ULONG len,
+                                   DWORD send_size, ULONG_PTR *total )
+{
+    FILE_POSITION_INFORMATION pos;
+    IO_STATUS_BLOCK io;
+    ULONGLONG remaining = len;
+    char *buffer = NULL;
+    NTSTATUS status;
+    struct stat st;
+    int file_fd, n;
+
+    if ((status = wine_server_handle_to_fd( file, FILE_READ_DATA, &file_fd, NULL ))) return status;
+
+    if (offset == -1)  /* use the current file position */
+    {
+        status = NtQueryInformationFile( file, &io, &pos, sizeof(pos), FilePositionInformation );
+        if (status) goto done;
+        offset = pos.CurrentByteOffset.QuadPart;
+    }
+    if (!remaining)  /* send the rest of the file */
+    {
+        if (fstat( file_fd, &st ) == -1)
+        {
+            status = wsaErrStatus();
+            goto done;
+        }
+        if (st.st_size > offset) remaining = st.st_size - offset;
+    }
+    if (!send_size) send_size = 0x7ffff000;
+
+    while (remaining)
+    {
+        size_t count = min( remaining, send_size );
+
+#ifdef HAVE_SYS_SENDFILE_H
+        if (!buffer)
+        {
+            off_t off = offset;
+            ssize_t ret = sendfile( fd, file_fd, &off, count );
+
+            if (ret > 0)
+            {
+                offset += ret;
+                remaining -= ret;
+                *total += ret;
+                continue;
+            }
+            if (!ret) break;  /* end of file */
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN)
+            {
+                do_block( fd, POLLOUT, -1 );
+                continue;
+            }
+            if (errno != EINVAL && errno != ENOSYS)
+            {
+                status = wsaErrStatus();
+                break;
+            }
+            /* sendfile() doesn't support this file, copy the data ourselves */
+        }
+#endif
+        if (!buffer && !(buffer = HeapAlloc( GetProcessHeap(), 0, TRANSMIT_BUFFER_SIZE )))
+        {
+            status = STATUS_NO_MEMORY;
+            break;
+        }
+        if ((n = pread( file_fd, buffer, min( count, TRANSMIT_BUFFER_SIZE ), offset )) < 0)
+        {
+            if (errno == EINTR) continue;
+            status = wsaErrStatus();
+            break;
+        }
+        if (!n) break;
+        if ((status = WS2_transmit_buffer( fd, buffer, n, total ))) break;
+        offset += n;
+        remaining -= n;
+    }
+
+done:
+    HeapFree( GetProcessHeap(), 0, buffer );
+    wine_server_release_fd( file, file_fd );
+    return status;
+}
+
+/***********************************************************************
+ *              WS2_transmit                       (INTERNAL)
+ *
+ * Workhorse for TransmitFile and TransmitPackets.
+ */
+static NTSTATUS WS2_transmit( ws2_transmit_async *wsa, ULONG_PTR *total )
+{
+    TRANSMIT_PACKETS_ELEMENT *element;
+    NTSTATUS status;
+    DWORD i;
+    int fd, cork = 1;
+
+    if ((status = wine_server_handle_to_fd( SOCKET2HANDLE(wsa->socket), FILE_WRITE_DATA, &fd, NULL )))
+        return status;
+
+#ifdef TCP_CORK
+    /* don't send partial segments between the elements */
+    if (wsa->count > 1) setsockopt( fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork) );
+#endif
+    for (i = 0; i < wsa->count && !status; i++)
+    {
+        element = &wsa->elements[i];
+        if (element->dwElFlags & TP_ELEMENT_FILE)
+            status = WS2_transmit_file( fd, element->u.s.hFile, element->u.s.nFileOffset.QuadPart,
+                                        element->cLength, wsa->send_size, total );
+        else if (element->dwElFlags & TP_ELEMENT_MEMORY)
+            status = WS2_transmit_buffer( fd, element->u.pBuffer, element->cLength, total );
+    }
+#ifdef TCP_CORK
+    cork = 0;
+    if (wsa->count > 1) setsockopt( fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork) );
+#endif
+    wine_server_release_fd( SOCKET2HANDLE(wsa->socket), fd );
+
+    _enable_event( SOCKET2HANDLE(wsa->socket), FD_WRITE, 0, 0 );
+    if (!status && (wsa->flags & TF_DISCONNECT)) WS_shutdown( wsa->socket, SD_SEND );
+    return status;
+}
+
+static DWORD WINAPI WS2_transmit_proc( void *arg )
+{
+    ws2_transmit_async *wsa = arg;
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->user_overlapped;
+    ULONG_PTR total = 0;
+    NTSTATUS status;
+
+    status = WS2_transmit( wsa, &total );
+    TRACE( "socket %04lx status %x %lu bytes\n", wsa->socket, status, total );
+
+    /* GetOverlappedResult may look at the status as soon as it changes */
+    iosb->Information = total;
+    iosb->u.Status = status;
+    if (wsa->cvalue) WS_AddCompletion( wsa->socket, wsa->cvalue, status, total, FALSE );
+    if (wsa->user_overlapped->hEvent) SetEvent( wsa->user_overlapped->hEvent );
+    HeapFree( GetProcessHeap(), 0, wsa );
+    return 0;
+}
+
+/* run a transmit request, in a worker thread for overlapped requests */
+static BOOL WS2_transmit_start( ws2_transmit_async *wsa )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->user_overlapped;
+    ULONG_PTR total = 0;
+    NTSTATUS status;
+
+    if (!iosb)
+    {
+        status = WS2_transmit( wsa, &total );
+        HeapFree( GetProcessHeap(), 0, wsa );
+        return !set_error( status );
+    }
+
+    wsa->cvalue = ((ULONG_PTR)wsa->user_overlapped->hEvent & 1) ? 0 : (ULONG_PTR)wsa->user_overlapped;
+    iosb->u.Status = STATUS_PENDING;
+    iosb->Information = 0;
+    if (wsa->user_overlapped->hEvent) ResetEvent( wsa->user_overlapped->hEvent );
+
+    if (!QueueUserWorkItem( WS2_transmit_proc, wsa, WT_EXECUTELONGFUNCTION ))
+    {
+        HeapFree( GetProcessHeap(), 0, wsa );
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    SetLastError( WSA_IO_PENDING );
+    return FALSE;
+}
+
+/***********************************************************************
+ *     TransmitFile
+ */
+static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE file, DWORD total_len, DWORD send_size,
+                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers,
+                                     DWORD flags )
+{
+    ws2_transmit_async *wsa;
+    int fd;
+
+    TRACE( "(%lx, %p, %u, %u, %p, %p, %x)\n", s, file, total_len, send_size, overlapped, buffers, flags );
+
+    if ((fd = get_sock_fd( s, FILE_WRITE_DATA, NULL )) == -1) return FALSE;
+    release_sock_fd( s, fd );
+
+    if (!(wsa = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( ws2_transmit_async, elements[3] ))))
+    {
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    wsa->socket          = s;
+    wsa->user_overlapped = overlapped;
+    wsa->cvalue          = 0;
+    wsa->flags           = flags;
+    wsa->send_size       = send_size;
+    wsa->count           = 0;
+
+    if (buffers && buffers->HeadLength)
+    {
+        wsa->elements[wsa->count].dwElFlags = TP_ELEMENT_MEMORY;
+        wsa->elements[wsa->count].cLength   = buffers->HeadLength;
+        wsa->elements[wsa->count].u.pBuffer = buffers->Head;
+        wsa->count++;
+    }
+    if (file)
+    {
+        wsa->elements[wsa->count].dwElFlags = TP_ELEMENT_FILE;
+        wsa->elements[wsa->count].cLength   = total_len;
+        wsa->elements[wsa->count].u.s.hFile = file;
+        if (overlapped)
+        {
+            wsa->elements[wsa->count].u.s.nFileOffset.u.LowPart  = overlapped->u.s.Offset;
+            wsa->elements[wsa->count].u.s.nFileOffset.u.HighPart = overlapped->u.s.OffsetHigh;
+        }
+        else wsa->elements[wsa->count].u.s.nFileOffset.QuadPart = -1;
+        wsa->count++;
+    }
+    if (buffers && buffers->TailLength)
+    {
+        wsa->elements[wsa->count].dwElFlags = TP_ELEMENT_MEMORY;
+        wsa->elements[wsa->count].cLength   = buffers->TailLength;
+        wsa->elements[wsa->count].u.pBuffer = buffers->Tail;
+        wsa->count++;
+    }
+    return WS2_transmit_start( wsa );
+}
+
+/***********************************************************************
+ *     TransmitPackets
+ */
+static BOOL WINAPI WS2_TransmitPackets( SOCKET s, LPTRANSMIT_PACKETS_ELEMENT elements, DWORD count,
+                                        DWORD send_size, LPOVERLAPPED overlapped, DWORD flags )
+{
+    ws2_transmit_async *wsa;
+    int fd;
+
+    TRACE( "(%lx, %p, %u, %u, %p, %x)\n", s, elements, count, send_size, overlapped, flags );
+
+    if (count && !elements)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if ((fd = get_sock_fd( s, FILE_WRITE_DATA, NULL )) == -1) return FALSE;
+    release_sock_fd( s, fd );
+
+    if (!(wsa = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( ws2_transmit_async, elements[count] ))))
+    {
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    wsa->socket          = s;
+    wsa->user_overlapped = overlapped;
+    wsa->cvalue          = 0;
+    wsa->flags           = flags;
+    wsa->send_size       = send_size;
+    wsa->count           = count;
+    memcpy( wsa->elements, elements, count * sizeof(*elements) );
+    return WS2_transmit_start( wsa );
+}
+
 /***********************************************************************
  *     WSASendMsg
  */
@@ -2704,6 +3425,7 @@ int WINAPI WS_bind(SOCKET s, const struct WS_sockaddr* name, int namelen)
 int WINAPI WS_closesocket(SOCKET s)
 {
     TRACE("socket %04lx\n", s);
+    reactor_close( s );
     if (CloseHandle(SOCKET2HANDLE(s))) return 0;
     return SOCKET_ERROR;
 }
@@ -3976,11 +4698,13 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         }
         else if ( IsEqualGUID(&transmitfile_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitFile\n");
+            *(LPFN_TRANSMITFILE *)out_buff = WS2_TransmitFile;
+            break;
         }
         else if ( IsEqualGUID(&transmitpackets_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitPackets\n");
+            *(LPFN_TRANSMITPACKETS *)out_buff = WS2_TransmitPackets;
+            break;
         }
         else if ( IsEqualGUID(&wsarecvmsg_guid, in_buff) )
         {
@@ -4118,7 +4842,7 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         overlapped->Internal = status;
         overlapped->InternalHigh = total;
         if (overlapped->hEvent) NtSetEvent( overlapped->hEvent, NULL );
-        if (cvalue) WS_AddCompletion( HANDLE2SOCKET(s), cvalue, status, total );
+        if (cvalue) WS_AddCompletion( HANDLE2SOCKET(s), cvalue, status, total, TRUE );
     }
 
     if (!status)
@@ -4390,7 +5114,7 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
 
 /* helper to send completion messages for client-only i/o operation case */
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus,
-                              ULONG Information )
+                              ULONG Information, BOOL sync )
 {
     SERVER_START_REQ( add_fd_completion )
     {
@@ -4398,6 +5122,7 @@ static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS C
         req->cvalue      = CompletionValue;
         req->status      = CompletionStatus;
         req->information = Information;
+        req->sync        = sync;
         wine_server_call( req );
     }
     SERVER_END_REQ;
@@ -4493,6 +5218,13 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
     for (;;)
     {
+        /* operations queued to the reactor have to complete first */
+        if (lpOverlapped && !lpCompletionRoutine && reactor_pending( s, fd, FALSE ))
+        {
+            n = -1;
+            errno = EAGAIN;
+            break;
+        }
         n = WS2_send( fd, wsa );
         if (n != -1 || errno != EINTR) break;
     }
@@ -4509,13 +5241,23 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
         wsa->user_overlapped = lpOverlapped;
         wsa->completion_func = lpCompletionRoutine;
-        release_sock_fd( s, fd );
 
         if (n == -1 || n < totalLength)
         {
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = n == -1 ? 0 : n;
 
+            if (reactor_queue( s, fd, wsa, FALSE, iosb->Information ))
+            {
+                release_sock_fd( s, fd );
+                WSASetLastError( WSA_IO_PENDING );
+                return SOCKET_ERROR;
+            }
+        }
+        release_sock_fd( s, fd );
+
+        if (n == -1 || n < totalLength)
+        {
             SERVER_START_REQ( register_async )
             {
                 req->type           = ASYNC_TYPE_WRITE;
@@ -4543,7 +5285,7 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
         if (lpNumberOfBytesSent) *lpNumberOfBytesSent = n;
         if (!wsa->completion_func)
         {
-            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
+            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, TRUE );
             if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
             HeapFree( GetProcessHeap(), 0, wsa );
         }
@@ -6494,7 +7236,13 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
     for (;;)
     {
-        n = WS2_recv( fd, wsa );
+        /* operations queued to the reactor have to complete first */
+        if (lpOverlapped && !lpCompletionRoutine && reactor_pending( s, fd, TRUE ))
+        {
+            n = -1;
+            errno = EAGAIN;
+        }
+        else n = WS2_recv( fd, wsa );
         if (n == -1)
         {
             if (errno == EINTR) continue;
@@ -6502,7 +7250,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             {
                 int loc_errno = errno;
                 err = wsaErrno();
-                if (cvalue) WS_AddCompletion( s, cvalue, sock_get_ntstatus(loc_errno), 0 );
+                if (cvalue) WS_AddCompletion( s, cvalue, sock_get_ntstatus(loc_errno), 0, TRUE );
                 goto error;
             }
         }
@@ -6515,13 +7263,23 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
             wsa->user_overlapped = lpOverlapped;
             wsa->completion_func = lpCompletionRoutine;
-            release_sock_fd( s, fd );
 
             if (n == -1)
             {
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
 
+                if (reactor_queue( s, fd, wsa, TRUE, 0 ))
+                {
+                    release_sock_fd( s, fd );
+                    WSASetLastError( WSA_IO_PENDING );
+                    return SOCKET_ERROR;
+                }
+            }
+            release_sock_fd( s, fd );
+
+            if (n == -1)
+            {
                 SERVER_START_REQ( register_async )
                 {
                     req->type           = ASYNC_TYPE_READ;
@@ -6544,7 +7302,7 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->Information = n;
             if (!wsa->completion_func)
             {
-                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
+                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, TRUE );
                 if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
                 HeapFree( GetProcessHeap(), 0, wsa );
             }
@@ -7606,6 +7606,420 @@ todo_wine
     ok(!ret, "WSALookupServiceEnd failed unexpectedly\n");
 }
 
+static void test_completion_skip_on_success(void)
+{
+    BOOL (WINAPI *pSetFileCompletionNotificationModes)(HANDLE, UCHAR);
+    WSAOVERLAPPED ov, *olp;
+    SOCKET src, dst;
+    HANDLE port;
+    WSABUF wsabuf;
+    ULONG_PTR key;
+    DWORD bytes, flags;
+    char buf[16];
+    BOOL bret;
+    int ret;
+
+    pSetFileCompletionNotificationModes = (void *)GetProcAddress( GetModuleHandleA("kernel32.dll"),
+                                                                  "SetFileCompletionNotificationModes" );
+    if (!pSetFileCompletionNotificationModes)
+    {
+        win_skip( "SetFileCompletionNotificationModes not available\n" );
+        return;
+    }
+    if (tcp_socketpair( &src, &dst ))
+    {
+        skip( "failed to create sockets\n" );
+        return;
+    }
+
+    port = CreateIoCompletionPort( (HANDLE)dst, NULL, 125, 0 );
+    ok( port != NULL, "CreateIoCompletionPort error %u\n", GetLastError() );
+    bret = pSetFileCompletionNotificationModes( (HANDLE)dst, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS );
+    ok( bret, "SetFileCompletionNotificationModes error %u\n", GetLastError() );
+
+    wsabuf.buf = buf;
+    wsabuf.len = sizeof(buf);
+
+    /* a receive that completes immediately doesn't queue a packet */
+    ret = send( src, "data", 4, 0 );
+    ok( ret == 4, "send returned %d\n", ret );
+    Sleep( 100 );
+    memset( &ov, 0, sizeof(ov) );
+    flags = 0;
+    ret = WSARecv( dst, &wsabuf, 1, &bytes, &flags, &ov, NULL );
+    ok( !ret, "WSARecv returned %d error %d\n", ret, WSAGetLastError() );
+    ok( bytes == 4, "got %u bytes\n", bytes );
+    olp = (WSAOVERLAPPED *)0xdeadbeef;
+    bret = GetQueuedCompletionStatus( port, &bytes, &key, &olp, 100 );
+    ok( !bret && GetLastError() == WAIT_TIMEOUT, "got unexpected packet, error %u\n", GetLastError() );
+    ok( !olp, "got overlapped %p\n", olp );
+
+    /* but one that stays pending still does */
+    memset( &ov, 0, sizeof(ov) );
+    flags = 0;
+    ret = WSARecv( dst, &wsabuf, 1, &bytes, &flags, &ov, NULL );
+    ok( ret == SOCKET_ERROR && WSAGetLastError() == WSA_IO_PENDING,
+        "WSARecv returned %d error %d\n", ret, WSAGetLastError() );
+    ret = send( src, "more data", 9, 0 );
+    ok( ret == 9, "send returned %d\n", ret );
+    olp = NULL;
+    bret = GetQueuedCompletionStatus( port, &bytes, &key, &olp, 1000 );
+    ok( bret, "GetQueuedCompletionStatus error %u\n", GetLastError() );
+    ok( key == 125, "got key %lx\n", key );
+    ok( olp == &ov, "got overlapped %p\n", olp );
+    ok( bytes == 9, "got %u bytes\n", bytes );
+
+    closesocket( src );
+    closesocket( dst );
+    CloseHandle( port );
+}
+
+#define IOCP_PAIRS  32
+#define IOCP_ROUNDS 100
+
+static void test_overlapped_recv_throughput(void)
+{
+    SOCKET src[IOCP_PAIRS], dst[IOCP_PAIRS];
+    char buffers[IOCP_PAIRS][2][16], msg[16];
+    WSAOVERLAPPED ovl[IOCP_PAIRS][2], *povl;
+    LARGE_INTEGER start, end, freq;
+    DWORD i, flags, size, received = 0;
+    ULONG_PTR key;
+    WSABUF wsabuf;
+    HANDLE port;
+    BOOL ret;
+    int iret;
+
+    port = CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 0 );
+    ok( port != NULL, "CreateIoCompletionPort error %u\n", GetLastError() );
+
+    for (i = 0; i < IOCP_PAIRS; i++)
+    {
+        if (tcp_socketpair( &src[i], &dst[i] ))
+        {
+            skip( "failed to create sockets\n" );
+            while (i--)
+            {
+                closesocket( src[i] );
+                closesocket( dst[i] );
+            }
+            CloseHandle( port );
+            return;
+        }
+        CreateIoCompletionPort( (HANDLE)dst[i], port, i, 0 );
+    }
+
+    /* two pending receives on every socket, they must complete in order */
+    memset( ovl, 0, sizeof(ovl) );
+    for (i = 0; i < 2 * IOCP_PAIRS; i++)
+    {
+        wsabuf.buf = buffers[i / 2][i % 2];
+        wsabuf.len = sizeof(msg);
+        flags = 0;
+        iret = WSARecv( dst[i / 2], &wsabuf, 1, NULL, &flags, &ovl[i / 2][i % 2], NULL );
+        ok( iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+            "WSARecv returned %d error %d\n", iret, WSAGetLastError() );
+    }
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < IOCP_PAIRS * IOCP_ROUNDS; i++)
+    {
+        sprintf( msg, "%04u-%010u", i % IOCP_PAIRS, i / IOCP_PAIRS );
+        iret = send( src[i % IOCP_PAIRS], msg, sizeof(msg), 0 );
+        ok( iret == sizeof(msg), "send returned %d error %d\n", iret, WSAGetLastError() );
+    }
+
+    while (received < IOCP_PAIRS * IOCP_ROUNDS)
+    {
+        DWORD pair, slot;
+
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 5000 );
+        ok( ret, "GetQueuedCompletionStatus error %u after %u messages\n", GetLastError(), received );
+        if (!ret) break;
+        pair = povl - ovl[0];
+        slot = pair % 2;
+        pair /= 2;
+        ok( key == pair, "got key %lu for pair %u\n", key, pair );
+        ok( size == sizeof(msg), "got size %u\n", size );
+        ok( atoi( buffers[pair][slot] ) == pair, "pair %u: got %.16s\n", pair, buffers[pair][slot] );
+        /* receives are satisfied in the order they were queued */
+        ok( atoi( buffers[pair][slot] + 5 ) % 2 == slot, "pair %u: got %.16s in slot %u\n",
+            pair, buffers[pair][slot], slot );
+        received++;
+
+        if (atoi( buffers[pair][slot] + 5 ) + 2 < IOCP_ROUNDS)
+        {
+            wsabuf.buf = buffers[pair][slot];
+            wsabuf.len = sizeof(msg);
+            flags = 0;
+            iret = WSARecv( dst[pair], &wsabuf, 1, NULL, &flags, povl, NULL );
+            ok( !iret || WSAGetLastError() == ERROR_IO_PENDING,
+                "WSARecv returned %d error %d\n", iret, WSAGetLastError() );
+        }
+    }
+    QueryPerformanceCounter( &end );
+    trace( "received %u messages on %u sockets in %u ms\n", received, IOCP_PAIRS,
+           (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart) );
+
+    for (i = 0; i < IOCP_PAIRS; i++)
+    {
+        closesocket( src[i] );
+        closesocket( dst[i] );
+    }
+    CloseHandle( port );
+}
+
+static void test_overlapped_recv_cancel(void)
+{
+    BOOL (WINAPI *pCancelIoEx)(HANDLE, OVERLAPPED *);
+    char buffers[3][16];
+    WSAOVERLAPPED ovl[3];
+    SOCKET src, dst;
+    WSABUF wsabuf;
+    DWORD i, flags, size;
+    BOOL bret;
+    int iret;
+
+    if (tcp_socketpair( &src, &dst ))
+    {
+        skip( "failed to create sockets\n" );
+        return;
+    }
+
+    memset( ovl, 0, sizeof(ovl) );
+    memset( buffers, 0, sizeof(buffers) );
+    for (i = 0; i < 3; i++)
+    {
+        ovl[i].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+        wsabuf.buf = buffers[i];
+        wsabuf.len = sizeof(buffers[i]);
+        flags = 0;
+        iret = WSARecv( dst, &wsabuf, 1, NULL, &flags, &ovl[i], NULL );
+        ok( iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+            "WSARecv returned %d error %d\n", iret, WSAGetLastError() );
+    }
+
+    pCancelIoEx = (void *)GetProcAddress( GetModuleHandleA( "kernel32.dll" ), "CancelIoEx" );
+    if (pCancelIoEx)
+    {
+        bret = pCancelIoEx( (HANDLE)dst, &ovl[1] );
+        ok( bret, "CancelIoEx error %u\n", GetLastError() );
+        bret = GetOverlappedResult( (HANDLE)dst, &ovl[1], &size, TRUE );
+        ok( !bret && GetLastError() == ERROR_OPERATION_ABORTED,
+            "GetOverlappedResult returned %d error %u\n", bret, GetLastError() );
+    }
+    else win_skip( "CancelIoEx is not available\n" );
+
+    /* the receive queued before the cancelled one still gets the data */
+    iret = send( src, "first", 6, 0 );
+    ok( iret == 6, "send returned %d error %d\n", iret, WSAGetLastError() );
+    bret = GetOverlappedResult( (HANDLE)dst, &ovl[0], &size, TRUE );
+    ok( bret, "GetOverlappedResult error %u\n", GetLastError() );
+    ok( size == 6, "got size %u\n", size );
+    ok( !strcmp( buffers[0], "first" ), "got %s\n", buffers[0] );
+
+    bret = CancelIo( (HANDLE)dst );
+    ok( bret, "CancelIo error %u\n", GetLastError() );
+    for (i = pCancelIoEx ? 2 : 1; i < 3; i++)
+    {
+        bret = GetOverlappedResult( (HANDLE)dst, &ovl[i], &size, TRUE );
+        ok( !bret && GetLastError() == ERROR_OPERATION_ABORTED,
+            "%u: GetOverlappedResult returned %d error %u\n", i, bret, GetLastError() );
+    }
+
+    /* nothing is left pending, the next receive gets the next data */
+    wsabuf.buf = buffers[0];
+    wsabuf.len = sizeof(buffers[0]);
+    flags = 0;
+    ResetEvent( ovl[0].hEvent );
+    iret = WSARecv( dst, &wsabuf, 1, NULL, &flags, &ovl[0], NULL );
+    ok( iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+        "WSARecv returned %d error %d\n", iret, WSAGetLastError() );
+    iret = send( src, "second", 7, 0 );
+    ok( iret == 7, "send returned %d error %d\n", iret, WSAGetLastError() );
+    bret = GetOverlappedResult( (HANDLE)dst, &ovl[0], &size, TRUE );
+    ok( bret, "GetOverlappedResult error %u\n", GetLastError() );
+    ok( size == 7, "got size %u\n", size );
+    ok( !strcmp( buffers[0], "second" ), "got %s\n", buffers[0] );
+
+    for (i = 0; i < 3; i++) CloseHandle( ovl[i].hEvent );
+    closesocket( src );
+    closesocket( dst );
+}
+
+static void test_TransmitFile(void)
+{
+    static const char head[] = "head data", tail[] = "tail data";
+    GUID transmitfile_guid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    LARGE_INTEGER start, end, freq;
+    TRANSMIT_FILE_BUFFERS buffers;
+    char path[MAX_PATH], buf[4096];
+    SOCKET src, dst;
+    OVERLAPPED ov;
+    DWORD size, i, total, file_size = 8 * 1024 * 1024;
+    HANDLE file;
+    BOOL bret;
+    int iret;
+
+    if (tcp_socketpair( &src, &dst ))
+    {
+        skip( "failed to create sockets\n" );
+        return;
+    }
+    iret = WSAIoctl( src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitfile_guid, sizeof(transmitfile_guid),
+                     &pTransmitFile, sizeof(pTransmitFile), &size, NULL, NULL );
+    if (iret || !pTransmitFile)
+    {
+        skip( "TransmitFile is not available\n" );
+        closesocket( src );
+        closesocket( dst );
+        return;
+    }
+
+    GetTempPathA( MAX_PATH, path );
+    GetTempFileNameA( path, "wst", 0, path );
+    file = CreateFileA( path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    for (i = 0; i < file_size / sizeof(buf); i++)
+    {
+        memset( buf, i, sizeof(buf) );
+        WriteFile( file, buf, sizeof(buf), &size, NULL );
+    }
+
+    /* small synchronous transfer with head and tail buffers, from the current position */
+    SetFilePointer( file, file_size - sizeof(buf), NULL, FILE_BEGIN );
+    buffers.Head = (void *)head;
+    buffers.HeadLength = sizeof(head);
+    buffers.Tail = (void *)tail;
+    buffers.TailLength = sizeof(tail);
+    bret = pTransmitFile( src, file, 0, 0, NULL, &buffers, 0 );
+    ok( bret, "TransmitFile failed %d\n", WSAGetLastError() );
+
+    total = 0;
+    while (total < sizeof(head) + sizeof(buf) + sizeof(tail))
+    {
+        iret = recv( dst, buf + total % sizeof(buf), min( sizeof(buf) - total % sizeof(buf), 512 ), 0 );
+        ok( iret > 0, "recv returned %d error %d\n", iret, WSAGetLastError() );
+        if (iret <= 0) break;
+        if (total < sizeof(head))
+            ok( !memcmp( buf, head, min( iret, sizeof(head) )), "wrong head data\n" );
+        total += iret;
+    }
+    ok( total == sizeof(head) + sizeof(buf) + sizeof(tail), "received %u bytes\n", total );
+
+    /* large overlapped transfer, the socket is shut down afterwards */
+    memset( &ov, 0, sizeof(ov) );
+    ov.hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    bret = pTransmitFile( src, file, file_size, 0, &ov, NULL, TF_DISCONNECT );
+    ok( bret || WSAGetLastError() == ERROR_IO_PENDING, "TransmitFile failed %d\n", WSAGetLastError() );
+
+    total = 0;
+    for (;;)
+    {
+        iret = recv( dst, buf, sizeof(buf), 0 );
+        ok( iret >= 0, "recv returned %d error %d\n", iret, WSAGetLastError() );
+        if (iret <= 0) break;
+        if ((BYTE)buf[0] != (BYTE)(total / sizeof(buf)))
+        {
+            ok( 0, "wrong data at offset %u\n", total );
+            break;
+        }
+        total += iret;
+    }
+    QueryPerformanceCounter( &end );
+    ok( total == file_size, "received %u bytes\n", total );
+    trace( "transmitted %u bytes in %u ms\n", total,
+           (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart) );
+
+    ok( !WaitForSingleObject( ov.hEvent, 1000 ), "event not signaled\n" );
+    bret = GetOverlappedResult( (HANDLE)src, &ov, &size, FALSE );
+    ok( bret, "GetOverlappedResult failed %u\n", GetLastError() );
+    ok( size == file_size, "got size %u\n", size );
+
+    CloseHandle( ov.hEvent );
+    CloseHandle( file );
+    closesocket( src );
+    closesocket( dst );
+}
+
+static void test_AcceptEx_early_data(void)
+{
+    static const char msg[] = "early data";
+    GUID acceptex_guid = WSAID_ACCEPTEX;
+    LPFN_ACCEPTEX pAcceptEx = NULL;
+    SOCKET listener, acceptor, connector;
+    struct sockaddr_in addr;
+    char buffer[256];
+    OVERLAPPED ov;
+    DWORD size;
+    BOOL bret;
+    int iret, len;
+
+    listener = socket( AF_INET, SOCK_STREAM, 0 );
+    acceptor = socket( AF_INET, SOCK_STREAM, 0 );
+    connector = socket( AF_INET, SOCK_STREAM, 0 );
+    ok( listener != INVALID_SOCKET && acceptor != INVALID_SOCKET && connector != INVALID_SOCKET,
+        "failed to create sockets, error %d\n", WSAGetLastError() );
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr( "127.0.0.1" );
+    iret = bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !iret, "bind failed, error %d\n", WSAGetLastError() );
+    len = sizeof(addr);
+    iret = getsockname( listener, (struct sockaddr *)&addr, &len );
+    ok( !iret, "getsockname failed, error %d\n", WSAGetLastError() );
+    iret = listen( listener, 5 );
+    ok( !iret, "listen failed, error %d\n", WSAGetLastError() );
+
+    iret = WSAIoctl( listener, SIO_GET_EXTENSION_FUNCTION_POINTER, &acceptex_guid, sizeof(acceptex_guid),
+                     &pAcceptEx, sizeof(pAcceptEx), &size, NULL, NULL );
+    if (iret || !pAcceptEx)
+    {
+        skip( "AcceptEx is not available\n" );
+        goto end;
+    }
+
+    /* the client data is already there when the connection is accepted */
+    iret = connect( connector, (struct sockaddr *)&addr, sizeof(addr) );
+    ok( !iret, "connect failed, error %d\n", WSAGetLastError() );
+    iret = send( connector, msg, sizeof(msg), 0 );
+    ok( iret == sizeof(msg), "send returned %d, error %d\n", iret, WSAGetLastError() );
+    Sleep( 100 );
+
+    memset( &ov, 0, sizeof(ov) );
+    ov.hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+    memset( buffer, 0, sizeof(buffer) );
+    bret = pAcceptEx( listener, acceptor, buffer, sizeof(buffer) - 2 * (sizeof(struct sockaddr_in) + 16),
+                      sizeof(struct sockaddr_in) + 16, sizeof(struct sockaddr_in) + 16, &size, &ov );
+    ok( bret || WSAGetLastError() == ERROR_IO_PENDING, "AcceptEx returned %d, error %d\n",
+        bret, WSAGetLastError() );
+    ok( !WaitForSingleObject( ov.hEvent, 1000 ), "AcceptEx did not complete\n" );
+
+    size = 0xdeadbeef;
+    bret = GetOverlappedResult( (HANDLE)listener, &ov, &size, FALSE );
+    ok( bret, "GetOverlappedResult failed, error %d\n", GetLastError() );
+    ok( size == sizeof(msg), "got %u bytes\n", size );
+    ok( !memcmp( buffer, msg, sizeof(msg) ), "got wrong data %s\n", buffer );
+
+    /* the accepted socket still works normally afterwards */
+    iret = send( connector, msg, sizeof(msg), 0 );
+    ok( iret == sizeof(msg), "send returned %d, error %d\n", iret, WSAGetLastError() );
+    iret = recv( acceptor, buffer, sizeof(buffer), 0 );
+    ok( iret == sizeof(msg), "recv returned %d, error %d\n", iret, WSAGetLastError() );
+
+    CloseHandle( ov.hEvent );
+end:
+    closesocket( connector );
+    closesocket( acceptor );
+    closesocket( listener );
+}
+
 /**************** Main program  ***************/
 
 START_TEST( sock )
@@ -7677,6 +8091,11 @@ START_TEST( sock )
     test_WSAAsyncGetServByName();
 
     test_completion_port();
+    test_completion_skip_on_success();
+    test_overlapped_recv_throughput();
+    test_overlapped_recv_cancel();
+    test_TransmitFile();
+    test_AcceptEx_early_data();
 
     /* this is an io heavy test, do it at the end so the kernel doesn't start dropping packets */
     test_send();
@@ -50,6 +50,19 @@ struct request_max_size
     int pad[16];
 };
 
+
+#define REQUEST_SLOT_SIZE      0x10000
+#define REQUEST_SLOT_DATA_SIZE (REQUEST_SLOT_SIZE - 16 - sizeof(struct request_max_size))
+
+struct request_slot
+{
+    unsigned int  reply_seq;
+    unsigned int  waiting;
+    int           __pad[2];
+    struct request_max_size reply;
+    char          data[REQUEST_SLOT_DATA_SIZE];
+};
+
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
@@ -652,6 +665,34 @@ struct rawinput_device
     user_handle_t  target;
 };
 
+struct completion_entry
+{
+    apc_param_t    ckey;
+    apc_param_t    cvalue;
+    apc_param_t    information;
+    unsigned int   status;
+    int            __pad;
+};
+
+#define REQUEST_STAT_BUCKETS 16
+
+struct request_stat
+{
+    unsigned __int64 time;
+    unsigned int   max_time;
+    unsigned int   count;
+    unsigned int   errors;
+    unsigned int   histogram[REQUEST_STAT_BUCKETS];
+    int            __pad;
+};
+
+struct process_request_stat
+{
+    unsigned __int64 time;
+    process_id_t   pid;
+    unsigned int   count;
+};
+
 
 
 
@@ -776,6 +817,18 @@ struct init_thread_reply
 
 
 
+struct set_request_slot_request
+{
+    struct request_header __header;
+    int          fd;
+};
+struct set_request_slot_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct terminate_process_request
 {
     struct request_header __header;
@@ -1310,6 +1363,29 @@ struct open_semaphore_reply
 
 
 
+struct get_esync_fd_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_esync_fd_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int access;
+    unsigned int max;
+    char __pad_20[4];
+};
+enum esync_type
+{
+    ESYNC_NONE,
+    ESYNC_MANUAL_EVENT,
+    ESYNC_AUTO_EVENT,
+    ESYNC_SEMAPHORE
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -4907,6 +4983,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(entries,completion_entries); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -4943,7 +5032,7 @@ struct add_fd_completion_request
     apc_param_t    cvalue;
     apc_param_t    information;
     unsigned int   status;
-    char __pad_36[4];
+    int            sync;
 };
 struct add_fd_completion_reply
 {
@@ -4952,6 +5041,34 @@ struct add_fd_completion_reply
 
 
 
+struct set_fd_completion_mode_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    unsigned int   flags;
+    char __pad_20[4];
+};
+struct set_fd_completion_mode_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct get_fd_completion_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+};
+struct get_fd_completion_reply
+{
+    struct reply_header __header;
+    int            bound;
+    char __pad_12[4];
+};
+
+
+
 struct get_window_layered_info_request
 {
     struct request_header __header;
@@ -5081,6 +5198,37 @@ struct set_suspend_context_reply
 };
 
 
+
+struct get_request_stats_request
+{
+    struct request_header __header;
+    int          reset;
+};
+struct get_request_stats_reply
+{
+    struct reply_header __header;
+    timeout_t    start_time;
+    unsigned int count;
+    /* VARARG(stats,request_stats); */
+    char __pad_20[4];
+};
+
+
+
+struct get_process_request_stats_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_process_request_stats_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(stats,process_request_stats); */
+    char __pad_12[4];
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5089,6 +5237,7 @@ enum request
     REQ_get_startup_info,
     REQ_init_process_done,
     REQ_init_thread,
+    REQ_set_request_slot,
     REQ_terminate_process,
     REQ_terminate_thread,
     REQ_get_process_info,
@@ -5121,6 +5270,7 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_esync_fd,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5327,9 +5477,12 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_set_fd_completion_mode,
+    REQ_get_fd_completion,
     REQ_get_window_layered_info,
     REQ_set_window_layered_info,
     REQ_alloc_user_handle,
@@ -5338,6 +5491,8 @@ enum request
     REQ_update_rawinput_devices,
     REQ_get_suspend_context,
     REQ_set_suspend_context,
+    REQ_get_request_stats,
+    REQ_get_process_request_stats,
     REQ_NB_REQUESTS
 };
 
@@ -5351,6 +5506,7 @@ union generic_request
     struct get_startup_info_request get_startup_info_request;
     struct init_process_done_request init_process_done_request;
     struct init_thread_request init_thread_request;
+    struct set_request_slot_request set_request_slot_request;
     struct terminate_process_request terminate_process_request;
     struct terminate_thread_request terminate_thread_request;
     struct get_process_info_request get_process_info_request;
@@ -5383,6 +5539,7 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_esync_fd_request get_esync_fd_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5589,9 +5746,12 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct set_fd_completion_mode_request set_fd_completion_mode_request;
+    struct get_fd_completion_request get_fd_completion_request;
     struct get_window_layered_info_request get_window_layered_info_request;
     struct set_window_layered_info_request set_window_layered_info_request;
     struct alloc_user_handle_request alloc_user_handle_request;
@@ -5600,6 +5760,8 @@ union generic_request
     struct update_rawinput_devices_request update_rawinput_devices_request;
     struct get_suspend_context_request get_suspend_context_request;
     struct set_suspend_context_request set_suspend_context_request;
+    struct get_request_stats_request get_request_stats_request;
+    struct get_process_request_stats_request get_process_request_stats_request;
 };
 union generic_reply
 {
@@ -5611,6 +5773,7 @@ union generic_reply
     struct get_startup_info_reply get_startup_info_reply;
     struct init_process_done_reply init_process_done_reply;
     struct init_thread_reply init_thread_reply;
+    struct set_request_slot_reply set_request_slot_reply;
     struct terminate_process_reply terminate_process_reply;
     struct terminate_thread_reply terminate_thread_reply;
     struct get_process_info_reply get_process_info_reply;
@@ -5643,6 +5806,7 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_esync_fd_reply get_esync_fd_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -5849,9 +6013,12 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
+    struct get_fd_completion_reply get_fd_completion_reply;
     struct get_window_layered_info_reply get_window_layered_info_reply;
     struct set_window_layered_info_reply set_window_layered_info_reply;
     struct alloc_user_handle_reply alloc_user_handle_reply;
@@ -5860,8 +6027,10 @@ union generic_reply
     struct update_rawinput_devices_reply update_rawinput_devices_reply;
     struct get_suspend_context_reply get_suspend_context_reply;
     struct set_suspend_context_reply set_suspend_context_reply;
+    struct get_request_stats_reply get_request_stats_reply;
+    struct get_process_request_stats_reply get_process_request_stats_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 454
+#define SERVER_PROTOCOL_VERSION 459
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
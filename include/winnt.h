@@ -817,6 +817,7 @@ NTSYSAPI VOID         WINAPI RtlInitializeSListHead(PSLIST_HEADER);
 NTSYSAPI PSLIST_ENTRY WINAPI RtlInterlockedFlushSList(PSLIST_HEADER);
 NTSYSAPI PSLIST_ENTRY WINAPI RtlInterlockedPopEntrySList(PSLIST_HEADER);
 NTSYSAPI PSLIST_ENTRY WINAPI RtlInterlockedPushEntrySList(PSLIST_HEADER, PSLIST_ENTRY);
+NTSYSAPI PSLIST_ENTRY WINAPI RtlInterlockedPushListSList(PSLIST_HEADER, PSLIST_ENTRY, PSLIST_ENTRY, ULONG);
 NTSYSAPI WORD         WINAPI RtlQueryDepthSList(PSLIST_HEADER);
 
 
@@ -5635,6 +5636,8 @@ typedef struct _PROCESSOR_NUMBER
     BYTE Reserved;
 } PROCESSOR_NUMBER, *PPROCESSOR_NUMBER;
 
+#define LTP_PC_SMT 0x1
+
 typedef struct _PROCESSOR_RELATIONSHIP
 {
     BYTE Flags;
@@ -5656,6 +5659,7 @@ typedef struct _CACHE_RELATIONSHIP
     BYTE Level;
     BYTE Associativity;
     WORD LineSize;
+    DWORD CacheSize;
     PROCESSOR_CACHE_TYPE Type;
     BYTE Reserved[20];
     GROUP_AFFINITY GroupMask;
@@ -0,0 +1,487 @@
+/*
+ * Display the request statistics of the wine server
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+
+#define MAX_LINES 20
+
+static struct request_stat stats[REQ_NB_REQUESTS], prev_stats[REQ_NB_REQUESTS];
+static struct process_request_stat *procs, *prev_procs;
+static unsigned int nb_procs, nb_prev_procs;
+
+/* request names, generated by tools/make_requests */
+/* ### make_requests begin ### */
+
+static const char * const req_names[REQ_NB_REQUESTS] =
+{
+    "new_process",
+    "get_new_process_info",
+    "new_thread",
+    "get_startup_info",
+    "init_process_done",
+    "init_thread",
+    "set_request_slot",
+    "terminate_process",
+    "terminate_thread",
+    "get_process_info",
+    "set_process_info",
+    "get_thread_info",
+    "set_thread_info",
+    "get_dll_info",
+    "suspend_thread",
+    "resume_thread",
+    "load_dll",
+    "unload_dll",
+    "queue_apc",
+    "get_apc_result",
+    "close_handle",
+    "set_handle_info",
+    "dup_handle",
+    "open_process",
+    "open_thread",
+    "select",
+    "create_event",
+    "event_op",
+    "query_event",
+    "open_event",
+    "create_keyed_event",
+    "open_keyed_event",
+    "create_mutex",
+    "release_mutex",
+    "open_mutex",
+    "create_semaphore",
+    "release_semaphore",
+    "query_semaphore",
+    "open_semaphore",
+    "get_esync_fd",
+    "create_file",
+    "open_file_object",
+    "alloc_file_handle",
+    "get_handle_unix_name",
+    "get_handle_fd",
+    "flush_file",
+    "lock_file",
+    "unlock_file",
+    "create_socket",
+    "accept_socket",
+    "accept_into_socket",
+    "set_socket_event",
+    "get_socket_event",
+    "get_socket_info",
+    "enable_socket_event",
+    "set_socket_deferred",
+    "alloc_console",
+    "free_console",
+    "get_console_renderer_events",
+    "open_console",
+    "get_console_wait_event",
+    "get_console_mode",
+    "set_console_mode",
+    "set_console_input_info",
+    "get_console_input_info",
+    "append_console_input_history",
+    "get_console_input_history",
+    "create_console_output",
+    "set_console_output_info",
+    "get_console_output_info",
+    "write_console_input",
+    "read_console_input",
+    "write_console_output",
+    "fill_console_output",
+    "read_console_output",
+    "move_console_output",
+    "send_console_signal",
+    "read_directory_changes",
+    "read_change",
+    "create_mapping",
+    "open_mapping",
+    "get_mapping_info",
+    "get_mapping_committed_range",
+    "add_mapping_committed_range",
+    "create_snapshot",
+    "next_process",
+    "next_thread",
+    "wait_debug_event",
+    "queue_exception_event",
+    "get_exception_status",
+    "output_debug_string",
+    "continue_debug_event",
+    "debug_process",
+    "debug_break",
+    "set_debugger_kill_on_exit",
+    "read_process_memory",
+    "write_process_memory",
+    "create_key",
+    "open_key",
+    "delete_key",
+    "flush_key",
+    "enum_key",
+    "set_key_value",
+    "get_key_value",
+    "enum_key_value",
+    "delete_key_value",
+    "load_registry",
+    "unload_registry",
+    "save_registry",
+    "set_registry_notification",
+    "create_timer",
+    "open_timer",
+    "set_timer",
+    "cancel_timer",
+    "get_timer_info",
+    "get_thread_context",
+    "set_thread_context",
+    "get_selector_entry",
+    "add_atom",
+    "delete_atom",
+    "find_atom",
+    "get_atom_information",
+    "set_atom_information",
+    "empty_atom_table",
+    "init_atom_table",
+    "get_msg_queue",
+    "set_queue_fd",
+    "set_queue_mask",
+    "get_queue_status",
+    "get_process_idle_event",
+    "send_message",
+    "post_quit_message",
+    "send_hardware_message",
+    "get_message",
+    "reply_message",
+    "accept_hardware_message",
+    "get_message_reply",
+    "set_win_timer",
+    "kill_win_timer",
+    "is_window_hung",
+    "get_serial_info",
+    "set_serial_info",
+    "register_async",
+    "cancel_async",
+    "ioctl",
+    "get_ioctl_result",
+    "create_named_pipe",
+    "get_named_pipe_info",
+    "create_window",
+    "destroy_window",
+    "get_desktop_window",
+    "set_window_owner",
+    "get_window_info",
+    "set_window_info",
+    "set_parent",
+    "get_window_parents",
+    "get_window_children",
+    "get_window_children_from_point",
+    "get_window_tree",
+    "set_window_pos",
+    "get_window_rectangles",
+    "get_window_text",
+    "set_window_text",
+    "get_windows_offset",
+    "get_visible_region",
+    "get_surface_region",
+    "get_window_region",
+    "set_window_region",
+    "get_update_region",
+    "update_window_zorder",
+    "redraw_window",
+    "set_window_property",
+    "remove_window_property",
+    "get_window_property",
+    "get_window_properties",
+    "create_winstation",
+    "open_winstation",
+    "close_winstation",
+    "get_process_winstation",
+    "set_process_winstation",
+    "enum_winstation",
+    "create_desktop",
+    "open_desktop",
+    "open_input_desktop",
+    "close_desktop",
+    "get_thread_desktop",
+    "set_thread_desktop",
+    "enum_desktop",
+    "set_user_object_info",
+    "register_hotkey",
+    "unregister_hotkey",
+    "attach_thread_input",
+    "get_thread_input",
+    "get_last_input_time",
+    "get_key_state",
+    "set_key_state",
+    "set_foreground_window",
+    "set_focus_window",
+    "set_active_window",
+    "set_capture_window",
+    "set_caret_window",
+    "set_caret_info",
+    "set_hook",
+    "remove_hook",
+    "start_hook_chain",
+    "finish_hook_chain",
+    "get_hook_info",
+    "create_class",
+    "destroy_class",
+    "set_class_info",
+    "set_clipboard_info",
+    "open_token",
+    "set_global_windows",
+    "adjust_token_privileges",
+    "get_token_privileges",
+    "check_token_privileges",
+    "duplicate_token",
+    "access_check",
+    "get_token_sid",
+    "get_token_groups",
+    "get_token_default_dacl",
+    "set_token_default_dacl",
+    "set_security_object",
+    "get_security_object",
+    "create_mailslot",
+    "set_mailslot_info",
+    "create_directory",
+    "open_directory",
+    "get_directory_entry",
+    "create_symlink",
+    "open_symlink",
+    "query_symlink",
+    "get_object_info",
+    "unlink_object",
+    "get_token_impersonation_level",
+    "allocate_locally_unique_id",
+    "create_device_manager",
+    "create_device",
+    "delete_device",
+    "get_next_device_request",
+    "make_process_system",
+    "get_token_statistics",
+    "create_completion",
+    "open_completion",
+    "add_completion",
+    "remove_completion",
+    "remove_completions",
+    "query_completion",
+    "set_completion_info",
+    "add_fd_completion",
+    "set_fd_completion_mode",
+    "get_fd_completion",
+    "get_window_layered_info",
+    "set_window_layered_info",
+    "alloc_user_handle",
+    "free_user_handle",
+    "set_cursor",
+    "update_rawinput_devices",
+    "get_suspend_context",
+    "set_suspend_context",
+    "get_request_stats",
+    "get_process_request_stats",
+};
+
+/* ### make_requests end ### */
+
+static void usage(void)
+{
+    printf( "Usage: serverstat [-d seconds] [-n count] [-r]\n\n" );
+    printf( "Displays the requests that take the most time in the wine server.\n\n" );
+    printf( "  -d seconds  delay between updates, default 1\n" );
+    printf( "  -n count    exit after count updates, 0 shows the totals since the last reset\n" );
+    printf( "  -r          reset the counters\n" );
+    exit( 1 );
+}
+
+static BOOL get_request_stats( BOOL reset, timeout_t *start_time )
+{
+    NTSTATUS status;
+
+    SERVER_START_REQ( get_request_stats )
+    {
+        req->reset = reset;
+        wine_server_set_reply( req, stats, sizeof(stats) );
+        if (!(status = wine_server_call( req ))) *start_time = reply->start_time;
+    }
+    SERVER_END_REQ;
+    if (status) fprintf( stderr, "serverstat: failed to get request statistics: %08x\n", status );
+    return !status;
+}
+
+static BOOL get_process_stats(void)
+{
+    unsigned int count = 32;
+    NTSTATUS status;
+
+    for (;;)
+    {
+        if (!(procs = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*procs) ))) return FALSE;
+        SERVER_START_REQ( get_process_request_stats )
+        {
+            wine_server_set_reply( req, procs, count * sizeof(*procs) );
+            status = wine_server_call( req );
+            nb_procs = wine_server_reply_size( reply ) / sizeof(*procs);
+            if (status == STATUS_BUFFER_OVERFLOW) count = reply->count + 16;
+        }
+        SERVER_END_REQ;
+        if (status != STATUS_BUFFER_OVERFLOW) break;
+        HeapFree( GetProcessHeap(), 0, procs );
+    }
+    return !status;
+}
+
+/* estimate a latency percentile in microseconds from the histogram buckets */
+static unsigned int get_percentile( const unsigned int *histogram, unsigned int count, unsigned int percent )
+{
+    unsigned int i, total = 0;
+
+    for (i = 0; i < REQUEST_STAT_BUCKETS - 1; i++)
+    {
+        total += histogram[i];
+        if ((ULONGLONG)total * 100 >= (ULONGLONG)count * percent) break;
+    }
+    return 1 << i;
+}
+
+static struct request_stat delta[REQ_NB_REQUESTS];
+
+static int compare_requests( const void *p1, const void *p2 )
+{
+    const struct request_stat *stat1 = &delta[*(const unsigned int *)p1];
+    const struct request_stat *stat2 = &delta[*(const unsigned int *)p2];
+
+    if (stat1->time != stat2->time) return stat1->time < stat2->time ? 1 : -1;
+    return stat2->count - stat1->count;
+}
+
+static int compare_processes( const void *p1, const void *p2 )
+{
+    const struct process_request_stat *stat1 = p1, *stat2 = p2;
+
+    if (stat1->time != stat2->time) return stat1->time < stat2->time ? 1 : -1;
+    return stat2->count - stat1->count;
+}
+
+static void display( double seconds )
+{
+    unsigned int i, j, order[REQ_NB_REQUESTS];
+    ULONGLONG total_time = 0, total_count = 0;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        delta[i] = stats[i];
+        delta[i].count  -= prev_stats[i].count;
+        delta[i].errors -= prev_stats[i].errors;
+        delta[i].time   -= prev_stats[i].time;
+        for (j = 0; j < REQUEST_STAT_BUCKETS; j++) delta[i].histogram[j] -= prev_stats[i].histogram[j];
+        total_time += delta[i].time;
+        total_count += delta[i].count;
+        order[i] = i;
+    }
+    qsort( order, REQ_NB_REQUESTS, sizeof(order[0]), compare_requests );
+
+    printf( "%.0f requests/s, %.1f%% server time\n\n", total_count / seconds, total_time / seconds / 1e7 );
+    printf( "%-32s %9s %8s %8s %8s %8s %6s %6s\n", "request", "calls/s", "avg(us)", "p50(us)",
+            "p99(us)", "max(us)", "err%", "time%" );
+    for (i = 0; i < MAX_LINES && delta[order[i]].count; i++)
+    {
+        const struct request_stat *stat = &delta[order[i]];
+
+        printf( "%-32s %9.0f %8.1f %8u %8u %8u %6.1f %6.1f\n", req_names[order[i]],
+                stat->count / seconds, stat->time / 1000.0 / stat->count,
+                get_percentile( stat->histogram, stat->count, 50 ),
+                get_percentile( stat->histogram, stat->count, 99 ),
+                stat->max_time / 1000, stat->errors * 100.0 / stat->count,
+                total_time ? stat->time * 100.0 / total_time : 0.0 );
+    }
+
+    for (i = 0; i < nb_procs; i++)
+    {
+        for (j = 0; j < nb_prev_procs; j++)
+        {
+            if (prev_procs[j].pid != procs[i].pid) continue;
+            procs[i].count -= prev_procs[j].count;
+            procs[i].time -= prev_procs[j].time;
+            break;
+        }
+    }
+    qsort( procs, nb_procs, sizeof(*procs), compare_processes );
+
+    printf( "\n%-8s %9s %8s %6s\n", "pid", "calls/s", "avg(us)", "time%" );
+    for (i = 0; i < MAX_LINES / 2 && i < nb_procs && procs[i].count; i++)
+        printf( "%08x %9.0f %8.1f %6.1f\n", procs[i].pid, procs[i].count / seconds,
+                procs[i].time / 1000.0 / procs[i].count,
+                total_time ? procs[i].time * 100.0 / total_time : 0.0 );
+}
+
+int main( int argc, char *argv[] )
+{
+    LARGE_INTEGER now, last;
+    timeout_t start_time;
+    unsigned int delay = 1000, count = ~0u;
+    BOOL reset = FALSE;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp( argv[i], "-d" ) && i + 1 < argc) delay = atof( argv[++i] ) * 1000;
+        else if (!strcmp( argv[i], "-n" ) && i + 1 < argc) count = atoi( argv[++i] );
+        else if (!strcmp( argv[i], "-r" )) reset = TRUE;
+        else usage();
+    }
+
+    if (reset || !count)
+    {
+        if (!get_request_stats( reset, &start_time )) return 1;
+        if (!count)
+        {
+            NtQuerySystemTime( &now );
+            if (!get_process_stats()) return 1;
+            display( (now.QuadPart - start_time) / 1e7 );
+            return 0;
+        }
+    }
+
+    if (!get_request_stats( FALSE, &start_time ) || !get_process_stats()) return 1;
+    NtQuerySystemTime( &last );
+
+    while (count--)
+    {
+        memcpy( prev_stats, stats, sizeof(stats) );
+        HeapFree( GetProcessHeap(), 0, prev_procs );
+        prev_procs = procs;
+        nb_prev_procs = nb_procs;
+
+        Sleep( delay );
+        if (!get_request_stats( FALSE, &start_time ) || !get_process_stats()) return 1;
+        NtQuerySystemTime( &now );
+
+        printf( "\33[H\33[2J" );
+        display( (now.QuadPart - last.QuadPart) / 1e7 );
+        fflush( stdout );
+        last = now;
+    }
+    return 0;
+}
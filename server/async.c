@@ -299,7 +299,8 @@ void async_set_result( struct object *obj, unsigned int status, apc_param_t tota
             thread_queue_apc( async->thread, NULL, &data );
         }
         if (async->event) set_event( async->event );
-        else if (async->queue->fd) set_fd_signaled( async->queue->fd, 1 );
+        else if (async->queue->fd && !(fd_get_comp_flags( async->queue->fd ) & FILE_SKIP_SET_EVENT_ON_HANDLE))
+            set_fd_signaled( async->queue->fd, 1 );
     }
 }
 
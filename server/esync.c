@@ -0,0 +1,218 @@
+/*
+ * eventfd-based synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* When the WINEESYNC environment variable is set, the state of events and
+ * semaphores is kept in an eventfd instead of in the server object. Clients
+ * fetch the eventfd with the get_esync_fd request and then signal and wait
+ * on it directly; the server only polls it while one of its own threads is
+ * waiting on the object.
+ *
+ * The eventfd counter is the state of the object: non-zero means signaled,
+ * and for semaphores it is the current count. Semaphore eventfds are
+ * created with EFD_SEMAPHORE, so that every read atomically takes a single
+ * unit; acquiring an object is always a single read, and nobody ever holds
+ * the count outside of the eventfd. Releasing a semaphore needs the current
+ * count for the limit check, so it is only done by the server, which takes
+ * all the units out, checks the limit and writes them back; clients that
+ * grab a unit in the meantime are simply ordered before the release.
+ *
+ * A server-side wait takes the unit out of the eventfd as soon as it finds
+ * the object signaled, since a client could grab it before the wait is
+ * satisfied otherwise. If the wait can't be satisfied after all, the unit
+ * is given back with esync_cancel_check. Pulsing an event only wakes the
+ * server-side waiters, clients polling the eventfd never see it.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "request.h"
+#include "thread.h"
+
+static int esync_get_poll_events( struct fd *fd );
+static void esync_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops esync_fd_ops =
+{
+    esync_get_poll_events,       /* get_poll_events */
+    esync_poll_event,            /* poll_event */
+    NULL,                        /* flush */
+    NULL,                        /* get_fd_type */
+    NULL,                        /* ioctl */
+    NULL,                        /* queue_async */
+    NULL,                        /* reselect_async */
+    NULL,                        /* cancel_async */
+};
+
+/* check whether eventfd-based synchronization objects are enabled */
+int do_esync(void)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEESYNC" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+#else
+    return 0;
+#endif
+}
+
+/* create the eventfd holding the state of a synchronization object */
+struct fd *create_esync_fd( struct object *obj, unsigned int count, int semaphore )
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    int unix_fd, flags = EFD_CLOEXEC | EFD_NONBLOCK;
+
+    if (semaphore) flags |= EFD_SEMAPHORE;
+    if ((unix_fd = eventfd( count, flags )) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+    return create_anonymous_fd( &esync_fd_ops, unix_fd, obj, 0 );
+#else
+    set_error( STATUS_NOT_IMPLEMENTED );
+    return NULL;
+#endif
+}
+
+/* retrieve and reset the eventfd counter; semaphore eventfds hand out one unit per read */
+unsigned int esync_read( struct fd *fd )
+{
+    unsigned long long value;
+    unsigned int count = 0;
+
+    while (read( get_unix_fd( fd ), &value, sizeof(value) ) == sizeof(value)) count += value;
+    return count;
+}
+
+/* try to take the object out of the eventfd: a single unit for semaphores, the whole signal for events */
+int esync_grab( struct fd *fd )
+{
+    unsigned long long value;
+
+    return read( get_unix_fd( fd ), &value, sizeof(value) ) == sizeof(value) && value;
+}
+
+/* add to the eventfd counter */
+void esync_write( struct fd *fd, unsigned int count )
+{
+    unsigned long long value = count;
+
+    if (!count) return;
+    if (write( get_unix_fd( fd ), &value, sizeof(value) ) != sizeof(value))
+        fprintf( stderr, "wineserver: failed to signal esync object: %s\n", strerror( errno ));
+}
+
+/* check whether the eventfd counter is non-zero */
+int esync_signaled( struct fd *fd )
+{
+    struct pollfd pfd;
+
+    pfd.fd = get_unix_fd( fd );
+    pfd.events = POLLIN;
+    return poll( &pfd, 1, 0 ) > 0 && (pfd.revents & POLLIN);
+}
+
+/* add a waiter to an eventfd-based object; clients may signal it without telling us */
+int esync_add_queue( struct object *obj, struct fd *fd, struct wait_queue_entry *entry )
+{
+    set_fd_events( fd, POLLIN );
+    return add_queue( obj, entry );
+}
+
+void esync_remove_queue( struct object *obj, struct fd *fd, struct wait_queue_entry *entry )
+{
+    remove_queue( obj, entry );
+    if (list_empty( &obj->wait_queue )) set_fd_events( fd, 0 );
+}
+
+/* a wait for all objects failed: give back what the check took out of the eventfd */
+void esync_cancel_check( struct object *obj )
+{
+    struct fd *fd;
+
+    if (!(fd = cancel_event_esync_check( obj )) && !(fd = cancel_semaphore_esync_check( obj ))) return;
+
+    /* a client may have taken the object since we last polled it */
+    if (!list_empty( &obj->wait_queue ) && !esync_signaled( fd )) set_fd_events( fd, POLLIN );
+}
+
+static int esync_get_poll_events( struct fd *fd )
+{
+    return 0;
+}
+
+static void esync_poll_event( struct fd *fd, int event )
+{
+    struct object *obj = grab_object( get_fd_user( fd ));
+
+    /* a client may grab the object before our waiters get to it; keep polling
+     * only if there are waiters left and the object is not signaled anymore,
+     * otherwise the waiters are waiting for other objects too */
+    set_fd_events( fd, 0 );
+    wake_up( obj, 0 );
+    if (!list_empty( &obj->wait_queue ) && !esync_signaled( fd )) set_fd_events( fd, POLLIN );
+    release_object( obj );
+}
+
+/* retrieve the eventfd of an event or semaphore */
+DECL_HANDLER(get_esync_fd)
+{
+    struct object *obj;
+    struct fd *fd;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, SYNCHRONIZE, NULL ))) return;
+
+    if ((fd = get_event_esync_fd( obj, &reply->type )) ||
+        (fd = get_semaphore_esync_fd( obj, &reply->type, &reply->max )))
+    {
+        reply->access = get_handle_access( current->process, req->handle );
+        send_client_fd( current->process, get_unix_fd( fd ), req->handle );
+    }
+    else set_error( STATUS_NOT_IMPLEMENTED );
+
+    release_object( obj );
+}
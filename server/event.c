@@ -31,6 +31,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
 #include "request.h"
@@ -41,22 +42,27 @@ struct event
     struct object  obj;             /* object header */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct fd     *esync_fd;        /* eventfd holding the state in esync mode */
+    int            esync_taken;     /* signal taken out of the eventfd by a wait check */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -67,7 +73,7 @@ static const struct object_ops event_ops =
     no_lookup_name,            /* lookup_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -115,6 +121,14 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->esync_fd     = NULL;
+            event->esync_taken  = 0;
+            if (do_esync() && !(event->esync_fd = create_esync_fd( &event->obj, initial_state != 0, 0 )))
+            {
+                release_object( event );
+                return NULL;
+            }
+            if (event->esync_fd) event->signaled = 0;  /* the eventfd holds the state */
             if (sd) default_set_sd( &event->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
                                                      DACL_SECURITY_INFORMATION|
@@ -131,6 +145,7 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
 
 void pulse_event( struct event *event )
 {
+    /* in esync mode this only reaches our own waiters, the eventfd is left alone */
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -139,7 +154,8 @@ void pulse_event( struct event *event )
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    if (!event->esync_fd) event->signaled = 1;
+    else if (!esync_signaled( event->esync_fd )) esync_write( event->esync_fd, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
@@ -147,14 +163,34 @@ void set_event( struct event *event )
 void reset_event( struct event *event )
 {
     event->signaled = 0;
+    if (event->esync_fd) esync_read( event->esync_fd );
+}
+
+struct fd *get_event_esync_fd( struct object *obj, int *type )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops || !event->esync_fd) return NULL;
+    *type = event->manual_reset ? ESYNC_MANUAL_EVENT : ESYNC_AUTO_EVENT;
+    return event->esync_fd;
+}
+
+struct fd *cancel_event_esync_check( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops || !event->esync_fd) return NULL;
+    if (event->esync_taken) esync_write( event->esync_fd, 1 );
+    event->esync_taken = 0;
+    return event->esync_fd;
 }
 
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    fprintf( stderr, "Event manual=%d signaled=%d ",
-             event->manual_reset, event->signaled );
+    fprintf( stderr, "Event manual=%d signaled=%d ", event->manual_reset,
+             event->esync_fd ? esync_signaled( event->esync_fd ) : event->signaled );
     dump_object_name( &event->obj );
     fputc( '\n', stderr );
 }
@@ -166,11 +202,31 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->esync_fd) return esync_add_queue( obj, event->esync_fd, entry );
+    return add_queue( obj, entry );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->esync_fd) esync_remove_queue( obj, event->esync_fd, entry );
+    else remove_queue( obj, entry );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    if (event->signaled || !event->esync_fd) return event->signaled;
+    if (event->manual_reset) return esync_signaled( event->esync_fd );
+    /* take the signal now, a client could grab it before we are satisfied otherwise */
+    if (!event->esync_taken) event->esync_taken = esync_grab( event->esync_fd );
+    return event->esync_taken;
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -178,7 +234,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) event->signaled = event->esync_taken = 0;
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -204,6 +260,13 @@ static int event_signal( struct object *obj, unsigned int access )
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->esync_fd) release_object( event->esync_fd );
+}
+
 struct keyed_event *create_keyed_event( struct directory *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -365,7 +428,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = event->esync_fd ? esync_signaled( event->esync_fd ) : event->signaled;
 
     release_object( event );
 }
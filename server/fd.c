@@ -191,6 +191,7 @@ struct fd
     struct async_queue  *wait_q;      /* other async waiters of this fd */
     struct completion   *completion;  /* completion object attached to this fd */
     apc_param_t          comp_key;    /* completion key to set in completion events */
+    unsigned int         comp_flags;  /* completion notification flags (FILE_SKIP_*) */
 };
 
 static void fd_dump( struct object *obj, int verbose );
@@ -345,15 +346,35 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 /****************************************************************/
 /* timeouts support */
 
+/* Timeouts are kept in a hierarchical timer wheel. Level 0 has one slot per
+ * tick of 2^TIMEOUT_TICK_SHIFT 100ns units; each slot of level n spans a full
+ * turn of level n-1. The slots of a level are moved down ("cascaded") to the
+ * lower levels when the wheel reaches them, so insertion and removal are
+ * O(1) and every timeout is cascaded at most TIMEOUT_LEVELS-1 times. Slots
+ * only need to be scanned for the exact expiry when looking for the next
+ * timeout, which is cheap since the first non-empty slot of each level holds
+ * its earliest timeouts. Timeouts beyond the range of the wheel are kept on
+ * a separate list and inserted again every time the last level turns. */
+
+#define TIMEOUT_TICK_SHIFT   14     /* tick of about 1.6ms */
+#define TIMEOUT_LEVEL_BITS   6
+#define TIMEOUT_LEVEL_SIZE   (1 << TIMEOUT_LEVEL_BITS)
+#define TIMEOUT_LEVEL_MASK   (TIMEOUT_LEVEL_SIZE - 1)
+#define TIMEOUT_LEVELS       5      /* covers about 20 days */
+
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in timer wheel slot or expired list */
     timeout_t             when;       /* timeout expiry (absolute time) */
+    int                   level;      /* timer wheel level, TIMEOUT_LEVELS if too far, -1 if not in the wheel */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+static struct list timeout_wheel[TIMEOUT_LEVELS][TIMEOUT_LEVEL_SIZE];
+static struct list far_timeouts = LIST_INIT(far_timeouts);  /* timeouts beyond the last level */
+static unsigned int timeout_count[TIMEOUT_LEVELS + 1];    /* number of timeouts in each level */
+static timeout_t wheel_tick;  /* current position of the wheel, in ticks */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -364,32 +385,186 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+static void init_timeout_wheel(void)
+{
+    static int initialized;
+    int level, i;
+
+    if (initialized) return;
+    for (level = 0; level < TIMEOUT_LEVELS; level++)
+        for (i = 0; i < TIMEOUT_LEVEL_SIZE; i++) list_init( &timeout_wheel[level][i] );
+    initialized = 1;
+}
+
+static inline int wheel_is_empty(void)
+{
+    int i;
+
+    for (i = 0; i <= TIMEOUT_LEVELS; i++) if (timeout_count[i]) return 0;
+    return 1;
+}
+
+/* insert a timeout into the slot of the wheel matching its expiry */
+static void wheel_insert( struct timeout_user *user )
+{
+    timeout_t tick = user->when >> TIMEOUT_TICK_SHIFT;
+    timeout_t delta;
+    int level;
+
+    if (tick < wheel_tick) tick = wheel_tick;  /* already expired */
+    delta = tick - wheel_tick;
+
+    for (level = 0; level < TIMEOUT_LEVELS; level++)
+        if (delta < (timeout_t)1 << ((level + 1) * TIMEOUT_LEVEL_BITS)) break;
+
+    user->level = level;
+    timeout_count[level]++;
+    if (level == TIMEOUT_LEVELS)
+    {
+        list_add_tail( &far_timeouts, &user->entry );
+        return;
+    }
+    list_add_tail( &timeout_wheel[level][(tick >> (level * TIMEOUT_LEVEL_BITS)) & TIMEOUT_LEVEL_MASK],
+                   &user->entry );
+}
+
+static void wheel_remove( struct timeout_user *user )
+{
+    list_remove( &user->entry );
+    if (user->level >= 0) timeout_count[user->level]--;
+    user->level = -1;
+}
+
+/* insert again all the timeouts of a list, once the wheel has moved */
+static void wheel_reinsert( struct list *list )
+{
+    struct list slot, *ptr;
+
+    list_init( &slot );
+    list_move_tail( &slot, list );
+    while ((ptr = list_head( &slot )))
+    {
+        struct timeout_user *user = LIST_ENTRY( ptr, struct timeout_user, entry );
+        wheel_remove( user );
+        wheel_insert( user );
+    }
+}
+
+/* move the timeouts of the higher level slots that the wheel reached to the lower levels */
+static void wheel_cascade(void)
+{
+    int level;
+
+    for (level = 1; level < TIMEOUT_LEVELS; level++)
+    {
+        unsigned int index = (wheel_tick >> (level * TIMEOUT_LEVEL_BITS)) & TIMEOUT_LEVEL_MASK;
+
+        wheel_reinsert( &timeout_wheel[level][index] );
+        if (index) return;  /* the next level didn't wrap */
+    }
+    wheel_reinsert( &far_timeouts );
+}
+
+/* add an expired timeout to the list, keeping it sorted */
+static void add_expired_timeout( struct list *expired_list, struct timeout_user *user )
+{
+    struct list *ptr;
+
+    wheel_remove( user );
+    for (ptr = list_tail( expired_list ); ptr; ptr = list_prev( expired_list, ptr ))
+        if (LIST_ENTRY( ptr, struct timeout_user, entry )->when <= user->when) break;
+    list_add_after( ptr ? ptr : expired_list, &user->entry );
+}
+
+/* advance the wheel to the current time and collect the expired timeouts */
+static void wheel_advance( struct list *expired_list )
+{
+    timeout_t now_tick = current_time >> TIMEOUT_TICK_SHIFT;
+    struct timeout_user *user, *next;
+    int level;
+
+    if (wheel_is_empty())
+    {
+        wheel_tick = now_tick;
+        return;
+    }
+
+    for (;;)
+    {
+        struct list *slot = &timeout_wheel[0][wheel_tick & TIMEOUT_LEVEL_MASK];
+
+        if (!(wheel_tick & TIMEOUT_LEVEL_MASK)) wheel_cascade();
+
+        LIST_FOR_EACH_ENTRY_SAFE( user, next, slot, struct timeout_user, entry )
+            if (wheel_tick < now_tick || user->when <= current_time)
+                add_expired_timeout( expired_list, user );
+
+        if (wheel_tick >= now_tick) break;
+        wheel_tick++;
+
+        /* skip the turns of the lower levels that don't contain anything */
+        for (level = 0; level < TIMEOUT_LEVELS && !timeout_count[level]; level++) ;
+        if (level == TIMEOUT_LEVELS)  /* only far timeouts left, move the wheel to them */
+        {
+            wheel_tick = now_tick;
+            wheel_reinsert( &far_timeouts );
+        }
+        else if (level)
+        {
+            timeout_t mask = ((timeout_t)1 << (level * TIMEOUT_LEVEL_BITS)) - 1;
+            wheel_tick = min( (wheel_tick + mask) & ~mask, now_tick );
+        }
+    }
+}
+
+/* return the earliest timeout in the wheel, or TIMEOUT_INFINITE */
+static timeout_t wheel_next_timeout(void)
+{
+    timeout_t ret = TIMEOUT_INFINITE;
+    struct timeout_user *user;
+    int level, i;
+
+    for (level = 0; level < TIMEOUT_LEVELS; level++)
+    {
+        unsigned int index = (wheel_tick >> (level * TIMEOUT_LEVEL_BITS)) & TIMEOUT_LEVEL_MASK;
+
+        if (!timeout_count[level]) continue;
+        /* the current slot of the higher levels holds the timeouts of the next turn */
+        for (i = level ? 1 : 0; i <= TIMEOUT_LEVEL_SIZE; i++)
+        {
+            struct list *slot = &timeout_wheel[level][(index + i) & TIMEOUT_LEVEL_MASK];
+
+            if (list_empty( slot )) continue;
+            LIST_FOR_EACH_ENTRY( user, slot, struct timeout_user, entry )
+                if (user->when < ret) ret = user->when;
+            break;
+        }
+    }
+    LIST_FOR_EACH_ENTRY( user, &far_timeouts, struct timeout_user, entry )
+        if (user->when < ret) ret = user->when;
+    return ret;
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    init_timeout_wheel();
+    if (wheel_is_empty()) wheel_tick = current_time >> TIMEOUT_TICK_SHIFT;
+    wheel_insert( user );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    wheel_remove( user );
     free( user );
 }
 
@@ -835,42 +1010,31 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
-    {
-        struct list expired_list, *ptr;
+    struct list expired_list, *ptr;
+    timeout_t next;
 
-        /* first remove all expired timers from the list */
+    if (wheel_is_empty()) return -1;  /* no pending timeouts */
 
-        list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+    /* first remove all expired timers from the wheel */
 
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
-        }
+    list_init( &expired_list );
+    wheel_advance( &expired_list );
 
-        /* now call the callback for all the removed timers */
+    /* now call the callback for all the removed timers */
 
-        while ((ptr = list_head( &expired_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            list_remove( &timeout->entry );
-            timeout->callback( timeout->private );
-            free( timeout );
-        }
+    while ((ptr = list_head( &expired_list )) != NULL)
+    {
+        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+        list_remove( &timeout->entry );
+        timeout->callback( timeout->private );
+        free( timeout );
+    }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            int diff = (timeout->when - current_time + 9999) / 10000;
-            if (diff < 0) diff = 0;
-            return diff;
-        }
+    if ((next = wheel_next_timeout()) != TIMEOUT_INFINITE)
+    {
+        int diff = (next - current_time + 9999) / 10000;
+        if (diff < 0) diff = 0;
+        return diff;
     }
     return -1;  /* no pending timeouts */
 }
@@ -1588,6 +1752,7 @@ static struct fd *alloc_fd_object(void)
     fd->write_q    = NULL;
     fd->wait_q     = NULL;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     list_init( &fd->inode_entry );
     list_init( &fd->locks );
 
@@ -1623,6 +1788,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->write_q    = NULL;
     fd->wait_q     = NULL;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     fd->no_fd_status = STATUS_BAD_DEVICE_TYPE;
     list_init( &fd->inode_entry );
     list_init( &fd->locks );
@@ -2196,6 +2362,11 @@ static struct fd *get_handle_fd_obj( struct process *process, obj_handle_t handl
     return fd;
 }
 
+unsigned int fd_get_comp_flags( struct fd *fd )
+{
+    return fd->comp_flags;
+}
+
 struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key )
 {
     *p_key = fd->comp_key;
@@ -2206,6 +2377,7 @@ void fd_copy_completion( struct fd *src, struct fd *dst )
 {
     assert( !dst->completion );
     dst->completion = fd_get_completion( src, &dst->comp_key );
+    dst->comp_flags = src->comp_flags;
 }
 
 /* flush a file buffers */
@@ -2317,6 +2489,9 @@ DECL_HANDLER(register_async)
     case ASYNC_TYPE_WRITE:
         access = FILE_WRITE_DATA;
         break;
+    case ASYNC_TYPE_WAIT:
+        access = 0;
+        break;
     default:
         set_error( STATUS_INVALID_PARAMETER );
         return;
@@ -2365,8 +2540,36 @@ DECL_HANDLER(add_fd_completion)
     struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
     if (fd)
     {
-        if (fd->completion)
+        /* synchronous successes don't need a packet if the application asked for it,
+         * operations that returned STATUS_PENDING always get one */
+        if (fd->completion && (!req->sync || req->status ||
+                               !(fd->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)))
             add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
         release_object( fd );
     }
 }
+
+/* set the completion notification mode of a fd */
+DECL_HANDLER(set_fd_completion_mode)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        if (!(fd->options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)))
+            fd->comp_flags = req->flags;
+        else
+            set_error( STATUS_INVALID_PARAMETER );
+        release_object( fd );
+    }
+}
+
+/* check whether a fd is associated with a completion port */
+DECL_HANDLER(get_fd_completion)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        reply->bound = (fd->completion != NULL);
+        release_object( fd );
+    }
+}
@@ -124,6 +124,7 @@ extern void *create_named_object( struct namespace *namespace, const struct obje
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
@@ -164,6 +165,25 @@ extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_han
 extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern struct fd *get_event_esync_fd( struct object *obj, int *type );
+extern struct fd *cancel_event_esync_check( struct object *obj );
+
+/* semaphore functions */
+
+extern struct fd *get_semaphore_esync_fd( struct object *obj, int *type, unsigned int *max );
+extern struct fd *cancel_semaphore_esync_check( struct object *obj );
+
+/* esync functions */
+
+extern int do_esync(void);
+extern struct fd *create_esync_fd( struct object *obj, unsigned int count, int semaphore );
+extern unsigned int esync_read( struct fd *fd );
+extern int esync_grab( struct fd *fd );
+extern void esync_write( struct fd *fd, unsigned int count );
+extern int esync_signaled( struct fd *fd );
+extern int esync_add_queue( struct object *obj, struct fd *fd, struct wait_queue_entry *entry );
+extern void esync_remove_queue( struct object *obj, struct fd *fd, struct wait_queue_entry *entry );
+extern void esync_cancel_check( struct object *obj );
 
 /* mutex functions */
 
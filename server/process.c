@@ -336,6 +336,8 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->trace_data      = 0;
     process->rawinput_mouse  = NULL;
     process->rawinput_kbd    = NULL;
+    process->req_count       = 0;
+    process->req_time        = 0;
     list_init( &process->thread_list );
     list_init( &process->locks );
     list_init( &process->classes );
@@ -1292,3 +1294,27 @@ DECL_HANDLER(make_process_system)
             shutdown_timeout = add_timeout_user( master_socket_timeout, server_shutdown_timeout, NULL );
     }
 }
+
+/* retrieve the number of requests and the time spent in them for every process */
+DECL_HANDLER(get_process_request_stats)
+{
+    struct process_request_stat *stat;
+    struct process *process;
+    data_size_t size;
+
+    LIST_FOR_EACH_ENTRY( process, &process_list, struct process, entry ) reply->count++;
+
+    size = min( reply->count, get_reply_max_size() / sizeof(*stat) ) * sizeof(*stat);
+    if (size < reply->count * sizeof(*stat)) set_error( STATUS_BUFFER_OVERFLOW );
+    if (!size || !(stat = set_reply_data_size( size ))) return;
+
+    LIST_FOR_EACH_ENTRY( process, &process_list, struct process, entry )
+    {
+        if (size < sizeof(*stat)) break;
+        stat->time  = process->req_time;
+        stat->pid   = process->id;
+        stat->count = process->req_count;
+        stat++;
+        size -= sizeof(*stat);
+    }
+}
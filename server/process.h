@@ -91,6 +91,8 @@ struct process
     struct list          rawinput_devices;/* list of registered rawinput devices */
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
+    unsigned int         req_count;       /* number of requests made by the process */
+    unsigned __int64     req_time;        /* time spent handling them, in nanoseconds */
 };
 
 struct process_snapshot
@@ -35,6 +35,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -60,6 +63,16 @@ struct notify
     struct process   *process;  /* process in which the hkey is valid */
 };
 
+/* hash index of the subkeys or values of a large key */
+struct name_index
+{
+    unsigned int      size;        /* number of buckets, always a power of 2 */
+    int               count;       /* number of indexed entries */
+    int               alloc;       /* allocated size of the next array */
+    int              *buckets;     /* position of the first entry of each bucket, -1 if empty */
+    int              *next;        /* position of the next entry in the same bucket, -1 if last */
+};
+
 /* a registry key */
 struct key
 {
@@ -71,13 +84,19 @@ struct key
     struct key       *parent;      /* parent key */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
+    int               sorted_subkeys; /* number of subkeys at the start of the array in sorted order */
     struct key      **subkeys;     /* subkeys array */
+    struct name_index *subkey_index; /* index of the subkeys for large keys */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
+    int               sorted_values; /* number of values at the start of the array in sorted order */
     struct key_value *values;      /* values array */
+    struct name_index *value_index; /* index of the values for large keys */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    unsigned int      hive_offset; /* offset of the key record in the hive, relative to the parent record */
+    unsigned int      hive_size;   /* size of the key record in the hive, 0 if not saved there */
 };
 
 /* key flags */
@@ -100,6 +119,12 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  64  /* min. number of subkeys or values to build a hash index */
+
+/* Keys with few entries keep their subkeys and values sorted and use a binary search.
+ * Above MIN_INDEXED entries, new entries are appended to the array and found through
+ * a hash index; the array is sorted again only when something needs the ordering,
+ * i.e. enumeration by index or saving. */
 
 #define MAX_NAME_LEN  255    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -119,18 +144,31 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static void free_index( struct name_index *index );
+static void sort_subkeys( struct key *key );
+static void sort_values( struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *hive_path;    /* path of the binary hive */
+    const char  *hive;         /* mapping of the last saved hive */
+    size_t       hive_size;    /* size of the hive mapping */
+    int          hive_stale;   /* hive needs to be saved even if the keys are clean */
+    int          text_stale;   /* text file is older than the hive */
+    int          text_exists;  /* text file has been loaded or saved */
+    file_pos_t   text_size;    /* size of the text file the hive corresponds to */
+    timeout_t    text_mtime;   /* modification time of the text file the hive corresponds to */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+static int save_branch( struct save_branch_info *info, int flush );
+
 
 /* information about a file being loaded */
 struct file_load_info
@@ -253,11 +291,13 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -407,12 +447,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free_index( key->value_index );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free_index( key->subkey_index );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -475,10 +517,16 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->flags       = 0;
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
+        key->sorted_subkeys = 0;
         key->subkeys     = NULL;
+        key->subkey_index = NULL;
         key->nb_values   = 0;
         key->last_value  = -1;
+        key->sorted_values = 0;
         key->values      = NULL;
+        key->value_index = NULL;
+        key->hive_offset = 0;
+        key->hive_size   = 0;
         key->modif       = modif;
         key->parent      = NULL;
         list_init( &key->notify_list );
@@ -540,6 +588,191 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change & ~REG_NOTIFY_CHANGE_LAST_SET, 0 );
 }
 
+/* compare two entry names, in the order used for the subkeys and values arrays */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmpW( name1, name2, min( len1, len2 ) / sizeof(WCHAR) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct key *key1 = *(const struct key * const *)ptr1;
+    const struct key *key2 = *(const struct key * const *)ptr2;
+    return compare_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+static int compare_values( const void *ptr1, const void *ptr2 )
+{
+    const struct key_value *value1 = ptr1;
+    const struct key_value *value2 = ptr2;
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+/* sort an array whose first 'sorted' entries are already in order */
+static int sort_entries( void *base, int count, int sorted, size_t size,
+                         int (*compare)( const void *, const void * ) )
+{
+    char *array = base, *tmp, *left, *right, *dst;
+    char *left_end = array + sorted * size, *right_end = array + count * size;
+
+    if (sorted >= count) return 1;
+    qsort( left_end, count - sorted, size, compare );
+    if (!sorted) return 1;
+    if (!(tmp = malloc( sorted * size ))) return 0;
+
+    /* merge the new entries with the sorted part */
+    memcpy( tmp, array, sorted * size );
+    left = tmp;
+    right = left_end;
+    dst = array;
+    left_end = tmp + sorted * size;
+    while (left < left_end && right < right_end)
+    {
+        if (compare( right, left ) < 0)
+        {
+            memcpy( dst, right, size );
+            right += size;
+        }
+        else
+        {
+            memcpy( dst, left, size );
+            left += size;
+        }
+        dst += size;
+    }
+    memcpy( dst, left, left_end - left );
+    free( tmp );
+    return 1;
+}
+
+static void free_index( struct name_index *index )
+{
+    if (!index) return;
+    free( index->buckets );
+    free( index->next );
+    free( index );
+}
+
+/* add the entry at a given array position to an index */
+static int add_to_index( struct name_index *index, const WCHAR *name, data_size_t len, int pos )
+{
+    unsigned int bucket = hash_strW( name, len ) & (index->size - 1);
+
+    if (pos >= index->alloc)
+    {
+        int alloc = max( index->alloc * 2, pos + 1 );
+        int *next = realloc( index->next, alloc * sizeof(*next) );
+        if (!next) return 0;
+        index->next = next;
+        index->alloc = alloc;
+    }
+    index->next[pos] = index->buckets[bucket];
+    index->buckets[bucket] = pos;
+    index->count++;
+    return 1;
+}
+
+/* remove the entry at a given array position from an index */
+static void remove_from_index( struct name_index *index, const WCHAR *name, data_size_t len, int pos )
+{
+    int *ptr = &index->buckets[hash_strW( name, len ) & (index->size - 1)];
+
+    while (*ptr != pos)
+    {
+        assert( *ptr != -1 );
+        ptr = &index->next[*ptr];
+    }
+    *ptr = index->next[pos];
+    index->count--;
+}
+
+/* allocate an empty index with enough buckets for a given number of entries */
+static struct name_index *alloc_index( int count )
+{
+    struct name_index *index;
+    unsigned int i, size = 16;
+
+    while (size < count) size *= 2;
+    if (!(index = mem_alloc( sizeof(*index) ))) return NULL;
+    index->size  = size;
+    index->count = 0;
+    index->alloc = 0;
+    index->next  = NULL;
+    if (!(index->buckets = mem_alloc( size * sizeof(*index->buckets) )))
+    {
+        free( index );
+        return NULL;
+    }
+    for (i = 0; i < size; i++) index->buckets[i] = -1;
+    return index;
+}
+
+/* (re)build the subkeys index of a key; on failure the key goes back to binary searches */
+static void build_subkey_index( struct key *key )
+{
+    int i;
+
+    free_index( key->subkey_index );
+    if (!(key->subkey_index = alloc_index( key->last_subkey + 1 ))) goto failed;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!add_to_index( key->subkey_index, key->subkeys[i]->name, key->subkeys[i]->namelen, i ))
+            goto failed;
+    return;
+
+failed:
+    free_index( key->subkey_index );
+    key->subkey_index = NULL;
+    sort_subkeys( key );
+}
+
+/* (re)build the values index of a key; on failure the key goes back to binary searches */
+static void build_value_index( struct key *key )
+{
+    int i;
+
+    free_index( key->value_index );
+    if (!(key->value_index = alloc_index( key->last_value + 1 ))) goto failed;
+    for (i = 0; i <= key->last_value; i++)
+        if (!add_to_index( key->value_index, key->values[i].name, key->values[i].namelen, i ))
+            goto failed;
+    return;
+
+failed:
+    free_index( key->value_index );
+    key->value_index = NULL;
+    sort_values( key );
+}
+
+/* make sure the subkeys array is entirely sorted */
+static void sort_subkeys( struct key *key )
+{
+    if (key->sorted_subkeys > key->last_subkey) return;
+    if (!sort_entries( key->subkeys, key->last_subkey + 1, key->sorted_subkeys,
+                       sizeof(*key->subkeys), compare_subkeys ))
+    {
+        /* no memory for merging, sort everything in place */
+        qsort( key->subkeys, key->last_subkey + 1, sizeof(*key->subkeys), compare_subkeys );
+    }
+    key->sorted_subkeys = key->last_subkey + 1;
+    if (key->subkey_index) build_subkey_index( key );
+}
+
+/* make sure the values array is entirely sorted */
+static void sort_values( struct key *key )
+{
+    if (key->sorted_values > key->last_value) return;
+    if (!sort_entries( key->values, key->last_value + 1, key->sorted_values,
+                       sizeof(*key->values), compare_values ))
+    {
+        /* no memory for merging, sort everything in place */
+        qsort( key->values, key->last_value + 1, sizeof(*key->values), compare_values );
+    }
+    key->sorted_values = key->last_value + 1;
+    if (key->value_index) build_value_index( key );
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -585,9 +818,25 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
-        parent->subkeys[index] = key;
+        if (parent->subkey_index)
+        {
+            /* indexed keys get new subkeys appended, they will be sorted when needed */
+            parent->subkeys[++parent->last_subkey] = key;
+            if (!add_to_index( parent->subkey_index, key->name, key->namelen, parent->last_subkey ))
+            {
+                free_index( parent->subkey_index );
+                parent->subkey_index = NULL;
+                sort_subkeys( parent );
+            }
+        }
+        else
+        {
+            for (i = ++parent->last_subkey; i > index; i--)
+                parent->subkeys[i] = parent->subkeys[i-1];
+            parent->subkeys[index] = key;
+            parent->sorted_subkeys++;
+            if (parent->last_subkey + 1 >= MIN_INDEXED) build_subkey_index( parent );
+        }
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -604,8 +853,21 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
+    if (parent->subkey_index && index == parent->last_subkey)
+        remove_from_index( parent->subkey_index, key->name, key->namelen, index );
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    if (index < parent->sorted_subkeys) parent->sorted_subkeys--;
+    if (parent->subkey_index)
+    {
+        if (parent->last_subkey + 1 < MIN_INDEXED / 2)
+        {
+            free_index( parent->subkey_index );
+            parent->subkey_index = NULL;
+            sort_subkeys( parent );
+        }
+        else if (index <= parent->last_subkey) build_subkey_index( parent );
+    }
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -630,6 +892,21 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index)
+    {
+        const struct name_index *idx = key->subkey_index;
+
+        for (i = idx->buckets[hash_strW( name->str, name->len ) & (idx->size - 1)]; i != -1; i = idx->next[i])
+        {
+            if (key->subkeys[i]->namelen != name->len) continue;
+            if (memicmpW( key->subkeys[i]->name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = i;
+            return key->subkeys[i];
+        }
+        *index = key->last_subkey + 1;  /* new subkeys are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -861,7 +1138,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     int i;
@@ -877,6 +1154,7 @@ static void enum_key( const struct key *key, int index, int info_class,
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -962,9 +1240,10 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
+    /* search from the end, recursive deletes remove the last subkey first */
+    for (index = parent->last_subkey; index >= 0; index--)
         if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    assert( index >= 0 );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1010,6 +1289,21 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index)
+    {
+        const struct name_index *idx = key->value_index;
+
+        for (i = idx->buckets[hash_strW( name->str, name->len ) & (idx->size - 1)]; i != -1; i = idx->next[i])
+        {
+            if (key->values[i].namelen != name->len) continue;
+            if (memicmpW( key->values[i].name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = i;
+            return &key->values[i];
+        }
+        *index = key->last_value + 1;  /* new values are appended */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1047,12 +1341,31 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
+    if (key->value_index) index = key->last_value + 1;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+
+    if (key->value_index)
+    {
+        /* indexed keys get new values appended, they will be sorted when needed */
+        if (!add_to_index( key->value_index, new_name, name->len, index ))
+        {
+            free_index( key->value_index );
+            key->value_index = NULL;
+            sort_values( key );
+            find_value( key, name, &index );
+            value = &key->values[index];
+        }
+    }
+    else
+    {
+        key->sorted_values++;
+        if (key->last_value + 1 >= MIN_INDEXED) build_value_index( key );
+    }
     return value;
 }
 
@@ -1135,6 +1448,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1187,10 +1501,23 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_index && index == key->last_value)
+        remove_from_index( key->value_index, value->name, value->namelen, index );
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
+    if (index < key->sorted_values) key->sorted_values--;
+    if (key->value_index)
+    {
+        if (key->last_value + 1 < MIN_INDEXED / 2)
+        {
+            free_index( key->value_index );
+            key->value_index = NULL;
+            sort_values( key );
+        }
+        else if (index <= key->last_value) build_value_index( key );
+    }
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1623,6 +1950,455 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     free( info.tmp );
 }
 
+/* create a temp file in the same directory as path */
+static int create_temp_file( const char *path, char **tmp_ret )
+{
+    char *p, *tmp;
+    int fd, count = 0;
+
+    *tmp_ret = NULL;
+    if (!(tmp = malloc( strlen(path) + 20 ))) return -1;
+    strcpy( tmp, path );
+    if ((p = strrchr( tmp, '/' ))) p++;
+    else p = tmp;
+    for (;;)
+    {
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST)
+        {
+            free( tmp );
+            return -1;
+        }
+    }
+    *tmp_ret = tmp;
+    return fd;
+}
+
+/*
+ * The binary hive is a cache of a registry text file that can be mapped and
+ * loaded without any parsing. It is only used when the text file still has
+ * the size and modification time recorded in the header; the text file stays
+ * the reference format and is rewritten when the server exits. The header
+ * also records whether the hive holds changes that the text file is missing,
+ * so that the text file can be brought up to date after an unclean shutdown.
+ *
+ * The header is followed by the record of the branch root key. A key record
+ * holds the key name and class, followed by the value records and then the
+ * records of the subkeys in sorted order. All records are aligned to 8 bytes.
+ * Since the size of a record includes all its subkeys, the record of a key
+ * whose subtree has not been modified is copied as is when saving again.
+ */
+
+#define HIVE_MAGIC   "WINEHIVE"
+#define HIVE_VERSION 1
+#define HIVE_ALIGN(size) (((size) + 7) & ~7)
+#define HIVE_NO_OFFSET (~0u)
+
+struct hive_header
+{
+    char          magic[8];      /* HIVE_MAGIC */
+    unsigned int  version;       /* HIVE_VERSION */
+    unsigned int  prefix_type;   /* prefix type of the registry */
+    file_pos_t    text_size;     /* size of the corresponding text file */
+    timeout_t     text_mtime;    /* modification time of the corresponding text file */
+    unsigned int  data_size;     /* size of the data following the header */
+    unsigned int  text_stale;    /* the text file is missing changes stored in the hive */
+};
+
+struct hive_key
+{
+    timeout_t      modif;        /* last modification time */
+    unsigned int   size;         /* size of the record, including values and subkeys */
+    unsigned int   flags;        /* key flags (only KEY_SYMLINK) */
+    unsigned short namelen;      /* length of key name */
+    unsigned short classlen;     /* length of class name */
+    unsigned int   nb_values;    /* number of value records */
+    unsigned int   nb_subkeys;   /* number of subkey records */
+    unsigned int   reserved;
+    /* followed by the name and class */
+};
+
+struct hive_value
+{
+    unsigned short namelen;      /* length of value name */
+    unsigned short type;         /* value type */
+    data_size_t    len;          /* value data length in bytes */
+    /* followed by the name and data */
+};
+
+/* buffer holding a hive being saved */
+struct hive_buffer
+{
+    char        *data;
+    size_t       size;
+    size_t       pos;
+    const char  *old;            /* key data of the previously saved hive */
+    size_t       old_size;
+};
+
+/* get the hive file name for a text registry file name */
+static char *get_hive_path( const char *path )
+{
+    size_t len = strlen( path );
+    char *ret;
+
+    if (len > 4 && !strcmp( path + len - 4, ".reg" )) len -= 4;
+    if ((ret = malloc( len + sizeof(".hive") )))
+    {
+        memcpy( ret, path, len );
+        strcpy( ret + len, ".hive" );
+    }
+    return ret;
+}
+
+/* check that a key record and all its subkeys are within bounds */
+static int check_hive_key( const char *base, unsigned int offset, unsigned int end )
+{
+    const struct hive_key *hkey;
+    const struct hive_value *hvalue;
+    unsigned int i, pos;
+
+    if (end - offset < sizeof(*hkey)) return 0;
+    hkey = (const struct hive_key *)(base + offset);
+    if (hkey->size > end - offset || hkey->size < sizeof(*hkey)) return 0;
+    if (hkey->namelen > MAX_NAME_LEN * sizeof(WCHAR) || hkey->namelen % sizeof(WCHAR)) return 0;
+    if (hkey->classlen % sizeof(WCHAR)) return 0;
+    if (sizeof(*hkey) + hkey->namelen + hkey->classlen > hkey->size) return 0;
+    end = offset + hkey->size;
+    pos = offset + HIVE_ALIGN( sizeof(*hkey) + hkey->namelen + hkey->classlen );
+
+    for (i = 0; i < hkey->nb_values; i++)
+    {
+        if (pos > end || end - pos < sizeof(*hvalue)) return 0;
+        hvalue = (const struct hive_value *)(base + pos);
+        if (hvalue->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || hvalue->namelen % sizeof(WCHAR)) return 0;
+        if (hvalue->namelen > end - pos - sizeof(*hvalue)) return 0;
+        if (hvalue->len > end - pos - sizeof(*hvalue) - hvalue->namelen) return 0;
+        pos += HIVE_ALIGN( sizeof(*hvalue) + hvalue->namelen + hvalue->len );
+    }
+    for (i = 0; i < hkey->nb_subkeys; i++)
+    {
+        if (pos > end || !check_hive_key( base, pos, end )) return 0;
+        pos += ((const struct hive_key *)(base + pos))->size;
+    }
+    return pos == end;
+}
+
+/* create the values and subkeys of a key from its hive record */
+static int load_hive_key( struct key *key, const char *record )
+{
+    const struct hive_key *hkey = (const struct hive_key *)record;
+    const char *ptr = record + sizeof(*hkey) + hkey->namelen;
+    struct unicode_str name;
+    unsigned int i;
+    int index;
+
+    key->modif = hkey->modif;
+    key->flags |= hkey->flags & KEY_SYMLINK;
+    if (hkey->classlen)
+    {
+        free( key->class );
+        key->classlen = 0;
+        if (!(key->class = memdup( ptr, hkey->classlen ))) return 0;
+        key->classlen = hkey->classlen;
+    }
+    ptr = record + HIVE_ALIGN( sizeof(*hkey) + hkey->namelen + hkey->classlen );
+
+    for (i = 0; i < hkey->nb_values; i++)
+    {
+        const struct hive_value *hvalue = (const struct hive_value *)ptr;
+        struct key_value *value;
+        void *data = NULL;
+
+        name.str = (const WCHAR *)(hvalue + 1);
+        name.len = hvalue->namelen;
+        if (hvalue->len && !(data = memdup( (const char *)name.str + name.len, hvalue->len ))) return 0;
+        if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+        {
+            free( data );
+            return 0;
+        }
+        free( value->data );
+        value->data = data;
+        value->len  = hvalue->len;
+        value->type = hvalue->type;
+        ptr += HIVE_ALIGN( sizeof(*hvalue) + hvalue->namelen + hvalue->len );
+    }
+
+    for (i = 0; i < hkey->nb_subkeys; i++)
+    {
+        const struct hive_key *hsubkey = (const struct hive_key *)ptr;
+        struct key *subkey;
+
+        name.str = (const WCHAR *)(hsubkey + 1);
+        name.len = hsubkey->namelen;
+        if (!(subkey = find_subkey( key, &name, &index )) &&
+            !(subkey = alloc_subkey( key, &name, index, hsubkey->modif )))
+            return 0;
+        if (!load_hive_key( subkey, ptr )) return 0;
+        subkey->hive_offset = ptr - record;
+        ptr += hsubkey->size;
+    }
+    key->hive_size = hkey->size;
+    return 1;
+}
+
+/* load a registry branch from its hive if it is up to date with the text file */
+static int load_hive( struct save_branch_info *info, const struct stat *text_st )
+{
+#ifdef HAVE_SYS_MMAN_H
+    const struct hive_header *header;
+    struct stat st;
+    void *ptr;
+    int fd;
+
+    if (!info->hive_path || (fd = open( info->hive_path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < (off_t)(sizeof(*header) + sizeof(struct hive_key)) ||
+        st.st_size > UINT_MAX ||
+        (ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    header = ptr;
+    if (memcmp( header->magic, HIVE_MAGIC, sizeof(header->magic) ) ||
+        header->version != HIVE_VERSION ||
+        header->text_size != text_st->st_size ||
+        header->text_mtime != text_st->st_mtime ||
+        header->data_size != st.st_size - sizeof(*header) ||
+        (prefix_type != PREFIX_UNKNOWN && header->prefix_type != prefix_type) ||
+        !check_hive_key( (const char *)(header + 1), 0, header->data_size ))
+    {
+        munmap( ptr, st.st_size );
+        return 0;
+    }
+
+    if (debug_level > 1) fprintf( stderr, "%s: loading hive\n", info->hive_path );
+    if (!load_hive_key( info->key, (const char *)(header + 1) ))
+    {
+        /* out of memory, there is no point in trying the text file */
+        fatal_error( "could not load registry hive %s\n", info->hive_path );
+    }
+    info->key->hive_offset = 0;
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+    info->text_stale = header->text_stale;
+    info->hive = ptr;
+    info->hive_size = st.st_size;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* release the mapping of the previously saved hive */
+static void unmap_hive( struct save_branch_info *info )
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (info->hive) munmap( (void *)info->hive, info->hive_size );
+#endif
+    info->hive = NULL;
+    info->hive_size = 0;
+}
+
+/* make room in the hive buffer */
+static void *reserve_hive_space( struct hive_buffer *buffer, size_t size )
+{
+    void *ret;
+
+    if (buffer->pos + size > buffer->size)
+    {
+        size_t new_size = max( buffer->size * 2, buffer->pos + size );
+        char *new_data = realloc( buffer->data, new_size );
+
+        if (!new_data) return NULL;
+        buffer->data = new_data;
+        buffer->size = new_size;
+    }
+    ret = buffer->data + buffer->pos;
+    memset( ret, 0, size );
+    buffer->pos += size;
+    return ret;
+}
+
+/* store a key and its subkeys into the hive buffer; old_offset is the position of the
+ * previous record of the key in the old hive, or HIVE_NO_OFFSET */
+static int save_hive_key( struct hive_buffer *buffer, struct key *key, unsigned int old_offset )
+{
+    struct hive_key *hkey;
+    struct hive_value *hvalue;
+    size_t start = buffer->pos;
+    unsigned int nb_subkeys = 0;
+    char *ptr;
+    int i;
+
+    if (old_offset != HIVE_NO_OFFSET && !(key->flags & KEY_DIRTY) && key->hive_size &&
+        old_offset <= buffer->old_size && key->hive_size <= buffer->old_size - old_offset)
+    {
+        /* nothing changed in this subtree since the last save, reuse the old record */
+        if (!(ptr = reserve_hive_space( buffer, key->hive_size ))) return 0;
+        memcpy( ptr, buffer->old + old_offset, key->hive_size );
+        return 1;
+    }
+
+    sort_subkeys( key );
+    sort_values( key );
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) nb_subkeys++;
+
+    if (!(ptr = reserve_hive_space( buffer, HIVE_ALIGN( sizeof(*hkey) + key->namelen + key->classlen ))))
+        return 0;
+    hkey = (struct hive_key *)ptr;
+    hkey->modif      = key->modif;
+    hkey->flags      = key->flags & KEY_SYMLINK;
+    hkey->namelen    = key->namelen;
+    hkey->classlen   = key->classlen;
+    hkey->nb_values  = key->last_value + 1;
+    hkey->nb_subkeys = nb_subkeys;
+    memcpy( hkey + 1, key->name, key->namelen );
+    memcpy( (char *)(hkey + 1) + key->namelen, key->class, key->classlen );
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[i];
+
+        if (!(ptr = reserve_hive_space( buffer, HIVE_ALIGN( sizeof(*hvalue) + value->namelen + value->len ))))
+            return 0;
+        hvalue = (struct hive_value *)ptr;
+        hvalue->namelen = value->namelen;
+        hvalue->type    = value->type;
+        hvalue->len     = value->len;
+        memcpy( hvalue + 1, value->name, value->namelen );
+        memcpy( (char *)(hvalue + 1) + value->namelen, value->data, value->len );
+    }
+
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        struct key *subkey = key->subkeys[i];
+        unsigned int offset = HIVE_NO_OFFSET;
+        size_t subkey_start = buffer->pos;
+
+        if (subkey->flags & KEY_VOLATILE) continue;
+        if (old_offset != HIVE_NO_OFFSET && key->hive_size && subkey->hive_size)
+            offset = old_offset + subkey->hive_offset;
+        if (!save_hive_key( buffer, subkey, offset )) return 0;
+        subkey->hive_offset = subkey_start - start;
+    }
+
+    /* the buffer may have been reallocated */
+    hkey = (struct hive_key *)(buffer->data + start);
+    hkey->size = key->hive_size = buffer->pos - start;
+    return 1;
+}
+
+/* save a registry branch to its hive, reusing the unmodified parts of the previous one;
+ * text_stale tells whether the text file will be missing some of the saved changes */
+static int save_hive( struct save_branch_info *info, int text_stale )
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct hive_buffer buffer;
+    struct hive_header *header;
+    struct key *key = info->key;
+    char *tmp = NULL;
+    size_t pos;
+    ssize_t ret;
+    int fd = -1;
+    void *ptr;
+
+    if (!info->hive_path) return 0;
+
+    buffer.size = max( info->hive_size, 4096 );
+    buffer.pos  = 0;
+    if (info->hive && key->hive_size)
+    {
+        buffer.old      = info->hive + sizeof(*header);
+        buffer.old_size = info->hive_size - sizeof(*header);
+    }
+    else
+    {
+        buffer.old      = NULL;
+        buffer.old_size = 0;
+    }
+    if (!(buffer.data = malloc( buffer.size ))) return 0;
+
+    if (!(header = reserve_hive_space( &buffer, sizeof(*header) ))) goto failed;
+    if (!save_hive_key( &buffer, key, buffer.old ? 0 : HIVE_NO_OFFSET )) goto failed;
+    if (buffer.pos > UINT_MAX) goto failed;
+    key->hive_offset = 0;
+
+    header = (struct hive_header *)buffer.data;
+    memcpy( header->magic, HIVE_MAGIC, sizeof(header->magic) );
+    header->version    = HIVE_VERSION;
+    header->prefix_type = prefix_type;
+    header->text_size  = info->text_size;
+    header->text_mtime = info->text_mtime;
+    header->data_size  = buffer.pos - sizeof(*header);
+    header->text_stale = text_stale;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->hive_path );
+        dump_operation( key, NULL, "saving hive" );
+    }
+
+    if ((fd = create_temp_file( info->hive_path, &tmp )) == -1) goto failed;
+    for (pos = 0; pos < buffer.pos; pos += ret)
+    {
+        if ((ret = write( fd, buffer.data + pos, buffer.pos - pos )) > 0) continue;
+        if (ret == -1 && errno == EINTR) { ret = 0; continue; }
+        goto failed;
+    }
+    if (close( fd )) goto failed;
+    fd = -1;
+    if (rename( tmp, info->hive_path )) goto failed;
+    free( tmp );
+
+    /* map the new hive to be able to reuse it on the next save */
+    unmap_hive( info );
+    if ((fd = open( info->hive_path, O_RDONLY )) != -1)
+    {
+        if ((ptr = mmap( NULL, buffer.pos, PROT_READ, MAP_PRIVATE, fd, 0 )) != MAP_FAILED)
+        {
+            info->hive = ptr;
+            info->hive_size = buffer.pos;
+        }
+        close( fd );
+    }
+    free( buffer.data );
+    info->hive_stale = 0;
+    return 1;
+
+failed:
+    /* the records of the keys no longer match the old hive */
+    unmap_hive( info );
+    if (fd != -1) close( fd );
+    if (tmp)
+    {
+        unlink( tmp );
+        free( tmp );
+    }
+    free( buffer.data );
+    info->hive_stale = 1;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+/* forget the saved hives, the keys have been modified behind our back */
+static void discard_hives(void)
+{
+    int i;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        unmap_hive( &save_branch_info[i] );
+        save_branch_info[i].hive_stale = 1;
+    }
+}
+
 /* load a part of the registry from a file */
 static void load_registry( struct key *key, obj_handle_t handle )
 {
@@ -1639,6 +2415,8 @@ static void load_registry( struct key *key, obj_handle_t handle )
         {
             load_keys( key, NULL, f, -1 );
             fclose( f );
+            /* the loaded keys are not marked dirty */
+            discard_hives();
         }
         else file_set_error();
     }
@@ -1647,25 +2425,45 @@ static void load_registry( struct key *key, obj_handle_t handle )
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info info;
+    struct stat st;
+    int loaded = 0;
     FILE *f;
 
-    if ((f = fopen( filename, "r" )))
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    memset( &info, 0, sizeof(info) );
+    info.path = filename;
+    info.key = key;
+    info.hive_path = get_hive_path( filename );
+
+    if (stat( filename, &st ) != -1)
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        info.text_exists = 1;
+        info.text_size   = st.st_size;
+        info.text_mtime  = st.st_mtime;
+        if (load_hive( &info, &st )) loaded = 1;
+        else if ((f = fopen( filename, "r" )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            loaded = 1;
+            info.hive_stale = 1;
+            load_keys( key, filename, f, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                /* never save over a file we don't understand */
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                free( info.hive_path );
+                return 1;
+            }
         }
     }
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
-
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    /* only register the branch once it has been loaded */
+    info.key = (struct key *)grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    save_branch_info[save_branch_count++] = info;
+    return loaded;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1735,6 +2533,7 @@ void init_registry(void)
     WCHAR *current_user_path;
     struct unicode_str current_user_str;
     struct key *key, *hklm, *hkcu;
+    int i;
 
     /* switch to the config dir */
 
@@ -1787,6 +2586,10 @@ void init_registry(void)
     release_object( hklm );
     release_object( hkcu );
 
+    /* the previous server didn't get to update the text files, do it now */
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].text_stale) save_branch( &save_branch_info[i], 1 );
+
     /* start the periodic save timer */
     set_periodic_save_timer();
 
@@ -1840,20 +2643,14 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* save a registry branch to a text file */
+static int save_text_branch( struct key *key, const char *path )
 {
     struct stat st;
-    char *p, *tmp = NULL;
-    int fd, count = 0, ret = 0;
+    char *tmp = NULL;
+    int fd, ret = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
-    {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
-    }
-
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -1870,17 +2667,7 @@ static int save_branch( struct key *key, const char *path )
 
     /* create a temp file in the same directory */
 
-    if (!(tmp = malloc( strlen(path) + 20 ))) goto done;
-    strcpy( tmp, path );
-    if ((p = strrchr( tmp, '/' ))) p++;
-    else p = tmp;
-    for (;;)
-    {
-        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
-        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
-        if (errno != EEXIST) goto done;
-        close( fd );
-    }
+    if ((fd = create_temp_file( path, &tmp )) == -1) goto done;
 
     /* now save to it */
 
@@ -1910,10 +2697,47 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
     return ret;
 }
 
+/* save a registry branch; the text file is only rewritten on flush, periodic saves use the hive */
+static int save_branch( struct save_branch_info *info, int flush )
+{
+    struct key *key = info->key;
+    struct stat st;
+
+    if (!(key->flags & KEY_DIRTY) && !info->hive_stale && !(flush && info->text_stale))
+    {
+        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
+        return 1;
+    }
+
+    if (!flush && info->text_exists)
+    {
+        /* the stale state is stored in the hive so that it survives an unclean shutdown */
+        int text_stale = info->text_stale || (key->flags & KEY_DIRTY);
+
+        if (save_hive( info, text_stale ))
+        {
+            info->text_stale = text_stale;
+            make_clean( key );
+            return 1;
+        }
+    }
+
+    if (!save_text_branch( key, info->path )) return 0;
+    info->text_stale = 0;
+    if (!stat( info->path, &st ))
+    {
+        info->text_exists = 1;
+        info->text_size   = st.st_size;
+        info->text_mtime  = st.st_mtime;
+        save_hive( info, 0 );
+    }
+    make_clean( key );
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -1922,7 +2746,7 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        save_branch( &save_branch_info[i], 0 );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -1942,7 +2766,7 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -47,6 +47,12 @@
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -77,6 +83,9 @@
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
 
+static struct request_stat request_stats[REQ_NB_REQUESTS];  /* statistics indexed by request code */
+static timeout_t request_stats_start;  /* time at which the statistics were reset */
+
 struct master_socket
 {
     struct object        obj;        /* object header */
@@ -188,6 +197,57 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
+/* wake up a client thread sleeping on its request slot */
+static void wake_request_slot( struct request_slot *slot )
+{
+#ifdef __NR_futex
+    if (slot->waiting) syscall( __NR_futex, &slot->reply_seq, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+}
+
+/* send a reply to the current thread through its request slot */
+static void send_slot_reply( struct request_slot *slot, union generic_reply *reply )
+{
+    int ret;
+
+    memcpy( &slot->reply, reply, sizeof(slot->reply) );
+    if (current->reply_size <= REQUEST_SLOT_DATA_SIZE)
+    {
+        if (current->reply_size) memcpy( slot->data, current->reply_data, current->reply_size );
+        interlocked_xchg_add( (int *)&slot->reply_seq, 1 );
+        wake_request_slot( slot );
+        free( current->reply_data );
+        current->reply_data = NULL;
+        return;
+    }
+
+    /* too large for the slot, the data follows on the reply pipe */
+    interlocked_xchg_add( (int *)&slot->reply_seq, 1 );
+    wake_request_slot( slot );
+    if ((ret = write( get_unix_fd( current->reply_fd ), current->reply_data, current->reply_size )) >= 0)
+    {
+        if ((current->reply_towrite = current->reply_size - ret))
+        {
+            /* couldn't write it all, wait for POLLOUT */
+            set_fd_events( current->reply_fd, POLLOUT );
+            set_fd_events( current->request_fd, 0 );
+            return;
+        }
+        free( current->reply_data );
+        current->reply_data = NULL;
+    }
+    else if (errno == EAGAIN)  /* the slot is Linux only, where EWOULDBLOCK is the same */
+    {
+        current->reply_towrite = current->reply_size;
+        set_fd_events( current->reply_fd, POLLOUT );
+        set_fd_events( current->request_fd, 0 );
+    }
+    else if (errno == EPIPE)
+        kill_thread( current, 0 );  /* normal death */
+    else
+        fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
+}
+
 /* send a reply to the current thread */
 static void send_reply( union generic_reply *reply )
 {
@@ -230,11 +290,51 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* get a monotonic time stamp in nanoseconds for the request statistics */
+static inline unsigned __int64 get_stats_time(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * (unsigned __int64)1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec * (unsigned __int64)1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+/* account for a request in the per-request and per-process statistics */
+static void update_request_stats( enum request req, struct process *process, unsigned __int64 start )
+{
+    struct request_stat *stat = &request_stats[req];
+    unsigned __int64 elapsed = get_stats_time() - start;
+    unsigned int usec = elapsed / 1000, bucket = 0;
+
+    while (usec && bucket < REQUEST_STAT_BUCKETS - 1)
+    {
+        usec >>= 1;
+        bucket++;
+    }
+    stat->count++;
+    stat->time += elapsed;
+    if (elapsed > stat->max_time) stat->max_time = min( elapsed, ~0u );
+    if (current && current->error) stat->errors++;
+    stat->histogram[bucket]++;
+    process->req_count++;
+    process->req_time += elapsed;
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    struct request_slot *slot = thread->request_slot;  /* the handler may set up a new one */
+    struct process *process = thread->process;
+    unsigned __int64 start = get_stats_time();
 
     current = thread;
     current->reply_size = 0;
@@ -244,7 +344,10 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
+    {
         req_handlers[req]( &current->req, &reply );
+        update_request_stats( req, process, start );
+    }
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
@@ -255,7 +358,8 @@ static void call_req_handler( struct thread *thread )
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            if (slot) send_slot_reply( slot, &reply );
+            else send_reply( &reply );
         }
         else
         {
@@ -287,6 +391,16 @@ void read_request( struct thread *thread )
                                   thread->req_toread, thread->req.request_header.req );
             return;
         }
+        if (thread->request_slot && thread->req_toread <= REQUEST_SLOT_DATA_SIZE)
+        {
+            /* the data has been stored in the request slot */
+            memcpy( thread->req_data, thread->request_slot->data, thread->req_toread );
+            thread->req_toread = 0;
+            call_req_handler( thread );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            return;
+        }
     }
 
     /* read the variable sized data */
@@ -315,6 +429,16 @@ error:
         fatal_protocol_error( thread, "read: %s\n", strerror( errno ));
 }
 
+/* unmap the request slot of a thread, waking it up if it's waiting for a reply */
+void free_request_slot( struct thread *thread )
+{
+    wake_request_slot( thread->request_slot );
+#ifdef HAVE_SYS_MMAN_H
+    munmap( thread->request_slot, sizeof(*thread->request_slot) );
+#endif
+    thread->request_slot = NULL;
+}
+
 /* receive a file descriptor on the process socket */
 int receive_fd( struct process *process )
 {
@@ -841,3 +965,16 @@ void close_master_socket( timeout_t timeout )
 
     master_timeout = add_timeout_user( timeout, close_socket_timeout, NULL );
 }
+
+/* retrieve the statistics of the requests handled by the server */
+DECL_HANDLER(get_request_stats)
+{
+    reply->start_time = request_stats_start ? request_stats_start : server_start_time;
+    reply->count = REQ_NB_REQUESTS;
+    set_reply_data( request_stats, min( sizeof(request_stats), get_reply_max_size() ));
+    if (req->reset)
+    {
+        memset( request_stats, 0, sizeof(request_stats) );
+        request_stats_start = current_time;
+    }
+}
@@ -31,6 +31,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
 #include "request.h"
@@ -41,22 +42,27 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct fd     *esync_fd; /* eventfd holding the count in esync mode */
+    int            esync_taken; /* unit taken out of the eventfd by a wait check */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -67,7 +73,7 @@ static const struct object_ops semaphore_ops =
     no_lookup_name,                /* lookup_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -89,6 +95,13 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->esync_fd = NULL;
+            sem->esync_taken = 0;
+            if (do_esync() && !(sem->esync_fd = create_esync_fd( &sem->obj, initial, 1 )))
+            {
+                release_object( sem );
+                return NULL;
+            }
             if (sd) default_set_sd( &sem->obj, sd, OWNER_SECURITY_INFORMATION|
                                                    GROUP_SECURITY_INFORMATION|
                                                    DACL_SECURITY_INFORMATION|
@@ -98,9 +111,36 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
     return sem;
 }
 
+/* in esync mode the count is taken out of the eventfd while we look at it;
+ * clients can only take units in the meantime, so the count we get is exact */
+static inline void esync_get_count( struct semaphore *sem )
+{
+    if (sem->esync_fd) sem->count = esync_read( sem->esync_fd );
+}
+
+static inline void esync_put_count( struct semaphore *sem )
+{
+    if (sem->esync_fd) esync_write( sem->esync_fd, sem->count );
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->esync_fd)
+    {
+        int ret;
+
+        esync_get_count( sem );
+        if (prev) *prev = sem->count;
+        if ((ret = (sem->count + count >= sem->count && sem->count + count <= sem->max)))
+            sem->count += count;
+        else
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+        esync_put_count( sem );
+        if (ret) wake_up( &sem->obj, count );
+        return ret;
+    }
+
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -124,7 +164,9 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    esync_get_count( sem );
     fprintf( stderr, "Semaphore count=%d max=%d ", sem->count, sem->max );
+    esync_put_count( sem );
     dump_object_name( &sem->obj );
     fputc( '\n', stderr );
 }
@@ -136,10 +178,32 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->esync_fd) return esync_add_queue( obj, sem->esync_fd, entry );
+    return add_queue( obj, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->esync_fd) esync_remove_queue( obj, sem->esync_fd, entry );
+    else remove_queue( obj, entry );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->esync_fd)
+    {
+        /* take the unit now, a client could grab it before we are satisfied otherwise */
+        if (!sem->esync_taken) sem->esync_taken = esync_grab( sem->esync_fd );
+        return sem->esync_taken;
+    }
     return (sem->count > 0);
 }
 
@@ -147,6 +211,12 @@ static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *en
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->esync_fd)
+    {
+        assert( sem->esync_taken );
+        sem->esync_taken = 0;
+        return;
+    }
     assert( sem->count );
     sem->count--;
 }
@@ -173,6 +243,33 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->esync_fd) release_object( sem->esync_fd );
+}
+
+struct fd *get_semaphore_esync_fd( struct object *obj, int *type, unsigned int *max )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops || !sem->esync_fd) return NULL;
+    *type = ESYNC_SEMAPHORE;
+    *max = sem->max;
+    return sem->esync_fd;
+}
+
+struct fd *cancel_semaphore_esync_check( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops || !sem->esync_fd) return NULL;
+    if (sem->esync_taken) esync_write( sem->esync_fd, 1 );
+    sem->esync_taken = 0;
+    return sem->esync_fd;
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -246,8 +343,10 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
+        esync_get_count( sem );
         reply->current = sem->count;
         reply->max = sem->max;
+        esync_put_count( sem );
         release_object( sem );
     }
 }
@@ -107,6 +107,7 @@ struct sock
     struct sock        *deferred;    /* socket that waits for a deferred accept */
     struct async_queue *read_q;      /* queue for asynchronous reads */
     struct async_queue *write_q;     /* queue for asynchronous writes */
+    struct async_queue *wait_q;      /* queue for operations completed by the client itself */
 };
 
 static void sock_dump( struct object *obj, int verbose );
@@ -536,6 +537,10 @@ static void sock_queue_async( struct fd *fd, const async_data_t *data, int type,
         if (!sock->write_q && !(sock->write_q = create_async_queue( sock->fd ))) return;
         queue = sock->write_q;
         break;
+    case ASYNC_TYPE_WAIT:
+        if (!sock->wait_q && !(sock->wait_q = create_async_queue( sock->fd ))) return;
+        queue = sock->wait_q;
+        break;
     default:
         set_error( STATUS_INVALID_PARAMETER );
         return;
@@ -570,6 +575,7 @@ static void sock_cancel_async( struct fd *fd, struct process *process, struct th
 
     n += async_wake_up_by( sock->read_q, process, thread, iosb, STATUS_CANCELLED );
     n += async_wake_up_by( sock->write_q, process, thread, iosb, STATUS_CANCELLED );
+    n += async_wake_up_by( sock->wait_q, process, thread, iosb, STATUS_CANCELLED );
     if (!n && iosb)
         set_error( STATUS_NOT_FOUND );
 }
@@ -592,6 +598,7 @@ static void sock_destroy( struct object *obj )
 
     free_async_queue( sock->read_q );
     free_async_queue( sock->write_q );
+    free_async_queue( sock->wait_q );
     if (sock->event) release_object( sock->event );
     if (sock->fd)
     {
@@ -618,6 +625,7 @@ static void init_sock(struct sock *sock)
     sock->deferred = NULL;
     sock->read_q  = NULL;
     sock->write_q = NULL;
+    sock->wait_q  = NULL;
     memset( sock->errors, 0, sizeof(sock->errors) );
 }
 
@@ -29,15 +29,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <time.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#if defined(__linux__) && !defined(F_GET_SEALS)
+#define F_GET_SEALS   1034
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW   0x0004
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -188,6 +197,7 @@ static inline void init_thread_structure( struct thread *thread )
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->request_slot    = NULL;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -276,6 +286,7 @@ static void cleanup_thread( struct thread *thread )
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    if (thread->request_slot) free_request_slot( thread );
     free( thread->suspend_context );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
@@ -655,7 +666,14 @@ static int check_wait( struct thread *thread )
          * want to do something when signaled, even if others are not */
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             not_ok |= !entry->obj->ops->signaled( entry->obj, entry );
-        if (not_ok) goto other_checks;
+        if (not_ok)
+        {
+            /* eventfd-based objects have to get back what they took out of the eventfd */
+            if (do_esync())
+                for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
+                    esync_cancel_check( entry->obj );
+            goto other_checks;
+        }
         /* Wait satisfied: tell it to all objects */
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             entry->obj->ops->satisfied( entry->obj, entry );
@@ -1309,6 +1327,48 @@ DECL_HANDLER(init_thread)
     if (wait_fd != -1) close( wait_fd );
 }
 
+/* set the shared memory to use for the requests of the current thread */
+DECL_HANDLER(set_request_slot)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(__linux__)
+    struct stat st;
+    void *ptr;
+    int fd, seals;
+
+    if ((fd = thread_get_inflight_fd( current, req->fd )) == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+    if (current->request_slot)
+    {
+        close( fd );
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    /* the client must not be able to resize the mapping under us, that would SIGBUS the server */
+    seals = fcntl( fd, F_GET_SEALS );
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*current->request_slot) || seals == -1 ||
+        (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW))
+    {
+        close( fd );
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    ptr = mmap( NULL, sizeof(*current->request_slot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED)
+    {
+        file_set_error();
+        return;
+    }
+    /* takes effect with the next request, the reply to this one still goes through the pipe */
+    current->request_slot = ptr;
+#else
+    set_error( STATUS_NOT_IMPLEMENTED );
+#endif
+}
+
 /* terminate a thread */
 DECL_HANDLER(terminate_thread)
 {
@@ -33,6 +33,23 @@ static inline WCHAR *strdupW( const WCHAR *str )
     return memdup( str, len );
 }
 
+/* case-insensitive FNV-1a hash of a string, with a final mix so that the low bits are usable */
+static inline unsigned int hash_strW( const WCHAR *str, data_size_t len )
+{
+    unsigned int hash = 2166136261u;
+
+    len /= sizeof(WCHAR);
+    while (len--)
+    {
+        hash ^= tolowerW(*str++);
+        hash *= 16777619;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    return hash;
+}
+
 extern int parse_strW( WCHAR *buffer, data_size_t *len, const char *src, char endchar );
 extern int dump_strW( const WCHAR *str, data_size_t len, FILE *f, const char escape[2] );
 